@@ -0,0 +1,107 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace dht {
+namespace bench {
+
+/** Prevents the compiler from optimizing away the computation of value */
+template <typename T>
+inline void doNotOptimize(T&& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * Times the operation of a benchmark: the operation is repeated until
+ * a sample lasts long enough, and the time per operation of several
+ * samples is reported.
+ */
+class Runner {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Result {
+        std::string name;
+        /** Operations per sample */
+        uint64_t iterations {0};
+        unsigned samples {0};
+        /** Median, minimum and maximum of the samples, in nanoseconds per operation */
+        double ns_per_op {0};
+        double ns_min {0};
+        double ns_max {0};
+    };
+
+    Runner(std::string name, std::chrono::nanoseconds sampleTime, unsigned samples)
+        : sampleTime_(sampleTime), samples_(samples) { result_.name = std::move(name); }
+
+    /** Times op */
+    template <typename Op>
+    void run(Op&& op) {
+        measure([&](uint64_t n) {
+            auto start = Clock::now();
+            for (uint64_t i = 0; i < n; i++)
+                op();
+            return Clock::now() - start;
+        });
+    }
+
+    /** Times op, calling setup (untimed) before each call */
+    template <typename Setup, typename Op>
+    void run(Setup&& setup, Op&& op) {
+        measure([&](uint64_t n) {
+            Clock::duration total {};
+            for (uint64_t i = 0; i < n; i++) {
+                setup();
+                auto start = Clock::now();
+                op();
+                total += Clock::now() - start;
+            }
+            return total;
+        });
+    }
+
+    const Result& result() const { return result_; }
+
+private:
+    void measure(const std::function<Clock::duration(uint64_t)>& loop);
+
+    std::chrono::nanoseconds sampleTime_;
+    unsigned samples_;
+    Result result_;
+};
+
+using Benchmark = std::function<void(Runner&)>;
+
+/** Registered benchmarks, by name */
+std::vector<std::pair<std::string, Benchmark>>& registry();
+
+/** Registers a benchmark at static initialization */
+struct Register {
+    Register(std::string name, Benchmark benchmark) {
+        registry().emplace_back(std::move(name), std::move(benchmark));
+    }
+};
+
+}
+}
@@ -0,0 +1,182 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "benchmark.h"
+
+#include <opendht/utils.h>
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace dht {
+namespace bench {
+
+std::vector<std::pair<std::string, Benchmark>>&
+registry()
+{
+    static std::vector<std::pair<std::string, Benchmark>> benchmarks;
+    return benchmarks;
+}
+
+void
+Runner::measure(const std::function<Clock::duration(uint64_t)>& loop)
+{
+    // warm up, then find the iteration count for a sample to last sampleTime_
+    uint64_t n = 1;
+    auto d = loop(n);
+    while (d < sampleTime_ and n < (1ull << 40)) {
+        auto ratio = d.count() > 0 ? (double)sampleTime_.count() / std::chrono::nanoseconds(d).count() : 100.;
+        n = std::max(n + 1, (uint64_t)(n * std::clamp(ratio * 1.2, 1., 100.)));
+        d = loop(n);
+    }
+
+    std::vector<double> samples;
+    samples.reserve(samples_);
+    for (unsigned i = 0; i < samples_; i++)
+        samples.emplace_back((double)std::chrono::nanoseconds(loop(n)).count() / n);
+    std::sort(samples.begin(), samples.end());
+
+    result_.iterations = n;
+    result_.samples = samples_;
+    result_.ns_per_op = samples[samples.size() / 2];
+    result_.ns_min = samples.front();
+    result_.ns_max = samples.back();
+}
+
+}
+}
+
+using namespace dht;
+
+static const constexpr struct option long_options[] = {
+    {"help",     no_argument,       nullptr, 'h'},
+    {"list",     no_argument,       nullptr, 'l'},
+    {"filter",   required_argument, nullptr, 'f'},
+    {"json",     required_argument, nullptr, 'j'},
+    {"time",     required_argument, nullptr, 't'},
+    {"samples",  required_argument, nullptr, 's'},
+    {nullptr,    0,                 nullptr,  0}
+};
+
+static void
+print_usage()
+{
+    std::cout << "Usage: opendht_benchmarks [options]" << std::endl << std::endl;
+    std::cout << "Micro-benchmarks of the OpenDHT core data structures." << std::endl << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  -h, --help           Show this help message and exit." << std::endl;
+    std::cout << "  -l, --list           List the benchmarks and exit." << std::endl;
+    std::cout << "  -f, --filter <text>  Only run the benchmarks whose name contains text." << std::endl;
+    std::cout << "  -j, --json <file>    Write the results as JSON to file ('-' for stdout)." << std::endl;
+    std::cout << "  -t, --time <ms>      Minimum duration of a sample (default 100)." << std::endl;
+    std::cout << "  -s, --samples <n>    Samples per benchmark (default 10)." << std::endl;
+}
+
+static std::string
+jsonEscape(const std::string& s)
+{
+    std::string ret;
+    for (auto c : s) {
+        if (c == '"' or c == '\\')
+            ret += '\\';
+        ret += c;
+    }
+    return ret;
+}
+
+/**
+ * Results in JSON, as read by benchmarks/compare.py:
+ * {"version": "<opendht version>",
+ *  "benchmarks": [{"name", "iterations", "samples", "ns_per_op", "ns_min", "ns_max"}, ...]}
+ */
+static void
+writeJson(std::ostream& out, const std::vector<bench::Runner::Result>& results)
+{
+    out << "{\n  \"version\": \"" << version() << "\",\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& r = results[i];
+        char line[512];
+        snprintf(line, sizeof(line),
+            "%s\n    {\"name\": \"%s\", \"iterations\": %llu, \"samples\": %u, "
+            "\"ns_per_op\": %.3f, \"ns_min\": %.3f, \"ns_max\": %.3f}",
+            i ? "," : "", jsonEscape(r.name).c_str(), (unsigned long long)r.iterations, r.samples,
+            r.ns_per_op, r.ns_min, r.ns_max);
+        out << line;
+    }
+    out << "\n  ]\n}\n";
+}
+
+int
+main(int argc, char** argv)
+{
+    std::string filter, json;
+    bool list = false;
+    std::chrono::milliseconds sampleTime {100};
+    unsigned samples = 10;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "hlf:j:t:s:", long_options, nullptr)) != -1) {
+        switch (opt) {
+        case 'l': list = true; break;
+        case 'f': filter = optarg; break;
+        case 'j': json = optarg; break;
+        case 't': sampleTime = std::chrono::milliseconds(strtoul(optarg, nullptr, 0)); break;
+        case 's': samples = std::max(1ul, strtoul(optarg, nullptr, 0)); break;
+        default:
+            print_usage();
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    auto& benchmarks = bench::registry();
+    std::sort(benchmarks.begin(), benchmarks.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+
+    std::vector<bench::Runner::Result> results;
+    for (const auto& b : benchmarks) {
+        if (not filter.empty() and b.first.find(filter) == std::string::npos)
+            continue;
+        if (list) {
+            std::cout << b.first << std::endl;
+            continue;
+        }
+        bench::Runner runner(b.first, sampleTime, samples);
+        b.second(runner);
+        const auto& r = runner.result();
+        char line[256];
+        snprintf(line, sizeof(line), "%-36s %14.1f ns/op  (min %.1f, max %.1f, %llu iterations)",
+            r.name.c_str(), r.ns_per_op, r.ns_min, r.ns_max, (unsigned long long)r.iterations);
+        (json == "-" ? std::cerr : std::cout) << line << std::endl;
+        results.emplace_back(r);
+    }
+
+    if (json == "-") {
+        writeJson(std::cout, results);
+    } else if (not json.empty()) {
+        std::ofstream out(json);
+        if (not out) {
+            std::cerr << "Can't open " << json << std::endl;
+            return 1;
+        }
+        writeJson(out, results);
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+# Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <https://www.gnu.org/licenses/>.
+"""
+Compares two results of opendht_benchmarks --json, and flags the
+benchmarks that became slower than the threshold.
+
+A benchmark is flagged if its median time per operation increased by more
+than the threshold, and its fastest sample is slower than the slowest
+sample of the baseline (to ignore noisy benchmarks).
+Exits with status 1 if any benchmark regressed.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        return {b['name']: b for b in json.load(f)['benchmarks']}
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare OpenDHT benchmark results')
+    parser.add_argument('baseline', help='JSON results of the reference build')
+    parser.add_argument('current', help='JSON results of the build to check')
+    parser.add_argument('-t', '--threshold', type=float, default=0.1,
+                        help='relative slowdown flagged as a regression (default 0.1)')
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+
+    regressions = 0
+    print('{:<36} {:>14} {:>14} {:>9}'.format('benchmark', 'baseline ns', 'current ns', 'change'))
+    for name in sorted(set(baseline) | set(current)):
+        if name not in current:
+            print('{:<36} {:>14.1f} {:>14} {:>9}'.format(name, baseline[name]['ns_per_op'], '-', 'removed'))
+            continue
+        if name not in baseline:
+            print('{:<36} {:>14} {:>14.1f} {:>9}'.format(name, '-', current[name]['ns_per_op'], 'new'))
+            continue
+        old, new = baseline[name], current[name]
+        change = new['ns_per_op'] / old['ns_per_op'] - 1 if old['ns_per_op'] else 0.
+        regressed = change > args.threshold and new['ns_min'] > old['ns_max']
+        regressions += regressed
+        print('{:<36} {:>14.1f} {:>14.1f} {:>+8.1f}%{}'.format(
+            name, old['ns_per_op'], new['ns_per_op'], change * 100, '  REGRESSION' if regressed else ''))
+
+    if regressions:
+        print('{} benchmark(s) regressed by more than {:.0f}%'.format(regressions, args.threshold * 100))
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
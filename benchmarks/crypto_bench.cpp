@@ -0,0 +1,53 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "benchmark.h"
+
+#include <opendht/crypto.h>
+
+using namespace dht;
+
+namespace {
+
+void
+hashBenchmark(bench::Runner& b, size_t size, size_t hashLength)
+{
+    Blob data(size, 0x2a);
+    Blob hash(hashLength);
+    b.run([&] {
+        crypto::hash(data.data(), data.size(), hash.data(), hash.size());
+        bench::doNotOptimize(hash);
+    });
+}
+
+bench::Register hash64("crypto/hash_64B", [](bench::Runner& b) {
+    hashBenchmark(b, 64, 32);
+});
+
+bench::Register hash1K("crypto/hash_1KB", [](bench::Runner& b) {
+    hashBenchmark(b, 1024, 32);
+});
+
+bench::Register hash64K("crypto/hash_64KB", [](bench::Runner& b) {
+    hashBenchmark(b, 64 * 1024, 32);
+});
+
+bench::Register hash1K512("crypto/hash_1KB_512bits", [](bench::Runner& b) {
+    hashBenchmark(b, 1024, 64);
+});
+
+}
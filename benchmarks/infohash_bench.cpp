@@ -0,0 +1,92 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "benchmark.h"
+
+#include <opendht/infohash.h>
+
+#include <random>
+
+using namespace dht;
+
+namespace {
+
+std::vector<InfoHash>
+randomHashes(size_t n)
+{
+    std::mt19937_64 rd(42);
+    std::vector<InfoHash> hashes;
+    hashes.reserve(n);
+    for (size_t i = 0; i < n; i++)
+        hashes.emplace_back(InfoHash::getRandom(rd));
+    return hashes;
+}
+
+bench::Register getHash("infohash/get", [](bench::Runner& b) {
+    std::string data(64, 'x');
+    b.run([&] {
+        bench::doNotOptimize(InfoHash::get(data));
+    });
+});
+
+bench::Register xorCmp("infohash/xor_cmp", [](bench::Runner& b) {
+    auto hashes = randomHashes(1024);
+    size_t i = 0;
+    b.run([&] {
+        const auto& target = hashes[i++ % hashes.size()];
+        bench::doNotOptimize(target.xorCmp(hashes[i % hashes.size()], hashes[(i + 1) % hashes.size()]));
+    });
+});
+
+bench::Register commonBits("infohash/common_bits", [](bench::Runner& b) {
+    auto hashes = randomHashes(1024);
+    size_t i = 0;
+    b.run([&] {
+        i++;
+        bench::doNotOptimize(InfoHash::commonBits(hashes[i % hashes.size()], hashes[(i + 1) % hashes.size()]));
+    });
+});
+
+bench::Register compare("infohash/compare", [](bench::Runner& b) {
+    auto hashes = randomHashes(1024);
+    size_t i = 0;
+    b.run([&] {
+        i++;
+        bench::doNotOptimize(hashes[i % hashes.size()] < hashes[(i + 1) % hashes.size()]);
+    });
+});
+
+bench::Register toString("infohash/to_string", [](bench::Runner& b) {
+    auto hashes = randomHashes(1024);
+    size_t i = 0;
+    b.run([&] {
+        bench::doNotOptimize(hashes[i++ % hashes.size()].toString());
+    });
+});
+
+bench::Register fromString("infohash/from_string", [](bench::Runner& b) {
+    auto hashes = randomHashes(1024);
+    std::vector<std::string> strings;
+    for (const auto& h : hashes)
+        strings.emplace_back(h.toString());
+    size_t i = 0;
+    b.run([&] {
+        bench::doNotOptimize(InfoHash(strings[i++ % strings.size()]));
+    });
+});
+
+}
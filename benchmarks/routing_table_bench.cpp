@@ -0,0 +1,93 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "benchmark.h"
+
+#include <opendht/routing_table.h>
+
+#include <random>
+
+using namespace dht;
+
+namespace {
+
+/* Nodes are good if they replied recently: these never did, so the table
+   is used at a time where their initial reply time is recent enough. */
+const time_point NOW = time_point::min() + Node::NODE_GOOD_TIME;
+
+/* Inserts nodes like Dht does, splitting the buckets containing myid when full */
+RoutingTable
+makeTable(const InfoHash& myid, size_t count, std::mt19937_64& rd)
+{
+    RoutingTable table {Bucket {AF_INET}};
+    sockaddr_in sin {};
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(4222);
+    for (size_t i = 0; i < count; i++) {
+        sin.sin_addr.s_addr = htonl((10u << 24) | (i + 1));
+        auto node = std::make_shared<Node>(InfoHash::getRandom(rd), SockAddr((const sockaddr*)&sin, sizeof(sin)), rd);
+        node->setTime(NOW);
+        while (true) {
+            auto b = table.findBucket(node->id);
+            if (b->nodes.size() < TARGET_NODES) {
+                b->nodes.emplace_back(std::move(node));
+                break;
+            }
+            if (not table.contains(b, myid) or not table.split(b))
+                break;
+        }
+    }
+    return table;
+}
+
+void
+findClosestBenchmark(bench::Runner& b, size_t count)
+{
+    std::mt19937_64 rd(42);
+    auto myid = InfoHash::getRandom(rd);
+    auto table = makeTable(myid, 100 * 1000, rd);
+    std::vector<InfoHash> targets;
+    for (size_t i = 0; i < 1024; i++)
+        targets.emplace_back(InfoHash::getRandom(rd));
+    size_t i = 0;
+    b.run([&] {
+        bench::doNotOptimize(table.findClosestNodes(targets[i++ % targets.size()], NOW, count));
+    });
+}
+
+bench::Register findClosest("routing_table/find_closest_8", [](bench::Runner& b) {
+    findClosestBenchmark(b, TARGET_NODES);
+});
+
+bench::Register findClosest14("routing_table/find_closest_14", [](bench::Runner& b) {
+    findClosestBenchmark(b, 14);
+});
+
+bench::Register findBucket("routing_table/find_bucket", [](bench::Runner& b) {
+    std::mt19937_64 rd(42);
+    auto myid = InfoHash::getRandom(rd);
+    auto table = makeTable(myid, 100 * 1000, rd);
+    std::vector<InfoHash> targets;
+    for (size_t i = 0; i < 1024; i++)
+        targets.emplace_back(InfoHash::getRandom(rd));
+    size_t i = 0;
+    b.run([&] {
+        bench::doNotOptimize(table.findBucket(targets[i++ % targets.size()]));
+    });
+});
+
+}
@@ -0,0 +1,83 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "benchmark.h"
+
+#include <opendht/scheduler.h>
+
+#include <random>
+
+using namespace dht;
+
+namespace {
+
+constexpr size_t JOBS {1000};
+
+std::vector<duration>
+randomDelays(size_t n)
+{
+    std::mt19937_64 rd(42);
+    std::uniform_int_distribution<duration::rep> dist(0, std::chrono::duration_cast<duration>(std::chrono::minutes(10)).count());
+    std::vector<duration> delays;
+    delays.reserve(n);
+    for (size_t i = 0; i < n; i++)
+        delays.emplace_back(dist(rd));
+    return delays;
+}
+
+bench::Register addRun("scheduler/add_run_1000", [](bench::Runner& b) {
+    auto delays = randomDelays(JOBS);
+    size_t ran = 0;
+    b.run([&] {
+        Scheduler scheduler;
+        auto now = scheduler.time();
+        for (const auto& d : delays)
+            scheduler.add(now + d, [&]{ ran++; });
+        scheduler.syncTime(now + std::chrono::hours(1));
+        scheduler.run();
+    });
+    bench::doNotOptimize(ran);
+});
+
+bench::Register addCancel("scheduler/add_cancel_1000", [](bench::Runner& b) {
+    auto delays = randomDelays(JOBS);
+    std::vector<Sp<Scheduler::Job>> jobs(JOBS);
+    b.run([&] {
+        Scheduler scheduler;
+        auto now = scheduler.time();
+        for (size_t i = 0; i < JOBS; i++)
+            jobs[i] = scheduler.add(now + delays[i], []{});
+        for (auto& job : jobs)
+            scheduler.cancel(job);
+    });
+});
+
+bench::Register edit("scheduler/edit", [](bench::Runner& b) {
+    auto delays = randomDelays(JOBS);
+    Scheduler scheduler;
+    auto now = scheduler.time();
+    std::vector<Sp<Scheduler::Job>> jobs;
+    for (const auto& d : delays)
+        jobs.emplace_back(scheduler.add(now + d, []{}));
+    size_t i = 0;
+    b.run([&] {
+        scheduler.edit(jobs[i % JOBS], now + delays[(i + 1) % JOBS]);
+        i++;
+    });
+});
+
+}
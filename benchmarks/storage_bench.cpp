@@ -0,0 +1,138 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "benchmark.h"
+
+#include <opendht/node.h>
+#include <opendht/scheduler.h>
+#include "storage.h"
+
+#include <algorithm>
+#include <random>
+
+using namespace dht;
+
+namespace {
+
+constexpr size_t VALUES {1000};
+
+std::vector<Sp<Value>>
+makeValues(size_t n)
+{
+    std::mt19937_64 rd(42);
+    std::vector<Sp<Value>> values;
+    values.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        auto v = std::make_shared<Value>(Blob(64, (uint8_t)i));
+        v->id = rd();
+        v->type = i % 4;
+        values.emplace_back(std::move(v));
+    }
+    return values;
+}
+
+/* Values stored at now, half of them expiring before later */
+void
+fill(Storage& storage, StorageBucket& bucket, const InfoHash& key, const std::vector<Sp<Value>>& values, time_point now)
+{
+    for (size_t i = 0; i < values.size(); i++) {
+        auto expiration = now + ((i % 2) ? std::chrono::minutes(5) : std::chrono::minutes(15));
+        storage.store(key, values[i], now, expiration, &bucket);
+    }
+}
+
+bench::Register store("storage/store_1000", [](bench::Runner& b) {
+    auto key = InfoHash::get("storage");
+    auto values = makeValues(VALUES);
+    auto now = clock::now();
+    std::unique_ptr<Storage> storage;
+    std::unique_ptr<StorageBucket> bucket;
+    b.run([&] {
+        storage = std::make_unique<Storage>(now);
+        bucket = std::make_unique<StorageBucket>();
+    }, [&] {
+        fill(*storage, *bucket, key, values, now);
+    });
+});
+
+bench::Register refresh("storage/store_existing", [](bench::Runner& b) {
+    auto key = InfoHash::get("storage");
+    auto values = makeValues(VALUES);
+    auto now = clock::now();
+    Storage storage(now);
+    StorageBucket bucket;
+    fill(storage, bucket, key, values, now);
+    size_t i = 0;
+    b.run([&] {
+        const auto& v = values[i++ % values.size()];
+        bench::doNotOptimize(storage.store(key, v, now, now + std::chrono::minutes(10), &bucket));
+    });
+});
+
+bench::Register get("storage/get_all_1000", [](bench::Runner& b) {
+    auto key = InfoHash::get("storage");
+    auto values = makeValues(VALUES);
+    auto now = clock::now();
+    Storage storage(now);
+    StorageBucket bucket;
+    fill(storage, bucket, key, values, now);
+    b.run([&] {
+        bench::doNotOptimize(storage.get());
+    });
+});
+
+bench::Register getFiltered("storage/get_filtered_1000", [](bench::Runner& b) {
+    auto key = InfoHash::get("storage");
+    auto values = makeValues(VALUES);
+    auto now = clock::now();
+    Storage storage(now);
+    StorageBucket bucket;
+    fill(storage, bucket, key, values, now);
+    auto filter = Where().valueType(2).getFilter();
+    b.run([&] {
+        bench::doNotOptimize(storage.get(filter));
+    });
+});
+
+bench::Register expireNone("storage/expire_none_1000", [](bench::Runner& b) {
+    auto key = InfoHash::get("storage");
+    auto values = makeValues(VALUES);
+    auto now = clock::now();
+    Storage storage(now);
+    StorageBucket bucket;
+    fill(storage, bucket, key, values, now);
+    b.run([&] {
+        bench::doNotOptimize(storage.expire(key, now + std::chrono::minutes(1)));
+    });
+});
+
+bench::Register expireHalf("storage/expire_half_1000", [](bench::Runner& b) {
+    auto key = InfoHash::get("storage");
+    auto values = makeValues(VALUES);
+    auto now = clock::now();
+    std::unique_ptr<Storage> storage;
+    std::unique_ptr<StorageBucket> bucket;
+    b.run([&] {
+        storage = std::make_unique<Storage>(now);
+        bucket = std::make_unique<StorageBucket>();
+        fill(*storage, *bucket, key, values, now);
+    }, [&] {
+        bench::doNotOptimize(storage->expire(key, now + std::chrono::minutes(10)));
+    });
+});
+
+}
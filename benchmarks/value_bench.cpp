@@ -0,0 +1,93 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "benchmark.h"
+
+#include <opendht/value.h>
+
+#include <random>
+
+using namespace dht;
+
+namespace {
+
+std::vector<Sp<Value>>
+makeValues(size_t n, size_t size)
+{
+    std::mt19937_64 rd(42);
+    std::vector<Sp<Value>> values;
+    values.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        auto v = std::make_shared<Value>(Blob(size, (uint8_t)i));
+        v->id = rd();
+        v->type = i % 4;
+        v->user_type = (i % 2) ? "text/plain" : "application/json";
+        values.emplace_back(std::move(v));
+    }
+    return values;
+}
+
+void
+packBenchmark(bench::Runner& b, size_t size)
+{
+    auto value = makeValues(1, size).front();
+    b.run([&] {
+        bench::doNotOptimize(value->getPacked());
+    });
+}
+
+void
+unpackBenchmark(bench::Runner& b, size_t size)
+{
+    auto packed = makeValues(1, size).front()->getPacked();
+    b.run([&] {
+        auto msg = msgpack::unpack((const char*)packed.data(), packed.size());
+        bench::doNotOptimize(Value(msg.get()));
+    });
+}
+
+bench::Register pack64("value/pack_64B", [](bench::Runner& b) { packBenchmark(b, 64); });
+bench::Register pack4K("value/pack_4KB", [](bench::Runner& b) { packBenchmark(b, 4096); });
+bench::Register unpack64("value/unpack_64B", [](bench::Runner& b) { unpackBenchmark(b, 64); });
+bench::Register unpack4K("value/unpack_4KB", [](bench::Runner& b) { unpackBenchmark(b, 4096); });
+
+bench::Register whereFilter("where/filter_1000", [](bench::Runner& b) {
+    auto values = makeValues(1000, 64);
+    auto filter = Where().valueType(1).userType("text/plain").getFilter();
+    b.run([&] {
+        size_t matching = 0;
+        for (const auto& v : values)
+            matching += filter(*v);
+        bench::doNotOptimize(matching);
+    });
+});
+
+bench::Register queryParse("query/parse", [](bench::Runner& b) {
+    b.run([&] {
+        bench::doNotOptimize(Query("SELECT id WHERE value_type=3,user_type=text/plain"));
+    });
+});
+
+bench::Register querySatisfied("query/is_satisfied_by", [](bench::Runner& b) {
+    Query q1 {Select().field(Value::Field::Id), Where().valueType(3)};
+    Query q2 {Select().field(Value::Field::Id), Where().valueType(3).userType("text/plain")};
+    b.run([&] {
+        bench::doNotOptimize(q1.isSatisfiedBy(q2));
+    });
+});
+
+}
@@ -21,6 +21,8 @@
 #include <opendht.h>
 #include <opendht/log.h>
 
+#include <array>
+
 using ValueSp = std::shared_ptr<dht::Value>;
 using PrivkeySp = std::shared_ptr<dht::crypto::PrivateKey>;
 using PubkeySp = std::shared_ptr<const dht::crypto::PublicKey>;
@@ -397,6 +399,52 @@ void dht_runner_get(dht_runner* r, const dht_infohash* h, dht_get_cb cb, dht_don
     });
 }
 
+/** Array of borrowed values, allocated on the stack for small batches */
+struct ValueArray {
+    ValueArray(const std::vector<ValueSp>& values) : count(values.size()) {
+        if (count > stackValues.size()) {
+            heapValues.resize(count);
+            ptrs = heapValues.data();
+        }
+        for (size_t i = 0; i < count; i++)
+            ptrs[i] = reinterpret_cast<const dht_value*>(&values[i]);
+    }
+    const dht_value* const* data() const { return ptrs; }
+    size_t size() const { return count; }
+private:
+    std::array<const dht_value*, 32> stackValues;
+    std::vector<const dht_value*> heapValues;
+    const dht_value** ptrs {stackValues.data()};
+    const size_t count;
+};
+
+void dht_runner_get_batch(dht_runner* r, const dht_infohash* h, dht_get_batch_cb cb, dht_done_cb done_cb, void* cb_user_data) {
+    auto runner = reinterpret_cast<dht::DhtRunner*>(r);
+    auto hash = reinterpret_cast<const dht::InfoHash*>(h);
+    runner->get(*hash, [cb,cb_user_data](const std::vector<ValueSp>& values){
+        ValueArray array(values);
+        return cb(array.data(), array.size(), cb_user_data);
+    }, [done_cb, cb_user_data](bool ok){
+        if (done_cb)
+            done_cb(ok, cb_user_data);
+    });
+}
+
+void dht_runner_get_many(dht_runner* r, const dht_infohash* h, size_t count, dht_keyed_get_cb cb, dht_done_cb done_cb, void* cb_user_data) {
+    auto runner = reinterpret_cast<dht::DhtRunner*>(r);
+    auto hashes = reinterpret_cast<const dht::InfoHash*>(h);
+    runner->getMany(std::vector<dht::InfoHash>(hashes, hashes + count), [cb,cb_user_data](const dht::InfoHash& key, const std::vector<std::shared_ptr<dht::Value>>& values){
+        for (const auto& value : values) {
+            if (not cb(reinterpret_cast<const dht_infohash*>(&key), reinterpret_cast<const dht_value*>(&value), cb_user_data))
+                return false;
+        }
+        return true;
+    }, [done_cb, cb_user_data](bool ok, const std::vector<dht::InfoHash>&){
+        if (done_cb)
+            done_cb(ok, cb_user_data);
+    });
+}
+
 struct ScopeGuardCb {
     ScopeGuardCb(dht_shutdown_cb cb, void* data)
      : onDestroy(cb), userData(data) {}
@@ -428,6 +476,21 @@ dht_op_token* dht_runner_listen(dht_runner* r, const dht_infohash* h, dht_value_
     return (dht_op_token*)fret;
 }
 
+dht_op_token* dht_runner_listen_batch(dht_runner* r, const dht_infohash* h, dht_value_batch_cb cb, dht_shutdown_cb done_cb, void* cb_user_data) {
+    auto runner = reinterpret_cast<dht::DhtRunner*>(r);
+    auto hash = reinterpret_cast<const dht::InfoHash*>(h);
+    auto fret = new std::future<size_t>;
+    *fret = runner->listen(*hash, [
+        cb,
+        cb_user_data,
+        guard = done_cb ? std::make_shared<ScopeGuardCb>(done_cb, cb_user_data) : std::shared_ptr<ScopeGuardCb>{}
+    ](const std::vector<ValueSp>& values, bool expired) {
+        ValueArray array(values);
+        return cb(array.data(), array.size(), expired, cb_user_data);
+    });
+    return (dht_op_token*)fret;
+}
+
 void dht_runner_cancel_listen(dht_runner* r, const dht_infohash* h, dht_op_token* t) {
     auto runner = reinterpret_cast<dht::DhtRunner*>(r);
     auto hash = reinterpret_cast<const dht::InfoHash*>(h);
@@ -439,6 +502,40 @@ void dht_op_token_delete(dht_op_token* token) {
     delete reinterpret_cast<std::future<size_t>*>(token);
 }
 
+struct ListenManyToken {
+    std::vector<dht::InfoHash> keys;
+    std::shared_future<std::vector<size_t>> tokens;
+};
+
+dht_op_many_token* dht_runner_listen_many(dht_runner* r, const dht_infohash* h, size_t count, dht_keyed_value_cb cb, dht_shutdown_cb done_cb, void* cb_user_data) {
+    auto runner = reinterpret_cast<dht::DhtRunner*>(r);
+    auto hashes = reinterpret_cast<const dht::InfoHash*>(h);
+    auto ret = new ListenManyToken;
+    ret->keys.assign(hashes, hashes + count);
+    ret->tokens = runner->listenMany(ret->keys, [
+        cb,
+        cb_user_data,
+        guard = done_cb ? std::make_shared<ScopeGuardCb>(done_cb, cb_user_data) : std::shared_ptr<ScopeGuardCb>{}
+    ](const dht::InfoHash& key, const std::vector<ValueSp>& values, bool expired) {
+        for (const auto& value : values) {
+            if (not cb(reinterpret_cast<const dht_infohash*>(&key), reinterpret_cast<const dht_value*>(&value), expired, cb_user_data))
+                return false;
+        }
+        return true;
+    }).share();
+    return (dht_op_many_token*)ret;
+}
+
+void dht_runner_cancel_listen_many(dht_runner* r, dht_op_many_token* t) {
+    auto runner = reinterpret_cast<dht::DhtRunner*>(r);
+    auto token = reinterpret_cast<ListenManyToken*>(t);
+    runner->cancelListen(token->keys, token->tokens);
+}
+
+void dht_op_many_token_delete(dht_op_many_token* token) {
+    delete reinterpret_cast<ListenManyToken*>(token);
+}
+
 void dht_runner_put(dht_runner* r, const dht_infohash* h, const dht_value* v, dht_done_cb done_cb, void* cb_user_data, bool permanent) {
     auto runner = reinterpret_cast<dht::DhtRunner*>(r);
     auto hash = reinterpret_cast<const dht::InfoHash*>(h);
@@ -449,6 +546,19 @@ void dht_runner_put(dht_runner* r, const dht_infohash* h, const dht_value* v, dh
     }, dht::time_point::max(), permanent);
 }
 
+void dht_runner_put_many(dht_runner* r, const dht_infohash* h, const dht_value* const* v, size_t count, dht_done_cb done_cb, void* cb_user_data, bool permanent) {
+    auto runner = reinterpret_cast<dht::DhtRunner*>(r);
+    auto hashes = reinterpret_cast<const dht::InfoHash*>(h);
+    std::vector<std::pair<dht::InfoHash, std::shared_ptr<dht::Value>>> values;
+    values.reserve(count);
+    for (size_t i = 0; i < count; i++)
+        values.emplace_back(hashes[i], *reinterpret_cast<const ValueSp*>(v[i]));
+    runner->putMany(std::move(values), [done_cb, cb_user_data](bool ok, const std::vector<dht::InfoHash>&){
+        if (done_cb)
+            done_cb(ok, cb_user_data);
+    }, dht::time_point::max(), permanent);
+}
+
 void dht_runner_put_signed(dht_runner* r, const dht_infohash* h, const dht_value* v, dht_done_cb done_cb, void* cb_user_data, bool permanent) {
     auto runner = reinterpret_cast<dht::DhtRunner*>(r);
     auto hash = reinterpret_cast<const dht::InfoHash*>(h);
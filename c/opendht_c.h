@@ -106,8 +106,11 @@ typedef uint64_t dht_value_id;
 OPENDHT_C_PUBLIC dht_value* dht_value_new(const uint8_t* data, size_t size);
 OPENDHT_C_PUBLIC dht_value* dht_value_with_id_new(const uint8_t* data, size_t size, uint64_t value_id);
 OPENDHT_C_PUBLIC dht_value* dht_value_new_from_string(const char* str);
+/* Values passed to callbacks are borrowed: they are only valid until the callback returns.
+ * dht_value_ref retains a value, returning a new reference to be released with dht_value_unref. */
 OPENDHT_C_PUBLIC dht_value* dht_value_ref(const dht_value*);
 OPENDHT_C_PUBLIC void dht_value_unref(dht_value*);
+/* Zero-copy view of the value data, valid as long as the value is */
 OPENDHT_C_PUBLIC dht_data_view dht_value_get_data(const dht_value* data);
 OPENDHT_C_PUBLIC dht_value_id dht_value_get_id(const dht_value* data);
 OPENDHT_C_PUBLIC dht_publickey* dht_value_get_owner(const dht_value* data);
@@ -117,14 +120,23 @@ OPENDHT_C_PUBLIC void dht_value_set_user_type(dht_value* data, const char* user_
 
 // callbacks
 typedef bool (*dht_get_cb)(const dht_value* value, void* user_data);
+typedef bool (*dht_keyed_get_cb)(const dht_infohash* key, const dht_value* value, void* user_data);
+typedef bool (*dht_keyed_value_cb)(const dht_infohash* key, const dht_value* value, bool expired, void* user_data);
 typedef bool (*dht_value_cb)(const dht_value* value, bool expired, void* user_data);
 typedef void (*dht_done_cb)(bool ok, void* user_data);
 typedef void (*dht_shutdown_cb)(void* user_data);
+/* Called once for each batch of values received together */
+typedef bool (*dht_get_batch_cb)(const dht_value* const* values, size_t count, void* user_data);
+typedef bool (*dht_value_batch_cb)(const dht_value* const* values, size_t count, bool expired, void* user_data);
 
 struct OPENDHT_C_PUBLIC dht_op_token;
 typedef struct dht_op_token dht_op_token;
 OPENDHT_C_PUBLIC void dht_op_token_delete(dht_op_token* token);
 
+struct OPENDHT_C_PUBLIC dht_op_many_token;
+typedef struct dht_op_many_token dht_op_many_token;
+OPENDHT_C_PUBLIC void dht_op_many_token_delete(dht_op_many_token* token);
+
 // config
 struct OPENDHT_PUBLIC dht_node_config {
     dht_infohash node_id;
@@ -173,8 +185,17 @@ OPENDHT_C_PUBLIC void dht_runner_bootstrap(dht_runner* runner, const char* host,
 OPENDHT_C_PUBLIC void dht_runner_get(dht_runner* runner, const dht_infohash* hash, dht_get_cb cb, dht_done_cb done_cb, void* cb_user_data);
 OPENDHT_C_PUBLIC dht_op_token* dht_runner_listen(dht_runner* runner, const dht_infohash* hash, dht_value_cb cb, dht_shutdown_cb done_cb, void* cb_user_data);
 OPENDHT_C_PUBLIC void dht_runner_cancel_listen(dht_runner* runner, const dht_infohash* hash, dht_op_token* token);
+// Batch variants of get and listen: cb is called once per batch of values instead of once per value
+OPENDHT_C_PUBLIC void dht_runner_get_batch(dht_runner* runner, const dht_infohash* hash, dht_get_batch_cb cb, dht_done_cb done_cb, void* cb_user_data);
+OPENDHT_C_PUBLIC dht_op_token* dht_runner_listen_batch(dht_runner* runner, const dht_infohash* hash, dht_value_batch_cb cb, dht_shutdown_cb done_cb, void* cb_user_data);
 OPENDHT_C_PUBLIC void dht_runner_put(dht_runner* runner, const dht_infohash* hash, const dht_value* value, dht_done_cb done_cb, void* cb_user_data, bool permanent);
 OPENDHT_C_PUBLIC void dht_runner_put_signed(dht_runner* runner, const dht_infohash* hash, const dht_value* value, dht_done_cb done_cb, void* cb_user_data, bool permanent);
+// Multi-key operations: done_cb is called once, when all keys are done
+OPENDHT_C_PUBLIC void dht_runner_get_many(dht_runner* runner, const dht_infohash* hashes, size_t count, dht_keyed_get_cb cb, dht_done_cb done_cb, void* cb_user_data);
+/* done_cb is called once the listen operation is cancelled on every key */
+OPENDHT_C_PUBLIC dht_op_many_token* dht_runner_listen_many(dht_runner* runner, const dht_infohash* hashes, size_t count, dht_keyed_value_cb cb, dht_shutdown_cb done_cb, void* cb_user_data);
+OPENDHT_C_PUBLIC void dht_runner_cancel_listen_many(dht_runner* runner, dht_op_many_token* token);
+OPENDHT_C_PUBLIC void dht_runner_put_many(dht_runner* runner, const dht_infohash* hashes, const dht_value* const* values, size_t count, dht_done_cb done_cb, void* cb_user_data, bool permanent);
 OPENDHT_C_PUBLIC void dht_runner_put_encrypted(dht_runner* runner, const dht_infohash* hash, const dht_infohash* to, const dht_value* value, dht_done_cb done_cb, void* cb_user_data, bool permanent);
 OPENDHT_C_PUBLIC void dht_runner_cancel_put(dht_runner* runner, const dht_infohash* hash, dht_value_id value_id);
 OPENDHT_C_PUBLIC void dht_runner_shutdown(dht_runner* runner, dht_shutdown_cb done_cb, void* cb_user_data);
@@ -23,6 +23,7 @@
 #include "infohash.h"
 #include "value.h"
 
+#include <array>
 #include <vector>
 #include <memory>
 #include <functional>
@@ -60,8 +61,18 @@ struct OPENDHT_PUBLIC NodeStats {
     unsigned table_depth {0};
     unsigned searches {0};
     unsigned node_cache_size {0};
+    /**
+     * Number of routing table nodes by smoothed round-trip time.
+     * Bucket i counts nodes with a RTT below RTT_HISTOGRAM_BOUNDS[i] milliseconds,
+     * and above the previous bound. The last bucket counts the slower nodes.
+     * Empty if no RTT was measured.
+     */
+    std::vector<unsigned> rtt_histogram;
+    static constexpr std::array<unsigned, 8> RTT_HISTOGRAM_BOUNDS {{5, 10, 20, 50, 100, 200, 500, 1000}};
+
     unsigned getKnownNodes() const { return good_nodes + dubious_nodes; }
     unsigned long getNetworkSizeEstimation() const { return 8 * std::exp2(table_depth); }
+    void addRtt(duration rtt);
     std::string toString() const;
 
 #ifdef OPENDHT_JSONCPP
@@ -73,7 +84,42 @@ struct OPENDHT_PUBLIC NodeStats {
     explicit NodeStats(const Json::Value& v);
 #endif
 
-    MSGPACK_DEFINE_MAP(good_nodes, dubious_nodes, cached_nodes, incoming_nodes, table_depth, searches, node_cache_size)
+    MSGPACK_DEFINE_MAP(good_nodes, dubious_nodes, cached_nodes, incoming_nodes, table_depth, searches, node_cache_size, rtt_histogram)
+};
+
+/**
+ * Estimated memory usage of the node subsystems, in bytes.
+ */
+struct OPENDHT_PUBLIC MemoryStats {
+    /** Stored values */
+    size_t storage {0};
+    /** Remote nodes listening to stored keys */
+    size_t listeners {0};
+    /** Searches, including their pending operations and value caches */
+    size_t searches {0};
+    size_t node_cache {0};
+    /** Incoming messages being reassembled */
+    size_t partial_messages {0};
+    /** Received packets waiting to be processed, and recycled packet buffers */
+    size_t rx_queue {0};
+    /** Sessions of the proxy server (listens, push subscriptions and permanent puts) */
+    size_t proxy {0};
+
+    /** Estimated allocation overhead of an element of a node-based container */
+    static constexpr size_t NODE_OVERHEAD {4 * sizeof(void*)};
+
+    size_t total() const {
+        return storage + listeners + searches + node_cache + partial_messages + rx_queue + proxy;
+    }
+    std::string toString() const;
+
+#ifdef OPENDHT_JSONCPP
+    Json::Value toJson() const;
+    MemoryStats() {};
+    explicit MemoryStats(const Json::Value& v);
+#endif
+
+    MSGPACK_DEFINE_MAP(storage, listeners, searches, node_cache, partial_messages, rx_queue, proxy)
 };
 
 struct OPENDHT_PUBLIC NodeInfo {
@@ -86,6 +132,7 @@ struct OPENDHT_PUBLIC NodeInfo {
     size_t storage_size {0};
     in_port_t bound4 {0};
     in_port_t bound6 {0};
+    MemoryStats memory {};
 
 #ifdef OPENDHT_JSONCPP
     /**
@@ -96,7 +143,7 @@ struct OPENDHT_PUBLIC NodeInfo {
     explicit NodeInfo(const Json::Value& v);
 #endif
 
-    MSGPACK_DEFINE_MAP(id, node_id, ipv4, ipv6)
+    MSGPACK_DEFINE_MAP(id, node_id, ipv4, ipv6, memory)
 };
 
 /**
@@ -137,6 +184,25 @@ struct OPENDHT_PUBLIC Config {
     /* If non-0, overrides the default maximum store key count. -1 means no limit.  */
     ssize_t max_store_keys {0};
 
+    /**
+     * If non-0, overrides the default memory limit of searches, in bytes. -1 means no limit.
+     * Above the limit, idle searches are evicted and new searches are refused.
+     */
+    ssize_t max_search_memory {0};
+
+    /**
+     * If non-0, overrides the default memory limit of remote listeners, in bytes. -1 means no limit.
+     * Above the limit, new listen requests from other nodes are refused.
+     */
+    ssize_t max_listener_memory {0};
+
+    /**
+     * If non-0, overrides the default memory limit of incoming messages being
+     * reassembled, in bytes. -1 means no limit.
+     * Above the limit, new fragmented messages are dropped.
+     */
+    ssize_t max_partial_memory {0};
+
     /**
      * Use appropriate bahavior for a public IP, stable node:
      *   - No connectivity change triggered when a search fails
@@ -146,6 +212,23 @@ struct OPENDHT_PUBLIC Config {
 
     /* Client mode, node will not be used by other nodes to store data. */
     bool client_mode {false};
+
+    /**
+     * Latency-aware searches: among the closest candidates of a search,
+     * query nodes with the lowest measured round-trip time first, and send
+     * hedged requests to other candidates when a solicited node is slower
+     * than expected.
+     */
+    bool latency_aware_search {false};
+
+    /* Maximum number of concurrent hedged requests per search, when latency_aware_search is set. */
+    unsigned max_hedged_requests {2};
+
+    /**
+     * If set, replaces the steady clock as the time source of the node.
+     * Allows to run nodes in virtual time, for simulations.
+     */
+    std::function<time_point()> clock {};
 };
 
 /**
@@ -161,6 +244,15 @@ struct OPENDHT_PUBLIC SecureDhtConfig
      * for use by the certificate store, putEncrypted and putSigned
      */
     bool cert_cache_all {false};
+
+    /**
+     * Maximum number of certificates and public keys in each cache.
+     * Found entries are kept for cert_cache_ttl,
+     * failed lookups for cert_cache_negative_ttl.
+     */
+    size_t cert_cache_size {4096};
+    duration cert_cache_ttl {std::chrono::hours(1)};
+    duration cert_cache_negative_ttl {std::chrono::minutes(1)};
 };
 
 enum class OPENDHT_PUBLIC PushNotificationResult: uint8_t {
@@ -178,6 +270,9 @@ enum class OPENDHT_PUBLIC PushNotificationResult: uint8_t {
 };
 
 static constexpr size_t DEFAULT_STORAGE_LIMIT {1024 * 1024 * 64};
+static constexpr size_t DEFAULT_SEARCH_MEMORY_LIMIT {1024 * 1024 * 64};
+static constexpr size_t DEFAULT_LISTENER_MEMORY_LIMIT {1024 * 1024 * 32};
+static constexpr size_t DEFAULT_PARTIAL_MEMORY_LIMIT {1024 * 1024 * 16};
 
 using ValuesExport = std::pair<InfoHash, Blob>;
 
@@ -185,6 +280,8 @@ using QueryCallback = std::function<bool(const std::vector<std::shared_ptr<Field
 using GetCallback = std::function<bool(const std::vector<std::shared_ptr<Value>>& values)>;
 using ValueCallback = std::function<bool(const std::vector<std::shared_ptr<Value>>& values, bool expired)>;
 using GetCallbackSimple = std::function<bool(std::shared_ptr<Value> value)>;
+using KeyedGetCallback = std::function<bool(const InfoHash& key, const std::vector<std::shared_ptr<Value>>& values)>;
+using KeyedValueCallback = std::function<bool(const InfoHash& key, const std::vector<std::shared_ptr<Value>>& values, bool expired)>;
 using ShutdownCallback = std::function<void()>;
 using IdentityAnnouncedCb = std::function<void(bool)>;
 using PublicAddressChangedCb = std::function<void(std::vector<SockAddr>)>;
@@ -192,6 +289,8 @@ using PublicAddressChangedCb = std::function<void(std::vector<SockAddr>)>;
 using CertificateStoreQuery = std::function<std::vector<std::shared_ptr<crypto::Certificate>>(const InfoHash& pk_id)>;
 using DoneCallback = std::function<void(bool success, const std::vector<std::shared_ptr<Node>>& nodes)>;
 using DoneCallbackSimple = std::function<void(bool success)>;
+/** Called once all the keys of a multi-key operation are done, with the keys that failed. */
+using DoneManyCallback = std::function<void(bool success, const std::vector<InfoHash>& failed)>;
 
 typedef bool (*GetCallbackRaw)(std::shared_ptr<Value>, void *user_data);
 typedef bool (*ValueCallbackRaw)(std::shared_ptr<Value>, bool expired, void *user_data);
@@ -199,6 +298,12 @@ typedef void (*DoneCallbackRaw)(bool, std::vector<std::shared_ptr<Node>>*, void
 typedef void (*ShutdownCallbackRaw)(void *user_data);
 typedef void (*DoneCallbackSimpleRaw)(bool, void *user_data);
 typedef bool (*FilterRaw)(const Value&, void *user_data);
+typedef bool (*KeyedGetCallbackRaw)(const InfoHash* key, std::shared_ptr<Value>, void *user_data);
+typedef bool (*KeyedValueCallbackRaw)(const InfoHash* key, std::shared_ptr<Value>, bool expired, void *user_data);
+typedef void (*DoneManyCallbackRaw)(bool, std::vector<InfoHash>* failed, void *user_data);
+typedef bool (*GetBatchCallbackRaw)(const std::vector<std::shared_ptr<Value>>* values, void *user_data);
+typedef bool (*ValueBatchCallbackRaw)(const std::vector<std::shared_ptr<Value>>* values, bool expired, void *user_data);
+typedef void (*UserDataReleaseRaw)(void *user_data);
 
 
 OPENDHT_PUBLIC GetCallbackSimple bindGetCb(GetCallbackRaw raw_cb, void* user_data);
@@ -209,5 +314,23 @@ OPENDHT_PUBLIC DoneCallback bindDoneCb(DoneCallbackSimple donecb);
 OPENDHT_PUBLIC DoneCallback bindDoneCb(DoneCallbackRaw raw_cb, void* user_data);
 OPENDHT_PUBLIC DoneCallbackSimple bindDoneCbSimple(DoneCallbackSimpleRaw raw_cb, void* user_data);
 OPENDHT_PUBLIC Value::Filter bindFilterRaw(FilterRaw raw_filter, void* user_data);
+OPENDHT_PUBLIC KeyedGetCallback bindKeyedGetCb(KeyedGetCallbackRaw raw_cb, void* user_data);
+OPENDHT_PUBLIC KeyedValueCallback bindKeyedValueCb(KeyedValueCallbackRaw raw_cb, void* user_data);
+OPENDHT_PUBLIC DoneManyCallback bindDoneManyCb(DoneManyCallbackRaw raw_cb, void* user_data);
+
+/**
+ * Like bindGetCb and bindValueCb, but raw_cb is called once per batch of values
+ * instead of once per value.
+ * If set, release is called with user_data when the returned callback is destroyed,
+ * or immediately if raw_cb is null.
+ */
+OPENDHT_PUBLIC GetCallback bindGetBatchCb(GetBatchCallbackRaw raw_cb, void* user_data, UserDataReleaseRaw release = nullptr);
+OPENDHT_PUBLIC ValueCallback bindValueBatchCb(ValueBatchCallbackRaw raw_cb, void* user_data, UserDataReleaseRaw release = nullptr);
+
+/**
+ * Like bindKeyedValueCb, but release is called with user_data when the returned
+ * callback is destroyed, or immediately if raw_cb is null.
+ */
+OPENDHT_PUBLIC KeyedValueCallback bindKeyedValueCb(KeyedValueCallbackRaw raw_cb, void* user_data, UserDataReleaseRaw release);
 
 }
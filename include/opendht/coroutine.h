@@ -0,0 +1,263 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * C++20 coroutine interface for DhtRunner.
+ *
+ * The library itself is built as C++17: this header is only enabled when
+ * the including translation unit is compiled with coroutine support.
+ *
+ *     dht::coro::Task lookup(dht::DhtRunner& node, dht::InfoHash key) {
+ *         auto [values, found] = co_await dht::coro::get(node, key);
+ *         bool ok = co_await dht::coro::put(node, key, std::make_shared<dht::Value>("hi"));
+ *         auto listener = dht::coro::listen(node, key);
+ *         while (auto event = co_await listener.next()) { ... }
+ *     }
+ */
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define OPENDHT_COROUTINES 1
+
+#include "dhtrunner.h"
+#include "thread_pool.h"
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace dht {
+namespace coro {
+
+/**
+ * Runs the continuation of a coroutine.
+ * If empty, coroutines are resumed inline on the DHT thread, and must then
+ * not block.
+ */
+using ExecutorFn = std::function<void(std::function<void()>&&)>;
+
+inline ExecutorFn
+onThreadPool(ThreadPool& pool) {
+    return [&pool](std::function<void()>&& f) { pool.run(std::move(f)); };
+}
+
+inline ExecutorFn
+onExecutor(std::shared_ptr<Executor> executor) {
+    return [executor = std::move(executor)](std::function<void()>&& f) { executor->run(std::move(f)); };
+}
+
+inline void
+resume(const ExecutorFn& executor, std::coroutine_handle<> h) {
+    if (executor)
+        executor([h]{ h.resume(); });
+    else
+        h.resume();
+}
+
+/**
+ * Eagerly started, detached coroutine.
+ */
+struct Task {
+    struct promise_type {
+        Task get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+/**
+ * Result of a get: the values found, and false if the operation failed.
+ */
+struct GetResult {
+    std::vector<Sp<Value>> values;
+    bool ok;
+};
+
+class GetAwaitable {
+public:
+    GetAwaitable(DhtRunner& runner, InfoHash key, ExecutorFn executor, Value::Filter f, Where w)
+        : runner_(runner), key_(key), executor_(std::move(executor)), filter_(std::move(f)), where_(std::move(w)) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+        // *this may be resumed and destroyed from the done callback:
+        // don't use it after starting the operation.
+        runner_.get(key_, GetCallback([this](const std::vector<Sp<Value>>& values) {
+            values_.insert(values_.end(), values.begin(), values.end());
+            return true;
+        }), DoneCallbackSimple([this, h, ex = executor_](bool ok) {
+            ok_ = ok;
+            resume(ex, h);
+        }), std::move(filter_), std::move(where_));
+    }
+    GetResult await_resume() { return {std::move(values_), ok_}; }
+
+private:
+    DhtRunner& runner_;
+    const InfoHash key_;
+    ExecutorFn executor_;
+    Value::Filter filter_;
+    Where where_;
+    std::vector<Sp<Value>> values_;
+    bool ok_ {false};
+};
+
+class PutAwaitable {
+public:
+    PutAwaitable(DhtRunner& runner, InfoHash key, Sp<Value> value, ExecutorFn executor, bool permanent)
+        : runner_(runner), key_(key), value_(std::move(value)), executor_(std::move(executor)), permanent_(permanent) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+        runner_.put(key_, std::move(value_), DoneCallbackSimple([this, h, ex = executor_](bool ok) {
+            ok_ = ok;
+            resume(ex, h);
+        }), time_point::max(), permanent_);
+    }
+    bool await_resume() const noexcept { return ok_; }
+
+private:
+    DhtRunner& runner_;
+    const InfoHash key_;
+    Sp<Value> value_;
+    ExecutorFn executor_;
+    const bool permanent_;
+    bool ok_ {false};
+};
+
+/**
+ * Asynchronous stream of value events from a listen operation.
+ * The listen operation is cancelled when the Listener is destroyed.
+ */
+class Listener {
+public:
+    struct Event {
+        std::vector<Sp<Value>> values;
+        bool expired;
+    };
+
+private:
+    struct State {
+        std::mutex lock;
+        std::deque<Event> events;
+        std::coroutine_handle<> waiter;
+        ExecutorFn executor;
+        bool closed {false};
+
+        void wakeUp(std::unique_lock<std::mutex>& lk) {
+            if (auto h = std::exchange(waiter, {})) {
+                lk.unlock();
+                resume(executor, h);
+            }
+        }
+    };
+
+public:
+    Listener(DhtRunner& runner, InfoHash key, ExecutorFn executor, Value::Filter f, Where w)
+        : runner_(runner), key_(key), state_(std::make_shared<State>())
+    {
+        state_->executor = std::move(executor);
+        token_ = runner_.listen(key_, [state = state_](const std::vector<Sp<Value>>& values, bool expired) {
+            std::unique_lock<std::mutex> lk(state->lock);
+            if (state->closed)
+                return false;
+            state->events.emplace_back(Event {values, expired});
+            state->wakeUp(lk);
+            return true;
+        }, std::move(f), std::move(w)).share();
+    }
+    Listener(Listener&&) = default;
+    Listener(const Listener&) = delete;
+    ~Listener() { cancel(); }
+
+    class NextAwaitable {
+    public:
+        NextAwaitable(std::shared_ptr<State> state) : state_(std::move(state)) {}
+        bool await_ready() const {
+            std::lock_guard<std::mutex> lk(state_->lock);
+            return state_->closed or not state_->events.empty();
+        }
+        bool await_suspend(std::coroutine_handle<> h) {
+            std::lock_guard<std::mutex> lk(state_->lock);
+            if (state_->closed or not state_->events.empty())
+                return false;
+            state_->waiter = h;
+            return true;
+        }
+        std::optional<Event> await_resume() {
+            std::lock_guard<std::mutex> lk(state_->lock);
+            if (state_->events.empty())
+                return std::nullopt;
+            auto event = std::move(state_->events.front());
+            state_->events.pop_front();
+            return event;
+        }
+    private:
+        std::shared_ptr<State> state_;
+    };
+
+    /**
+     * Awaits the next event.
+     * Resolves to std::nullopt once the listener is cancelled.
+     */
+    NextAwaitable next() { return {state_}; }
+
+    void cancel() {
+        if (not state_)
+            return;
+        {
+            std::unique_lock<std::mutex> lk(state_->lock);
+            if (state_->closed)
+                return;
+            state_->closed = true;
+            state_->wakeUp(lk);
+        }
+        runner_.cancelListen(key_, token_);
+    }
+
+private:
+    DhtRunner& runner_;
+    InfoHash key_;
+    std::shared_future<size_t> token_;
+    std::shared_ptr<State> state_;
+};
+
+inline GetAwaitable
+get(DhtRunner& runner, InfoHash key, ExecutorFn executor = {}, Value::Filter f = {}, Where w = {}) {
+    return {runner, key, std::move(executor), std::move(f), std::move(w)};
+}
+
+inline PutAwaitable
+put(DhtRunner& runner, InfoHash key, Sp<Value> value, ExecutorFn executor = {}, bool permanent = false) {
+    return {runner, key, std::move(value), std::move(executor), permanent};
+}
+
+inline Listener
+listen(DhtRunner& runner, InfoHash key, ExecutorFn executor = {}, Value::Filter f = {}, Where w = {}) {
+    return {runner, key, std::move(executor), std::move(f), std::move(w)};
+}
+
+}
+}
+
+#endif
@@ -35,6 +35,7 @@ extern "C" {
 #include <atomic>
 #include <mutex>
 #include <string_view>
+#include <array>
 
 #ifdef _WIN32
 #include <iso646.h>
@@ -116,6 +117,12 @@ struct OPENDHT_PUBLIC PublicKey
         return checkSignature(data.data(), data.size(), signature.data(), signature.size());
     }
 
+    /**
+     * Encrypt data for the owner of this key.
+     * RSA keys: RSA encryption, with AES-GCM for data larger than a block.
+     * Ed25519 keys: ephemeral X25519 key agreement and AES-GCM,
+     * adding 60 bytes to the data.
+     */
     Blob encrypt(const uint8_t* data, size_t data_len) const;
     inline Blob encrypt(const Blob& data) const {
         return encrypt(data.data(), data.size());
@@ -207,6 +214,12 @@ struct OPENDHT_PUBLIC PrivateKey
      */
     static PrivateKey generate(unsigned key_length = 4096);
     static PrivateKey generateEC();
+    /**
+     * Generate a new Ed25519 key pair.
+     * Signatures and public keys are much smaller and faster to verify
+     * than with RSA. Requires GnuTLS 3.6 or later.
+     */
+    static PrivateKey generateEd25519();
 
     gnutls_privkey_t key {};
     gnutls_x509_privkey_t x509_key {};
@@ -689,6 +702,9 @@ OPENDHT_PUBLIC Identity generateIdentity(const std::string& name = "dhtnode", co
 OPENDHT_PUBLIC Identity generateEcIdentity(const std::string& name, const Identity& ca, bool is_ca);
 OPENDHT_PUBLIC Identity generateEcIdentity(const std::string& name = "dhtnode", const Identity& ca = {});
 
+OPENDHT_PUBLIC Identity generateEd25519Identity(const std::string& name, const Identity& ca, bool is_ca);
+OPENDHT_PUBLIC Identity generateEd25519Identity(const std::string& name = "dhtnode", const Identity& ca = {});
+
 OPENDHT_PUBLIC void saveIdentity(const Identity& id, const std::string& path, const std::string& privkey_password = {});
 OPENDHT_PUBLIC Identity loadIdentity(const std::string &path,const std::string &privkey_password = {});
 
@@ -704,6 +720,68 @@ OPENDHT_PUBLIC Blob hash(const Blob& data, size_t hash_length = 512/8);
 
 OPENDHT_PUBLIC void hash(const uint8_t* data, size_t data_length, uint8_t* hash, size_t hash_length);
 
+/**
+ * Incremental version of hash(), using the same hash function for a given
+ * hash_length. The context lives on the stack and never allocates.
+ *
+ *     HashContext ctx(32);
+ *     ctx.update(a.data(), a.size());
+ *     ctx.update(b.data(), b.size());
+ *     ctx.final(out);
+ */
+class OPENDHT_PUBLIC HashContext {
+public:
+    explicit HashContext(size_t hash_length = 512/8);
+
+    void update(const uint8_t* data, size_t data_length);
+    void update(const Blob& data) { update(data.data(), data.size()); }
+
+    /**
+     * Writes length() bytes of hash to out,
+     * and resets the context so it can be reused.
+     */
+    void final(uint8_t* out);
+
+    /** Size of the output of final() */
+    size_t length() const { return length_; }
+
+private:
+    gnutls_digest_algorithm_t algo_;
+    size_t length_;
+    alignas(8) uint8_t ctx_[224];
+};
+
+/**
+ * Keyed HMAC-SHA256 generator for short authentication tokens.
+ * The key schedule is computed once by setKey(): generating or checking
+ * a token doesn't allocate.
+ */
+class OPENDHT_PUBLIC TokenGenerator {
+public:
+    static constexpr size_t TOKEN_LENGTH {256/8};
+    using Token = std::array<uint8_t, TOKEN_LENGTH>;
+
+    /** Uses a random key */
+    TokenGenerator();
+    TokenGenerator(const uint8_t* key, size_t key_length) { setKey(key, key_length); }
+
+    void setKey(const uint8_t* key, size_t key_length);
+
+    /** Writes the first out_length bytes (at most TOKEN_LENGTH) of the token for data */
+    void get(const uint8_t* data, size_t data_length, uint8_t* out, size_t out_length = TOKEN_LENGTH) const;
+    Token get(const uint8_t* data, size_t data_length) const {
+        Token ret;
+        get(data, data_length, ret.data(), ret.size());
+        return ret;
+    }
+
+    /** Constant-time check of a token previously returned by get() */
+    bool check(const uint8_t* token, size_t token_length, const uint8_t* data, size_t data_length) const;
+
+private:
+    alignas(8) uint8_t ctx_[352];
+};
+
 /**
  * Generates an encryption key from a text password,
  * making the key longer to bruteforce.
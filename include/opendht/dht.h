@@ -295,6 +295,8 @@ public:
         return network_engine.getNodeMessageStats(in);
     }
 
+    void setMetrics(const Sp<metrics::Registry>& registry) override;
+
     /**
      * Set the in-memory storage limit in bytes
      */
@@ -313,6 +315,8 @@ public:
         return {total_store_size, total_values};
     }
 
+    MemoryStats getMemoryStats() const override;
+
     std::vector<SockAddr> getPublicAddress(sa_family_t family = 0) override;
 
     PushNotificationResult pushNotificationReceived(const std::map<std::string, std::string>&) override {
@@ -340,6 +344,9 @@ private:
     /* Concurrent search nodes requested count */
     static constexpr unsigned MAX_REQUESTED_SEARCH_NODES {4};
 
+    /* Concurrent search nodes requested count while a search of the same region is discovering nodes */
+    static constexpr unsigned MAX_REQUESTED_FOLLOWER_SEARCH_NODES {1};
+
     /* Number of listening nodes */
     static constexpr unsigned LISTEN_NODES {4};
 
@@ -378,8 +385,8 @@ private:
 
     InfoHash myid {};
 
-    uint64_t secret {};
-    uint64_t oldsecret {};
+    crypto::TokenGenerator secret {};
+    crypto::TokenGenerator oldsecret {};
 
     // registred types
     TypeStore types;
@@ -414,13 +421,22 @@ private:
     size_t max_store_size {DEFAULT_STORAGE_LIMIT};
 
     size_t max_searches {MAX_SEARCHES};
+    size_t max_search_memory {DEFAULT_SEARCH_MEMORY_LIMIT};
+    size_t searches_memory {0};
     size_t search_id {0};
 
+    size_t max_listener_memory {DEFAULT_LISTENER_MEMORY_LIMIT};
+    size_t listeners_memory {0};
+
     // map a global listen token to IPv4, IPv6 specific listen tokens.
     // 0 is the invalid token.
     std::map<size_t, std::tuple<size_t, size_t, size_t>> listeners {};
     size_t listener_token {1};
 
+    // metrics
+    struct Metrics;
+    std::unique_ptr<Metrics> metrics_;
+    void updateMetrics();
 
     // timing
     Scheduler scheduler;
@@ -438,6 +454,8 @@ private:
     const bool is_bootstrap {false};
     const bool maintain_storage {false};
     const bool public_stable {false};
+    const bool latency_aware_search {false};
+    const unsigned max_hedged_requests {0};
 
     inline const duration& getListenExpiration() const {
         return public_stable ? LISTEN_EXPIRE_TIME_PUBLIC : LISTEN_EXPIRE_TIME;
@@ -451,12 +469,17 @@ private:
     void reportedAddr(const SockAddr&);
 
     // Storage
-    void storageAddListener(const InfoHash& id, const Sp<Node>& node, size_t tid, Query&& = {}, int version = 0);
+    /**
+     * @returns false if the listener was refused (key or memory limit reached)
+     */
+    bool storageAddListener(const InfoHash& id, const Sp<Node>& node, size_t tid, Query&& = {}, int version = 0);
     bool storageStore(const InfoHash& id, const Sp<Value>& value, time_point created, const SockAddr& sa = {}, bool permanent = false);
     bool storageRefresh(const InfoHash& id, Value::Id vid);
     void expireStore();
     void expireStorage(InfoHash h);
     void expireStore(decltype(store)::iterator);
+    /* (Re)schedules the expiration of st at its next value expiration */
+    void scheduleStorageExpiration(const InfoHash& id, Storage& st);
 
     void storageRemoved(const InfoHash& id, Storage& st, const std::vector<Sp<Value>>& values, size_t totalSize);
     void storageChanged(const InfoHash& id, Storage& st, const Sp<Value>&, bool newValue);
@@ -507,6 +530,13 @@ private:
      */
     Sp<Search> search(const InfoHash& id, sa_family_t af, GetCallback = {}, QueryCallback = {}, DoneCallback = {}, Value::Filter = {}, const Sp<Query>& q = {});
 
+    /**
+     * Returns an ongoing search for a key in the same routing table bucket
+     * as id, if any. Such searches start from the same nodes and can share
+     * node discovery.
+     */
+    Sp<Search> findRegionLeader(const InfoHash& id, sa_family_t af);
+
     void announce(const InfoHash& id, sa_family_t af, Sp<Value> value, DoneCallback callback, time_point created=time_point::max(), bool permanent = false);
     size_t listenTo(const InfoHash& id, sa_family_t af, ValueCallback cb, Value::Filter f = {}, const Sp<Query>& q = {});
 
@@ -520,6 +550,16 @@ private:
     unsigned refill(Search& sr);
     void expireSearches();
 
+    /**
+     * Removes the least recently stepped search with no pending
+     * operation, of family af, or of any family if af is 0.
+     *
+     * @return true if a search was removed.
+     */
+    bool dropIdleSearch(sa_family_t af = 0);
+    /* Updates searches_memory with the current estimate for sr */
+    void updateSearchMemory(Search& sr);
+
     void confirmNodes();
     void expire();
 
@@ -564,6 +604,12 @@ private:
      */
     SearchNode* searchSendGetValues(Sp<Search> sr, SearchNode *n = nullptr, bool update = true);
 
+    /**
+     * Maximum number of concurrent 'get' requests for a search, including
+     * hedged requests sent to replace slow nodes.
+     */
+    unsigned maxSolicitedNodes(const Search& sr, time_point now) const;
+
     /**
      * Forwards an 'announce' request for a list of nodes to the network engine.
      *
@@ -21,6 +21,7 @@
 #include "infohash.h"
 #include "logger.h"
 #include "node_export.h"
+#include "metrics.h"
 
 #include <queue>
 
@@ -231,6 +232,11 @@ public:
      */
     virtual std::pair<size_t, size_t> getStoreSize() const = 0;
 
+    /**
+     * Returns the estimated memory usage of the node subsystems.
+     */
+    virtual MemoryStats getMemoryStats() const = 0;
+
     virtual std::vector<SockAddr> getPublicAddress(sa_family_t family = 0) = 0;
 
     virtual void setLogger(const Logger& l) {
@@ -253,6 +259,12 @@ public:
             logger_->setFilter(f);
     }
 
+    /**
+     * Registers the node metrics (message processing, searches, storage)
+     * in the given registry.
+     */
+    virtual void setMetrics(const std::shared_ptr<metrics::Registry>&) {}
+
     virtual void setPushNotificationToken(const std::string&) {};
 
     virtual void setPushNotificationTopic(const std::string&) {};
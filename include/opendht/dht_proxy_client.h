@@ -273,6 +273,7 @@ public:
     void insertNode(const InfoHash&, const SockAddr&) override { }
     void insertNode(const NodeExport&) override { }
     std::pair<size_t, size_t> getStoreSize() const override { return {}; }
+    MemoryStats getMemoryStats() const override { return {}; }
     std::vector<NodeExport> exportNodes() const override { return {}; }
     std::vector<ValuesExport> exportValues() const override { return {}; }
     void importValues(const std::vector<ValuesExport>&) override {}
@@ -298,6 +299,16 @@ public:
     }
     inline uint32_t listenKeepIdle() { return listenKeepIdle_; }
 
+    /**
+     * Configure how many idle keep-alive connections to the proxy are kept for reuse.
+     */
+    void setConnectionPoolConfig(const http::ConnectionPool::Config& config) {
+        connectionPool_->setConfig(config);
+    }
+    http::ConnectionPool::Stats getConnectionPoolStats() const {
+        return connectionPool_->getStats();
+    }
+
 private:
     /**
      * Start the connection with a server.
@@ -367,6 +378,8 @@ private:
     SockAddr publicAddressV4_;
     SockAddr publicAddressV6_;
     std::atomic_bool launchConnectedCbs_ {false};
+    /** The proxy server supports msgpack encoded values */
+    std::atomic_bool msgpack_ {false};
     PublicAddressChangedCb publicAddressChangedCb_ {};
 
     InfoHash myid {};
@@ -381,6 +394,8 @@ private:
     asio::io_context httpContext_;
     mutable std::mutex resolverLock_;
     std::shared_ptr<http::Resolver> resolver_;
+    /** Idle keep-alive connections to the proxy, shared by short requests */
+    std::shared_ptr<http::ConnectionPool> connectionPool_ {std::make_shared<http::ConnectionPool>(httpContext_)};
 
     mutable std::mutex requestLock_;
     std::map<unsigned, std::shared_ptr<http::Request>> requests_;
@@ -28,13 +28,18 @@
 #include "sockaddr.h"
 #include "value.h"
 #include "http.h"
+#include "metrics.h"
 
 #include <restinio/all.hpp>
 #include <restinio/tls.hpp>
 #include <json/json.h>
 
+#include <deque>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <set>
+#include <tuple>
 
 namespace dht {
 enum class PushType {
@@ -69,6 +74,25 @@ struct OPENDHT_PUBLIC ProxyServerConfig {
     std::string persistStatePath {};
     dht::crypto::Identity identity {};
     std::string bundleId {};
+    /** Number of TLS sessions kept by the server for resumption (0 disables the cache) */
+    size_t tlsSessionCacheSize {4096};
+    /** Lifetime of resumable TLS sessions and session tickets */
+    std::chrono::seconds tlsSessionTimeout {std::chrono::hours(2)};
+    /** Allow stateless session resumption with TLS session tickets */
+    bool tlsSessionTickets {true};
+    /** Maximum number of notifications sent in one push gateway request */
+    size_t pushBatchSize {100};
+    /** Maximum number of concurrent push gateway requests */
+    size_t pushMaxInflight {8};
+    /** Notifications queued beyond this limit are dropped */
+    size_t pushQueueSize {65536};
+    /** Serve the node and proxy metrics at /metrics, in the Prometheus text format */
+    bool metricsEndpoint {false};
+    /**
+     * Estimated memory used by listen sessions, push subscriptions and
+     * permanent puts beyond which new ones are refused (0 for no limit)
+     */
+    size_t maxSessionMemory {0};
 };
 
 /**
@@ -104,6 +128,15 @@ public:
     struct PushStats {
         uint64_t highPriorityCount {0};
         uint64_t normalPriorityCount {0};
+        /** Notifications waiting to be sent to the push gateway */
+        uint64_t queueDepth {0};
+        /** Notifications dropped because the queue was full */
+        uint64_t droppedCount {0};
+        /** Push gateway requests including notifications of this type */
+        uint64_t batchCount {0};
+        /** Total and maximum push gateway response time */
+        clock::duration batchLatencyTotal {0};
+        clock::duration batchLatencyMax {0};
 
         void increment(bool highPriority) {
             if (highPriority)
@@ -112,15 +145,36 @@ public:
                 normalPriorityCount++;
         }
 
+        void addBatch(clock::duration latency) {
+            batchCount++;
+            batchLatencyTotal += latency;
+            batchLatencyMax = std::max(batchLatencyMax, latency);
+        }
+
+        clock::duration batchLatencyAverage() const {
+            return batchCount ? batchLatencyTotal / batchCount : clock::duration::zero();
+        }
+
         Json::Value toJson() const {
+            using namespace std::chrono;
             Json::Value val;
             val["highPriorityCount"] = static_cast<Json::UInt64>(highPriorityCount);
             val["normalPriorityCount"] = static_cast<Json::UInt64>(normalPriorityCount);
+            val["queueDepth"] = static_cast<Json::UInt64>(queueDepth);
+            val["droppedCount"] = static_cast<Json::UInt64>(droppedCount);
+            val["batchCount"] = static_cast<Json::UInt64>(batchCount);
+            val["batchLatencyAverage"] = duration<double, std::milli>(batchLatencyAverage()).count();
+            val["batchLatencyMax"] = duration<double, std::milli>(batchLatencyMax).count();
             return val;
         }
 
         std::string toString() const {
-            return fmt::format("{} high priority, {} normal priority", highPriorityCount, normalPriorityCount);
+            auto ret = fmt::format("{} high priority, {} normal priority", highPriorityCount, normalPriorityCount);
+            if (batchCount)
+                ret += fmt::format(", {} batches ({} avg, {} max), {} queued, {} dropped",
+                                   batchCount, print_duration(batchLatencyAverage()), print_duration(batchLatencyMax),
+                                   queueDepth, droppedCount);
+            return ret;
         }
     };
 
@@ -200,9 +254,18 @@ private:
     struct RestRouterTraitsTls;
     struct RestRouterTraits;
 
+    /** Encoding of the values sent to a client */
+    enum class ValueFormat : uint8_t {
+        Json,
+        Msgpack
+    };
+    /** Values are sent as msgpack when the client accepts it */
+    static ValueFormat getValueFormat(const restinio::request_t& request);
+
     template <typename HttpResponse>
-    static HttpResponse initHttpResponse(HttpResponse response);
+    static HttpResponse initHttpResponse(HttpResponse response, ValueFormat format = ValueFormat::Json);
     static restinio::request_handling_status_t serverError(restinio::request_t& request);
+    static restinio::request_handling_status_t serverOverloaded(restinio::request_t& request);
 
     template< typename ServerSettings >
     void addServerSettings(ServerSettings& serverSettings,
@@ -231,12 +294,23 @@ private:
     RequestStatus getStats(restinio::request_handle_t request,
                            restinio::router::route_params_t params);
 
+    /**
+     * Return the node and proxy metrics, if enabled by the configuration
+     * Method: GET "/metrics"
+     * Result: HTTP 200, body: metrics in the Prometheus text format
+     * @param session
+     */
+    RequestStatus getMetrics(restinio::request_handle_t request,
+                             restinio::router::route_params_t params);
+
     /**
      * Return Values of an infoHash
      * Method: GET "/{InfoHash: .*}"
      * Return: Multiple JSON object in parts. Example:
      * Value in JSON format\n
      * Value in JSON format
+     * With Accept: application/msgpack, values are sent as
+     * msgpack frames (see proxy::MSGPACK_FRAME_SIZE_LEN).
      *
      * On error: HTTP 503, body: {"err":"xxxx"}
      * @param session
@@ -250,6 +324,8 @@ private:
      * Return: Multiple JSON object in parts. Example:
      * Value in JSON format\n
      * Value in JSON format
+     * With Accept: application/msgpack, values are sent as
+     * msgpack frames (see proxy::MSGPACK_FRAME_SIZE_LEN).
      *
      * On error: HTTP 503, body: {"err":"xxxx"}
      * @param session
@@ -257,10 +333,32 @@ private:
     RequestStatus listen(restinio::request_handle_t request,
                          restinio::router::route_params_t params);
 
+    /**
+     * Dispatch values received by a shared DHT listen operation
+     * to every listen session on the key.
+     */
+    bool handleSharedListen(const InfoHash& infoHash, const std::vector<Sp<Value>>& values, bool expired);
+
+    /**
+     * Remove a listen session from the shared listen operation of a key,
+     * cancelling the DHT listen when no session remains.
+     * lockListener_ must be held.
+     */
+    void removeListenSession(const InfoHash& infoHash, restinio::connection_id_t id);
+
+    /**
+     * Return the serialized representation of a value, as sent on response streams
+     * (JSON followed by a new line, or a msgpack frame). The result is built once
+     * per value, expired state and format, and shared by all the responses delivering it.
+     */
+    std::shared_ptr<const std::string> getSerializedValue(const Sp<Value>& value, bool expired = false,
+                                                          ValueFormat format = ValueFormat::Json);
+
     /**
      * Put a value on the DHT
      * Method: POST "/{InfoHash: .*}"
-     * body = Value to put in JSON
+     * body = Value to put in JSON, or with Content-Type: application/msgpack,
+     * a msgpack map {"value": Value, "permanent": true or map of push parameters}
      * Return: HTTP 200 if success and the value put in JSON
      * On error: HTTP 503, body: {"err":"xxxx"} if no dht
      * HTTP 400, body: {"err":"xxxx"} if bad json or HTTP 502 if put fails
@@ -401,11 +499,60 @@ private:
                           const std::shared_ptr<DhtProxyServer::PushSessionContext>& sessionCtx, const std::string& topic,
                           const std::vector<std::shared_ptr<Value>>& values, bool expired);
 
+    /** A notification waiting to be sent to the gorush push gateway */
+    struct PendingPush {
+        std::string token;
+        /** gorush notification, without the tokens */
+        Json::Value notification;
+        PushType type;
+        bool highPriority;
+    };
+
+    /**
+     * Queue a notification for the push gateway.
+     * Drops it if the queue is full.
+     */
+    void enqueuePushNotification(PendingPush&& push);
+
+    /**
+     * Send queued notifications in batches, while less than
+     * pushMaxInflight_ gateway requests are pending.
+     */
+    void flushPushNotifications();
+
+    /**
+     * Send a batch of notifications in a single gateway request.
+     * Notifications with identical content, ignoring their send time,
+     * are merged, with all their tokens.
+     */
+    void sendPushBatch(std::vector<PendingPush>&& batch);
+
+    /** @note pushStatsMutex_ must be held */
+    PushStats* getPushStats(PushType type);
+
+    /**
+     * @returns true if clientId already listens to infoHash with pushToken.
+     * @note lockListener_ must be held
+     */
+    bool hasPushListener(const std::string& pushToken, const InfoHash& infoHash, const std::string& clientId) const;
+
 #endif //OPENDHT_PUSH_NOTIFICATIONS
 
     void handlePrintStats(const asio::error_code &ec);
     void updateStats();
 
+    /**
+     * Estimated memory used by listen sessions, push subscriptions and
+     * permanent puts, in bytes.
+     * lockListener_ and lockSearchPuts_ must not be held.
+     */
+    size_t getSessionMemory();
+    /**
+     * @returns true if maxSessionMemory is set and exceeded.
+     * The estimate is refreshed at most once per second.
+     */
+    bool sessionMemoryExceeded();
+
     template <typename Os>
     void saveState(Os& stream);
 
@@ -448,6 +595,22 @@ private:
     std::map<restinio::connection_id_t, http::ListenerSession> listeners_;
     // Connection Listener observing conn state changes.
     std::shared_ptr<ConnectionListener> connListener_;
+    /**
+     * A single DHT listen operation shared by all the listen sessions on a key.
+     * Guarded by lockListener_.
+     */
+    struct SharedListen {
+        std::future<size_t> token;
+        /** Values currently known, sent to sessions joining later */
+        std::map<Value::Id, Sp<Value>> values;
+        std::set<restinio::connection_id_t> sessions;
+    };
+    std::map<InfoHash, std::shared_ptr<SharedListen>> sharedListens_;
+
+    // Serialized values, keyed by value address, expired state and format.
+    std::mutex serializedValuesLock_;
+    std::map<std::tuple<const Value*, bool, ValueFormat>, std::pair<std::weak_ptr<Value>, std::shared_ptr<const std::string>>> serializedValues_;
+    size_t serializedValuesPruneSize_ {0};
     struct PermanentPut {
         time_point expiration;
         std::string pushToken;
@@ -490,9 +653,17 @@ private:
     std::mutex lockSearchPuts_;
     std::map<InfoHash, SearchPuts> puts_;
 
+    size_t maxSessionMemory_ {0};
+    std::atomic<size_t> sessionMemory_ {0};
+    std::atomic<time_point> sessionMemoryTime_ {time_point::min()};
+
     mutable std::atomic<size_t> requestNum_ {0};
     mutable std::atomic<time_point> lastStatsReset_ {time_point::min()};
 
+    struct Metrics;
+    std::unique_ptr<Metrics> metrics_;
+    bool metricsEndpoint_ {false};
+
     std::string pushServer_;
     std::string bundleId_;
 
@@ -530,6 +701,17 @@ private:
         MSGPACK_DEFINE_ARRAY(listeners)
     };
     std::map<std::string, PushListener> pushListeners_;
+
+    size_t pushBatchSize_;
+    size_t pushMaxInflight_;
+    size_t pushQueueSize_;
+    std::mutex pushQueueLock_;
+    std::deque<PendingPush> pushQueue_;
+    /** Pending push gateway requests */
+    size_t pushInflight_ {0};
+    bool pushFlushScheduled_ {false};
+    std::unique_ptr<asio::steady_timer> pushFlushTimer_;
+    std::shared_ptr<http::ConnectionPool> pushConnectionPool_;
 #endif //OPENDHT_PUSH_NOTIFICATIONS
 };
 
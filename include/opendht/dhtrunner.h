@@ -28,6 +28,7 @@
 #include "logger.h"
 #include "network_utils.h"
 #include "node_export.h"
+#include "metrics.h"
 
 #include <thread>
 #include <mutex>
@@ -70,6 +71,8 @@ public:
         std::shared_ptr<dht::crypto::Certificate> server_ca;
         dht::crypto::Identity client_identity;
         SockAddr bind4 {}, bind6 {};
+        /** Maximum memory used by received packets waiting to be processed, in bytes */
+        size_t max_rx_queue_memory {net::RX_QUEUE_MAX_MEMORY};
     };
 
     struct Context {
@@ -81,6 +84,8 @@ public:
         IdentityAnnouncedCb identityAnnouncedCb {};
         PublicAddressChangedCb publicAddressChangedCb {};
         std::unique_ptr<std::mt19937_64> rng {};
+        /** Registry receiving the node metrics. A new one is created if not set. */
+        std::shared_ptr<metrics::Registry> metrics {};
         Context() {}
     };
 
@@ -155,6 +160,13 @@ public:
         return p->get_future();
     }
 
+    /**
+     * Get values for several keys as a single operation.
+     * Searches for keys in the same region of the keyspace share node
+     * discovery. dcb is called once, when all keys are done.
+     */
+    void getMany(std::vector<InfoHash> keys, KeyedGetCallback vcb, DoneManyCallback dcb = {}, Value::Filter f = {}, Where w = {});
+
     void query(const InfoHash& hash, QueryCallback cb, DoneCallback done_cb = {}, Query q = {});
     void query(const InfoHash& hash, QueryCallback cb, DoneCallbackSimple done_cb = {}, Query q = {}) {
         query(hash, cb, bindDoneCb(done_cb), q);
@@ -224,8 +236,15 @@ public:
         getFilterSet<T>(f), w);
     }
 
+    /**
+     * Listen to several keys as a single operation.
+     * @return the listen tokens, in the order of keys.
+     */
+    std::future<std::vector<size_t>> listenMany(std::vector<InfoHash> keys, KeyedValueCallback vcb, Value::Filter f = {}, Where w = {});
+
     void cancelListen(InfoHash h, size_t token);
     void cancelListen(InfoHash h, std::shared_future<size_t> token);
+    void cancelListen(std::vector<InfoHash> keys, std::shared_future<std::vector<size_t>> tokens);
 
     void put(InfoHash hash, std::shared_ptr<Value> value, DoneCallback cb={}, time_point created=time_point::max(), bool permanent = false);
     void put(InfoHash hash, std::shared_ptr<Value> value, DoneCallbackSimple cb, time_point created=time_point::max(), bool permanent = false) {
@@ -238,6 +257,12 @@ public:
     }
     void put(const std::string& key, Value&& value, DoneCallbackSimple cb={}, time_point created=time_point::max(), bool permanent = false);
 
+    /**
+     * Put several values as a single operation.
+     * cb is called once, when all values are announced or failed.
+     */
+    void putMany(std::vector<std::pair<InfoHash, std::shared_ptr<Value>>> values, DoneManyCallback cb = {}, time_point created=time_point::max(), bool permanent = false);
+
     void cancelPut(const InfoHash& h, Value::Id id);
     void cancelPut(const InfoHash& h, const std::shared_ptr<Value>& value);
 
@@ -386,6 +411,15 @@ public:
     void findCertificate(InfoHash hash, std::function<void(const std::shared_ptr<crypto::Certificate>&)>);
     void registerCertificate(const std::shared_ptr<crypto::Certificate>& cert);
     void setLocalCertificateStore(CertificateStoreQuery&& query_method);
+    LookupCacheStats getCertificateCacheStats() const;
+
+    /**
+     * Sets the identity of a node started without one.
+     * Allows to run the node unsigned while the identity is generated,
+     * for instance with crypto::IdentityFactory.
+     * Signed and encrypted operations fail until an identity is set.
+     */
+    void setIdentity(const crypto::Identity& identity);
 
     /**
      * @param port: Local port to bind. Both IPv4 and IPv6 will be tried (ANY).
@@ -438,6 +472,13 @@ public:
 
     std::shared_ptr<PeerDiscovery> getPeerDiscovery() const { return peerDiscovery_; };
 
+    /**
+     * Returns the registry holding the node metrics
+     * (receive queue, message processing, searches, storage),
+     * available once the node is running.
+     */
+    std::shared_ptr<metrics::Registry> getMetrics() const { return metrics_; }
+
     void setProxyServer(const std::string& proxy, const std::string& pushNodeId = "");
 
     /**
@@ -488,6 +529,7 @@ private:
     void opEnded();
     DoneCallback bindOpDoneCallback(DoneCallback&& cb);
     DoneCallbackSimple bindOpDoneCallback(DoneCallbackSimple&& cb);
+    std::function<void(const InfoHash&, bool)> bindManyDoneCallback(size_t count, DoneManyCallback&& cb);
 
     /** DHT instance */
     std::unique_ptr<SecureDht> dht_;
@@ -507,9 +549,13 @@ private:
     mutable std::mutex dht_mtx {};
     std::thread dht_thread {};
     std::condition_variable cv {};
-    std::mutex sock_mtx {};
+    mutable std::mutex sock_mtx {};
     net::PacketList rcv {};
     decltype(rcv) rcv_free {};
+    /* estimated memory used by rcv and rcv_free, protected by sock_mtx */
+    size_t rcv_memory {0};
+    size_t rcv_free_memory {0};
+    size_t rcv_max_memory {net::RX_QUEUE_MAX_MEMORY};
 
     std::queue<std::function<void(SecureDht&)>> pending_ops_prio {};
     std::queue<std::function<void(SecureDht&)>> pending_ops {};
@@ -527,6 +573,10 @@ private:
     /** PeerDiscovery Parameters */
     std::shared_ptr<PeerDiscovery> peerDiscovery_;
 
+    std::shared_ptr<metrics::Registry> metrics_;
+    struct RxMetrics;
+    std::unique_ptr<RxMetrics> rxMetrics_;
+
     /**
      * The Logger instance is used in enableProxy and other methods that
      * would create instances of classes using a common logger.
@@ -30,12 +30,15 @@
 #endif
 
 #include <asio/ip/tcp.hpp>
+#include <asio/steady_timer.hpp>
 #include <asio/streambuf.hpp>
 #include <asio/ssl/context.hpp>
 #include <restinio/message_builders.hpp>
 
 #include <memory>
 #include <queue>
+#include <deque>
+#include <map>
 #include <mutex>
 #include <future>
 
@@ -60,6 +63,8 @@ struct Certificate;
 
 namespace http {
 
+class TlsSessionCache;
+
 using HandlerCb = std::function<void(const asio::error_code& ec)>;
 using BytesHandlerCb = std::function<void(const asio::error_code& ec, size_t bytes)>;
 using ConnectHandlerCb = std::function<void(const asio::error_code& ec,
@@ -99,6 +104,13 @@ public:
 
     void set_ssl_verification(const std::string& hostname, const asio::ssl::verify_mode verify_mode);
 
+    /**
+     * Resume a previous TLS session with the same host if the cache has one,
+     * and store the session negotiated by the next handshake.
+     * Must be called after set_ssl_verification and before async_handshake.
+     */
+    void set_session_cache(std::shared_ptr<TlsSessionCache> cache);
+
     asio::streambuf& input();
     std::istream& data() { return istream_; }
 
@@ -116,6 +128,7 @@ public:
     void set_keepalive(uint32_t seconds);
 
     const asio::ip::address& local_address() const;
+    const asio::ip::tcp::endpoint& endpoint() const;
 
     void timeout(const std::chrono::seconds& timeout, HandlerCb cb = {});
 
@@ -151,6 +164,48 @@ private:
     std::unique_ptr<asio::steady_timer> timeout_timer_;
     std::shared_ptr<log::Logger> logger_;
     bool checkOcsp_ {false};
+
+    std::string hostname_;
+    std::shared_ptr<TlsSessionCache> sessionCache_;
+    std::string sessionKey_;
+    static int onNewSession(SSL* ssl, SSL_SESSION* session);
+};
+
+/* @class TlsSessionCache
+ * @brief Keeps the last TLS client session negotiated with each host (name and port),
+ * so that reconnections resume it and skip the asymmetric part of the handshake.
+ * Sessions are keyed by host only: a cache must only be shared between connections
+ * using the same TLS credentials.
+ */
+class OPENDHT_PUBLIC TlsSessionCache
+{
+public:
+    struct Stats {
+        /** Handshakes that resumed a cached session */
+        uint64_t resumed {0};
+        /** Full handshakes */
+        uint64_t full {0};
+        /** Sessions currently cached */
+        size_t sessions {0};
+    };
+
+    TlsSessionCache(size_t maxSessions = 64) : maxSessions_(maxSessions) {}
+
+    std::shared_ptr<SSL_SESSION> get(const std::string& host) const;
+    void set(const std::string& host, std::shared_ptr<SSL_SESSION> session);
+    void erase(const std::string& host);
+    void clear();
+
+    void onHandshake(bool resumed);
+    Stats getStats() const;
+
+private:
+    mutable std::mutex mutex_;
+    size_t maxSessions_;
+    std::map<std::string, std::shared_ptr<SSL_SESSION>> sessions_;
+    /** hosts in insertion order, to evict the oldest first */
+    std::deque<std::string> order_;
+    Stats stats_ {};
 };
 
 /* @class Resolver
@@ -203,6 +258,95 @@ private:
     std::shared_ptr<log::Logger> logger_;
 };
 
+/* @class ConnectionPool
+ * @brief Keeps idle keep-alive connections to reuse them for later requests to the same origin,
+ * saving a TCP connect and TLS handshake per request.
+ * Connections are keyed by origin only: a pool must only be shared between requests
+ * using the same TLS credentials.
+ */
+class OPENDHT_PUBLIC ConnectionPool : public std::enable_shared_from_this<ConnectionPool>
+{
+public:
+    struct Config {
+        /** Maximum number of idle connections kept per origin */
+        size_t max_idle_per_host {4};
+        /** Maximum number of idle connections kept for all origins */
+        size_t max_idle {32};
+        /** Idle connections are closed after this delay */
+        std::chrono::seconds idle_timeout {30};
+    };
+
+    struct Stats {
+        /** Requests sent on an idle connection */
+        uint64_t hits {0};
+        /** Requests that required a new connection */
+        uint64_t misses {0};
+        /** Reused connections found closed by the peer */
+        uint64_t stale {0};
+        /** Idle connections closed because of the timeout or pool limits */
+        uint64_t evicted {0};
+        /** Connections currently idle */
+        size_t idle {0};
+        /** TLS handshakes that resumed a cached session */
+        uint64_t tls_resumed {0};
+        /** Full TLS handshakes */
+        uint64_t tls_full {0};
+
+        double hitRate() const {
+            auto total = hits + misses;
+            return total ? (double)hits / total : 0.;
+        }
+    };
+
+    ConnectionPool(asio::io_context& ctx, Config config = {});
+    ~ConnectionPool();
+
+    void setConfig(const Config& config);
+
+    /**
+     * Take the most recently used idle connection for this origin.
+     * @return an open connection, or nullptr if none is available.
+     */
+    std::shared_ptr<Connection> get(const std::string& origin);
+
+    /**
+     * Give back a connection after a complete keep-alive response.
+     */
+    void release(const std::string& origin, std::shared_ptr<Connection> conn);
+
+    /** A connection returned by get() was closed by the peer */
+    void stale();
+
+    /** Close all idle connections */
+    void clear();
+
+    Stats getStats() const;
+
+    /** TLS sessions of the connections created for this pool */
+    const std::shared_ptr<TlsSessionCache>& getSessionCache() const {
+        return sessionCache_;
+    }
+
+private:
+    struct IdleConnection {
+        std::shared_ptr<Connection> conn;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    void evictOldest();
+    void scheduleEviction();
+    void onEvictionTimer(const asio::error_code& ec);
+
+    mutable std::mutex mutex_;
+    Config config_;
+    std::map<std::string, std::deque<IdleConnection>> idle_;
+    size_t idleCount_ {0};
+    Stats stats_ {};
+    asio::steady_timer evictionTimer_;
+    bool evictionScheduled_ {false};
+    std::shared_ptr<TlsSessionCache> sessionCache_ {std::make_shared<TlsSessionCache>()};
+};
+
 class Request;
 
 struct Response
@@ -254,6 +398,18 @@ public:
     inline unsigned int id() const { return  id_; };
     void set_connection(std::shared_ptr<Connection> connection);
     std::shared_ptr<Connection> get_connection() const;
+
+    /**
+     * Reuse idle connections from the pool and give back the connection once
+     * the response is complete. Switches the request to keep-alive.
+     */
+    void set_connection_pool(std::shared_ptr<ConnectionPool> pool);
+
+    /**
+     * Resume TLS sessions from this cache for new https connections.
+     * Set implicitly by set_connection_pool.
+     */
+    void set_session_cache(std::shared_ptr<TlsSessionCache> cache);
     inline const Url& get_url() const {
         return resolver_->get_url();
     };
@@ -328,11 +484,16 @@ private:
      */
     void init_parser();
 
+    void start();
     void connect(std::vector<asio::ip::tcp::endpoint>&& endpoints, HandlerCb cb = {});
+    void set_host(bool https, in_port_t port);
+    std::string get_origin() const;
+    /** The request can safely be sent again */
+    bool is_idempotent() const;
 
     void post();
 
-    void handle_request(const asio::error_code& ec);
+    void handle_request(const asio::error_code& ec, size_t n_bytes);
     void handle_response(const asio::error_code& ec, size_t bytes);
 
     void onHeadersComplete();
@@ -362,6 +523,15 @@ private:
     sa_family_t family_ = AF_UNSPEC;
     std::shared_ptr<Connection> conn_;
     std::shared_ptr<Resolver> resolver_;
+    std::shared_ptr<ConnectionPool> pool_;
+    std::shared_ptr<TlsSessionCache> sessionCache_;
+    /** conn_ was taken from pool_ */
+    bool reused_ {false};
+    /** some of the request was written to conn_ */
+    bool sent_ {false};
+    /** conn_ was given back to pool_ */
+    bool released_ {false};
+    bool complete_ {false};
 
     Response response_ {};
     std::string request_;
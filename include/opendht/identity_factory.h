@@ -0,0 +1,98 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "crypto.h"
+#include "thread_pool.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+
+namespace dht {
+namespace crypto {
+
+/**
+ * Generates private keys and identities asynchronously,
+ * on the computation thread pool.
+ *
+ * Up to pool_size keys are generated in advance, so that a key is usually
+ * ready when requested; the pool is refilled in the background.
+ *
+ *     IdentityFactory factory;
+ *     node.run(port);  // no identity yet
+ *     factory.getIdentity([&](const Identity& id, std::exception_ptr) {
+ *         node.setIdentity(id);
+ *     }, "dhtnode");
+ *
+ * The destructor waits for keys being generated.
+ */
+class OPENDHT_PUBLIC IdentityFactory {
+public:
+    using KeyGenerator = std::function<PrivateKey()>;
+    using KeyCallback = std::function<void(const std::shared_ptr<PrivateKey>&, std::exception_ptr)>;
+    using IdentityCallback = std::function<void(const Identity&, std::exception_ptr)>;
+
+    /**
+     * @param pool_size number of keys to generate in advance.
+     * @param generator the key generator, RSA-4096 by default.
+     */
+    IdentityFactory(size_t pool_size = 1, KeyGenerator generator = {});
+    ~IdentityFactory();
+
+    IdentityFactory(const IdentityFactory&) = delete;
+    IdentityFactory& operator=(const IdentityFactory&) = delete;
+
+    /**
+     * Calls cb with a new key, immediately if one is ready,
+     * or from the computation thread pool once generated.
+     */
+    void getKey(KeyCallback cb);
+    std::future<std::shared_ptr<PrivateKey>> getKey();
+
+    /**
+     * Calls cb with a new identity, using a new key and a certificate
+     * signed by ca, or a self-signed CA certificate if ca is empty,
+     * like generateIdentity.
+     */
+    void getIdentity(IdentityCallback cb, const std::string& name = "dhtnode", const Identity& ca = {});
+    std::future<Identity> getIdentity(const std::string& name = "dhtnode", const Identity& ca = {});
+
+    /** Number of keys ready to be used */
+    size_t available() const;
+
+private:
+    void fill(std::unique_lock<std::mutex>& lock);
+    void generated(std::shared_ptr<PrivateKey> key, std::exception_ptr err);
+
+    const size_t poolSize_;
+    const KeyGenerator generator_;
+
+    mutable std::mutex lock_ {};
+    std::condition_variable cv_ {};
+    std::deque<std::shared_ptr<PrivateKey>> keys_ {};
+    std::deque<KeyCallback> waiting_ {};
+    size_t generating_ {0};
+    bool running_ {true};
+};
+
+}
+}
@@ -42,6 +42,7 @@ typedef uint16_t in_port_t;
 #include <array>
 #include <vector>
 #include <string_view>
+#include <functional>
 #include <algorithm>
 #include <stdexcept>
 #include <sstream>
@@ -57,6 +58,22 @@ namespace crypto {
     OPENDHT_PUBLIC void hash(const uint8_t* data, size_t data_length, uint8_t* hash, size_t hash_length);
 }
 
+/**
+ * Random per-process seed for hash tables keyed by data received
+ * from the network, so that peers can't craft colliding keys.
+ */
+OPENDHT_PUBLIC uint64_t hashSeed();
+
+/**
+ * Fast non-cryptographic 64-bit mixing function (splitmix64 finalizer).
+ */
+constexpr uint64_t
+hashMix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
 /**
  * Represents an Hash,
  * a byte array of N bytes.
@@ -397,3 +414,16 @@ struct fmt::formatter<dht::Hash<N>>: formatter<string_view> {
     return formatter<string_view>::format(c.to_view(), ctx);
   }
 };
+
+template <size_t N>
+struct std::hash<dht::Hash<N>> {
+    size_t operator()(const dht::Hash<N>& h) const noexcept {
+        uint64_t ret = dht::hashSeed();
+        for (size_t i = 0; i < N; i += sizeof(uint64_t)) {
+            uint64_t w {0};
+            std::memcpy(&w, h.data() + i, std::min(sizeof(uint64_t), N - i));
+            ret = dht::hashMix(ret ^ w);
+        }
+        return static_cast<size_t>(ret);
+    }
+};
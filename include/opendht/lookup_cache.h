@@ -0,0 +1,208 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "infohash.h"
+#include "utils.h"
+
+#include <list>
+#include <unordered_map>
+#include <functional>
+#include <vector>
+
+namespace dht {
+
+struct OPENDHT_PUBLIC LookupCacheStats {
+    /** Lookups answered with a cached entry */
+    uint64_t hits {0};
+    /** Lookups answered with a cached failure */
+    uint64_t negative_hits {0};
+    /** Lookups that joined a query already in progress */
+    uint64_t coalesced {0};
+    /** Lookups that started a new query */
+    uint64_t misses {0};
+    /** Current number of entries */
+    size_t size {0};
+
+    /** Fraction of lookups that didn't start a new query */
+    double hitRate() const {
+        auto total = hits + negative_hits + coalesced + misses;
+        return total ? (total - misses) / (double)total : 0.;
+    }
+};
+
+/**
+ * Bounded cache of lookup results (like certificates or public keys) by id.
+ *
+ * Entries expire after ttl, failed lookups are remembered for negative_ttl,
+ * and the least recently used entry is evicted when the cache is full.
+ * Concurrent lookups for the same id are coalesced: only the first caller
+ * starts a query, and all callers get its result from resolve().
+ *
+ * Not thread-safe.
+ */
+template <typename T>
+class LookupCache {
+public:
+    using Callback = std::function<void(const Sp<T>&)>;
+
+    LookupCache(size_t max_size = 4096,
+                duration ttl = std::chrono::hours(1),
+                duration negative_ttl = std::chrono::minutes(1))
+        : max_size_(max_size), ttl_(ttl), negative_ttl_(negative_ttl) {}
+
+    /**
+     * Returns the cached entry for id, or nullptr if there is none,
+     * if it expired or if it's a cached failure.
+     * Doesn't count as a lookup.
+     */
+    Sp<T> get(const InfoHash& id, const time_point& now = clock::now()) {
+        auto it = find(id, now);
+        return it == entries_.end() ? nullptr : it->second.value;
+    }
+
+    /**
+     * Looks up id. If the result is known, cb is called immediately.
+     * Otherwise cb will be called by resolve().
+     * @return true if the caller must start a query for id,
+     *         and call resolve() with its result.
+     */
+    bool lookup(const InfoHash& id, Callback cb, const time_point& now = clock::now()) {
+        auto it = find(id, now);
+        if (it != entries_.end()) {
+            if (it->second.value)
+                stats_.hits++;
+            else
+                stats_.negative_hits++;
+            if (cb)
+                cb(it->second.value);
+            return false;
+        }
+        auto p = pending_.find(id);
+        if (p != pending_.end()) {
+            stats_.coalesced++;
+            if (cb)
+                p->second.emplace_back(std::move(cb));
+            return false;
+        }
+        stats_.misses++;
+        auto& callbacks = pending_[id];
+        if (cb)
+            callbacks.emplace_back(std::move(cb));
+        return true;
+    }
+
+    /**
+     * Caches the result of a query (nullptr if it failed),
+     * and calls the callbacks waiting for it.
+     */
+    void resolve(const InfoHash& id, Sp<T> value, const time_point& now = clock::now()) {
+        insert(id, value, now);
+        auto p = pending_.find(id);
+        if (p == pending_.end())
+            return;
+        // callbacks may start new lookups
+        auto callbacks = std::move(p->second);
+        pending_.erase(p);
+        for (const auto& cb : callbacks)
+            cb(value);
+    }
+
+    /**
+     * Inserts or replaces the entry for id.
+     * A null value is cached as a failure.
+     */
+    void insert(const InfoHash& id, Sp<T> value, const time_point& now = clock::now()) {
+        auto expiration = now + (value ? ttl_ : negative_ttl_);
+        auto it = entries_.find(id);
+        if (it != entries_.end()) {
+            // don't replace a valid entry with a failure
+            if (not value and it->second.value and it->second.expiration > now)
+                return;
+            it->second.value = std::move(value);
+            it->second.expiration = expiration;
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+            return;
+        }
+        if (max_size_ == 0)
+            return;
+        while (entries_.size() >= max_size_) {
+            entries_.erase(lru_.back());
+            lru_.pop_back();
+        }
+        lru_.emplace_front(id);
+        entries_.emplace(id, Entry {std::move(value), expiration, lru_.begin()});
+    }
+
+    void erase(const InfoHash& id) {
+        auto it = entries_.find(id);
+        if (it != entries_.end()) {
+            lru_.erase(it->second.lru);
+            entries_.erase(it);
+        }
+    }
+
+    void clear() {
+        entries_.clear();
+        lru_.clear();
+    }
+
+    /** Number of queries in progress */
+    size_t pending() const { return pending_.size(); }
+    size_t size() const { return entries_.size(); }
+
+    LookupCacheStats getStats() const {
+        auto stats = stats_;
+        stats.size = entries_.size();
+        return stats;
+    }
+
+private:
+    struct Entry {
+        Sp<T> value;
+        time_point expiration;
+        std::list<InfoHash>::iterator lru;
+    };
+    using EntryMap = std::unordered_map<InfoHash, Entry>;
+
+    /** Finds a valid entry, removing it if expired */
+    typename EntryMap::iterator find(const InfoHash& id, const time_point& now) {
+        auto it = entries_.find(id);
+        if (it == entries_.end())
+            return it;
+        if (it->second.expiration <= now) {
+            lru_.erase(it->second.lru);
+            entries_.erase(it);
+            return entries_.end();
+        }
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        return it;
+    }
+
+    const size_t max_size_;
+    const duration ttl_;
+    const duration negative_ttl_;
+
+    EntryMap entries_ {};
+    /** Most recently used first */
+    std::list<InfoHash> lru_ {};
+    std::unordered_map<InfoHash, std::vector<Callback>> pending_ {};
+    LookupCacheStats stats_ {};
+};
+
+}
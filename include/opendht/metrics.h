@@ -0,0 +1,138 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "def.h"
+#include "utils.h"
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dht {
+namespace metrics {
+
+using Labels = std::vector<std::pair<std::string, std::string>>;
+
+/** Monotonic counter */
+class OPENDHT_PUBLIC Counter {
+public:
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<uint64_t> value_ {0};
+};
+
+/** Value that can go up and down */
+class OPENDHT_PUBLIC Gauge {
+public:
+    void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+    void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<int64_t> value_ {0};
+};
+
+/** Distribution of observed values, in buckets with fixed upper bounds */
+class OPENDHT_PUBLIC Histogram {
+public:
+    /** Bounds in seconds, from 100µs to 10s */
+    static const std::vector<double>& latencyBounds();
+
+    explicit Histogram(std::vector<double> bounds = latencyBounds());
+
+    void observe(double v);
+    void observe(duration d) {
+        observe(std::chrono::duration<double>(d).count());
+    }
+
+    const std::vector<double>& bounds() const { return bounds_; }
+    /** Count of observations in each bucket (not cumulative), the last one being +Inf */
+    std::vector<uint64_t> buckets() const;
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    double sum() const { return sum_.load(std::memory_order_relaxed); }
+
+private:
+    const std::vector<double> bounds_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+    std::atomic<uint64_t> count_ {0};
+    std::atomic<double> sum_ {0.};
+};
+
+/**
+ * Set of named metrics, exported in the Prometheus/OpenMetrics text format.
+ *
+ * Metrics are registered once (under a lock), and then updated without
+ * locking from any thread. Registering an existing name and label set
+ * returns the existing metric. Metrics live as long as the registry.
+ */
+class OPENDHT_PUBLIC Registry {
+public:
+    Counter& counter(const std::string& name, const std::string& help, const Labels& labels = {});
+    Gauge& gauge(const std::string& name, const std::string& help, const Labels& labels = {});
+    Histogram& histogram(const std::string& name, const std::string& help, const Labels& labels = {},
+                         const std::vector<double>& bounds = Histogram::latencyBounds());
+
+    /** Prometheus text exposition format (version 0.0.4) */
+    std::string toPrometheus() const;
+    static constexpr const char* CONTENT_TYPE = "text/plain; version=0.0.4; charset=utf-8";
+
+private:
+    enum class Type { Counter, Gauge, Histogram };
+    struct Metric {
+        std::string labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+    struct Family {
+        std::string name;
+        std::string help;
+        Type type;
+        std::deque<Metric> metrics;
+    };
+
+    Metric& get(const std::string& name, const std::string& help, Type type, const Labels& labels);
+
+    mutable std::mutex lock_;
+    std::deque<Family> families_;
+    std::map<std::string, Family*> byName_;
+};
+
+/**
+ * Measures the time until destruction into a histogram, if set.
+ */
+class ScopedTimer {
+public:
+    ScopedTimer(Histogram* h) : histogram_(h), start_(h ? clock::now() : time_point{}) {}
+    ~ScopedTimer() {
+        if (histogram_)
+            histogram_->observe(clock::now() - start_);
+    }
+private:
+    Histogram* histogram_;
+    time_point start_;
+};
+
+}
+}
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "node_cache.h"
+#include "callbacks.h"
 #include "value.h"
 #include "infohash.h"
 #include "node.h"
@@ -29,6 +30,7 @@
 #include "rate_limiter.h"
 #include "logger.h"
 #include "network_utils.h"
+#include "metrics.h"
 
 #include <vector>
 #include <string>
@@ -53,6 +55,8 @@ struct NetworkConfig {
     ssize_t max_req_per_sec {0};
     ssize_t max_peer_req_per_sec {0};
     bool is_client {false};
+    /** Maximum memory used by incomplete fragmented messages, in bytes */
+    size_t max_partial_memory {DEFAULT_PARTIAL_MEMORY_LIMIT};
 };
 
 class DhtProtocolException : public DhtException {
@@ -61,6 +65,7 @@ public:
     static const constexpr uint16_t NON_AUTHORITATIVE_INFORMATION {203}; /* incomplete request packet. */
     static const constexpr uint16_t UNAUTHORIZED {401};                  /* wrong tokens. */
     static const constexpr uint16_t NOT_FOUND {404};                     /* storage not found */
+    static const constexpr uint16_t OVERLOADED {503};                    /* request refused: resource limit reached */
     // for internal use (custom).
     static const constexpr uint16_t INVALID_TID_SIZE {421};              /* id was truncated. */
     static const constexpr uint16_t UNKNOWN_TID {422};                   /* unknown tid */
@@ -73,6 +78,7 @@ public:
     static const std::string PUT_WRONG_TOKEN;    /* got "put" request with wrong token */
     static const std::string STORAGE_NOT_FOUND;  /* got access request for an unknown storage */
     static const std::string PUT_INVALID_ID;     /* invalid id in "put" request */
+    static const std::string LISTEN_OVERLOADED;  /* "listen" refused: listener limit reached */
 
     DhtProtocolException(uint16_t code, const std::string& msg="", InfoHash failing_node_id={})
         : DhtException(msg), msg(msg), code(code), failing_node_id(failing_node_id) {}
@@ -457,6 +463,12 @@ public:
 
     void blacklistNode(const Sp<Node>& n);
 
+    /**
+     * Registers the message processing metrics (received, dropped and
+     * processing time per message type) in registry.
+     */
+    void setMetrics(metrics::Registry& registry);
+
     std::vector<Sp<Node>> getCachedNodes(const InfoHash& id, sa_family_t sa_f, size_t count) {
         return cache.getCachedNodes(id, sa_f, count);
     }
@@ -475,10 +487,16 @@ public:
     size_t getPartialCount() const {
         return partial_messages.size();
     }
+    /** Estimated memory used by incomplete fragmented messages, in bytes */
+    size_t getPartialMemory() const {
+        return partial_memory;
+    }
 
 private:
 
     struct PartialMessage;
+    struct PartialTransmit;
+    using TxKey = std::pair<Tid, SockAddr>;
 
     /***************
      *  Constants  *
@@ -494,6 +512,16 @@ private:
     static constexpr std::chrono::seconds RX_MAX_PACKET_TIME {10};
     /* Max. time between packet fragments */
     static constexpr std::chrono::seconds RX_TIMEOUT {3};
+    /* Time without new fragments after which missing parts are requested */
+    static constexpr std::chrono::milliseconds RX_ACK_DELAY {100};
+    /* Max. number of missing ranges reported in a part acknowledgement */
+    static constexpr size_t RX_ACK_MAX_RANGES {64};
+    /* Number of fragments sent back-to-back */
+    static constexpr unsigned TX_BURST {8};
+    /* Time between two bursts of fragments */
+    static constexpr std::chrono::milliseconds TX_PACING {2};
+    /* Max. number of outgoing fragmented messages kept for retransmission */
+    static constexpr size_t TX_MAX_PENDING {256};
     /* The maximum number of nodes that we snub.  There is probably little
         reason to increase this value. */
     static constexpr unsigned BLACKLISTED_MAX {10};
@@ -531,12 +559,23 @@ private:
     // basic wrapper for socket sendto function
     int send(const SockAddr& addr, const char *buf, size_t len, bool confirmed = false);
 
-    void sendValueParts(Tid tid, const std::vector<Blob>& svals, const SockAddr& addr);
+    /**
+     * Sends values in MTU-sized fragments, paced in bursts of TX_BURST.
+     * Fragments are kept until acknowledged by the receiver so that only
+     * missing ones are retransmitted.
+     */
+    void sendValueParts(Tid tid, std::vector<Blob> svals, const SockAddr& addr);
+    void sendValuePart(Tid tid, unsigned index, const Blob& v, size_t start, const SockAddr& addr, bool want_ack);
+    void sendPendingParts(const TxKey& key);
+    /* Acknowledges received fragments, listing missing ones (none if complete) */
+    void sendPartsAck(Tid tid, const SockAddr& addr, const std::map<unsigned, std::vector<std::pair<unsigned, unsigned>>>& missing);
+    void requestMissingParts(Tid tid);
     std::vector<Blob> packValueHeader(msgpack::sbuffer&, std::vector<Sp<Value>>::const_iterator, std::vector<Sp<Value>>::const_iterator) const;
     std::vector<Blob> packValueHeader(msgpack::sbuffer& buf, const std::vector<Sp<Value>>& values) const {
         return packValueHeader(buf, values.begin(), values.end());
     }
     void maintainRxBuffer(Tid tid);
+    void maintainTxBuffer(const TxKey& key);
 
     /*************
      *  Answers  *
@@ -590,6 +629,9 @@ private:
     // requests handling
     std::map<Tid, Sp<Request>> requests {};
     std::map<Tid, PartialMessage> partial_messages;
+    size_t partial_memory {0};
+    /* Tids are chosen by the requesting peer: transmits are also keyed by destination */
+    std::map<TxKey, PartialTransmit> partial_transmits;
 
     MessageStats in_stats {}, out_stats {};
     std::set<SockAddr> blacklist {};
@@ -597,6 +639,9 @@ private:
     Scheduler& scheduler;
 
     bool logIncoming_ {false};
+
+    struct Metrics;
+    std::unique_ptr<Metrics> metrics_;
 };
 
 } /* namespace net  */
@@ -43,6 +43,7 @@ namespace net {
 
 static const constexpr in_port_t DHT_DEFAULT_PORT = 4222;
 static const constexpr size_t RX_QUEUE_MAX_SIZE = 1024 * 64;
+static const constexpr size_t RX_QUEUE_MAX_MEMORY = 1024 * 1024 * 64;
 static const constexpr std::chrono::milliseconds RX_QUEUE_MAX_DELAY(650);
 
 int bindSocket(const SockAddr& addr, SockAddr& bound);
@@ -56,6 +57,11 @@ struct ReceivedPacket {
     Blob data;
     SockAddr from;
     time_point received;
+
+    /** Estimated memory used by the packet in a PacketList, in bytes */
+    size_t memoryUsage() const {
+        return sizeof(ReceivedPacket) + 2 * sizeof(void*) + data.capacity();
+    }
 };
 using PacketList = std::list<ReceivedPacket>;
 
@@ -45,7 +45,7 @@ struct Socket {
     SocketCb on_receive {};
 };
 
-struct Node {
+struct OPENDHT_PUBLIC Node {
     const InfoHash id;
 
     Node(const InfoHash& id, const SockAddr& addr, std::mt19937_64& rd, bool client=false);
@@ -94,6 +94,7 @@ struct Node {
         NodeExport ne;
         ne.id = id;
         ne.addr = addr;
+        ne.rtt = std::chrono::duration_cast<std::chrono::microseconds>(srtt_);
         return ne;
     }
     sa_family_t getFamily() const { return addr.getFamily(); }
@@ -107,6 +108,20 @@ struct Node {
 
     void setExpired();
 
+    /**
+     * Smoothed round-trip time of the replies of this node,
+     * or zero if none was measured yet.
+     */
+    duration getRtt() const { return srtt_; }
+    duration getRttVar() const { return rttvar_; }
+
+    /**
+     * Retransmission timeout for requests to this node, computed from the
+     * round-trip time estimation (RFC 6298), or MAX_RESPONSE_TIME until
+     * a reply was measured.
+     */
+    duration getRto() const;
+
     /**
      * Opens a socket on which a node will be able allowed to write for further
      * additionnal updates following the response to a previous request.
@@ -154,16 +169,24 @@ struct Node {
     /* Time for a request to timeout */
     static constexpr const std::chrono::seconds MAX_RESPONSE_TIME {1};
 
+    /* Bounds of the retransmission timeout */
+    static constexpr const std::chrono::milliseconds MIN_RTO {200};
+    static constexpr const std::chrono::seconds MAX_RTO {2};
+
 private:
     /* Number of times we accept authentication errors from this node. */
     static const constexpr unsigned MAX_AUTH_ERRORS {3};
 
+    void updateRtt(duration rtt);
+
     SockAddr addr;
     bool is_client {false};
     time_point time {time_point::min()};            /* last time eared about */
     time_point reply_time {time_point::min()};      /* time of last correct reply received */
     unsigned auth_errors {0};
     bool expired_ {false};
+    duration srtt_ {0};                             /* smoothed round-trip time */
+    duration rttvar_ {0};                           /* round-trip time variation */
     Tid transaction_id;
     using TransactionDist = std::uniform_int_distribution<decltype(transaction_id)>;
 
@@ -20,6 +20,7 @@
 #include "infohash.h"
 #include "sockaddr.h"
 
+#include <chrono>
 #include <string_view>
 
 namespace dht {
@@ -28,16 +29,22 @@ using namespace std::literals;
 struct OPENDHT_PUBLIC NodeExport {
     InfoHash id;
     SockAddr addr;
+    /** Smoothed round-trip time, zero if unknown */
+    std::chrono::microseconds rtt {0};
 
     template <typename Packer>
     void msgpack_pack(Packer& pk) const
     {
-        pk.pack_map(2);
+        pk.pack_map(rtt.count() ? 3 : 2);
         pk.pack("id"sv);
         pk.pack(id);
         pk.pack("addr"sv);
         pk.pack_bin(addr.getLength());
         pk.pack_bin_body((const char*)addr.get(), (size_t)addr.getLength());
+        if (rtt.count()) {
+            pk.pack("rtt"sv);
+            pk.pack(rtt.count());
+        }
     }
 
     void msgpack_unpack(msgpack::object o);
@@ -18,6 +18,8 @@
 #pragma once
 
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 
 namespace dht {
 namespace proxy {
@@ -27,5 +29,15 @@ constexpr const std::chrono::hours OP_MARGIN {2}; // two hours
 
 using ListenToken = uint64_t;
 
+constexpr const char* CONTENT_TYPE_JSON = "application/json";
+constexpr const char* CONTENT_TYPE_MSGPACK = "application/msgpack";
+
+/**
+ * Values sent as msgpack are framed as:
+ * 32-bit big-endian size of the rest of the frame, flags byte, packed value.
+ */
+constexpr const size_t MSGPACK_FRAME_SIZE_LEN {4};
+constexpr const uint8_t MSGPACK_FRAME_EXPIRED {1};
+
 }
 }
@@ -49,7 +49,7 @@ struct Bucket {
     }
 };
 
-class RoutingTable : public std::list<Bucket> {
+class OPENDHT_PUBLIC RoutingTable : public std::list<Bucket> {
 public:
     using std::list<Bucket>::list;
 
@@ -42,6 +42,12 @@ public:
         void cancel() { do_ = {}; }
     };
 
+    /** Source of the current time, used to run the scheduler in virtual time */
+    using Clock = std::function<time_point()>;
+
+    Scheduler() {}
+    explicit Scheduler(Clock c) : clock_(std::move(c)), now(clock_ ? clock_() : clock::now()) {}
+
     /**
      * Adds another job to the queue.
      *
@@ -121,10 +127,11 @@ public:
      * operations.
      */
     inline const time_point& time() const { return now; }
-    inline time_point syncTime() { return (now = clock::now()); }
+    inline time_point syncTime() { return (now = clock_ ? clock_() : clock::now()); }
     inline void syncTime(const time_point& n) { now = n; }
 
 private:
+    Clock clock_ {};
     time_point now {clock::now()};
     std::multimap<time_point, Sp<Job>> timers {}; /* the jobs ordered by time */
 };
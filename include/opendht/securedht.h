@@ -22,6 +22,7 @@
 
 #include "dht.h"
 #include "crypto.h"
+#include "lookup_cache.h"
 
 #include <map>
 #include <vector>
@@ -55,16 +56,27 @@ public:
 
     virtual ~SecureDht();
 
+    // key_ may be set by setIdentity while these are called from another thread
     InfoHash getId() const {
-        return key_ ? key_->getPublicKey().getId() : InfoHash();
+        auto key = std::atomic_load(&key_);
+        return key ? key->getPublicKey().getId() : InfoHash();
     }
     PkId getLongId() const {
-        return key_ ? key_->getPublicKey().getLongId() : PkId();
+        auto key = std::atomic_load(&key_);
+        return key ? key->getPublicKey().getLongId() : PkId();
     }
     Sp<crypto::PublicKey> getPublicKey() const {
-        return key_ ? key_->getSharedPublicKey() : Sp<crypto::PublicKey>{};
+        auto key = std::atomic_load(&key_);
+        return key ? key->getSharedPublicKey() : Sp<crypto::PublicKey>{};
     }
 
+    /**
+     * Sets the identity of a node started without one (or replaces it),
+     * and announces its certificate.
+     * The node id, computed at startup, is not changed.
+     */
+    void setIdentity(const crypto::Identity& id);
+
     ValueType secureType(ValueType&& type);
 
     ValueType secureType(const ValueType& type) {
@@ -135,12 +147,27 @@ public:
     void findCertificate(const InfoHash& node, const std::function<void(const Sp<crypto::Certificate>)>& cb);
     void findPublicKey(const InfoHash& node, const std::function<void(const Sp<crypto::PublicKey>)>& cb);
 
+    /**
+     * Registered certificates are kept until the SecureDht is destroyed,
+     * outside of the bounded certificate cache.
+     */
     Sp<crypto::Certificate> registerCertificate(const InfoHash& node, const Blob& cert);
     void registerCertificate(const Sp<crypto::Certificate>& cert);
 
     Sp<crypto::Certificate> getCertificate(const InfoHash& node) const;
     Sp<crypto::PublicKey> getPublicKey(const InfoHash& node) const;
 
+    /**
+     * Hit and miss counters of the certificate and public key caches
+     * used by findCertificate and findPublicKey.
+     */
+    LookupCacheStats getCertificateCacheStats() const {
+        return nodesCertificates_.getStats();
+    }
+    LookupCacheStats getPublicKeyCacheStats() const {
+        return nodesPubKeys_.getStats();
+    }
+
     /**
      * Allows to set a custom callback called by the library to find a locally-stored certificate.
      * The search key used is the public key ID, so there may be multiple certificates retured, signed with
@@ -167,6 +194,9 @@ public:
     std::pair<size_t, size_t> getStoreSize() const override {
         return dht_->getStoreSize();
     }
+    MemoryStats getMemoryStats() const override {
+        return dht_->getMemoryStats();
+    }
     std::string getStorageLog() const override {
         return dht_->getStorageLog();
     }
@@ -350,25 +380,38 @@ public:
         dht_->setLogFilter(f);
     }
 
+    void setMetrics(const std::shared_ptr<metrics::Registry>& registry) override {
+        dht_->setMetrics(registry);
+    }
+
 private:
     std::unique_ptr<DhtInterface> dht_;
     // prevent copy
     SecureDht(const SecureDht&) = delete;
     SecureDht& operator=(const SecureDht&) = delete;
 
+    /** Returns the certificate in data if it belongs to node, nullptr otherwise */
+    Sp<crypto::Certificate> parseCertificate(const InfoHash& node, const Blob& data) const;
     Sp<Value> checkValue(const Sp<Value>& v);
     ValueCallback getCallbackFilter(const ValueCallback&, Value::Filter&&);
     GetCallback getCallbackFilter(const GetCallback&, Value::Filter&&);
+    /** Announce our certificate, once connected */
+    void announceCertificate();
 
+    /** Set by setIdentity from any thread: use std::atomic_load/store */
     Sp<crypto::PrivateKey> key_ {};
     Sp<crypto::Certificate> certificate_ {};
 
+    IdentityAnnouncedCb identityAnnouncedCb_ {};
+
     // method to query the local certificate store
     CertificateStoreQuery localQueryMethod_ {};
 
+    // certificates registered by the user, never expired
+    std::map<InfoHash, Sp<crypto::Certificate>> pinnedCertificates_ {};
     // our certificate cache
-    std::map<InfoHash, Sp<crypto::Certificate>> nodesCertificates_ {};
-    std::map<InfoHash, Sp<crypto::PublicKey>> nodesPubKeys_ {};
+    mutable LookupCache<crypto::Certificate> nodesCertificates_;
+    mutable LookupCache<crypto::PublicKey> nodesPubKeys_;
 
     std::atomic_bool forward_all_ {false};
     bool enableCache_ {false};
@@ -42,6 +42,7 @@ typedef uint16_t in_port_t;
 #endif
 
 #include <string>
+#include <functional>
 #include <memory>
 #include <vector>
 #include <stdexcept>
@@ -322,4 +323,12 @@ OPENDHT_PUBLIC bool operator==(const SockAddr& a, const SockAddr& b);
 
 #if FMT_VERSION >= 90000
 template <> struct fmt::formatter<dht::SockAddr> : ostream_formatter {};
-#endif
\ No newline at end of file
+#endif
+
+/**
+ * Hashes the address family, address and port.
+ */
+template <>
+struct OPENDHT_PUBLIC std::hash<dht::SockAddr> {
+    size_t operator()(const dht::SockAddr& addr) const noexcept;
+};
@@ -0,0 +1,51 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "def.h"
+
+#include <ostream>
+#include <string>
+
+namespace dht {
+namespace trace {
+
+/**
+ * Tracing of DHT operations (gets, puts, searches and network requests).
+ *
+ * Spans are only recorded if the library was built with tracing enabled
+ * (OPENDHT_TRACING), and are compiled out otherwise.
+ * Each thread records its events in its own ring buffer, keeping the
+ * most recent events.
+ */
+
+/** Whether the library was built with tracing */
+OPENDHT_PUBLIC bool enabled();
+
+/**
+ * Writes the events recorded by all threads in the Chrome trace event
+ * JSON format, that can be loaded in chrome://tracing or Perfetto.
+ */
+OPENDHT_PUBLIC void dumpChromeTrace(std::ostream& out);
+OPENDHT_PUBLIC std::string dumpChromeTrace();
+
+/** Discards the recorded events */
+OPENDHT_PUBLIC void clear();
+
+}
+}
@@ -36,10 +36,12 @@ from libcpp.memory cimport shared_ptr
 from cython.parallel import parallel, prange
 from cython.operator cimport dereference as deref, preincrement as inc, predecrement as dec
 from cpython cimport ref
+from cpython.buffer cimport PyBuffer_FillInfo
 from datetime import timedelta
 
 cimport opendht_cpp as cpp
 
+import asyncio
 import threading
 
 cdef inline void lookup_callback(cpp.vector[cpp.shared_ptr[cpp.IndexValue]]* values, cpp.Prefix* p, void *user_data) noexcept with gil:
@@ -58,21 +60,43 @@ cdef inline void shutdown_callback(void* user_data) noexcept with gil:
         cbs['shutdown']()
     ref.Py_DECREF(cbs)
 
-cdef inline bool get_callback(shared_ptr[cpp.Value] value, void *user_data) noexcept with gil:
+cdef inline list make_values(const cpp.vector[shared_ptr[cpp.Value]]* values, f):
+    cdef Value pv
+    vals = []
+    for val in deref(values):
+        pv = Value.__new__(Value)
+        pv._value = val
+        if not f or f(pv):
+            vals.append(pv)
+    return vals
+
+# Value callbacks are called once per batch of values (a single GIL acquisition).
+# If cbs['batch'] is set, the Python callback gets the list of values,
+# otherwise it is called for each value.
+cdef inline bool get_batch_callback(const cpp.vector[shared_ptr[cpp.Value]]* values, void *user_data) noexcept with gil:
     cbs = <object>user_data
     cb = cbs['get']
-    f = cbs['filter'] if 'filter' in cbs else None
-    pv = Value()
-    pv._value = value
-    return cb(pv) if not f or f(pv) else True
+    vals = make_values(values, cbs.get('filter'))
+    if cbs.get('batch'):
+        return cb(vals) if vals else True
+    for pv in vals:
+        if not cb(pv):
+            return False
+    return True
 
-cdef inline bool value_callback(shared_ptr[cpp.Value] value, bool expired, void *user_data) noexcept with gil:
+cdef inline bool value_batch_callback(const cpp.vector[shared_ptr[cpp.Value]]* values, bool expired, void *user_data) noexcept with gil:
     cbs = <object>user_data
     cb = cbs['valcb']
-    f = cbs['filter'] if 'filter' in cbs else None
-    pv = Value()
-    pv._value = value
-    return cb(pv, expired) if not f or f(pv) else True
+    vals = make_values(values, cbs.get('filter'))
+    if cbs.get('batch'):
+        return cb(vals, expired) if vals else True
+    for pv in vals:
+        if not cb(pv, expired):
+            return False
+    return True
+
+cdef inline void release_callback(void *user_data) noexcept with gil:
+    ref.Py_DECREF(<object>user_data)
 
 cdef inline void done_callback(bool done, cpp.vector[shared_ptr[cpp.Node]]* nodes, void *user_data) noexcept with gil:
     node_ids = []
@@ -86,12 +110,53 @@ cdef inline void done_callback(bool done, cpp.vector[shared_ptr[cpp.Node]]* node
         cbs['done'](done, node_ids)
     ref.Py_DECREF(cbs)
 
+cdef inline bool keyed_get_callback(const cpp.InfoHash* key, shared_ptr[cpp.Value] value, void *user_data) noexcept with gil:
+    cbs = <object>user_data
+    cb = cbs['get']
+    f = cbs['filter'] if 'filter' in cbs else None
+    h = InfoHash()
+    h._infohash = deref(key)
+    pv = Value()
+    pv._value = value
+    return cb(h, pv) if not f or f(pv) else True
+
+cdef inline bool keyed_value_callback(const cpp.InfoHash* key, shared_ptr[cpp.Value] value, bool expired, void *user_data) noexcept with gil:
+    cbs = <object>user_data
+    cb = cbs['valcb']
+    h = InfoHash()
+    h._infohash = deref(key)
+    pv = Value()
+    pv._value = value
+    return cb(h, pv, expired)
+
+cdef inline void done_many_callback(bool done, cpp.vector[cpp.InfoHash]* failed, void *user_data) noexcept with gil:
+    failed_keys = []
+    for k in deref(failed):
+        h = InfoHash()
+        h._infohash = k
+        failed_keys.append(h)
+    cbs = <object>user_data
+    if 'done' in cbs and cbs['done']:
+        cbs['done'](done, failed_keys)
+    ref.Py_DECREF(cbs)
+
 cdef inline void done_callback_simple(bool done, void *user_data) noexcept with gil:
     cbs = <object>user_data
     if 'done' in cbs and cbs['done']:
         cbs['done'](done)
     ref.Py_DECREF(cbs)
 
+def _resolve(loop, fut, result):
+    """Sets the result of an asyncio future from any thread."""
+    def set_result():
+        if not fut.done():
+            fut.set_result(result)
+    try:
+        loop.call_soon_threadsafe(set_result)
+    except RuntimeError:
+        # event loop closed
+        pass
+
 cdef class _WithID(object):
     def __repr__(self):
         return "<%s '%s'>" % (self.__class__.__name__, str(self))
@@ -244,10 +309,23 @@ cdef class Where(object):
         return self
 
 cdef class Value(object):
+    """A DHT value.
+
+    Value supports the buffer protocol: memoryview(value) (or value.view)
+    is a read-only, zero-copy view of the value data.
+    """
     cdef shared_ptr[cpp.Value] _value
+    cdef Py_ssize_t _exports
     def __init__(self, bytes val=b'', cpp.uint16_t id=0):
         self._value.reset(new cpp.Value(id, val, len(val)))
 
+    def __getbuffer__(self, Py_buffer *buffer, int flags):
+        cdef cpp.Value* v = self._value.get()
+        PyBuffer_FillInfo(buffer, self, <void*>v.data.data(), v.data.size(), 1, flags)
+        self._exports += 1
+    def __releasebuffer__(self, Py_buffer *buffer):
+        self._exports -= 1
+
     def __str__(self):
         return self._value.get().toString().decode()
     property owner:
@@ -266,7 +344,12 @@ cdef class Value(object):
         def __get__(self):
             return string(<char*>self._value.get().data.data(), self._value.get().data.size())
         def __set__(self, bytes value):
+            if self._exports:
+                raise BufferError("Value data is being viewed")
             self._value.get().data = value
+    property view:
+        def __get__(self):
+            return memoryview(self)
     property user_type:
         def __get__(self):
             return self._value.get().user_type.decode()
@@ -365,6 +448,11 @@ cdef class PrivateKey(_WithID):
         k = PrivateKey()
         k._key = cpp.make_shared[cpp.PrivateKey](cpp.PrivateKey.generateEC())
         return k
+    @staticmethod
+    def generateEd25519():
+        k = PrivateKey()
+        k._key = cpp.make_shared[cpp.PrivateKey](cpp.PrivateKey.generateEd25519())
+        return k
 
 cdef class PublicKey(_WithID):
     cdef cpp.shared_ptr[cpp.PublicKey] _key
@@ -432,7 +520,10 @@ cdef class TrustList(object):
 cdef class ListenToken(object):
     cdef cpp.InfoHash _h
     cdef cpp.shared_future[size_t] _t
-    _cb = dict()
+
+cdef class ListenManyToken(object):
+    cdef cpp.vector[cpp.InfoHash] _keys
+    cdef cpp.shared_future[cpp.vector[size_t]] _t
 
 cdef class Identity(object):
     cdef cpp.Identity _id
@@ -550,24 +641,44 @@ cdef class DhtRunner(_WithID):
     def bootstrap(self, str host, str port=None):
         host_bytes = host.encode()
         port_bytes = port.encode() if port else b'4222'
-        self.thisptr.get().bootstrap(<cpp.const_char*>host_bytes, <cpp.const_char*>port_bytes)
+        cdef cpp.DhtRunner* r = self.thisptr.get()
+        cdef cpp.const_char* h = host_bytes
+        cdef cpp.const_char* p = port_bytes
+        with nogil:
+            r.bootstrap(h, p)
     def run(self, Identity id=None, is_bootstrap=False, cpp.in_port_t port=0, str ipv4="", str ipv6="", DhtConfig config=DhtConfig()):
         if id:
             config.setIdentity(id)
+        cdef cpp.DhtRunner* r = self.thisptr.get()
+        cdef cpp.DhtRunnerConfig* c = &config._config
+        cdef cpp.const_char* b4
+        cdef cpp.const_char* b6
+        cdef cpp.const_char* service
         if ipv4 or ipv6:
             bind4 = ipv4.encode() if ipv4 else b''
             bind6 = ipv6.encode() if ipv6 else b''
-            self.thisptr.get().run(bind4, bind6, str(port).encode(), config._config)
+            port_bytes = str(port).encode()
+            b4, b6, service = bind4, bind6, port_bytes
+            with nogil:
+                r.run(b4, b6, service, deref(c))
         else:
-            self.thisptr.get().run(port, config._config)
+            with nogil:
+                r.run(port, deref(c))
     def join(self):
-        self.thisptr.get().join()
+        cdef cpp.DhtRunner* r = self.thisptr.get()
+        with nogil:
+            r.join()
     def shutdown(self, shutdown_cb=None):
         cb_obj = {'shutdown':shutdown_cb}
         ref.Py_INCREF(cb_obj)
-        self.thisptr.get().shutdown(cpp.bindShutdownCb(shutdown_callback, <void*>cb_obj))
+        cdef cpp.DhtRunner* r = self.thisptr.get()
+        cdef cpp.ShutdownCallback cb = cpp.bindShutdownCb(shutdown_callback, <void*>cb_obj)
+        with nogil:
+            r.shutdown(cb)
     def registerType(self, ValueType type):
-        self.thisptr.get().registerType(deref(type._value))
+        cdef cpp.DhtRunner* r = self.thisptr.get()
+        with nogil:
+            r.registerType(deref(type._value))
     def enableLogging(self):
         cpp.enableLogging(self.thisptr.get()[0])
     def disableLogging(self):
@@ -581,14 +692,29 @@ cdef class DhtRunner(_WithID):
         s._addr = self.thisptr.get().getBound(af)
         return s
     def getStorageLog(self):
-        return self.thisptr.get().getStorageLog().decode()
+        cdef cpp.DhtRunner* r = self.thisptr.get()
+        cdef string log
+        with nogil:
+            log = r.getStorageLog()
+        return log.decode()
     def getRoutingTablesLog(self, cpp.sa_family_t af):
-        return self.thisptr.get().getRoutingTablesLog(af).decode()
+        cdef cpp.DhtRunner* r = self.thisptr.get()
+        cdef string log
+        with nogil:
+            log = r.getRoutingTablesLog(af)
+        return log.decode()
     def getSearchesLog(self, cpp.sa_family_t af):
-        return self.thisptr.get().getSearchesLog(af).decode()
+        cdef cpp.DhtRunner* r = self.thisptr.get()
+        cdef string log
+        with nogil:
+            log = r.getSearchesLog(af)
+        return log.decode()
     def getNodeMessageStats(self):
         stats = []
-        cdef cpp.vector[unsigned] res = self.thisptr.get().getNodeMessageStats(False)
+        cdef cpp.DhtRunner* r = self.thisptr.get()
+        cdef cpp.vector[unsigned] res
+        with nogil:
+            res = r.getNodeMessageStats(False)
         for n in res:
             stats.append(n)
         return stats
@@ -603,33 +729,79 @@ cdef class DhtRunner(_WithID):
                    operation is completed.
         """
         if get_cb:
+            self._get(key, get_cb, done_cb, filter, where, False)
+        else:
+            lock = threading.Condition()
+            pending = 0
+            res = []
+            def tmp_get(vals):
+                nonlocal res
+                res.extend(vals)
+                return True
+            def tmp_done(ok, nodes):
+                nonlocal pending, lock
+                with lock:
+                    pending -= 1
+                    lock.notify()
+            with lock:
+                pending += 1
+                self._get(key, tmp_get, tmp_done, filter, where, True)
+                while pending > 0:
+                    lock.wait()
+            return res
+
+    cdef _get(self, InfoHash key, get_cb, done_cb, filter, Where where, bool batch):
+        cb_obj = {'get':get_cb, 'done':done_cb, 'filter':filter, 'batch':batch}
+        ref.Py_INCREF(cb_obj)
+        if where is None:
+            where = Where()
+        self.thisptr.get().get(key._infohash, cpp.bindGetBatchCb(get_batch_callback, <void*>cb_obj, NULL),
+                cpp.bindDoneCb(done_callback, <void*>cb_obj),
+                cpp.nullptr, #filter implemented in the get_batch_callback
+                where._where)
+
+    def getMany(self, keys, get_cb=None, done_cb=None, filter=None, Where where=None):
+        """Retreive values associated with several keys, as a single operation.
+
+        keys    -- the keys for which to search
+        get_cb  -- is set, makes the operation non-blocking. Called with the
+                   key and the value when a value is found on the DHT.
+        done_cb -- optional callback used when get_cb is set. Called once,
+                   when all keys are completed, with the list of failed keys.
+        """
+        cdef cpp.vector[cpp.InfoHash] cpp_keys
+        cdef InfoHash k
+        if get_cb:
+            for k in keys:
+                cpp_keys.push_back(k._infohash)
             cb_obj = {'get':get_cb, 'done':done_cb, 'filter':filter}
             ref.Py_INCREF(cb_obj)
             if where is None:
                 where = Where()
-            self.thisptr.get().get(key._infohash, cpp.bindGetCb(get_callback, <void*>cb_obj),
-                    cpp.bindDoneCb(done_callback, <void*>cb_obj),
+            self.thisptr.get().getMany(cpp_keys, cpp.bindKeyedGetCb(keyed_get_callback, <void*>cb_obj),
+                    cpp.bindDoneManyCb(done_many_callback, <void*>cb_obj),
                     cpp.nullptr, #filter implemented in the get_callback
                     where._where)
         else:
+            keys = list(keys)
             lock = threading.Condition()
             pending = 0
-            res = []
-            def tmp_get(v):
+            res = {k.toString(): [] for k in keys}
+            def tmp_get(k, v):
                 nonlocal res
-                res.append(v)
+                res[k.toString()].append(v)
                 return True
-            def tmp_done(ok, nodes):
+            def tmp_done(ok, failed):
                 nonlocal pending, lock
                 with lock:
                     pending -= 1
                     lock.notify()
             with lock:
                 pending += 1
-                self.get(key, get_cb=tmp_get, done_cb=tmp_done, filter=filter, where=where)
+                self.getMany(keys, get_cb=tmp_get, done_cb=tmp_done, filter=filter, where=where)
                 while pending > 0:
                     lock.wait()
-            return res
+            return [(k, res[k.toString()]) for k in keys]
 
     def put(self, InfoHash key, Value val, done_cb=None, permanent=False):
         """Publish a new value on the DHT at key.
@@ -659,6 +831,39 @@ cdef class DhtRunner(_WithID):
                     lock.wait()
             return ok
 
+    def putMany(self, values, done_cb=None, permanent=False):
+        """Publish several values on the DHT, as a single operation.
+
+        values  -- iterable of (key, value) pairs
+        done_cb -- optional callback called once, when all values are
+                   published, with the list of keys that failed.
+        """
+        cdef cpp.vector[pair[cpp.InfoHash, shared_ptr[cpp.Value]]] cpp_values
+        cdef InfoHash k
+        cdef Value v
+        if done_cb:
+            for k, v in values:
+                cpp_values.push_back(pair[cpp.InfoHash, shared_ptr[cpp.Value]](k._infohash, v._value))
+            cb_obj = {'done':done_cb}
+            ref.Py_INCREF(cb_obj)
+            self.thisptr.get().putMany(cpp_values, cpp.bindDoneManyCb(done_many_callback, <void*>cb_obj), cpp.time_point.max(), permanent)
+        else:
+            lock = threading.Condition()
+            pending = 0
+            ok = False
+            def tmp_done(ok_ret, failed):
+                nonlocal pending, ok, lock
+                with lock:
+                    ok = ok_ret
+                    pending -= 1
+                    lock.notify()
+            with lock:
+                pending += 1
+                self.putMany(values, done_cb=tmp_done, permanent=permanent)
+                while pending > 0:
+                    lock.wait()
+            return ok
+
     def putSigned(self, InfoHash key, Value val, done_cb=None, permanent=False):
         if done_cb:
             cb_obj = {'done':done_cb}
@@ -729,18 +934,137 @@ cdef class DhtRunner(_WithID):
         self.thisptr.get().cancelPut(key._infohash, val._value)
 
     def listen(self, InfoHash key, value_cb):
-        t = ListenToken()
+        """Listen for changes of values at key.
+        value_cb is called with the value and the expired flag.
+        """
+        return self._listen(key, value_cb, None, None, False)
+    def cancelListen(self, ListenToken token):
+        self.thisptr.get().cancelListen(token._h, token._t)
+    cdef _listen(self, InfoHash key, value_cb, filter, Where where, bool batch):
+        cdef ListenToken t = ListenToken()
         t._h = key._infohash
+        cb_obj = {'valcb':value_cb, 'filter':filter, 'batch':batch}
+        # released by the DHT thread once the listen operation is cancelled
+        ref.Py_INCREF(cb_obj)
+        if where is None:
+            where = Where()
+        t._t = self.thisptr.get().listen(t._h, cpp.bindValueBatchCb(value_batch_callback, <void*>cb_obj, release_callback),
+                cpp.nullptr, #filter implemented in the value_batch_callback
+                where._where).share()
+        return t
+    def listenMany(self, keys, value_cb):
+        """Listen to several keys, as a single operation.
+        value_cb is called with the key, the value and the expired flag.
+        """
+        cdef InfoHash k
+        t = ListenManyToken()
+        for k in keys:
+            t._keys.push_back(k._infohash)
         cb_obj = {'valcb':value_cb}
-        t._cb['cb'] = cb_obj
-        # avoid the callback being destructed if the token is destroyed
+        # released by the DHT thread once the listen operation is cancelled
         ref.Py_INCREF(cb_obj)
-        t._t = self.thisptr.get().listen(t._h, cpp.bindValueCb(value_callback, <void*>cb_obj)).share()
+        t._t = self.thisptr.get().listenMany(t._keys, cpp.bindKeyedValueCb(keyed_value_callback, <void*>cb_obj, release_callback)).share()
         return t
-    def cancelListen(self, ListenToken token):
-        self.thisptr.get().cancelListen(token._h, token._t)
-        ref.Py_DECREF(<object>token._cb['cb'])
-        # fixme: not thread safe
+    def cancelListenMany(self, ListenManyToken token):
+        self.thisptr.get().cancelListen(token._keys, token._t)
+
+    # asyncio interface: these methods must be called from a running event loop.
+
+    def getAsync(self, InfoHash key, filter=None, Where where=None):
+        """Retreive values associated with a key on the DHT.
+        Returns an awaitable resolving to the list of values found.
+        """
+        loop = asyncio.get_running_loop()
+        fut = loop.create_future()
+        res = []
+        def tmp_get(vals):
+            res.extend(vals)
+            return not fut.cancelled()
+        def tmp_done(ok, nodes):
+            _resolve(loop, fut, res)
+        self._get(key, tmp_get, tmp_done, filter, where, True)
+        return fut
+
+    def putAsync(self, InfoHash key, Value val, permanent=False):
+        """Publish a new value on the DHT at key.
+        Returns an awaitable resolving to True if the operation succeeded.
+        """
+        loop = asyncio.get_running_loop()
+        fut = loop.create_future()
+        self.put(key, val, done_cb=lambda ok, nodes: _resolve(loop, fut, ok), permanent=permanent)
+        return fut
+
+    def putSignedAsync(self, InfoHash key, Value val, permanent=False):
+        loop = asyncio.get_running_loop()
+        fut = loop.create_future()
+        self.putSigned(key, val, done_cb=lambda ok, nodes: _resolve(loop, fut, ok), permanent=permanent)
+        return fut
+
+    def pingAsync(self, SockAddr addr):
+        loop = asyncio.get_running_loop()
+        fut = loop.create_future()
+        self.ping(addr, done_cb=lambda ok: _resolve(loop, fut, ok))
+        return fut
+
+    def listenAsync(self, InfoHash key, filter=None, Where where=None):
+        """Listen for changes of values at key.
+        Returns an asynchronous iterator of (values, expired) events:
+
+            async with node.listenAsync(key) as listener:
+                async for values, expired in listener:
+                    ...
+        """
+        return AsyncListener(self, key, filter, where)
+
+class AsyncListener(object):
+    """Asynchronous iterator over the value events of a listen operation.
+
+    Each event is a (values, expired) pair, with the values received
+    together from the DHT thread.
+    The listen operation is cancelled by cancel(), or when leaving
+    the 'async with' block.
+    """
+    def __init__(self, DhtRunner runner, InfoHash key, filter=None, Where where=None):
+        self._loop = asyncio.get_running_loop()
+        self._queue = asyncio.Queue()
+        self._closed = False
+        self._runner = runner
+        self._token = runner._listen(key, self._push, filter, where, True)
+
+    def _push(self, values, expired):
+        # called from the DHT thread
+        if self._closed:
+            return False
+        try:
+            self._loop.call_soon_threadsafe(self._queue.put_nowait, (values, expired))
+        except RuntimeError:
+            # event loop closed
+            self._closed = True
+            return False
+        return True
+
+    def cancel(self):
+        if not self._closed:
+            self._closed = True
+            self._runner.cancelListen(self._token)
+            self._queue.put_nowait(None)
+
+    def __aiter__(self):
+        return self
+
+    async def __anext__(self):
+        event = await self._queue.get()
+        if event is None:
+            # keep the iterator exhausted
+            self._queue.put_nowait(None)
+            raise StopAsyncIteration
+        return event
+
+    async def __aenter__(self):
+        return self
+
+    async def __aexit__(self, *exc):
+        self.cancel()
 
 cdef class IndexValue(object):
     cdef cpp.shared_ptr[cpp.IndexValue] _value
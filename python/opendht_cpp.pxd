@@ -105,6 +105,8 @@ cdef extern from "opendht/crypto.h" namespace "dht::crypto":
         PrivateKey generate()
         @staticmethod
         PrivateKey generateEC()
+        @staticmethod
+        PrivateKey generateEd25519()
 
     cdef cppclass PublicKey:
         PublicKey()
@@ -203,6 +205,12 @@ cdef extern from "opendht/callbacks.h" namespace "dht":
     ctypedef bool (*ValueCallbackRaw)(shared_ptr[Value] values, bool expired, void *user_data)
     ctypedef void (*DoneCallbackRaw)(bool done, vector[shared_ptr[Node]]* nodes, void *user_data)
     ctypedef void (*DoneCallbackSimpleRaw)(bool done, void *user_data)
+    ctypedef bool (*KeyedGetCallbackRaw)(const InfoHash* key, shared_ptr[Value] values, void *user_data)
+    ctypedef bool (*KeyedValueCallbackRaw)(const InfoHash* key, shared_ptr[Value] values, bool expired, void *user_data)
+    ctypedef void (*DoneManyCallbackRaw)(bool done, vector[InfoHash]* failed, void *user_data)
+    ctypedef bool (*GetBatchCallbackRaw)(const vector[shared_ptr[Value]]* values, void *user_data)
+    ctypedef bool (*ValueBatchCallbackRaw)(const vector[shared_ptr[Value]]* values, bool expired, void *user_data)
+    ctypedef void (*UserDataReleaseRaw)(void *user_data)
 
     cppclass ShutdownCallback:
         ShutdownCallback() except +
@@ -214,12 +222,24 @@ cdef extern from "opendht/callbacks.h" namespace "dht":
         DoneCallback() except +
     cppclass DoneCallbackSimple:
         DoneCallbackSimple() except +
+    cppclass KeyedGetCallback:
+        KeyedGetCallback() except +
+    cppclass KeyedValueCallback:
+        KeyedValueCallback() except +
+    cppclass DoneManyCallback:
+        DoneManyCallback() except +
 
     cdef ShutdownCallback bindShutdownCb(ShutdownCallbackRaw cb, void *user_data)
     cdef GetCallback bindGetCb(GetCallbackRaw cb, void *user_data)
     cdef ValueCallback bindValueCb(ValueCallbackRaw cb, void *user_data)
     cdef DoneCallback bindDoneCb(DoneCallbackRaw cb, void *user_data)
     cdef DoneCallbackSimple bindDoneCbSimple(DoneCallbackSimpleRaw cb, void *user_data)
+    cdef KeyedGetCallback bindKeyedGetCb(KeyedGetCallbackRaw cb, void *user_data)
+    cdef KeyedValueCallback bindKeyedValueCb(KeyedValueCallbackRaw cb, void *user_data)
+    cdef KeyedValueCallback bindKeyedValueCb(KeyedValueCallbackRaw cb, void *user_data, UserDataReleaseRaw release)
+    cdef DoneManyCallback bindDoneManyCb(DoneManyCallbackRaw cb, void *user_data)
+    cdef GetCallback bindGetBatchCb(GetBatchCallbackRaw cb, void *user_data, UserDataReleaseRaw release)
+    cdef ValueCallback bindValueBatchCb(ValueBatchCallbackRaw cb, void *user_data, UserDataReleaseRaw release)
 
     cppclass Config:
         InfoHash node_id
@@ -233,9 +253,11 @@ cdef extern from "opendht/callbacks.h" namespace "dht":
         Config node_config
         Identity id
 
-cdef extern from "opendht/dhtrunner.h" namespace "dht":
+cdef extern from "opendht/dhtrunner.h" namespace "dht" nogil:
     ctypedef future[size_t] ListenToken
     ctypedef shared_future[size_t] SharedListenToken
+    ctypedef future[vector[size_t]] ListenManyToken
+    ctypedef shared_future[vector[size_t]] SharedListenManyToken
     cdef cppclass DhtRunner:
         DhtRunner() except +
         cppclass Config:
@@ -256,10 +278,10 @@ cdef extern from "opendht/dhtrunner.h" namespace "dht":
 
         InfoHash getId() const
         InfoHash getNodeId() const
-        void bootstrap(const_char*, const_char*)
+        void bootstrap(const_char*, const_char*) except +
         void bootstrap(const SockAddr&, DoneCallbackSimple done_cb)
-        void run(in_port_t, Config config)
-        void run(const_char*, const_char*, const_char*, Config config)
+        void run(in_port_t, Config config) except +
+        void run(const_char*, const_char*, const_char*, Config config) except +
         void join()
         void shutdown(ShutdownCallback)
         void registerType(ValueType& value);
@@ -275,7 +297,12 @@ cdef extern from "opendht/dhtrunner.h" namespace "dht":
         void putEncrypted(InfoHash key, shared_ptr[PublicKey] to, shared_ptr[Value] val, DoneCallback done_cb, bool permanent)
         void cancelPut(InfoHash key, shared_ptr[Value] val)
         ListenToken listen(InfoHash key, ValueCallback get_cb)
+        ListenToken listen(InfoHash key, ValueCallback get_cb, nullptr_t f, Where w)
         void cancelListen(InfoHash key, SharedListenToken token)
+        void getMany(vector[InfoHash] keys, KeyedGetCallback get_cb, DoneManyCallback done_cb, nullptr_t f, Where w)
+        void putMany(vector[pair[InfoHash, shared_ptr[Value]]] values, DoneManyCallback done_cb, time_point created, bool permanent)
+        ListenManyToken listenMany(vector[InfoHash] keys, KeyedValueCallback value_cb)
+        void cancelListen(vector[InfoHash] keys, SharedListenManyToken tokens)
         vector[unsigned] getNodeMessageStats(bool i)
 
 ctypedef DhtRunner.Config DhtRunnerConfig
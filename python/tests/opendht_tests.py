@@ -1,3 +1,4 @@
+import asyncio
 import unittest
 import opendht as dht
 
@@ -18,6 +19,37 @@ class OpenDhtTester(unittest.TestCase):
         b.run()
         self.assertTrue(b.ping(a.getBound()))
 
+    def test_value_view(self):
+        v = dht.Value(b'hello')
+        view = v.view
+        self.assertEqual(bytes(view), b'hello')
+        self.assertTrue(view.readonly)
+        with self.assertRaises(BufferError):
+            v.data = b'world'
+        view.release()
+        v.data = b'world'
+        self.assertEqual(bytes(memoryview(v)), b'world')
+
+    # test the asyncio interface
+    def test_async(self):
+        a = dht.DhtRunner()
+        a.run()
+        b = dht.DhtRunner()
+        b.run()
+        self.assertTrue(b.ping(a.getBound()))
+        key = dht.InfoHash.getRandom()
+        async def run():
+            async with b.listenAsync(key) as listener:
+                self.assertTrue(await a.putAsync(key, dht.Value(b'async')))
+                values, expired = await asyncio.wait_for(listener.__anext__(), 10)
+                self.assertFalse(expired)
+                self.assertEqual(bytes(values[0].view), b'async')
+            values = await b.getAsync(key)
+            self.assertEqual([v.data for v in values], [b'async'])
+        asyncio.run(run())
+        a.join()
+        b.join()
+
     def test_crypto(self):
         i = dht.Identity.generate("id")
         message = dht.InfoHash.getRandom().toString()
@@ -36,6 +68,17 @@ class OpenDhtTester(unittest.TestCase):
         trust.add(cert)
         self.assertTrue(trust.verify(cert2))
 
+    def test_crypto_ed25519(self):
+        key = dht.PrivateKey.generateEd25519()
+        cert = dht.Certificate.generate(key, "CA", is_ca=True)
+        ca_id = dht.Identity(key, cert)
+        self.assertTrue(cert.getId() == key.getPublicKey().getId())
+        key2 = dht.PrivateKey.generateEd25519()
+        cert2 = dht.Certificate.generate(key2, "cert", ca_id)
+        trust = dht.TrustList()
+        trust.add(cert)
+        self.assertTrue(trust.verify(cert2))
+
     def test_trust(self):
         main_id = dht.Identity.generate("id_1")
         sub_id1 = dht.Identity.generate("sid_1", main_id)
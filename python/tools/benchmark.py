@@ -19,6 +19,8 @@
 
 import os
 import sys
+import asyncio
+import threading
 import subprocess
 import signal
 import argparse
@@ -142,6 +144,98 @@ class WorkBench():
                 self.stop_cluster(procs_count-i-1)
 
 
+def python_api_benchmark(node_num=8, num_ops=200, value_size=1024):
+    """
+    Compares the blocking and the asyncio interfaces of the Python binding on a
+    network of local nodes (doesn't need the virtual network).
+    """
+    bootstrap = DhtRunner()
+    bootstrap.run()
+    nodes = []
+    for _ in range(node_num):
+        n = DhtRunner()
+        n.run()
+        n.ping(bootstrap.getBound())
+        nodes.append(n)
+    time.sleep(2)
+    client, other = nodes[0], nodes[-1]
+    payload = os.urandom(value_size)
+
+    def report(name, sync_time, async_time):
+        print('{:<8} sync: {:8.3f} s ({:8.1f} op/s)   asyncio: {:8.3f} s ({:8.1f} op/s)'.format(name,
+            sync_time, num_ops/sync_time, async_time, num_ops/async_time))
+
+    # blocking interface: one operation at a time
+    keys = [InfoHash.getRandom() for _ in range(num_ops)]
+    start = time.monotonic()
+    for k in keys:
+        client.put(k, Value(payload))
+    sync_put = time.monotonic() - start
+    start = time.monotonic()
+    sync_size = sum(len(v.data) for k in keys for v in other.get(k))
+    sync_get = time.monotonic() - start
+
+    listen_key = InfoHash.getRandom()
+    received = threading.Event()
+    count = 0
+    def value_cb(v, expired):
+        nonlocal count
+        count += 1
+        if count == num_ops:
+            received.set()
+        return True
+    token = other.listen(listen_key, value_cb)
+    start = time.monotonic()
+    for i in range(num_ops):
+        client.put(listen_key, Value(payload, i+1), done_cb=lambda ok, nodes: None)
+    received.wait(30)
+    sync_listen = time.monotonic() - start
+    other.cancelListen(token)
+
+    # asyncio interface: concurrent operations, values delivered by batches
+    async def run_async():
+        keys = [InfoHash.getRandom() for _ in range(num_ops)]
+        start = time.monotonic()
+        await asyncio.gather(*(client.putAsync(k, Value(payload)) for k in keys))
+        put_time = time.monotonic() - start
+        start = time.monotonic()
+        results = await asyncio.gather(*(other.getAsync(k) for k in keys))
+        # zero-copy access to the value data
+        size = sum(len(v.view) for values in results for v in values)
+        get_time = time.monotonic() - start
+
+        listen_key = InfoHash.getRandom()
+        async with other.listenAsync(listen_key) as listener:
+            start = time.monotonic()
+            for i in range(num_ops):
+                client.put(listen_key, Value(payload, i+1), done_cb=lambda ok, nodes: None)
+            count = 0
+            async def consume():
+                nonlocal count
+                async for values, expired in listener:
+                    count += len(values)
+                    if count >= num_ops:
+                        break
+            try:
+                await asyncio.wait_for(consume(), 30)
+            except asyncio.TimeoutError:
+                pass
+            listen_time = time.monotonic() - start
+        return put_time, get_time, listen_time, size
+
+    async_put, async_get, async_listen, async_size = asyncio.run(run_async())
+
+    print('Python API benchmark:', node_num, 'nodes,', num_ops, 'operations of', value_size, 'bytes')
+    report('put', sync_put, async_put)
+    report('get', sync_get, async_get)
+    report('listen', sync_listen, async_listen)
+    print('Data received: sync', sync_size, 'bytes, asyncio', async_size, 'bytes')
+
+    for n in nodes + [bootstrap]:
+        n.shutdown()
+        n.join()
+
+
 if __name__ == '__main__':
     parser = argparse.ArgumentParser(description='Run, test and benchmark a '\
             'DHT network on a local virtual network with simulated packet '\
@@ -159,7 +253,7 @@ if __name__ == '__main__':
 
     testArgs = parser.add_argument_group('Test arguments')
     testArgs.add_argument('--bs-dht-log', action='store_true', default=False, help='Enables dht log in bootstrap.')
-    testArgs.add_argument('-t', '--test', type=str, default=None, required=True, help='Specifies the test.')
+    testArgs.add_argument('-t', '--test', type=str, default=None, help='Specifies the test.')
     testArgs.add_argument('-o', '--opt', type=str, default=[], nargs='+',
             help='Options passed to tests routines.')
     testArgs.add_argument('-m', type=int, default=None, help='Generic size option passed to tests.')
@@ -173,6 +267,10 @@ if __name__ == '__main__':
                     'Available args for "-t" are: insert. '\
                     'Timer available by adding "timer" to "-o" args'\
                     'Use "-m" option for fixing number of keys to create during the test.')
+    featureArgs.add_argument('--python-api', action='store_true', default=False,
+            help='Compares the blocking and asyncio Python interfaces on local nodes. '\
+                 'Use "-n" to specify the number of nodes, "-m" the number of operations '\
+                 'and "-e" the value size.')
     featureArgs.add_argument('--data-persistence', action='store_true', default=0,
             help='Launches data persistence benchmark test. '\
                  'Available args for "-t" are: delete, replace, mult_time. '\
@@ -181,6 +279,11 @@ if __name__ == '__main__':
                  'Use "-e" to specify the number of values to put on the DHT.')
 
     args = parser.parse_args()
+    if args.python_api:
+        python_api_benchmark(args.node_num, args.m or 200, args.e or 1024)
+        sys.exit(0)
+    if not args.test:
+        parser.error('the following arguments are required: -t/--test')
     test_opt = { o : True for o in args.opt }
 
     wb = WorkBench(args.ifname, args.virtual_locs, args.node_num, loss=args.loss,
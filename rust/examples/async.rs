@@ -0,0 +1,135 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Compares the callback and async interfaces between two local nodes.
+// Any async runtime can be used: this example uses a minimal executor.
+
+extern crate opendht;
+use std::future::Future;
+use std::pin::pin;
+use std::sync::{ mpsc, Arc };
+use std::task::{ Context, Poll, Wake };
+use std::thread::{ self, Thread };
+use std::time::{ Duration, Instant };
+
+use opendht::{ InfoHash, DhtRunner, Value };
+
+const OPS: usize = 200;
+const PORT: u16 = 4242;
+
+struct ThreadWaker(Thread);
+
+impl Wake for ThreadWaker {
+    fn wake(self: Arc<Self>) {
+        self.0.unpark();
+    }
+}
+
+fn block_on<F: Future>(future: F) -> F::Output {
+    let mut future = pin!(future);
+    let waker = Arc::new(ThreadWaker(thread::current())).into();
+    let mut cx = Context::from_waker(&waker);
+    loop {
+        match future.as_mut().poll(&mut cx) {
+            Poll::Ready(output) => return output,
+            Poll::Pending => thread::park(),
+        }
+    }
+}
+
+fn bench_callbacks(a: &mut DhtRunner, b: &mut DhtRunner, keys: &[InfoHash]) -> (Duration, Duration, usize) {
+    let start = Instant::now();
+    for key in keys {
+        let (tx, rx) = mpsc::channel();
+        let mut done_cb = move |ok: bool| { tx.send(ok).unwrap(); };
+        a.put(key, Value::new("callback"), &mut done_cb, false);
+        rx.recv().unwrap();
+    }
+    let put_time = start.elapsed();
+
+    let start = Instant::now();
+    let mut count = 0;
+    for key in keys {
+        let (tx, rx) = mpsc::channel();
+        let mut values = Vec::new();
+        let mut get_cb = |v: Box<Value>| {
+            values.push(v);
+            true
+        };
+        let mut done_cb = move |_ok: bool| { tx.send(()).unwrap(); };
+        b.get(key, &mut get_cb, &mut done_cb);
+        rx.recv().unwrap();
+        count += values.len();
+    }
+    (put_time, start.elapsed(), count)
+}
+
+fn bench_async(a: &mut DhtRunner, b: &mut DhtRunner, keys: &[InfoHash]) -> (Duration, Duration, usize) {
+    // operations start when created: awaiting them in turn runs them concurrently
+    let start = Instant::now();
+    let puts: Vec<_> = keys.iter().map(|key| a.put_async(key, Value::new("async"), false)).collect();
+    for put in puts {
+        block_on(put);
+    }
+    let put_time = start.elapsed();
+
+    let start = Instant::now();
+    let gets: Vec<_> = keys.iter().map(|key| b.get_async(key)).collect();
+    let count = gets.into_iter().map(|get| block_on(get).len()).sum();
+    (put_time, start.elapsed(), count)
+}
+
+fn main() {
+    let mut a = DhtRunner::new();
+    a.run(PORT);
+    let mut b = DhtRunner::new();
+    b.run(0);
+    b.bootstrap("127.0.0.1", PORT);
+    thread::sleep(Duration::from_secs(2));
+
+    let keys: Vec<InfoHash> = (0..OPS).map(|_| InfoHash::random()).collect();
+    let (put_time, get_time, count) = bench_callbacks(&mut a, &mut b, &keys);
+    println!("callbacks: {} puts in {:?}, {} gets in {:?} ({} values)", OPS, put_time, OPS, get_time, count);
+
+    let keys: Vec<InfoHash> = (0..OPS).map(|_| InfoHash::random()).collect();
+    let (put_time, get_time, count) = bench_async(&mut a, &mut b, &keys);
+    println!("async:     {} puts in {:?}, {} gets in {:?} ({} values)", OPS, put_time, OPS, get_time, count);
+
+    // listen stream: receive the values put after it started
+    let key = InfoHash::random();
+    let mut stream = b.listen_stream(&key);
+    let start = Instant::now();
+    let hashes: Vec<InfoHash> = (0..OPS).map(|_| InfoHash { d: key.d }).collect();
+    let values: Vec<Box<Value>> = (0..OPS).map(|i| Value::new(&format!("value {}", i))).collect();
+    let put = a.put_many_async(&hashes, &values, false);
+    let received = block_on(async {
+        let mut received = 0;
+        while received < OPS {
+            match stream.next().await {
+                Some((values, _expired)) => received += values.len(),
+                None => break,
+            }
+        }
+        received
+    });
+    println!("listen:    {} values in {:?}", received, start.elapsed());
+    block_on(put);
+    drop(stream);
+
+    block_on(b.shutdown_async());
+    block_on(a.shutdown_async());
+}
@@ -0,0 +1,132 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Compares value delivery with one callback per value (get, listen)
+// and one callback per batch of borrowed values (get_batch, listen_batch),
+// between two local nodes.
+
+extern crate opendht;
+use std::sync::mpsc;
+use std::time::{ Duration, Instant };
+
+use opendht::{ InfoHash, DhtRunner, Value };
+
+const VALUE_COUNT: usize = 1000;
+const ROUNDS: usize = 20;
+const PORT: u16 = 4232;
+
+fn put_values(node: &mut DhtRunner, key: &InfoHash) {
+    let hashes: Vec<InfoHash> = (0..VALUE_COUNT).map(|_| InfoHash { d: key.d }).collect();
+    let values: Vec<Box<Value>> = (0..VALUE_COUNT).map(|i| Value::new(&format!("value {}", i))).collect();
+    let (tx, rx) = mpsc::channel();
+    let mut done_cb = move |ok: bool| { tx.send(ok).unwrap(); };
+    node.put_many(&hashes, &values, &mut done_cb, false);
+    println!("put_many: {}", rx.recv().unwrap());
+}
+
+fn bench_get(node: &mut DhtRunner, key: &InfoHash) -> (Duration, usize) {
+    let start = Instant::now();
+    let mut total = 0;
+    for _ in 0..ROUNDS {
+        let (tx, rx) = mpsc::channel();
+        let mut size = 0;
+        let mut get_cb = |v: Box<Value>| {
+            size += v.data().len();
+            true
+        };
+        let mut done_cb = move |_ok: bool| { tx.send(()).unwrap(); };
+        node.get(key, &mut get_cb, &mut done_cb);
+        rx.recv().unwrap();
+        total += size;
+    }
+    (start.elapsed(), total)
+}
+
+fn bench_get_batch(node: &mut DhtRunner, key: &InfoHash) -> (Duration, usize) {
+    let start = Instant::now();
+    let mut total = 0;
+    for _ in 0..ROUNDS {
+        let (tx, rx) = mpsc::channel();
+        let mut size = 0;
+        let mut get_cb = |values: &[&Value]| {
+            size += values.iter().map(|v| v.data().len()).sum::<usize>();
+            true
+        };
+        let mut done_cb = move |_ok: bool| { tx.send(()).unwrap(); };
+        node.get_batch(key, &mut get_cb, &mut done_cb);
+        rx.recv().unwrap();
+        total += size;
+    }
+    (start.elapsed(), total)
+}
+
+fn bench_listen(node: &mut DhtRunner, key: &InfoHash) -> Duration {
+    let (tx, rx) = mpsc::channel();
+    let mut count = 0;
+    let mut cb = move |_v: Box<Value>, _expired: bool| {
+        count += 1;
+        if count == VALUE_COUNT {
+            tx.send(()).unwrap();
+        }
+        true
+    };
+    let start = Instant::now();
+    let token = node.listen(key, &mut cb);
+    rx.recv_timeout(Duration::from_secs(30)).ok();
+    let elapsed = start.elapsed();
+    node.cancel_listen(key, token);
+    elapsed
+}
+
+fn bench_listen_batch(node: &mut DhtRunner, key: &InfoHash) -> Duration {
+    let (tx, rx) = mpsc::channel();
+    let mut count = 0;
+    let mut cb = move |values: &[&Value], _expired: bool| {
+        count += values.len();
+        if count == VALUE_COUNT {
+            tx.send(()).unwrap();
+        }
+        true
+    };
+    let start = Instant::now();
+    let token = node.listen_batch(key, &mut cb);
+    rx.recv_timeout(Duration::from_secs(30)).ok();
+    let elapsed = start.elapsed();
+    node.cancel_listen(key, token);
+    elapsed
+}
+
+fn main() {
+    let mut a = DhtRunner::new();
+    a.run(PORT);
+    let mut b = DhtRunner::new();
+    b.run(0);
+    b.bootstrap("127.0.0.1", PORT);
+    std::thread::sleep(Duration::from_secs(2));
+
+    let key = InfoHash::random();
+    put_values(&mut a, &key);
+
+    let (get_time, get_size) = bench_get(&mut b, &key);
+    let (batch_time, batch_size) = bench_get_batch(&mut b, &key);
+    println!("get:          {:?} ({} bytes)", get_time, get_size);
+    println!("get_batch:    {:?} ({} bytes)", batch_time, batch_size);
+
+    // values are already stored: listen gets them at once
+    println!("listen:       {:?}", bench_listen(&mut b, &key));
+    println!("listen_batch: {:?}", bench_listen_batch(&mut b, &key));
+}
@@ -0,0 +1,270 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//! Futures and streams over the DhtRunner operations,
+//! usable from any async runtime.
+//!
+//! Operations are started when the future or stream is created,
+//! and completed from the DHT thread.
+
+use libc::c_void;
+use std::collections::VecDeque;
+use std::future::Future;
+use std::marker::PhantomData;
+use std::pin::Pin;
+use std::sync::{ Arc, Mutex };
+use std::task::{ Context, Poll, Waker };
+
+use futures_core::Stream;
+
+pub use crate::ffi::*;
+
+struct OpState<T> {
+    result: Option<T>,
+    waker: Option<Waker>,
+}
+
+type SharedOp<T> = Arc<Mutex<OpState<T>>>;
+
+fn complete<T>(op: &SharedOp<T>, result: T) {
+    let waker = {
+        let mut state = op.lock().unwrap();
+        state.result = Some(result);
+        state.waker.take()
+    };
+    if let Some(waker) = waker {
+        waker.wake();
+    }
+}
+
+/// Result of an asynchronous DHT operation.
+pub struct OpFuture<T> {
+    op: SharedOp<T>,
+}
+
+impl<T> OpFuture<T> {
+    fn new() -> (OpFuture<T>, SharedOp<T>) {
+        let op = Arc::new(Mutex::new(OpState { result: None, waker: None }));
+        (OpFuture { op: op.clone() }, op)
+    }
+}
+
+impl<T> Future for OpFuture<T> {
+    type Output = T;
+
+    fn poll(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<T> {
+        let mut state = self.op.lock().unwrap();
+        match state.result.take() {
+            Some(result) => Poll::Ready(result),
+            None => {
+                state.waker = Some(cx.waker().clone());
+                Poll::Pending
+            }
+        }
+    }
+}
+
+struct GetOp {
+    values: Vec<Box<Value>>,
+    op: SharedOp<Vec<Box<Value>>>,
+}
+
+extern "C" fn get_op_values(values: *const *const Value, count: usize, ptr: *mut c_void) -> bool {
+    unsafe {
+        let get = &mut *(ptr as *mut GetOp);
+        let values = std::slice::from_raw_parts(values, count);
+        get.values.reserve(count);
+        get.values.extend(values.iter().map(|v| (**v).retain()));
+    }
+    true
+}
+
+extern "C" fn get_op_done(_ok: bool, ptr: *mut c_void) {
+    unsafe {
+        let get = Box::from_raw(ptr as *mut GetOp);
+        complete(&get.op, get.values);
+    }
+}
+
+extern "C" fn bool_op_done(ok: bool, ptr: *mut c_void) {
+    unsafe {
+        let op = Box::from_raw(ptr as *mut SharedOp<bool>);
+        complete(&op, ok);
+    }
+}
+
+extern "C" fn unit_op_done(ptr: *mut c_void) {
+    unsafe {
+        let op = Box::from_raw(ptr as *mut SharedOp<()>);
+        complete(&op, ());
+    }
+}
+
+struct ListenState {
+    events: VecDeque<(Vec<Box<Value>>, bool)>,
+    waker: Option<Waker>,
+    closed: bool,
+}
+
+type SharedListen = Arc<Mutex<ListenState>>;
+
+extern "C" fn listen_op_values(values: *const *const Value, count: usize, expired: bool, ptr: *mut c_void) -> bool {
+    let listen = unsafe { &*(ptr as *const SharedListen) };
+    let values = unsafe { std::slice::from_raw_parts(values, count) };
+    let waker = {
+        let mut state = listen.lock().unwrap();
+        if state.closed {
+            return false;
+        }
+        let batch = values.iter().map(|v| unsafe { (**v).retain() }).collect();
+        state.events.push_back((batch, expired));
+        state.waker.take()
+    };
+    if let Some(waker) = waker {
+        waker.wake();
+    }
+    true
+}
+
+extern "C" fn listen_op_done(ptr: *mut c_void) {
+    let listen = unsafe { Box::from_raw(ptr as *mut SharedListen) };
+    let waker = {
+        let mut state = listen.lock().unwrap();
+        state.closed = true;
+        state.waker.take()
+    };
+    if let Some(waker) = waker {
+        waker.wake();
+    }
+}
+
+/// Stream of (values, expired) events of a listen operation,
+/// with the values received together from the DHT thread.
+/// The listen operation is cancelled when the stream is dropped.
+pub struct ListenStream<'a> {
+    runner: *mut DhtRunner,
+    hash: InfoHash,
+    token: Option<Box<OpToken>>,
+    state: SharedListen,
+    _runner: PhantomData<&'a DhtRunner>,
+}
+
+// DhtRunner operations are thread-safe
+unsafe impl<'a> Send for ListenStream<'a> {}
+
+impl<'a> ListenStream<'a> {
+    /// Awaits the next event, without requiring the Stream trait.
+    pub async fn next(&mut self) -> Option<(Vec<Box<Value>>, bool)> {
+        std::future::poll_fn(|cx| Pin::new(&mut *self).poll_next(cx)).await
+    }
+
+    pub fn cancel(&mut self) {
+        if let Some(token) = self.token.take() {
+            self.state.lock().unwrap().closed = true;
+            unsafe {
+                dht_runner_cancel_listen(self.runner, &self.hash, &*token);
+            }
+        }
+    }
+}
+
+impl<'a> Stream for ListenStream<'a> {
+    type Item = (Vec<Box<Value>>, bool);
+
+    fn poll_next(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Option<Self::Item>> {
+        let mut state = self.state.lock().unwrap();
+        if let Some(event) = state.events.pop_front() {
+            return Poll::Ready(Some(event));
+        }
+        if state.closed {
+            return Poll::Ready(None);
+        }
+        state.waker = Some(cx.waker().clone());
+        Poll::Pending
+    }
+}
+
+impl<'a> Drop for ListenStream<'a> {
+    fn drop(&mut self) {
+        self.cancel();
+    }
+}
+
+impl DhtRunner {
+    /// Gets the values stored at h.
+    pub fn get_async(&mut self, h: &InfoHash) -> OpFuture<Vec<Box<Value>>> {
+        let (future, op) = OpFuture::new();
+        let get = Box::into_raw(Box::new(GetOp { values: Vec::new(), op })) as *mut c_void;
+        unsafe {
+            dht_runner_get_batch(&mut *self, h, get_op_values, get_op_done, get);
+        }
+        future
+    }
+
+    /// Puts v at h. Resolves to true if the operation succeeded.
+    pub fn put_async(&mut self, h: &InfoHash, v: Box<Value>, permanent: bool) -> OpFuture<bool> {
+        let (future, op) = OpFuture::new();
+        let op = Box::into_raw(Box::new(op)) as *mut c_void;
+        unsafe {
+            dht_runner_put(&mut *self, h, &*v, bool_op_done, op, permanent);
+        }
+        future
+    }
+
+    /// Puts values[i] at hashes[i] as a single operation.
+    pub fn put_many_async(&mut self, hashes: &[InfoHash], values: &[Box<Value>], permanent: bool) -> OpFuture<bool> {
+        assert_eq!(hashes.len(), values.len());
+        let ptrs: Vec<*const Value> = values.iter().map(|v| &**v as *const Value).collect();
+        let (future, op) = OpFuture::new();
+        let op = Box::into_raw(Box::new(op)) as *mut c_void;
+        unsafe {
+            dht_runner_put_many(&mut *self, hashes.as_ptr(), ptrs.as_ptr(), ptrs.len(), bool_op_done, op, permanent);
+        }
+        future
+    }
+
+    /// Listens for values at h.
+    pub fn listen_stream(&self, h: &InfoHash) -> ListenStream<'_> {
+        let runner = self as *const DhtRunner as *mut DhtRunner;
+        let state = Arc::new(Mutex::new(ListenState {
+            events: VecDeque::new(),
+            waker: None,
+            closed: false,
+        }));
+        let data = Box::into_raw(Box::new(state.clone())) as *mut c_void;
+        let token = unsafe {
+            Box::from_raw(dht_runner_listen_batch(runner, h, listen_op_values, listen_op_done, data))
+        };
+        ListenStream {
+            runner,
+            hash: InfoHash { d: h.d },
+            token: Some(token),
+            state,
+            _runner: PhantomData,
+        }
+    }
+
+    /// Stops the node. Resolves once the shutdown is complete.
+    pub fn shutdown_async(&mut self) -> OpFuture<()> {
+        let (future, op) = OpFuture::new();
+        let op = Box::into_raw(Box::new(op)) as *mut c_void;
+        unsafe {
+            dht_runner_shutdown(&mut *self, unit_op_done, op);
+        }
+        future
+    }
+}
@@ -137,6 +137,37 @@ extern fn done_handler_cb(ok: bool, ptr: *mut c_void) {
     }
 }
 
+struct GetBatchHandler<'a>
+{
+    get_cb: &'a mut(dyn FnMut(&[&Value]) -> bool),
+    done_cb: &'a mut(dyn FnMut(bool))
+}
+
+/// Borrows an array of values from the C API
+unsafe fn values_slice<'a>(values: *const *const Value, count: usize) -> &'a [&'a Value] {
+    if count == 0 {
+        return &[];
+    }
+    std::slice::from_raw_parts(values as *const &Value, count)
+}
+
+extern fn get_batch_handler_cb(values: *const *const Value, count: usize, ptr: *mut c_void) -> bool {
+    if ptr.is_null() {
+        return true;
+    }
+    unsafe {
+        let handler = ptr as *mut GetBatchHandler;
+        ((*handler).get_cb)(values_slice(values, count))
+    }
+}
+
+extern fn get_batch_done_cb(ok: bool, ptr: *mut c_void) {
+    unsafe {
+        let handler = Box::from_raw(ptr as *mut GetBatchHandler);
+        (*handler.done_cb)(ok)
+    }
+}
+
 struct PutHandler<'a>
 {
     done_cb: &'a mut(dyn FnMut(bool))
@@ -181,6 +212,24 @@ extern fn listen_handler_done(ptr: *mut c_void) {
     }
 }
 
+struct ListenBatchHandler<'a>
+{
+    cb: &'a mut(dyn FnMut(&[&Value], bool) -> bool)
+}
+
+extern fn listen_batch_handler(values: *const *const Value, count: usize, expired: bool, ptr: *mut c_void) -> bool {
+    unsafe {
+        let handler = ptr as *mut ListenBatchHandler;
+        ((*handler).cb)(values_slice(values, count), expired)
+    }
+}
+
+extern fn listen_batch_handler_done(ptr: *mut c_void) {
+    unsafe {
+        drop(Box::from_raw(ptr as *mut ListenBatchHandler));
+    }
+}
+
 impl DhtRunner {
     pub fn new() -> Box<DhtRunner> {
         unsafe {
@@ -233,6 +282,21 @@ impl DhtRunner {
         }
     }
 
+    /// Like get, but get_cb is called once per batch of values, which are
+    /// borrowed for the duration of the call (use Value::retain to keep them).
+    pub fn get_batch<'a>(&mut self, h: &InfoHash,
+                get_cb: &'a mut(dyn FnMut(&[&Value]) -> bool),
+                done_cb: &'a mut(dyn FnMut(bool))) {
+        let handler = Box::new(GetBatchHandler {
+            get_cb,
+            done_cb,
+        });
+        let handler = Box::into_raw(handler) as *mut c_void;
+        unsafe {
+            dht_runner_get_batch(&mut *self, h, get_batch_handler_cb, get_batch_done_cb, handler)
+        }
+    }
+
     pub fn put<'a>(&mut self, h: &InfoHash, v: Box<Value>,
                    done_cb: &'a mut(dyn FnMut(bool)), permanent: bool) {
         let handler = Box::new(PutHandler {
@@ -244,6 +308,21 @@ impl DhtRunner {
         }
     }
 
+    /// Puts values[i] at hashes[i], as a single operation:
+    /// done_cb is called once, when all values are published.
+    pub fn put_many<'a>(&mut self, hashes: &[InfoHash], values: &[Box<Value>],
+                   done_cb: &'a mut(dyn FnMut(bool)), permanent: bool) {
+        assert_eq!(hashes.len(), values.len());
+        let ptrs: Vec<*const Value> = values.iter().map(|v| &**v as *const Value).collect();
+        let handler = Box::new(PutHandler {
+            done_cb,
+        });
+        let handler = Box::into_raw(handler) as *mut c_void;
+        unsafe {
+            dht_runner_put_many(&mut *self, hashes.as_ptr(), ptrs.as_ptr(), ptrs.len(), put_handler_done, handler, permanent)
+        }
+    }
+
     pub fn put_signed<'a>(&mut self, h: &InfoHash, v: Box<Value>,
                                                  done_cb: &'a mut(dyn FnMut(bool)), permanent: bool) {
         let handler = Box::new(PutHandler {
@@ -283,6 +362,19 @@ impl DhtRunner {
         }
     }
 
+    /// Like listen, but cb is called once per batch of values, which are
+    /// borrowed for the duration of the call (use Value::retain to keep them).
+    pub fn listen_batch<'a>(&mut self, h: &InfoHash,
+                cb: &'a mut(dyn FnMut(&[&Value], bool) -> bool)) -> Box<OpToken> {
+        let handler = Box::new(ListenBatchHandler {
+            cb,
+        });
+        let handler = Box::into_raw(handler) as *mut c_void;
+        unsafe {
+            Box::from_raw(dht_runner_listen_batch(&mut *self, h, listen_batch_handler, listen_batch_handler_done, handler))
+        }
+    }
+
     pub fn cancel_listen(&mut self, h: &InfoHash, token: Box<OpToken>) {
         unsafe {
             dht_runner_cancel_listen(&mut *self, h, &*token)
@@ -290,7 +382,7 @@ impl DhtRunner {
     }
 
     pub fn shutdown(&mut self,
-                    done_cb: extern fn(bool, *mut c_void),
+                    done_cb: extern fn(*mut c_void),
                     cb_user_data: *mut c_void)
     {
         unsafe {
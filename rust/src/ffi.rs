@@ -213,13 +213,26 @@ extern {
                       done_cb: extern fn(bool, *mut c_void),
                       cb_user_data: *mut c_void);
     pub fn dht_runner_cancel_put(dht: *mut DhtRunner, h: *const InfoHash, vid: u64);
+    pub fn dht_runner_get_batch(dht: *mut DhtRunner, h: *const InfoHash,
+                          get_cb: extern fn(*const *const Value, size_t, *mut c_void) -> bool,
+                          done_cb: extern fn(bool, *mut c_void),
+                          cb_user_data: *mut c_void);
+    pub fn dht_runner_put_many(dht: *mut DhtRunner, h: *const InfoHash, v: *const *const Value,
+                          count: size_t,
+                          done_cb: extern fn(bool, *mut c_void),
+                          cb_user_data: *mut c_void,
+                          permanent: bool);
+    pub fn dht_runner_listen_batch(dht: *mut DhtRunner, h: *const InfoHash,
+                      cb: extern fn(*const *const Value, size_t, bool, *mut c_void) -> bool,
+                      done_cb: extern fn(*mut c_void),
+                      cb_user_data: *mut c_void) -> *mut OpToken;
     pub fn dht_runner_listen(dht: *mut DhtRunner, h: *const InfoHash,
                       cb: extern fn(*mut Value, bool, *mut c_void) -> bool,
                       done_cb: extern fn(*mut c_void),
                       cb_user_data: *mut c_void) -> *mut OpToken;
     pub fn dht_runner_cancel_listen(dht: *mut DhtRunner, h: *const InfoHash,
                       token: *const OpToken);
-    pub fn dht_runner_shutdown(dht: *mut DhtRunner, done_cb: extern fn(bool, *mut c_void),
+    pub fn dht_runner_shutdown(dht: *mut DhtRunner, done_cb: extern fn(*mut c_void),
                       cb_user_data: *mut c_void);
     pub fn dht_runner_get_public_address(dht: *const DhtRunner) -> *mut *mut OsSocketAddr;
 }
\ No newline at end of file
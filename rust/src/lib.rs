@@ -16,9 +16,11 @@
  *  along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+extern crate futures_core;
 extern crate libc;
 extern crate os_socketaddr;
 
+mod async_runner;
 mod blob;
 pub mod crypto;
 mod dhtrunner;
@@ -27,6 +29,7 @@ mod infohash;
 mod pkid;
 mod value;
 
+pub use async_runner::{ ListenStream, OpFuture };
 pub use blob::Blob;
 pub use dhtrunner::{ DhtRunner, DhtRunnerConfig, OpToken };
 pub use infohash::InfoHash;
@@ -51,6 +51,17 @@ impl Value {
         }
     }
 
+    /// Borrows the value data, without copy.
+    pub fn data(&self) -> &[u8] {
+        unsafe {
+            let dv = dht_value_get_data(self);
+            if dv.data.is_null() {
+                return &[];
+            }
+            slice::from_raw_parts(dv.data, dv.size)
+        }
+    }
+
     pub fn as_bytes(&self) -> Vec<u8> {
         unsafe {
             let dv = dht_value_get_data(self);
@@ -60,6 +71,12 @@ impl Value {
     }
 
     pub fn boxed(&mut self) -> Box<Value> {
+        self.retain()
+    }
+
+    /// Returns a new reference to a value, for instance to keep a value
+    /// borrowed from a batch callback.
+    pub fn retain(&self) -> Box<Value> {
         unsafe {
             Box::from_raw(dht_value_ref(self))
         }
@@ -22,6 +22,8 @@
 
 #include "callbacks.h"
 
+#include <algorithm>
+
 namespace dht {
 
 
@@ -89,6 +91,100 @@ bindDoneCbSimple(DoneCallbackSimpleRaw raw_cb, void* user_data) {
     };
 }
 
+KeyedGetCallback
+bindKeyedGetCb(KeyedGetCallbackRaw raw_cb, void* user_data)
+{
+    if (not raw_cb) return {};
+    return [=](const InfoHash& key, const std::vector<std::shared_ptr<Value>>& values) {
+        for (const auto& v : values)
+            if (not raw_cb(&key, v, user_data))
+                return false;
+        return true;
+    };
+}
+
+KeyedValueCallback
+bindKeyedValueCb(KeyedValueCallbackRaw raw_cb, void* user_data)
+{
+    if (not raw_cb) return {};
+    return [=](const InfoHash& key, const std::vector<std::shared_ptr<Value>>& values, bool expired) {
+        for (const auto& v : values)
+            if (not raw_cb(&key, v, expired, user_data))
+                return false;
+        return true;
+    };
+}
+
+DoneManyCallback
+bindDoneManyCb(DoneManyCallbackRaw raw_cb, void* user_data)
+{
+    if (not raw_cb) return {};
+    return [=](bool success, const std::vector<InfoHash>& failed) {
+        raw_cb(success, (std::vector<InfoHash>*)&failed, user_data);
+    };
+}
+
+static std::shared_ptr<void>
+userData(void* user_data, UserDataReleaseRaw release)
+{
+    return {user_data, [release](void* data) {
+        if (release)
+            release(data);
+    }};
+}
+
+GetCallback
+bindGetBatchCb(GetBatchCallbackRaw raw_cb, void* user_data, UserDataReleaseRaw release)
+{
+    if (not raw_cb) {
+        if (release)
+            release(user_data);
+        return {};
+    }
+    return [raw_cb, data = userData(user_data, release)](const std::vector<std::shared_ptr<Value>>& values) {
+        return raw_cb(&values, data.get());
+    };
+}
+
+ValueCallback
+bindValueBatchCb(ValueBatchCallbackRaw raw_cb, void* user_data, UserDataReleaseRaw release)
+{
+    if (not raw_cb) {
+        if (release)
+            release(user_data);
+        return {};
+    }
+    return [raw_cb, data = userData(user_data, release)](const std::vector<std::shared_ptr<Value>>& values, bool expired) {
+        return raw_cb(&values, expired, data.get());
+    };
+}
+
+KeyedValueCallback
+bindKeyedValueCb(KeyedValueCallbackRaw raw_cb, void* user_data, UserDataReleaseRaw release)
+{
+    if (not raw_cb) {
+        if (release)
+            release(user_data);
+        return {};
+    }
+    return [raw_cb, data = userData(user_data, release)](const InfoHash& key, const std::vector<std::shared_ptr<Value>>& values, bool expired) {
+        for (const auto& v : values)
+            if (not raw_cb(&key, v, expired, data.get()))
+                return false;
+        return true;
+    };
+}
+
+void
+NodeStats::addRtt(duration rtt)
+{
+    if (rtt_histogram.empty())
+        rtt_histogram.resize(RTT_HISTOGRAM_BOUNDS.size() + 1);
+    auto ms = static_cast<unsigned>(std::chrono::duration_cast<std::chrono::milliseconds>(rtt).count());
+    auto bucket = std::upper_bound(RTT_HISTOGRAM_BOUNDS.begin(), RTT_HISTOGRAM_BOUNDS.end(), ms);
+    rtt_histogram[std::distance(RTT_HISTOGRAM_BOUNDS.begin(), bucket)]++;
+}
+
 std::string
 NodeStats::toString() const
 {
@@ -99,6 +195,33 @@ NodeStats::toString() const
         ss << "Routing table depth: " << table_depth << std::endl;
         ss << "Network size estimation: " << getNetworkSizeEstimation() << " nodes" << std::endl;
     }
+    if (not rtt_histogram.empty()) {
+        ss << "Round-trip time (ms):";
+        for (size_t i = 0; i < rtt_histogram.size(); i++) {
+            if (i < RTT_HISTOGRAM_BOUNDS.size())
+                ss << " <" << RTT_HISTOGRAM_BOUNDS[i];
+            else
+                ss << " >=" << RTT_HISTOGRAM_BOUNDS.back();
+            ss << ": " << rtt_histogram[i];
+        }
+        ss << std::endl;
+    }
+    return ss.str();
+}
+
+std::string
+MemoryStats::toString() const
+{
+    std::ostringstream ss;
+    ss << "Memory: " << total()/1024 << " KB (storage " << storage/1024
+       << " KB, listeners " << listeners/1024
+       << " KB, searches " << searches/1024
+       << " KB, node cache " << node_cache/1024
+       << " KB, partial messages " << partial_messages/1024
+       << " KB, rx queue " << rx_queue/1024 << " KB";
+    if (proxy)
+        ss << ", proxy " << proxy/1024 << " KB";
+    ss << ")" << std::endl;
     return ss.str();
 }
 
@@ -117,6 +240,11 @@ NodeStats::toJson() const
         val["table_depth"] = static_cast<Json::LargestUInt>(table_depth);
         val["network_size_estimation"] = static_cast<Json::LargestUInt>(getNetworkSizeEstimation());
     }
+    if (not rtt_histogram.empty()) {
+        auto& histogram = val["rtt_histogram"];
+        for (auto count : rtt_histogram)
+            histogram.append(count);
+    }
     return val;
 }
 
@@ -130,6 +258,35 @@ NodeStats::NodeStats(const Json::Value& val)
         incoming_nodes = static_cast<unsigned>(val["incoming"].asLargestUInt());
     if (val.isMember("table_depth"))
         table_depth = static_cast<unsigned>(val["table_depth"].asLargestUInt());
+    if (val.isMember("rtt_histogram"))
+        for (const auto& count : val["rtt_histogram"])
+            rtt_histogram.emplace_back(count.asUInt());
+}
+
+Json::Value
+MemoryStats::toJson() const
+{
+    Json::Value val;
+    val["storage"] = static_cast<Json::LargestUInt>(storage);
+    val["listeners"] = static_cast<Json::LargestUInt>(listeners);
+    val["searches"] = static_cast<Json::LargestUInt>(searches);
+    val["node_cache"] = static_cast<Json::LargestUInt>(node_cache);
+    val["partial_messages"] = static_cast<Json::LargestUInt>(partial_messages);
+    val["rx_queue"] = static_cast<Json::LargestUInt>(rx_queue);
+    if (proxy)
+        val["proxy"] = static_cast<Json::LargestUInt>(proxy);
+    return val;
+}
+
+MemoryStats::MemoryStats(const Json::Value& val)
+{
+    storage = val["storage"].asLargestUInt();
+    listeners = val["listeners"].asLargestUInt();
+    searches = val["searches"].asLargestUInt();
+    node_cache = val["node_cache"].asLargestUInt();
+    partial_messages = val["partial_messages"].asLargestUInt();
+    rx_queue = val["rx_queue"].asLargestUInt();
+    proxy = val["proxy"].asLargestUInt();
 }
 
 /**
@@ -145,6 +302,7 @@ NodeInfo::toJson() const
     val["ipv4"] = ipv4.toJson();
     val["ipv6"] = ipv6.toJson();
     val["ops"] = Json::Value::LargestUInt(ongoing_ops);
+    val["memory"] = memory.toJson();
     return val;
 }
 
@@ -156,6 +314,8 @@ NodeInfo::NodeInfo(const Json::Value& v)
     ipv4 = NodeStats(v["ipv4"]);
     ipv6 = NodeStats(v["ipv6"]);
     ongoing_ops = v["ops"].asLargestUInt();
+    if (v.isMember("memory"))
+        memory = MemoryStats(v["memory"]);
 }
 
 #endif
@@ -26,11 +26,20 @@ extern "C" {
 #include <gnutls/x509.h>
 #include <nettle/gcm.h>
 #include <nettle/aes.h>
+#include <nettle/sha1.h>
+#include <nettle/sha2.h>
+#include <nettle/hmac.h>
+#include <nettle/memops.h>
 #include <gnutls/crypto.h>
+#if GNUTLS_VERSION_NUMBER >= 0x030600
+#include <nettle/curve25519.h>
+#endif
 
 #include <argon2.h>
 }
 
+#include <array>
+#include <algorithm>
 #include <random>
 #include <sstream>
 #include <fstream>
@@ -218,26 +227,280 @@ Blob stretchKey(std::string_view password, Blob& salt, size_t key_length)
 
 Blob hash(const Blob& data, size_t hash_len)
 {
-    auto algo = gnutlsHashAlgo(hash_len);
-    size_t res_size = gnutlsHashSize(algo);
-    Blob res;
-    res.resize(res_size);
-    const gnutls_datum_t gdat {(uint8_t*)data.data(), (unsigned)data.size()};
-    if (auto err = gnutls_fingerprint(algo, &gdat, res.data(), &res_size))
-        throw CryptoException(std::string("Can't compute hash: ") + gnutls_strerror(err));
-    res.resize(std::min(hash_len, res_size));
+    HashContext ctx(hash_len);
+    Blob res(ctx.length());
+    ctx.update(data);
+    ctx.final(res.data());
     return res;
 }
 
 void hash(const uint8_t* data, size_t data_length, uint8_t* hash, size_t hash_length)
 {
-    auto algo = gnutlsHashAlgo(hash_length);
-    size_t res_size = hash_length;
-    const gnutls_datum_t gdat {(uint8_t*)data, (unsigned)data_length};
-    if (auto err = gnutls_fingerprint(algo, &gdat, hash, &res_size))
+    HashContext ctx(hash_length);
+    ctx.update(data, data_length);
+    ctx.final(hash);
+}
+
+HashContext::HashContext(size_t hash_length)
+    : algo_(gnutlsHashAlgo(hash_length)), length_(std::min(hash_length, gnutlsHashSize(algo_)))
+{
+    static_assert(sizeof(ctx_) >= sizeof(sha512_ctx) && sizeof(ctx_) >= sizeof(sha256_ctx) && sizeof(ctx_) >= sizeof(sha1_ctx),
+                  "HashContext storage is too small");
+    switch (algo_) {
+    case GNUTLS_DIG_SHA512: sha512_init(reinterpret_cast<sha512_ctx*>(ctx_)); break;
+    case GNUTLS_DIG_SHA256: sha256_init(reinterpret_cast<sha256_ctx*>(ctx_)); break;
+    default:                sha1_init(reinterpret_cast<sha1_ctx*>(ctx_)); break;
+    }
+}
+
+void
+HashContext::update(const uint8_t* data, size_t data_length)
+{
+    switch (algo_) {
+    case GNUTLS_DIG_SHA512: sha512_update(reinterpret_cast<sha512_ctx*>(ctx_), data_length, data); break;
+    case GNUTLS_DIG_SHA256: sha256_update(reinterpret_cast<sha256_ctx*>(ctx_), data_length, data); break;
+    default:                sha1_update(reinterpret_cast<sha1_ctx*>(ctx_), data_length, data); break;
+    }
+}
+
+void
+HashContext::final(uint8_t* out)
+{
+    // nettle digest functions also reset the context
+    switch (algo_) {
+    case GNUTLS_DIG_SHA512: sha512_digest(reinterpret_cast<sha512_ctx*>(ctx_), length_, out); break;
+    case GNUTLS_DIG_SHA256: sha256_digest(reinterpret_cast<sha256_ctx*>(ctx_), length_, out); break;
+    default:                sha1_digest(reinterpret_cast<sha1_ctx*>(ctx_), length_, out); break;
+    }
+}
+
+TokenGenerator::TokenGenerator()
+{
+    std::array<uint8_t, TOKEN_LENGTH> key;
+    if (auto err = gnutls_rnd(GNUTLS_RND_KEY, key.data(), key.size()))
+        throw CryptoException(std::string("Can't generate token key: ") + gnutls_strerror(err));
+    setKey(key.data(), key.size());
+}
+
+void
+TokenGenerator::setKey(const uint8_t* key, size_t key_length)
+{
+    static_assert(sizeof(ctx_) >= sizeof(hmac_sha256_ctx), "TokenGenerator storage is too small");
+    hmac_sha256_set_key(reinterpret_cast<hmac_sha256_ctx*>(ctx_), key_length, key);
+}
+
+void
+TokenGenerator::get(const uint8_t* data, size_t data_length, uint8_t* out, size_t out_length) const
+{
+    // Work on a copy of the keyed state, so the key schedule is reused.
+    hmac_sha256_ctx ctx = *reinterpret_cast<const hmac_sha256_ctx*>(ctx_);
+    hmac_sha256_update(&ctx, data_length, data);
+    hmac_sha256_digest(&ctx, std::min(out_length, TOKEN_LENGTH), out);
+}
+
+bool
+TokenGenerator::check(const uint8_t* token, size_t token_length, const uint8_t* data, size_t data_length) const
+{
+    if (token_length == 0 or token_length > TOKEN_LENGTH)
+        return false;
+    Token expected;
+    get(data, data_length, expected.data(), token_length);
+    return memeql_sec(expected.data(), token, token_length);
+}
+
+#if GNUTLS_VERSION_NUMBER >= 0x030600
+/*
+ * Encryption for Ed25519 keys: ephemeral X25519 key agreement with the
+ * X25519 form of the recipient key, then AES-GCM.
+ * Format: ephemeral public key (32 bytes) | aesEncrypt() output
+ */
+
+using X25519Key = std::array<uint8_t, CURVE25519_SIZE>;
+
+/* Element of GF(2^255-19), as 16 limbs of 16 bits */
+using Fe25519 = std::array<int64_t, 16>;
+
+static void
+feCarry(Fe25519& o)
+{
+    for (size_t i = 0; i < o.size(); i++) {
+        o[i] += (int64_t)1 << 16;
+        int64_t c = o[i] >> 16;
+        if (i < 15)
+            o[i+1] += c - 1;
+        else
+            o[0] += 38 * (c - 1);
+        o[i] -= c * 65536;
+    }
+}
+
+static void
+feMul(Fe25519& o, const Fe25519& a, const Fe25519& b)
+{
+    int64_t t[31] {};
+    for (size_t i = 0; i < 16; i++)
+        for (size_t j = 0; j < 16; j++)
+            t[i+j] += a[i] * b[j];
+    for (size_t i = 0; i < 15; i++)
+        t[i] += 38 * t[i+16];
+    std::copy_n(t, 16, o.begin());
+    feCarry(o);
+    feCarry(o);
+}
+
+static Fe25519
+feInvert(const Fe25519& a)
+{
+    // a^(p-2)
+    Fe25519 c = a;
+    for (int i = 253; i >= 0; i--) {
+        feMul(c, c, c);
+        if (i != 2 and i != 4)
+            feMul(c, c, a);
+    }
+    return c;
+}
+
+static Fe25519
+feUnpack(const uint8_t* in)
+{
+    Fe25519 o;
+    for (size_t i = 0; i < 16; i++)
+        o[i] = in[2*i] + ((int64_t)in[2*i+1] << 8);
+    o[15] &= 0x7fff;
+    return o;
+}
+
+static X25519Key
+fePack(const Fe25519& n)
+{
+    Fe25519 t = n, m;
+    feCarry(t);
+    feCarry(t);
+    feCarry(t);
+    for (int j = 0; j < 2; j++) {
+        m[0] = t[0] - 0xffed;
+        for (size_t i = 1; i < 15; i++) {
+            m[i] = t[i] - 0xffff - ((m[i-1] >> 16) & 1);
+            m[i-1] &= 0xffff;
+        }
+        m[15] = t[15] - 0x7fff - ((m[14] >> 16) & 1);
+        bool borrow = (m[15] >> 16) & 1;
+        m[14] &= 0xffff;
+        if (not borrow)
+            t = m;
+    }
+    X25519Key out;
+    for (size_t i = 0; i < 16; i++) {
+        out[2*i] = t[i] & 0xff;
+        out[2*i+1] = t[i] >> 8;
+    }
+    return out;
+}
+
+/**
+ * X25519 public key of an Ed25519 public key: u = (1 + y) / (1 - y)
+ */
+static X25519Key
+x25519PublicKey(gnutls_pubkey_t pk)
+{
+    gnutls_ecc_curve_t curve;
+    gnutls_datum_t x {nullptr, 0}, y {nullptr, 0};
+    if (auto err = gnutls_pubkey_export_ecc_raw2(pk, &curve, &x, &y, 0))
+        throw CryptoException(std::string("Can't export public key: ") + gnutls_strerror(err));
+    if (x.size != CURVE25519_SIZE) {
+        gnutls_free(x.data);
+        gnutls_free(y.data);
+        throw CryptoException("Unexpected Ed25519 public key size");
+    }
+    auto ed = feUnpack(x.data);
+    gnutls_free(x.data);
+    gnutls_free(y.data);
+    Fe25519 num, den, u;
+    for (size_t i = 0; i < 16; i++) {
+        num[i] = ed[i];
+        den[i] = -ed[i];
+    }
+    num[0] += 1;
+    den[0] += 1;
+    feMul(u, num, feInvert(den));
+    return fePack(u);
+}
+
+/**
+ * X25519 private key of an Ed25519 private key: the clamped first half of SHA-512(seed)
+ */
+static X25519Key
+x25519PrivateKey(gnutls_x509_privkey_t key)
+{
+    gnutls_ecc_curve_t curve;
+    gnutls_datum_t x {nullptr, 0}, y {nullptr, 0}, k {nullptr, 0};
+    if (auto err = gnutls_x509_privkey_export_ecc_raw(key, &curve, &x, &y, &k))
+        throw CryptoException(std::string("Can't export private key: ") + gnutls_strerror(err));
+    std::array<uint8_t, 64> h;
+    int err = gnutls_hash_fast(GNUTLS_DIG_SHA512, k.data, k.size, h.data());
+    std::fill_n(k.data, k.size, 0);
+    gnutls_free(x.data);
+    gnutls_free(y.data);
+    gnutls_free(k.data);
+    if (err)
+        throw CryptoException(std::string("Can't compute hash: ") + gnutls_strerror(err));
+    X25519Key ret;
+    std::copy_n(h.begin(), ret.size(), ret.begin());
+    std::fill(h.begin(), h.end(), 0);
+    ret[0] &= 248;
+    ret[31] &= 127;
+    ret[31] |= 64;
+    return ret;
+}
+
+static Blob
+x25519Kdf(const X25519Key& shared, const uint8_t* ephemeral, const X25519Key& recipient)
+{
+    std::array<uint8_t, 3 * CURVE25519_SIZE> ikm;
+    auto it = std::copy(shared.begin(), shared.end(), ikm.begin());
+    it = std::copy_n(ephemeral, CURVE25519_SIZE, it);
+    std::copy(recipient.begin(), recipient.end(), it);
+    Blob key(256/8);
+    int err = gnutls_hash_fast(GNUTLS_DIG_SHA256, ikm.data(), ikm.size(), key.data());
+    std::fill(ikm.begin(), ikm.end(), 0);
+    if (err)
         throw CryptoException(std::string("Can't compute hash: ") + gnutls_strerror(err));
+    return key;
+}
+
+static Blob
+x25519Encrypt(gnutls_pubkey_t pk, const uint8_t* data, size_t data_len)
+{
+    auto recipient = x25519PublicKey(pk);
+    X25519Key secret, shared;
+    if (auto err = gnutls_rnd(GNUTLS_RND_KEY, secret.data(), secret.size()))
+        throw CryptoException(std::string("Can't generate key: ") + gnutls_strerror(err));
+    Blob ret(CURVE25519_SIZE);
+    curve25519_mul_g(ret.data(), secret.data());
+    curve25519_mul(shared.data(), secret.data(), recipient.data());
+    std::fill(secret.begin(), secret.end(), 0);
+    auto encrypted = aesEncrypt(data, data_len, x25519Kdf(shared, ret.data(), recipient));
+    ret.insert(ret.end(), encrypted.begin(), encrypted.end());
+    return ret;
 }
 
+static Blob
+x25519Decrypt(gnutls_x509_privkey_t key, const uint8_t* cypher, size_t cypher_len)
+{
+    if (cypher_len <= CURVE25519_SIZE)
+        throw DecryptError("Unexpected cipher length");
+    auto secret = x25519PrivateKey(key);
+    X25519Key shared, recipient;
+    curve25519_mul(shared.data(), secret.data(), cypher);
+    curve25519_mul_g(recipient.data(), secret.data());
+    std::fill(secret.begin(), secret.end(), 0);
+    if (std::all_of(shared.begin(), shared.end(), [](uint8_t b) { return b == 0; }))
+        throw DecryptError("Invalid ephemeral key");
+    return aesDecrypt(cypher + CURVE25519_SIZE, cypher_len - CURVE25519_SIZE, x25519Kdf(shared, cypher, recipient));
+}
+#endif
+
 PrivateKey::PrivateKey()
 {}
 
@@ -314,6 +577,24 @@ PrivateKey::operator=(PrivateKey&& o) noexcept
     return *this;
 }
 
+/**
+ * Signature algorithm used for values signed with a key of the given type.
+ */
+static gnutls_sign_algorithm_t
+signatureAlgorithm(int pk_algo)
+{
+    switch (pk_algo) {
+    case GNUTLS_PK_EC:
+        return GNUTLS_SIGN_ECDSA_SHA512;
+#if GNUTLS_VERSION_NUMBER >= 0x030600
+    case GNUTLS_PK_EDDSA_ED25519:
+        return GNUTLS_SIGN_EDDSA_ED25519;
+#endif
+    default:
+        return GNUTLS_SIGN_RSA_SHA512;
+    }
+}
+
 Blob
 PrivateKey::sign(const uint8_t* data, size_t data_length) const
 {
@@ -323,8 +604,14 @@ PrivateKey::sign(const uint8_t* data, size_t data_length) const
         throw CryptoException("Can't sign data: too large !");
     gnutls_datum_t sig {nullptr, 0};
     const gnutls_datum_t dat {(unsigned char*)data, (unsigned)data_length};
+#if GNUTLS_VERSION_NUMBER >= 0x030600
+    auto algo = signatureAlgorithm(gnutls_privkey_get_pk_algorithm(key, nullptr));
+    if (gnutls_privkey_sign_data2(key, algo, 0, &dat, &sig) != GNUTLS_E_SUCCESS)
+        throw CryptoException("Can't sign data !");
+#else
     if (gnutls_privkey_sign_data(key, GNUTLS_DIG_SHA512, 0, &dat, &sig) != GNUTLS_E_SUCCESS)
         throw CryptoException("Can't sign data !");
+#endif
     Blob ret(sig.data, sig.data+sig.size);
     gnutls_free(sig.data);
     return ret;
@@ -353,8 +640,15 @@ PrivateKey::decrypt(const uint8_t* cypher, size_t cypher_len) const
     int err = gnutls_privkey_get_pk_algorithm(key, &key_len);
     if (err < 0)
         throw CryptoException("Can't read public key length !");
+#if GNUTLS_VERSION_NUMBER >= 0x030600
+    if (err == GNUTLS_PK_EDDSA_ED25519) {
+        if (not x509_key)
+            throw CryptoException("Can't decrypt data without private key !");
+        return x25519Decrypt(x509_key, cypher, cypher_len);
+    }
+#endif
     if (err != GNUTLS_PK_RSA)
-        throw CryptoException("Must be an RSA key");
+        throw CryptoException("Must be an RSA or Ed25519 key");
 
     unsigned cypher_block_sz = key_len / 8;
     if (cypher_len < cypher_block_sz)
@@ -504,7 +798,7 @@ bool PublicKey::checkSignature(const uint8_t* data, size_t data_len, const uint8
         return false;
     const gnutls_datum_t sig {(uint8_t*)signature, (unsigned)signature_len};
     const gnutls_datum_t dat {(uint8_t*)data, (unsigned)data_len};
-    int rc = gnutls_pubkey_verify_data2(pk, GNUTLS_SIGN_RSA_SHA512, 0, &dat, &sig);
+    int rc = gnutls_pubkey_verify_data2(pk, signatureAlgorithm(gnutls_pubkey_get_pk_algorithm(pk, nullptr)), 0, &dat, &sig);
     return rc >= 0;
 }
 
@@ -532,8 +826,12 @@ PublicKey::encrypt(const uint8_t* data, size_t data_len) const
     int err = gnutls_pubkey_get_pk_algorithm(pk, &key_len);
     if (err < 0)
         throw CryptoException("Can't read public key length !");
+#if GNUTLS_VERSION_NUMBER >= 0x030600
+    if (err == GNUTLS_PK_EDDSA_ED25519)
+        return x25519Encrypt(pk, data, data_len);
+#endif
     if (err != GNUTLS_PK_RSA)
-        throw CryptoException("Must be an RSA key");
+        throw CryptoException("Must be an RSA or Ed25519 key");
 
     const unsigned max_block_sz = key_len / 8 - 11;
     const unsigned cypher_block_sz = key_len / 8;
@@ -1156,6 +1454,24 @@ PrivateKey::generateEC()
     return PrivateKey{key};
 }
 
+PrivateKey
+PrivateKey::generateEd25519()
+{
+#if GNUTLS_VERSION_NUMBER >= 0x030600
+    gnutls_x509_privkey_t key;
+    if (gnutls_x509_privkey_init(&key) != GNUTLS_E_SUCCESS)
+        throw CryptoException("Can't initialize private key.");
+    int err = gnutls_x509_privkey_generate(key, GNUTLS_PK_EDDSA_ED25519, gnutls_sec_param_to_pk_bits(GNUTLS_PK_EDDSA_ED25519, GNUTLS_SEC_PARAM_HIGH), 0);
+    if (err != GNUTLS_E_SUCCESS) {
+        gnutls_x509_privkey_deinit(key);
+        throw CryptoException(std::string("Can't generate Ed25519 key pair: ") + gnutls_strerror(err));
+    }
+    return PrivateKey{key};
+#else
+    throw CryptoException("Ed25519 keys require GnuTLS 3.6 or later");
+#endif
+}
+
 Identity
 generateIdentity(const std::string& name, const Identity& ca, unsigned key_length, bool is_ca)
 {
@@ -1183,6 +1499,19 @@ generateEcIdentity(const std::string& name, const Identity& ca) {
     return generateEcIdentity(name, ca, !ca.first || !ca.second);
 }
 
+Identity
+generateEd25519Identity(const std::string& name, const Identity& ca, bool is_ca)
+{
+    auto key = std::make_shared<PrivateKey>(PrivateKey::generateEd25519());
+    auto cert = std::make_shared<Certificate>(Certificate::generate(*key, name, ca, is_ca));
+    return {std::move(key), std::move(cert)};
+}
+
+Identity
+generateEd25519Identity(const std::string& name, const Identity& ca) {
+    return generateEd25519Identity(name, ca, !ca.first || !ca.second);
+}
+
 void
 saveIdentity(const Identity& id, const std::string& path, const std::string& privkey_password)
 {
@@ -22,6 +22,7 @@
 #include "search.h"
 #include "storage.h"
 #include "request.h"
+#include "trace_span.h"
 
 #include <msgpack.hpp>
 
@@ -45,6 +46,29 @@ constexpr duration Dht::REANNOUNCE_MARGIN;
 static constexpr size_t MAX_REQUESTS_PER_SEC {8 * 1024};
 static constexpr duration BOOTSTRAP_PERIOD_MAX {std::chrono::hours(24)};
 
+struct Dht::Metrics {
+    Sp<metrics::Registry> registry;
+    metrics::Histogram& getDuration;
+    metrics::Counter& storeAccepted;
+    metrics::Counter& storeRejected;
+    metrics::Counter& valuesRemoved;
+    metrics::Gauge& searches;
+    metrics::Gauge& storageKeys;
+    metrics::Gauge& storageValues;
+    metrics::Gauge& storageBytes;
+
+    Metrics(const Sp<metrics::Registry>& r) : registry(r),
+        getDuration(r->histogram("dht_get_duration_seconds", "Time to complete get operations")),
+        storeAccepted(r->counter("dht_storage_puts_total", "Values offered to local storage", {{"result", "accepted"}})),
+        storeRejected(r->counter("dht_storage_puts_total", "Values offered to local storage", {{"result", "rejected"}})),
+        valuesRemoved(r->counter("dht_storage_values_removed_total", "Values expired or evicted from local storage")),
+        searches(r->gauge("dht_searches", "Searches in memory")),
+        storageKeys(r->gauge("dht_storage_keys", "Keys in local storage")),
+        storageValues(r->gauge("dht_storage_values", "Values in local storage")),
+        storageBytes(r->gauge("dht_storage_bytes", "Size of values in local storage"))
+    {}
+};
+
 NodeStatus
 Dht::updateStatus(sa_family_t af)
 {
@@ -287,6 +311,52 @@ Dht::expireSearches()
     };
     erase_if(dht4.searches, expired);
     erase_if(dht6.searches, expired);
+
+    // Refresh the memory estimate, and drop idle searches while over the limit
+    searches_memory = 0;
+    for (auto* srs : {&dht4.searches, &dht6.searches}) {
+        for (auto& srp : *srs) {
+            srp.second->memory = srp.second->memoryUsage();
+            searches_memory += srp.second->memory;
+        }
+    }
+    while (searches_memory > max_search_memory and dropIdleSearch()) {}
+}
+
+bool
+Dht::dropIdleSearch(sa_family_t af)
+{
+    SearchMap* oldest_srs {nullptr};
+    SearchMap::iterator oldest;
+    for (auto* srs : {&dht4.searches, &dht6.searches}) {
+        if (af and srs != &searches(af))
+            continue;
+        for (auto it = srs->begin(); it != srs->end(); ++it) {
+            const auto& sr = *it->second;
+            if (not sr.callbacks.empty() or not sr.announce.empty() or not sr.listeners.empty())
+                continue;
+            if (not oldest_srs or sr.step_time < oldest->second->step_time) {
+                oldest_srs = srs;
+                oldest = it;
+            }
+        }
+    }
+    if (not oldest_srs)
+        return false;
+    if (logger_)
+        logger_->d(oldest->first, "[search %s] Dropping idle search", oldest->first.toString().c_str());
+    searches_memory -= std::min(searches_memory, oldest->second->memory);
+    oldest->second->clear();
+    oldest_srs->erase(oldest);
+    return true;
+}
+
+void
+Dht::updateSearchMemory(Search& sr)
+{
+    auto memory = sr.memoryUsage();
+    searches_memory = searches_memory + memory - std::min(searches_memory, sr.memory);
+    sr.memory = memory;
 }
 
 void
@@ -392,13 +462,27 @@ void Dht::paginate(std::weak_ptr<Search> ws, Sp<Query> query, SearchNode* n) {
             );
 }
 
+unsigned
+Dht::maxSolicitedNodes(const Search& sr, time_point now) const
+{
+    /* Until the leading search of the region gets closer to its target than
+       the point where both targets diverge, let it discover the nodes: they
+       are inserted in this search as they are found (see trySearchInsert). */
+    if (auto leader = sr.leader.lock())
+        if (not leader->done and not leader->expired and not leader->nodes.empty()
+            and InfoHash::commonBits(leader->nodes.front()->node->id, leader->id) < InfoHash::commonBits(leader->id, sr.id))
+            return MAX_REQUESTED_FOLLOWER_SEARCH_NODES;
+    if (not max_hedged_requests)
+        return MAX_REQUESTED_SEARCH_NODES;
+    return MAX_REQUESTED_SEARCH_NODES + std::min(sr.slowSolicitedNodeCount(now), max_hedged_requests);
+}
+
 Dht::SearchNode*
 Dht::searchSendGetValues(Sp<Search> sr, SearchNode* pn, bool update)
 {
-    if (sr->done or sr->currentlySolicitedNodeCount() >= MAX_REQUESTED_SEARCH_NODES)
-        return nullptr;
-
     const auto& now = scheduler.time();
+    if (sr->done or sr->currentlySolicitedNodeCount() >= maxSolicitedNodes(*sr, now))
+        return nullptr;
 
     std::weak_ptr<Search> ws = sr;
     auto cb = sr->callbacks.begin();
@@ -419,6 +503,10 @@ Dht::searchSendGetValues(Sp<Search> sr, SearchNode* pn, bool update)
                     break;
                 }
             }
+            /* Closest nodes are equally useful to sync the search: prefer the fastest one. */
+            if (n and latency_aware_search)
+                if (auto fastest = sr->getFastestNode(now, up, query))
+                    n = fastest;
         }
 
         if (sr->callbacks.empty()) { /* 'find_node' request */
@@ -451,7 +539,9 @@ Dht::searchSendGetValues(Sp<Search> sr, SearchNode* pn, bool update)
                         std::bind(&Dht::searchNodeGetExpired, this, _1, _2, ws, query));
             } else
                 paginate(ws, query, n);
+            cb->second.span.mark(trace::Point::FirstRequest);
         }
+        sr->span.mark(trace::Point::FirstRequest);
 
         /* We only attempt to send one request. Return. */
         return n;
@@ -709,18 +799,22 @@ Dht::searchStep(std::weak_ptr<Search> ws)
             logger_->d(sr->id, "[search %s IPv%c] Step (%d requests)",
                 sr->id.toString().c_str(), sr->af == AF_INET ? '4' : '6', req_count);*/
     sr->step_time = now;
+    updateSearchMemory(*sr);
 
     if (sr->refill_time + Node::NODE_EXPIRE_TIME < now and sr->nodes.size()-sr->getNumberOfBadNodes() < SEARCH_NODES)
         refill(*sr);
 
     /* Check if the first TARGET_NODES (8) live nodes have replied. */
     if (sr->isSynced(now)) {
+        sr->traceMark(trace::Point::Synced);
         if (not (sr->callbacks.empty() and sr->announce.empty())) {
             // search is synced but some (newer) get operations are not complete
             // Call callbacks when done
             std::vector<Get> completed_gets;
             for (auto b = sr->callbacks.begin(); b != sr->callbacks.end();) {
                 if (sr->isDone(b->second)) {
+                    if (metrics_)
+                        metrics_->getDuration.observe(now - b->first);
                     sr->setDone(b->second);
                     completed_gets.emplace_back(std::move(b->second));
                     b = sr->callbacks.erase(b);
@@ -781,8 +875,17 @@ Dht::searchStep(std::weak_ptr<Search> ws)
         searchSendAnnounceValue(sr, syncLevel);
     }
 
-    while (sr->currentlySolicitedNodeCount() < MAX_REQUESTED_SEARCH_NODES and searchSendGetValues(sr));
+    auto maxSolicited = maxSolicitedNodes(*sr, now);
+    while (sr->currentlySolicitedNodeCount() < maxSolicited and searchSendGetValues(sr));
 
+    if (max_hedged_requests) {
+        /* Wake up when a solicited node gets slower than expected, to send a hedged request */
+        auto hedgeTime = sr->getNextHedgeTime(now);
+        if (sr->hedgeStep)
+            scheduler.edit(sr->hedgeStep, hedgeTime);
+        else
+            sr->hedgeStep = scheduler.add(hedgeTime, std::bind(&Dht::searchStep, this, ws));
+    }
 
     if (sr->getNumberOfConsecutiveBadNodes() >= std::min<size_t>(sr->nodes.size(), SEARCH_MAX_BAD_NODES))
     {
@@ -797,6 +900,7 @@ Dht::searchStep(std::weak_ptr<Search> ws)
 }
 
 unsigned Dht::refill(Dht::Search& sr) {
+    trace::ScopedSpan span("refill");
     const auto& now = scheduler.time();
     sr.refill_time = now;
     /* we search for up to SEARCH_NODES good nodes. */
@@ -840,26 +944,25 @@ Dht::search(const InfoHash& id, sa_family_t af, GetCallback gcb, QueryCallback q
 
     if (srp != srs.end()) {
         sr = srp->second;
+        if (sr->done or sr->expired)
+            sr->span.begin("search");
         sr->done = false;
         sr->expired = false;
     } else {
-        if (srs.size() < max_searches) {
-            sr = std::make_shared<Search>();
-            srs.emplace(id, sr);
-        } else {
-            for (auto it = srs.begin(); it!=srs.end();) {
-                auto& s = *it->second;
-                if ((s.done or s.expired) and s.announce.empty() and s.listeners.empty()) {
-                    sr = it->second;
-                    break;
-                }
-            }
-            if (not sr) {
-                if (logger_)
-                    logger_->e(id, "[search %s IPv%c] Maximum number of searches reached!", id.toString().c_str(), (af == AF_INET) ? '4' : '6');
-                return {};
-            }
+        auto overLimit = [&]{
+            return srs.size() >= max_searches or searches_memory >= max_search_memory;
+        };
+        while (overLimit() and dropIdleSearch(srs.size() >= max_searches ? af : 0)) {}
+        if (overLimit()) {
+            if (logger_)
+                logger_->e(id, "[search %s IPv%c] Search limit reached (%zu searches, %zu KB)", id.toString().c_str(), (af == AF_INET) ? '4' : '6',
+                    srs.size(), searches_memory / 1024);
+            if (dcb)
+                dcb(false, {});
+            return {};
         }
+        sr = std::make_shared<Search>();
+        srs.emplace(id, sr);
         sr->af = af;
         sr->tid = search_id++;
         sr->step_time = time_point::min();
@@ -868,7 +971,9 @@ Dht::search(const InfoHash& id, sa_family_t af, GetCallback gcb, QueryCallback q
         sr->expired = false;
         sr->nodes.clear();
         sr->nodes.reserve(SEARCH_NODES+1);
+        sr->leader = findRegionLeader(id, af);
         sr->nextSearchStep = scheduler.add(time_point::max(), std::bind(&Dht::searchStep, this, std::weak_ptr<Search>(sr)));
+        sr->span.begin("search");
         if (logger_)
             logger_->w(id, "[search %s IPv%c] New search", id.toString().c_str(), (af == AF_INET) ? '4' : '6');
         if (search_id == 0)
@@ -881,6 +986,31 @@ Dht::search(const InfoHash& id, sa_family_t af, GetCallback gcb, QueryCallback q
     return sr;
 }
 
+Sp<Dht::Search>
+Dht::findRegionLeader(const InfoHash& id, sa_family_t af)
+{
+    const auto& table = buckets(af);
+    auto b = table.findBucket(id);
+    if (b == table.end())
+        return {};
+    auto depth = table.depth(b);
+
+    auto& srs = searches(af);
+    auto it = srs.lower_bound(id);
+    for (auto n : {it, it == srs.begin() ? srs.end() : std::prev(it)}) {
+        if (n == srs.end() or n->first == id)
+            continue;
+        const auto& sr = n->second;
+        /* Only one level of leadership: followers never lead */
+        auto leader = sr->leader.lock();
+        if (not leader)
+            leader = sr;
+        if (not leader->done and not leader->expired and InfoHash::commonBits(leader->id, id) >= depth)
+            return leader;
+    }
+    return {};
+}
+
 void
 Dht::announce(const InfoHash& id,
         sa_family_t af,
@@ -911,7 +1041,7 @@ Dht::listenTo(const InfoHash& id, sa_family_t af, ValueCallback cb, Value::Filte
     auto srp = srs.find(id);
     Sp<Search> sr = (srp == srs.end()) ? search(id, af) : srp->second;
     if (!sr)
-        throw DhtException("Unable to create search");
+        return 0;
     if (logger_)
         logger_->w(id, "[search %s IPv%c] Listen", id.to_c_str(), (af == AF_INET) ? '4' : '6');
     return sr->listen(cb, std::move(f), q, scheduler);
@@ -947,8 +1077,14 @@ Dht::listen(const InfoHash& id, ValueCallback cb, Value::Filter f, Where where)
 
     auto token4 = Dht::listenTo(id, AF_INET, gcb, filter, query);
     auto token6 = token4 == 0 ? 0 : Dht::listenTo(id, AF_INET6, gcb, filter, query);
-    if (token6 == 0 && st != store.end()) {
-        st->second.cancelListen(tokenlocal);
+    if (token6 == 0) {
+        if (st != store.end())
+            st->second.cancelListen(tokenlocal);
+        if (token4) {
+            auto srp = dht4.searches.find(id);
+            if (srp != dht4.searches.end())
+                srp->second->cancelListen(token4, scheduler);
+        }
         return 0;
     }
 
@@ -1323,13 +1459,12 @@ Dht::storageStore(const InfoHash& id, const Sp<Value>& value, time_point created
         store_bucket = &store_quota[sa];
 
     auto store = st->second.store(id, value, created, expiration, store_bucket);
+    if (metrics_)
+        (store.first ? metrics_->storeAccepted : metrics_->storeRejected).inc();
     if (auto vs = store.first) {
         total_store_size += store.second.size_diff;
         total_values += store.second.values_diff;
-        scheduler.cancel(vs->expiration_job);
-        if (not permanent) {
-            vs->expiration_job = scheduler.add(expiration, std::bind(&Dht::expireStorage, this, id));
-        }
+        scheduleStorageExpiration(id, st->second);
         if (total_store_size > max_store_size) {
             auto value = vs->data;
             auto value_diff = store.second.values_diff;
@@ -1344,19 +1479,25 @@ Dht::storageStore(const InfoHash& id, const Sp<Value>& value, time_point created
     return std::get<0>(store);
 }
 
-void
+bool
 Dht::storageAddListener(const InfoHash& id, const Sp<Node>& node, size_t socket_id, Query&& query, int version)
 {
     const auto& now = scheduler.time();
     auto st = store.find(id);
     if (st == store.end()) {
         if (store.size() >= max_store_keys)
-            return;
+            return false;
         st = store.emplace(id, now).first;
     }
     auto& node_listeners = st->second.listeners[node];
     auto l = node_listeners.find(socket_id);
     if (l == node_listeners.end()) {
+        if (listeners_memory + Storage::LISTENER_MEMORY > max_listener_memory) {
+            if (node_listeners.empty())
+                st->second.listeners.erase(node);
+            return false;
+        }
+        listeners_memory += Storage::LISTENER_MEMORY;
         auto vals = st->second.get(query.where.getFilter());
         if (not vals.empty()) {
             network_engine.tellListener(node, socket_id, id, WANT4 | WANT6, makeToken(node->getAddr(), false),
@@ -1367,6 +1508,7 @@ Dht::storageAddListener(const InfoHash& id, const Sp<Node>& node, size_t socket_
     }
     else
         l->second.refresh(now, std::forward<Query>(query));
+    return true;
 }
 
 void
@@ -1374,10 +1516,29 @@ Dht::expireStore(decltype(store)::iterator i)
 {
     const auto& id = i->first;
     auto& st = i->second;
+    auto listener_count = st.listenerCount();
     auto stats = st.expire(id, scheduler.time());
+    listeners_memory -= std::min(listeners_memory, (listener_count - st.listenerCount()) * Storage::LISTENER_MEMORY);
     if (not stats.second.empty()) {
         storageRemoved(id, st, stats.second, -stats.first);
     }
+    scheduleStorageExpiration(id, st);
+}
+
+void
+Dht::scheduleStorageExpiration(const InfoHash& id, Storage& st)
+{
+    auto next = st.nextExpiration();
+    if (st.expiration_job) {
+        if (st.expiration_job->t_ == next)
+            return;
+        // a due job may be the one running: let it end instead of cancelling it
+        if (st.expiration_job->t_ > scheduler.time())
+            scheduler.cancel(st.expiration_job);
+        st.expiration_job.reset();
+    }
+    if (next != time_point::max())
+        st.expiration_job = scheduler.add(next, std::bind(&Dht::expireStorage, this, id));
 }
 
 void
@@ -1397,6 +1558,8 @@ Dht::storageRemoved(const InfoHash& id, Storage& st, const std::vector<Sp<Value>
 
     total_store_size -= totalSize;
     total_values -= values.size();
+    if (metrics_)
+        metrics_->valuesRemoved.inc(values.size());
 
     if (not st.listeners.empty()) {
         if (logger_)
@@ -1494,41 +1657,44 @@ void
 Dht::rotateSecrets()
 {
     oldsecret = secret;
-    secret = std::uniform_int_distribution<uint64_t>{}(rd);
+    secret = {};
     uniform_duration_distribution<> time_dist(std::chrono::minutes(15), std::chrono::minutes(45));
     auto rotate_secrets_time = scheduler.time() + time_dist(rd);
     scheduler.add(rotate_secrets_time, std::bind(&Dht::rotateSecrets, this));
 }
 
-Blob
-Dht::makeToken(const SockAddr& addr, bool old) const
+/**
+ * Writes the token input for addr (IP address and port) to buf.
+ * @return the input size, or 0 for an unsupported address family.
+ */
+static size_t
+tokenData(const SockAddr& addr, std::array<uint8_t, sizeof(in6_addr) + sizeof(in_port_t)>& buf)
 {
-    const void *ip;
-    size_t iplen;
-    in_port_t port;
-
     auto family = addr.getFamily();
     if (family == AF_INET) {
         const auto& sin = addr.getIPv4();
-        ip = &sin.sin_addr;
-        iplen = 4;
-        port = sin.sin_port;
+        std::memcpy(buf.data(), &sin.sin_addr, sizeof(in_addr));
+        std::memcpy(buf.data() + sizeof(in_addr), &sin.sin_port, sizeof(in_port_t));
+        return sizeof(in_addr) + sizeof(in_port_t);
     } else if (family == AF_INET6) {
         const auto& sin6 = addr.getIPv6();
-        ip = &sin6.sin6_addr;
-        iplen = 16;
-        port = sin6.sin6_port;
-    } else {
-        return {};
+        std::memcpy(buf.data(), &sin6.sin6_addr, sizeof(in6_addr));
+        std::memcpy(buf.data() + sizeof(in6_addr), &sin6.sin6_port, sizeof(in_port_t));
+        return sizeof(in6_addr) + sizeof(in_port_t);
     }
+    return 0;
+}
 
-    const auto& c1 = old ? oldsecret : secret;
-    Blob data;
-    data.reserve(sizeof(secret)+sizeof(in_port_t)+iplen);
-    data.insert(data.end(), (uint8_t*)&c1, ((uint8_t*)&c1) + sizeof(c1));
-    data.insert(data.end(), (uint8_t*)ip, (uint8_t*)ip+iplen);
-    data.insert(data.end(), (uint8_t*)&port, ((uint8_t*)&port)+sizeof(in_port_t));
-    return crypto::hash(data, TOKEN_SIZE);
+Blob
+Dht::makeToken(const SockAddr& addr, bool old) const
+{
+    std::array<uint8_t, sizeof(in6_addr) + sizeof(in_port_t)> data;
+    auto len = tokenData(addr, data);
+    if (not len)
+        return {};
+    Blob token(TOKEN_SIZE);
+    (old ? oldsecret : secret).get(data.data(), len, token.data(), token.size());
+    return token;
 }
 
 bool
@@ -1536,11 +1702,12 @@ Dht::tokenMatch(const Blob& token, const SockAddr& addr) const
 {
     if (not addr or token.size() != TOKEN_SIZE)
         return false;
-    if (token == makeToken(addr, false))
-        return true;
-    if (token == makeToken(addr, true))
-        return true;
-    return false;
+    std::array<uint8_t, sizeof(in6_addr) + sizeof(in_port_t)> data;
+    auto len = tokenData(addr, data);
+    if (not len)
+        return false;
+    return secret.check(token.data(), token.size(), data.data(), len)
+        or oldsecret.check(token.data(), token.size(), data.data(), len);
 }
 
 NodeStats
@@ -1551,6 +1718,19 @@ Dht::getNodesStats(sa_family_t af) const
     return stats;
 }
 
+MemoryStats
+Dht::getMemoryStats() const
+{
+    MemoryStats stats;
+    stats.storage = total_store_size;
+    stats.listeners = listeners_memory;
+    stats.searches = searches_memory;
+    stats.node_cache = network_engine.getNodeCacheSize()
+        * (MemoryStats::NODE_OVERHEAD + sizeof(InfoHash) + sizeof(std::weak_ptr<Node>) + sizeof(Node));
+    stats.partial_messages = network_engine.getPartialMemory();
+    return stats;
+}
+
 NodeStats
 Dht::Kad::getNodesStats(time_point now, const InfoHash& myid) const
 {
@@ -1563,6 +1743,8 @@ Dht::Kad::getNodesStats(time_point now, const InfoHash& myid) const
                     stats.incoming_nodes++;
             } else if (not n->isExpired())
                 stats.dubious_nodes++;
+            if (not n->isExpired() and n->getRtt() != duration::zero())
+                stats.addRtt(n->getRtt());
         }
         if (b.cached)
             stats.cached_nodes++;
@@ -1589,6 +1771,8 @@ Dht::dumpBucket(const Bucket& b, std::ostream& out) const
             out << " updated: " << print_time_relative(now, t) << ", replied: " << print_time_relative(now, r);
         else
             out << " updated: " << print_time_relative(now, t);
+        if (n->getRtt() != duration::zero())
+            out << " rtt: " << print_duration(n->getRtt()) << " ±" << print_duration(n->getRttVar());
         if (n->isExpired())
             out << " [expired]";
         else if (n->isGood(now))
@@ -1613,12 +1797,18 @@ Dht::dumpSearch(const Search& sr, std::ostream& out) const
         (sr.isSynced(now) ? " [synced]"sv : " [not synced]"sv),
         (sr.isListening(now, listen_expire) ? " [listening]"sv : ""sv)
     );
+    auto timing = sr.span.breakdown();
+    if (not timing.empty())
+        fmt::print(out, "Timing: {}\n", timing);
 
     // printing the queries
     if (sr.callbacks.size() + sr.listeners.size() > 0)
         fmt::print(out, "Queries:\n");
     for (const auto& cb : sr.callbacks) {
         out << *cb.second.query << std::endl;
+        auto get_timing = cb.second.span.breakdown();
+        if (not get_timing.empty())
+            fmt::print(out, "  get timing: {}\n", get_timing);
     }
     for (const auto& l : sr.listeners) {
         out << *l.second.query << std::endl;
@@ -1627,6 +1817,9 @@ Dht::dumpSearch(const Search& sr, std::ostream& out) const
     for (const auto& a : sr.announce) {
         bool announced = sr.isAnnounced(a.value->id);
         out << "Announcement: " << *a.value << (announced ? " [announced]" : "") << std::endl;
+        auto put_timing = a.span.breakdown();
+        if (not put_timing.empty())
+            fmt::print(out, "  put timing: {}\n", put_timing);
     }
 
     fmt::print(out, " Common bits    InfoHash                       Conn. Get   Ops  IP\n");
@@ -1813,6 +2006,7 @@ fromDhtConfig(const Config& config)
         ? config.max_peer_req_per_sec
         : netConf.max_req_per_sec/8;
     netConf.is_client = config.client_mode;
+    netConf.max_partial_memory = config.max_partial_memory ? (size_t)config.max_partial_memory : DEFAULT_PARTIAL_MEMORY_LIMIT;
     return netConf;
 }
 
@@ -1825,6 +2019,9 @@ Dht::Dht(std::unique_ptr<net::DatagramSocket>&& sock, const Config& config, cons
     max_store_keys(config.max_store_keys ? (int)config.max_store_keys : MAX_HASHES),
     max_store_size(config.max_store_size ? (int)config.max_store_size : DEFAULT_STORAGE_LIMIT),
     max_searches(config.max_searches ? (int)config.max_searches : MAX_SEARCHES),
+    max_search_memory(config.max_search_memory ? (size_t)config.max_search_memory : DEFAULT_SEARCH_MEMORY_LIMIT),
+    max_listener_memory(config.max_listener_memory ? (size_t)config.max_listener_memory : DEFAULT_LISTENER_MEMORY_LIMIT),
+    scheduler(config.clock),
     network_engine(myid, fromDhtConfig(config), std::move(sock), logger_, rd, scheduler,
             std::bind(&Dht::onError, this, _1, _2),
             std::bind(&Dht::onNewNode, this, _1, _2),
@@ -1838,7 +2035,9 @@ Dht::Dht(std::unique_ptr<net::DatagramSocket>&& sock, const Config& config, cons
     persistPath(config.persist_path),
     is_bootstrap(config.is_bootstrap),
     maintain_storage(config.maintain_storage),
-    public_stable(config.public_stable)
+    public_stable(config.public_stable),
+    latency_aware_search(config.latency_aware_search),
+    max_hedged_requests(config.latency_aware_search ? config.max_hedged_requests : 0)
 {
     scheduler.syncTime();
     auto s = network_engine.getSocket();
@@ -1858,8 +2057,6 @@ Dht::Dht(std::unique_ptr<net::DatagramSocket>&& sock, const Config& config, cons
     uniform_duration_distribution<> time_dis {std::chrono::seconds(3), std::chrono::seconds(5)};
     nextNodesConfirmation = scheduler.add(scheduler.time() + time_dis(rd), std::bind(&Dht::confirmNodes, this));
 
-    // Fill old secret
-    secret = std::uniform_int_distribution<uint64_t>{}(rd);
     rotateSecrets();
 
     if (not persistPath.empty())
@@ -2036,7 +2233,28 @@ Dht::periodic(const uint8_t *buf, size_t buflen, SockAddr from, const time_point
                 logger_->w("Unable to process message: %s", e.what());
         }
     }
-    return scheduler.run();
+    auto next = scheduler.run();
+    if (metrics_)
+        updateMetrics();
+    return next;
+}
+
+void
+Dht::setMetrics(const Sp<metrics::Registry>& registry)
+{
+    if (registry) {
+        metrics_ = std::make_unique<Metrics>(registry);
+        network_engine.setMetrics(*registry);
+    }
+}
+
+void
+Dht::updateMetrics()
+{
+    metrics_->searches.set(dht4.searches.size() + dht6.searches.size());
+    metrics_->storageKeys.set(store.size());
+    metrics_->storageValues.set(total_values);
+    metrics_->storageBytes.set(total_store_size);
 }
 
 void
@@ -2372,6 +2590,7 @@ void Dht::onGetValuesDone(const Sp<Node>& node,
             if (logger_)
                 logger_->d(sr->id, node->id, "[search %s] [node %s] Found %u values",
                       sr->id.toString().c_str(), node->toString().c_str(), a.values.size());
+            sr->span.mark(trace::Point::FirstValue);
             for (auto& getp : sr->callbacks) { /* call all callbacks for this search */
                 auto& get = getp.second;
                 if (not (get.get_cb or get.query_cb) or
@@ -2379,6 +2598,7 @@ void Dht::onGetValuesDone(const Sp<Node>& node,
                     continue;
 
                 if (get.query_cb) { /* in case of a request with query */
+                    get.span.mark(trace::Point::FirstValue);
                     if (not a.fields.empty()) {
                         get.query_cb(a.fields);
                     } else if (not a.values.empty()) {
@@ -2393,8 +2613,10 @@ void Dht::onGetValuesDone(const Sp<Node>& node,
                     for (const auto& v : a.values)
                         if (not get.filter or get.filter(*v))
                             tmp.emplace_back(v);
-                    if (not tmp.empty())
+                    if (not tmp.empty()) {
+                        get.span.mark(trace::Point::FirstValue);
                         get.get_cb(tmp);
+                    }
                 }
             }
 
@@ -2448,7 +2670,11 @@ Dht::onListen(Sp<Node> node, const InfoHash& hash, const Blob& token, size_t soc
         throw net::DhtProtocolException {net::DhtProtocolException::UNAUTHORIZED, net::DhtProtocolException::LISTEN_WRONG_TOKEN};
     }
     Query q = query;
-    storageAddListener(hash, node, socket_id, std::move(q), version);
+    if (not storageAddListener(hash, node, socket_id, std::move(q), version)) {
+        if (logger_)
+            logger_->w(hash, node->id, "[node %s] Refusing 'listen' for %s: limit reached", node->toString().c_str(), hash.toString().c_str());
+        throw net::DhtProtocolException {net::DhtProtocolException::OVERLOADED, net::DhtProtocolException::LISTEN_OVERLOADED};
+    }
     return {};
 }
 
@@ -2592,13 +2818,8 @@ Dht::storageRefresh(const InfoHash& id, Value::Id vid)
             }
         }
 
-        auto expiration = s->second.refresh(id, now, vid, types);
-        if (expiration.first) {
-            scheduler.cancel(expiration.first->expiration_job);
-            if (expiration.second != time_point::max()) {
-                expiration.first->expiration_job = scheduler.add(expiration.second, std::bind(&Dht::expireStorage, this, id));
-            }
-        }
+        if (s->second.refresh(id, now, vid, types).first)
+            scheduleStorageExpiration(id, s->second);
         return true;
     }
     return false;
@@ -93,6 +93,64 @@ private:
     std::string line_ {};
 };
 
+/**
+ * Split a stream of msgpack frames (see proxy::MSGPACK_FRAME_SIZE_LEN).
+ */
+struct FrameSplit {
+    /** Largest accepted frame: a packed value with its signature, owner key or encryption overhead */
+    static constexpr size_t MAX_FRAME_SIZE {MAX_VALUE_SIZE + 8 * 1024};
+
+    void append(const char* d, size_t l) {
+        // stop buffering a stream that already failed
+        if (invalid_)
+            return;
+        // drop the frames read since the last append
+        buf_.erase(buf_.begin(), buf_.begin() + pos_);
+        pos_ = 0;
+        buf_.insert(buf_.end(), d, d+l);
+    }
+    /**
+     * Read the next complete frame, if any.
+     * Throws if the stream announces a frame larger than MAX_FRAME_SIZE.
+     */
+    bool getFrame() {
+        if (invalid_)
+            throw std::length_error("invalid msgpack frame stream");
+        auto available = buf_.size() - pos_;
+        if (available < proxy::MSGPACK_FRAME_SIZE_LEN)
+            return false;
+        size_t size = 0;
+        for (size_t i = 0; i < proxy::MSGPACK_FRAME_SIZE_LEN; i++)
+            size = (size << 8) | (uint8_t)buf_[pos_ + i];
+        if (size > MAX_FRAME_SIZE) {
+            invalid_ = true;
+            buf_.clear();
+            pos_ = 0;
+            throw std::length_error("msgpack frame too large: " + std::to_string(size));
+        }
+        if (available < proxy::MSGPACK_FRAME_SIZE_LEN + size)
+            return false;
+        auto begin = buf_.begin() + pos_ + proxy::MSGPACK_FRAME_SIZE_LEN;
+        frame_.assign(begin, begin + size);
+        pos_ += proxy::MSGPACK_FRAME_SIZE_LEN + size;
+        return true;
+    }
+    /** Unpack the value of the current frame */
+    Sp<Value> value(bool& expired) const {
+        if (frame_.empty())
+            throw msgpack::type_error();
+        expired = frame_[0] & proxy::MSGPACK_FRAME_EXPIRED;
+        auto oh = msgpack::unpack(frame_.data() + 1, frame_.size() - 1);
+        return std::make_shared<Value>(oh.get());
+    }
+private:
+    std::vector<char> buf_ {};
+    /** Start of the next frame in buf_ */
+    size_t pos_ {0};
+    std::string frame_ {};
+    bool invalid_ {false};
+};
+
 std::string
 getRandomSessionId(size_t length = 8) {
     static constexpr const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789!#$%&()*+,./:;<=>?@[]^_`{|}~";
@@ -217,6 +275,7 @@ DhtProxyClient::stop()
             for (auto& request : requests_)
                 request.second->cancel();
         }
+        connectionPool_->clear();
         if (not httpContext_.stopped())
             httpContext_.stop();
         if (httpClientThread_.joinable())
@@ -334,9 +393,11 @@ DhtProxyClient::get(const InfoHash& key, GetCallback cb, DoneCallback donecb, Va
     try {
         auto request = buildRequest("/key/" + key.toString());
         auto reqid = request->id();
-        //request->set_connection_type(restinio::http_connection_header_t::keep_alive);
         request->set_method(restinio::http_method_get());
         setHeaderFields(*request);
+        bool msgpack = msgpack_;
+        if (msgpack)
+            request->set_header_field(restinio::http_field_t::accept, proxy::CONTENT_TYPE_MSGPACK);
 
         auto opstate = std::make_shared<OperationState>();
 
@@ -346,23 +407,35 @@ DhtProxyClient::get(const InfoHash& key, GetCallback cb, DoneCallback donecb, Va
             opstate,
             filter = Value::Filter::chain(std::move(f), w.getFilter()),
             rxBuf = std::make_shared<LineSplit>(),
+            frameBuf = msgpack ? std::make_shared<FrameSplit>() : std::shared_ptr<FrameSplit>{},
             cb
         ](const char* at, size_t length){
             try {
-                rxBuf->append(at, length);
-                // one value per body line
                 std::vector<Sp<Value>> values;
-                while (rxBuf->getLine('\n') and !opstate->stop) {
-                    std::string err;
-                    Json::Value json;
-                    const auto& line = rxBuf->line();
-                    if (!jsonReader_->parse(line.data(), line.data() + line.size(), &json, &err)){
-                        opstate->ok.store(false);
-                        return;
+                if (frameBuf) {
+                    frameBuf->append(at, length);
+                    // one value per frame
+                    while (frameBuf->getFrame() and !opstate->stop) {
+                        bool expired;
+                        auto value = frameBuf->value(expired);
+                        if ((not filter or filter(*value)) and cb)
+                            values.emplace_back(std::move(value));
+                    }
+                } else {
+                    rxBuf->append(at, length);
+                    // one value per body line
+                    while (rxBuf->getLine('\n') and !opstate->stop) {
+                        std::string err;
+                        Json::Value json;
+                        const auto& line = rxBuf->line();
+                        if (!jsonReader_->parse(line.data(), line.data() + line.size(), &json, &err)){
+                            opstate->ok.store(false);
+                            return;
+                        }
+                        auto value = std::make_shared<Value>(json);
+                        if ((not filter or filter(*value)) and cb)
+                            values.emplace_back(std::move(value));
                     }
-                    auto value = std::make_shared<Value>(json);
-                    if ((not filter or filter(*value)) and cb)
-                        values.emplace_back(std::move(value));
                 }
                 if (not values.empty() and cb) {
                     {
@@ -498,6 +571,7 @@ DhtProxyClient::buildRequest(const std::string& target)
     if (clientIdentity_.first and clientIdentity_.second)
         request->set_identity(clientIdentity_);
     request->set_header_field(restinio::http_field_t::user_agent, userAgent_);
+    request->set_connection_pool(connectionPool_);
     return request;
 }
 
@@ -513,29 +587,72 @@ DhtProxyClient::doPut(const InfoHash& key, Sp<Value> val, DoneCallbackSimple cb,
         request->set_method(restinio::http_method_post());
         setHeaderFields(*request);
 
-        auto json = val->toJson();
+        Json::Value refresh;
         if (permanent) {
             if (deviceKey_.empty()) {
-                json["permanent"] = true;
+                refresh = true;
             } else {
 #ifdef OPENDHT_PUSH_NOTIFICATIONS
-                Json::Value refresh;
                 getPushRequest(refresh);
-                json["permanent"] = refresh;
 #else
-                json["permanent"] = true;
+                refresh = true;
 #endif
             }
         }
-        request->set_body(Json::writeString(jsonBuilder_, json));
-        request->add_on_done_callback([this, reqid, cb, val, key, permanent] (const http::Response& response){
+        bool msgpack = msgpack_;
+        if (msgpack) {
+            request->set_header_field(restinio::http_field_t::accept, proxy::CONTENT_TYPE_MSGPACK);
+            request->set_header_field(restinio::http_field_t::content_type, proxy::CONTENT_TYPE_MSGPACK);
+            msgpack::sbuffer buffer;
+            msgpack::packer<msgpack::sbuffer> pk(&buffer);
+            pk.pack_map(permanent ? 2 : 1);
+            pk.pack("value"); pk.pack(*val);
+            if (permanent) {
+                pk.pack("permanent");
+                if (refresh.isObject()) {
+                    auto members = refresh.getMemberNames();
+                    pk.pack_map(members.size());
+                    for (const auto& member : members) {
+                        pk.pack(member);
+                        pk.pack(refresh[member].asString());
+                    }
+                } else {
+                    pk.pack(true);
+                }
+            }
+            request->set_body(std::string(buffer.data(), buffer.size()));
+        } else {
+            auto json = val->toJson();
+            if (permanent)
+                json["permanent"] = refresh;
+            request->set_body(Json::writeString(jsonBuilder_, json));
+        }
+        request->add_on_done_callback([this, reqid, cb, val, key, permanent, msgpack] (const http::Response& response){
             bool ok = response.status_code == 200;
             if (ok) {
                 if (val->id == Value::INVALID_ID) {
                     std::string err;
-                    Json::Value parsedValue;
-                    if (jsonReader_->parse(response.body.data(), response.body.data() + response.body.size(), &parsedValue, &err)){
-                        auto id = dht::Value(parsedValue).id;
+                    Value::Id id {Value::INVALID_ID};
+                    bool parsed = false;
+                    try {
+                        if (msgpack) {
+                            FrameSplit frame;
+                            frame.append(response.body.data(), response.body.size());
+                            bool expired;
+                            if ((parsed = frame.getFrame()))
+                                id = frame.value(expired)->id;
+                            else
+                                err = "incomplete frame";
+                        } else {
+                            Json::Value parsedValue;
+                            if ((parsed = jsonReader_->parse(response.body.data(), response.body.data() + response.body.size(), &parsedValue, &err)))
+                                id = dht::Value(parsedValue).id;
+                        }
+                    } catch (const std::exception& e) {
+                        parsed = false;
+                        err = e.what();
+                    }
+                    if (parsed) {
                         val->id = id;
                         if (permanent) {
                             std::lock_guard<std::mutex> lock(searchLock_);
@@ -651,6 +768,8 @@ DhtProxyClient::getProxyInfos()
     if (logger_)
         logger_->d("[proxy:client] [status] sending request");
 
+    // connectivity may have changed: don't reuse previous connections
+    connectionPool_->clear();
     auto resolver = std::make_shared<http::Resolver>(httpContext_, proxyUrl_, logger_);
     queryProxyInfo(infoState, resolver, AF_INET);
     queryProxyInfo(infoState, resolver, AF_INET6);
@@ -740,6 +859,11 @@ DhtProxyClient::onProxyInfos(const Json::Value& proxyInfos, const sa_family_t fa
                        family == AF_INET ? "ipv4" : "ipv6");
         try {
             myid = InfoHash(proxyInfos["node_id"].asString());
+            bool msgpack = false;
+            for (const auto& contentType : proxyInfos["content_types"])
+                if (contentType.asString() == proxy::CONTENT_TYPE_MSGPACK)
+                    msgpack = true;
+            msgpack_ = msgpack;
             stats4_ = NodeStats(proxyInfos["ipv4"]);
             stats6_ = NodeStats(proxyInfos["ipv6"]);
             auto publicIp = parsePublicAddress(proxyInfos["public_ip"]);
@@ -1057,6 +1181,10 @@ DhtProxyClient::sendListen(const restinio::http_request_header_t& header,
         auto reqid = request->id();
         request->set_header(header);
         setHeaderFields(*request);
+        // push subscriptions are always answered in JSON
+        bool msgpack = method == ListenMethod::LISTEN and msgpack_;
+        if (msgpack)
+            request->set_header_field(restinio::http_field_t::accept, proxy::CONTENT_TYPE_MSGPACK);
         if (method == ListenMethod::LISTEN)
             request->set_connection_type(restinio::http_connection_header_t::keep_alive);
 #ifdef OPENDHT_PUSH_NOTIFICATIONS
@@ -1066,8 +1194,28 @@ DhtProxyClient::sendListen(const restinio::http_request_header_t& header,
         request->set_body(body);
 #endif
         auto rxBuf = std::make_shared<LineSplit>();
-        request->add_on_body_callback([this, reqid, opstate, rxBuf, cb](const char* at, size_t length){
+        auto frameBuf = msgpack ? std::make_shared<FrameSplit>() : std::shared_ptr<FrameSplit>{};
+        request->add_on_body_callback([this, reqid, opstate, rxBuf, frameBuf, cb](const char* at, size_t length){
             try {
+                if (frameBuf) {
+                    frameBuf->append(at, length);
+                    // one value per frame
+                    while (frameBuf->getFrame() and !opstate->stop) {
+                        bool expired;
+                        auto value = frameBuf->value(expired);
+                        if (cb){
+                            {
+                                std::lock_guard<std::mutex> lock(lockCallbacks_);
+                                callbacks_.emplace_back([cb, value, opstate, expired]() {
+                                    if (not opstate->stop.load() and not cb({value}, expired, system_clock::time_point::min()))
+                                        opstate->stop.store(true);
+                                });
+                            }
+                            loopSignal_();
+                        }
+                    }
+                    return;
+                }
                 auto& b = *rxBuf;
                 b.append(at, length);
 
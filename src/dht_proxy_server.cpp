@@ -42,10 +42,12 @@ using namespace std::literals;
 
 namespace dht {
 constexpr char RESP_MSG_JSON_INCORRECT[] = "{\"err:\":\"Incorrect JSON\"}";
+constexpr char RESP_MSG_MSGPACK_INCORRECT[] = "{\"err:\":\"Incorrect msgpack\"}";
 constexpr char RESP_MSG_SERVICE_UNAVAILABLE[] = "{\"err\":\"Incorrect DhtRunner\"}";
 constexpr char RESP_MSG_INTERNAL_SERVER_ERRROR[] = "{\"err\":\"Internal server error\"}";
 constexpr char RESP_MSG_MISSING_PARAMS[] = "{\"err\":\"Missing parameters\"}";
 constexpr char RESP_MSG_PUT_FAILED[] = "{\"err\":\"Put failed\"}";
+constexpr char RESP_MSG_OVERLOADED[] = "{\"err\":\"Too many sessions\"}";
 #ifdef OPENDHT_PROXY_SERVER_IDENTITY
 constexpr char RESP_MSG_DESTINATION_NOT_FOUND[] = "{\"err\":\"No destination found\"}";
 #endif
@@ -54,6 +56,15 @@ constexpr char RESP_MSG_NO_TOKEN[] = "{\"err\":\"No token\"}";
 #endif
 
 constexpr const std::chrono::minutes PRINT_STATS_PERIOD {2};
+constexpr const std::chrono::seconds SESSION_MEMORY_PERIOD {1};
+// Number of serialized values kept before looking for values that don't exist anymore
+constexpr const size_t SERIALIZED_VALUES_PRUNE_SIZE {1024};
+// Sessions cached by the TLS server are only resumed within this context
+constexpr const unsigned char TLS_SESSION_ID_CONTEXT[] = "opendht-proxy";
+#ifdef OPENDHT_PUSH_NOTIFICATIONS
+// Delay to gather notifications in a batch when less than a full batch is queued
+constexpr const std::chrono::milliseconds PUSH_BATCH_DELAY {10};
+#endif
 
 using ResponseByParts = restinio::chunked_output_t;
 using ResponseByPartsBuilder = restinio::response_builder_t<ResponseByParts>;
@@ -66,7 +77,7 @@ struct ListenerSession
 {
     ListenerSession() = default;
     dht::InfoHash hash;
-    std::future<size_t> token;
+    bool msgpack {false};
     std::shared_ptr<restinio::response_builder_t<restinio::chunked_output_t>> response;
 };
 }
@@ -107,6 +118,13 @@ DhtProxyServer::serverError(restinio::request_t& request) {
     return response.done();
 }
 
+RequestStatus
+DhtProxyServer::serverOverloaded(restinio::request_t& request) {
+    auto response = initHttpResponse(request.create_response(restinio::status_service_unavailable()));
+    response.set_body(RESP_MSG_OVERLOADED);
+    return response.done();
+}
+
 // connection listener
 
 class DhtProxyServer::ConnectionListener
@@ -140,7 +158,7 @@ DhtProxyServer::onConnectionClosed(restinio::connection_id_t id)
     std::lock_guard<std::mutex> lock(lockListener_);
     auto it = listeners_.find(id);
     if (it != listeners_.end()) {
-        dht_->cancelListen(it->second.hash, std::move(it->second.token));
+        removeListenSession(it->second.hash, id);
         listeners_.erase(it);
         if (logger_)
             logger_->d("[proxy:server] [connection:%li] listener cancelled, %li still connected", id, listeners_.size());
@@ -216,6 +234,29 @@ DhtProxyServer::Listener::msgpack_unpack(const msgpack::object& o)
 }
 #endif
 
+struct DhtProxyServer::Metrics {
+    Sp<metrics::Registry> registry;
+    metrics::Counter& getRequests;
+    metrics::Counter& putRequests;
+    metrics::Counter& listenRequests;
+    metrics::Counter& subscribeRequests;
+    metrics::Histogram& getDuration;
+    metrics::Histogram& putDuration;
+
+    Metrics(const Sp<metrics::Registry>& r) : registry(r),
+        getRequests(requests(*r, "get")),
+        putRequests(requests(*r, "put")),
+        listenRequests(requests(*r, "listen")),
+        subscribeRequests(requests(*r, "subscribe")),
+        getDuration(r->histogram("dht_proxy_get_duration_seconds", "Time to answer get requests")),
+        putDuration(r->histogram("dht_proxy_put_duration_seconds", "Time to answer put requests"))
+    {}
+
+    static metrics::Counter& requests(metrics::Registry& r, const char* op) {
+        return r.counter("dht_proxy_requests_total", "Proxy requests received", {{"op", op}});
+    }
+};
+
 DhtProxyServer::DhtProxyServer(const std::shared_ptr<DhtRunner>& dht,
         const ProxyServerConfig& config,
         const std::shared_ptr<dht::Logger>& logger
@@ -227,10 +268,23 @@ DhtProxyServer::DhtProxyServer(const std::shared_ptr<DhtRunner>& dht,
         connListener_(std::make_shared<ConnectionListener>(std::bind(&DhtProxyServer::onConnectionClosed, this, std::placeholders::_1))),
         pushServer_(config.pushServer),
         bundleId_(config.bundleId)
+#ifdef OPENDHT_PUSH_NOTIFICATIONS
+        , pushBatchSize_(std::max<size_t>(config.pushBatchSize, 1)),
+        pushMaxInflight_(std::max<size_t>(config.pushMaxInflight, 1)),
+        pushQueueSize_(config.pushQueueSize),
+        pushFlushTimer_(std::make_unique<asio::steady_timer>(*ioContext_)),
+        pushConnectionPool_(std::make_shared<http::ConnectionPool>(*ioContext_))
+#endif
 {
     if (not dht_)
         throw std::invalid_argument("A DHT instance must be provided");
 
+    // share the node registry when available, so that /metrics exports both
+    auto registry = dht_->getMetrics();
+    metrics_ = std::make_unique<Metrics>(registry ? registry : std::make_shared<metrics::Registry>());
+    metricsEndpoint_ = config.metricsEndpoint;
+    maxSessionMemory_ = config.maxSessionMemory;
+
     if (logger_)
         logger_->d("[proxy:server] [init] running on %i", config.port);
     if (not pushServer_.empty()){
@@ -269,6 +323,19 @@ DhtProxyServer::DhtProxyServer(const std::shared_ptr<DhtRunner>& dht,
 #ifdef SSL_OP_NO_RENEGOTIATION
         SSL_CTX_set_options(tls_context.native_handle(), SSL_OP_NO_RENEGOTIATION); // CVE-2009-3555
 #endif
+        // session resumption, for clients reconnecting frequently
+        auto sslCtx = tls_context.native_handle();
+        SSL_CTX_set_session_id_context(sslCtx, TLS_SESSION_ID_CONTEXT, sizeof(TLS_SESSION_ID_CONTEXT) - 1);
+        if (config.tlsSessionCacheSize) {
+            SSL_CTX_set_session_cache_mode(sslCtx, SSL_SESS_CACHE_SERVER);
+            SSL_CTX_sess_set_cache_size(sslCtx, config.tlsSessionCacheSize);
+        } else
+            SSL_CTX_set_session_cache_mode(sslCtx, SSL_SESS_CACHE_OFF);
+        SSL_CTX_set_timeout(sslCtx, config.tlsSessionTimeout.count());
+        if (config.tlsSessionTickets)
+            SSL_CTX_clear_options(sslCtx, SSL_OP_NO_TICKET);
+        else
+            SSL_CTX_set_options(sslCtx, SSL_OP_NO_TICKET);
         // node private key
         auto key = config.identity.first->serialize();
         tls_context.use_private_key(asio::const_buffer{key.data(), key.size()},
@@ -471,8 +538,10 @@ DhtProxyServer::~DhtProxyServer()
     }
     if (dht_) {
         std::lock_guard<std::mutex> lock(lockListener_);
+        for (auto& l : sharedListens_)
+            dht_->cancelListen(l.first, std::move(l.second->token));
+        sharedListens_.clear();
         for (auto& l : listeners_) {
-            dht_->cancelListen(l.second.hash, std::move(l.second.token));
             if (l.second.response)
                 l.second.response->done();
         }
@@ -488,6 +557,11 @@ DhtProxyServer::~DhtProxyServer()
                 }
         }
         pushListeners_.clear();
+        {
+            // the flush timer is armed under pushQueueLock_ by the server thread
+            std::lock_guard<std::mutex> l(pushQueueLock_);
+            pushFlushTimer_->cancel();
+        }
 #endif
     }
     if (logger_)
@@ -495,6 +569,19 @@ DhtProxyServer::~DhtProxyServer()
     ioContext_->stop();
     if (serverThread_.joinable())
         serverThread_.join();
+#ifdef OPENDHT_PUSH_NOTIFICATIONS
+    {
+        std::lock_guard<std::mutex> l(pushQueueLock_);
+        pushQueue_.clear();
+    }
+#endif
+    // pending requests call back on completion: end them while members are still valid
+    decltype(requests_) requests;
+    {
+        std::lock_guard<std::mutex> l(requestLock_);
+        requests = std::move(requests_);
+    }
+    requests.clear();
     if (logger_)
         logger_->d("[proxy:server] http server closed");
 }
@@ -565,6 +652,7 @@ DhtProxyServer::updateStats(std::shared_ptr<NodeInfo> info) const
 void
 DhtProxyServer::updateStats() {
     dht_->getNodeInfo([this](std::shared_ptr<NodeInfo> newInfo){
+        newInfo->memory.proxy = getSessionMemory();
         stats_ = updateStats(newInfo);
         nodeInfo_ = newInfo;
         if (logger_) {
@@ -574,6 +662,68 @@ DhtProxyServer::updateStats() {
     });
 }
 
+size_t
+DhtProxyServer::getSessionMemory()
+{
+    size_t memory {0};
+    {
+        std::lock_guard<std::mutex> lock(lockListener_);
+        memory += listeners_.size() * (MemoryStats::NODE_OVERHEAD + sizeof(decltype(listeners_)::value_type));
+        for (const auto& shared : sharedListens_) {
+            memory += MemoryStats::NODE_OVERHEAD + sizeof(shared) + sizeof(SharedListen)
+                    + shared.second->sessions.size() * (MemoryStats::NODE_OVERHEAD + sizeof(restinio::connection_id_t));
+            for (const auto& value : shared.second->values)
+                memory += MemoryStats::NODE_OVERHEAD + sizeof(value) + sizeof(Value) + value.second->size();
+        }
+#ifdef OPENDHT_PUSH_NOTIFICATIONS
+        for (const auto& pushListener : pushListeners_) {
+            memory += MemoryStats::NODE_OVERHEAD + sizeof(pushListener) + pushListener.first.size();
+            for (const auto& listeners : pushListener.second.listeners)
+                memory += MemoryStats::NODE_OVERHEAD + sizeof(listeners) + listeners.second.size() * sizeof(Listener);
+        }
+#endif
+    }
+    {
+        std::lock_guard<std::mutex> lock(lockSearchPuts_);
+        for (const auto& searchPuts : puts_) {
+            memory += MemoryStats::NODE_OVERHEAD + sizeof(searchPuts);
+            for (const auto& put : searchPuts.second.puts)
+                memory += MemoryStats::NODE_OVERHEAD + sizeof(put) + sizeof(Value)
+                        + (put.second.value ? put.second.value->size() : 0);
+        }
+    }
+    sessionMemory_ = memory;
+    return memory;
+}
+
+bool
+DhtProxyServer::sessionMemoryExceeded()
+{
+    if (not maxSessionMemory_)
+        return false;
+    auto now = clock::now();
+    auto last = sessionMemoryTime_.load();
+    if (now - last >= SESSION_MEMORY_PERIOD and sessionMemoryTime_.compare_exchange_strong(last, now))
+        getSessionMemory();
+    return sessionMemory_ > maxSessionMemory_;
+}
+
+#ifdef OPENDHT_PUSH_NOTIFICATIONS
+bool
+DhtProxyServer::hasPushListener(const std::string& pushToken, const InfoHash& infoHash, const std::string& clientId) const
+{
+    auto pushListener = pushListeners_.find(pushToken);
+    if (pushListener == pushListeners_.end())
+        return false;
+    auto listeners = pushListener->second.listeners.find(infoHash);
+    if (listeners == pushListener->second.listeners.end())
+        return false;
+    return std::any_of(listeners->second.begin(), listeners->second.end(), [&](const Listener& l) {
+        return l.clientId == clientId;
+    });
+}
+#endif
+
 void
 DhtProxyServer::handlePrintStats(const asio::error_code &ec)
 {
@@ -584,11 +734,19 @@ DhtProxyServer::handlePrintStats(const asio::error_code &ec)
     printStatsTimer_->async_wait(std::bind(&DhtProxyServer::handlePrintStats, this, std::placeholders::_1));
 }
 
+DhtProxyServer::ValueFormat
+DhtProxyServer::getValueFormat(const restinio::request_t& request)
+{
+    auto accept = request.header().get_field_or(restinio::http_field::accept, "");
+    return accept.find(proxy::CONTENT_TYPE_MSGPACK) != std::string::npos ? ValueFormat::Msgpack : ValueFormat::Json;
+}
+
 template <typename HttpResponse>
-HttpResponse DhtProxyServer::initHttpResponse(HttpResponse response)
+HttpResponse DhtProxyServer::initHttpResponse(HttpResponse response, ValueFormat format)
 {
     response.append_header("Server", "RESTinio");
-    response.append_header(restinio::http_field::content_type, "application/json");
+    response.append_header(restinio::http_field::content_type,
+        format == ValueFormat::Msgpack ? proxy::CONTENT_TYPE_MSGPACK : proxy::CONTENT_TYPE_JSON);
     response.append_header(restinio::http_field::access_control_allow_origin, "*");
     return response;
 }
@@ -625,6 +783,9 @@ DhtProxyServer::createRestRouter()
     router->http_get("/node/info", std::bind(&DhtProxyServer::getNodeInfo, this, _1, _2));
     // node.stats
     router->http_get("/node/stats", std::bind(&DhtProxyServer::getStats, this, _1, _2));
+    // node.metrics
+    if (metricsEndpoint_)
+        router->http_get("/metrics", std::bind(&DhtProxyServer::getMetrics, this, _1, _2));
     // key.options
     router->http_get("/key/:hash/options", std::bind(&DhtProxyServer::options, this, _1, _2));
     // key.get
@@ -664,6 +825,10 @@ DhtProxyServer::getNodeInfo(restinio::request_handle_t request,
             auto result = nodeInfo->toJson();
             // [ipv6:ipv4]:port or ipv4:port
             result["public_ip"] = request->remote_endpoint().address().to_string();
+            // value encodings supported by get, listen and put
+            auto& contentTypes = result["content_types"];
+            contentTypes.append(proxy::CONTENT_TYPE_JSON);
+            contentTypes.append(proxy::CONTENT_TYPE_MSGPACK);
             auto response = initHttpResponse(request->create_response());
             response.append_body(Json::writeString(jsonBuilder_, result) + "\n");
             return response.done();
@@ -696,29 +861,45 @@ DhtProxyServer::getStats(restinio::request_handle_t request,
     }
 }
 
+RequestStatus
+DhtProxyServer::getMetrics(restinio::request_handle_t request,
+                           restinio::router::route_params_t /*params*/)
+{
+    try {
+        auto response = request->create_response();
+        response.append_header("Server", "RESTinio");
+        response.append_header(restinio::http_field::content_type, metrics::Registry::CONTENT_TYPE);
+        response.set_body(metrics_->registry->toPrometheus());
+        return response.done();
+    } catch (...){
+        return serverError(*request);
+    }
+}
+
 RequestStatus
 DhtProxyServer::get(restinio::request_handle_t request,
                     restinio::router::route_params_t params)
 {
     requestNum_++;
+    metrics_->getRequests.inc();
     try {
         InfoHash infoHash(params["hash"]);
         if (!infoHash)
             infoHash = InfoHash::get(params["hash"]);
+        auto format = getValueFormat(*request);
         auto response = std::make_shared<ResponseByPartsBuilder>(
-            initHttpResponse(request->create_response<ResponseByParts>()));
+            initHttpResponse(request->create_response<ResponseByParts>(), format));
         response->flush();
-        dht_->get(infoHash, [this, response](const std::vector<Sp<Value>>& values) {
-            std::ostringstream output;
-            for (const auto& value : values) {
-                output << Json::writeString(jsonBuilder_, value->toJson()) << "\n";
-            }
-            response->append_chunk(output.str());
+        dht_->get(infoHash, [this, response, format](const std::vector<Sp<Value>>& values) {
+            for (const auto& value : values)
+                response->append_chunk(getSerializedValue(value, false, format));
             response->flush();
             return true;
         },
-        [response] (bool /*ok*/){
+        // the get may complete after the server is gone: keep the histogram registry alive
+        [response, start = clock::now(), duration = Sp<metrics::Histogram>(metrics_->registry, &metrics_->getDuration)] (bool /*ok*/){
             response->done();
+            duration->observe(clock::now() - start);
         });
         return restinio::request_handling_status_t::accepted;
     } catch (const std::exception& e){
@@ -731,36 +912,156 @@ DhtProxyServer::listen(restinio::request_handle_t request,
                        restinio::router::route_params_t params)
 {
     requestNum_++;
+    metrics_->listenRequests.inc();
 
     try {
+        auto id = request->connection_id();
+        if (sessionMemoryExceeded()) {
+            // only sessions replacing an existing one are accepted
+            std::lock_guard<std::mutex> lock(lockListener_);
+            if (listeners_.find(id) == listeners_.end())
+                return serverOverloaded(*request);
+        }
         InfoHash infoHash(params["hash"]);
         if (!infoHash)
             infoHash = InfoHash::get(params["hash"]);
+        auto format = getValueFormat(*request);
         auto response = std::make_shared<ResponseByPartsBuilder>(
-            initHttpResponse(request->create_response<ResponseByParts>()));
+            initHttpResponse(request->create_response<ResponseByParts>(), format));
         response->flush();
         std::lock_guard<std::mutex> lock(lockListener_);
         // save the listener to handle a disconnect
-        auto &session = listeners_[request->connection_id()];
+        auto sessionIt = listeners_.find(id);
+        if (sessionIt != listeners_.end())
+            removeListenSession(sessionIt->second.hash, id);
+        auto& session = listeners_[id];
         session.hash = infoHash;
+        session.msgpack = format == ValueFormat::Msgpack;
         session.response = response;
-        session.token = dht_->listen(infoHash, [this, response]
-                (const std::vector<Sp<Value>>& values, bool expired){
-            for (const auto& value: values){
-                auto jsonVal = value->toJson();
-                if (expired)
-                    jsonVal["expired"] = true;
-                response->append_chunk(Json::writeString(jsonBuilder_, jsonVal) + "\n");
+        // listen sessions on the same key share a single DHT listen
+        auto& shared = sharedListens_[infoHash];
+        if (not shared) {
+            shared = std::make_shared<SharedListen>();
+            shared->sessions.emplace(id);
+            shared->token = dht_->listen(infoHash, [this, infoHash]
+                    (const std::vector<Sp<Value>>& values, bool expired){
+                return handleSharedListen(infoHash, values, expired);
+            });
+        } else {
+            shared->sessions.emplace(id);
+            if (not shared->values.empty()) {
+                for (const auto& value : shared->values)
+                    response->append_chunk(getSerializedValue(value.second, false, format));
+                response->flush();
             }
-            response->flush();
-            return true;
-        });
+        }
         return restinio::request_handling_status_t::accepted;
     } catch (const std::exception& e){
         return serverError(*request);
     }
 }
 
+bool
+DhtProxyServer::handleSharedListen(const InfoHash& infoHash, const std::vector<Sp<Value>>& values, bool expired)
+{
+    std::vector<std::pair<std::shared_ptr<ResponseByPartsBuilder>, ValueFormat>> responses;
+    {
+        std::lock_guard<std::mutex> lock(lockListener_);
+        auto it = sharedListens_.find(infoHash);
+        if (it == sharedListens_.end())
+            return false;
+        auto& shared = *it->second;
+        for (const auto& value : values) {
+            if (expired)
+                shared.values.erase(value->id);
+            else
+                shared.values[value->id] = value;
+        }
+        responses.reserve(shared.sessions.size());
+        for (const auto& id : shared.sessions) {
+            auto session = listeners_.find(id);
+            if (session != listeners_.end() and session->second.response)
+                responses.emplace_back(session->second.response,
+                                       session->second.msgpack ? ValueFormat::Msgpack : ValueFormat::Json);
+        }
+    }
+
+    // serialize values at most once per format
+    std::vector<std::shared_ptr<const std::string>> chunks[2];
+    for (const auto& [response, format] : responses) {
+        auto& formatChunks = chunks[static_cast<size_t>(format)];
+        if (formatChunks.empty()) {
+            formatChunks.reserve(values.size());
+            for (const auto& value : values)
+                formatChunks.emplace_back(getSerializedValue(value, expired, format));
+        }
+        for (const auto& chunk : formatChunks)
+            response->append_chunk(chunk);
+        response->flush();
+    }
+    return true;
+}
+
+void
+DhtProxyServer::removeListenSession(const InfoHash& infoHash, restinio::connection_id_t id)
+{
+    auto it = sharedListens_.find(infoHash);
+    if (it == sharedListens_.end())
+        return;
+    it->second->sessions.erase(id);
+    if (it->second->sessions.empty()) {
+        dht_->cancelListen(infoHash, std::move(it->second->token));
+        sharedListens_.erase(it);
+    }
+}
+
+std::shared_ptr<const std::string>
+DhtProxyServer::getSerializedValue(const Sp<Value>& value, bool expired, ValueFormat format)
+{
+    auto key = std::make_tuple((const Value*)value.get(), expired, format);
+    {
+        std::lock_guard<std::mutex> lock(serializedValuesLock_);
+        auto it = serializedValues_.find(key);
+        if (it != serializedValues_.end() and not it->second.first.expired())
+            return it->second.second;
+    }
+    std::shared_ptr<const std::string> serialized;
+    if (format == ValueFormat::Msgpack) {
+        msgpack::sbuffer buffer;
+        // frame size, filled once the value is packed
+        buffer.write("\0\0\0\0", proxy::MSGPACK_FRAME_SIZE_LEN);
+        char flags = expired ? proxy::MSGPACK_FRAME_EXPIRED : 0;
+        buffer.write(&flags, 1);
+        msgpack::pack(buffer, *value);
+        uint32_t size = buffer.size() - proxy::MSGPACK_FRAME_SIZE_LEN;
+        auto data = buffer.data();
+        data[0] = (size >> 24) & 0xff;
+        data[1] = (size >> 16) & 0xff;
+        data[2] = (size >> 8) & 0xff;
+        data[3] = size & 0xff;
+        serialized = std::make_shared<const std::string>(buffer.data(), buffer.size());
+    } else {
+        auto jsonVal = value->toJson();
+        if (expired)
+            jsonVal["expired"] = true;
+        serialized = std::make_shared<const std::string>(Json::writeString(jsonBuilder_, jsonVal) + "\n");
+    }
+
+    std::lock_guard<std::mutex> lock(serializedValuesLock_);
+    if (serializedValues_.size() >= std::max(serializedValuesPruneSize_, SERIALIZED_VALUES_PRUNE_SIZE)) {
+        for (auto it = serializedValues_.begin(); it != serializedValues_.end();) {
+            if (it->second.first.expired())
+                it = serializedValues_.erase(it);
+            else
+                ++it;
+        }
+        // avoid scanning again before the cache doubled in size
+        serializedValuesPruneSize_ = serializedValues_.size() * 2;
+    }
+    serializedValues_[key] = {value, serialized};
+    return serialized;
+}
+
 #ifdef OPENDHT_PUSH_NOTIFICATIONS
 
 PushType
@@ -821,7 +1122,9 @@ DhtProxyServer::subscribe(restinio::request_handle_t request,
                           restinio::router::route_params_t params)
 {
     requestNum_++;
+    metrics_->subscribeRequests.inc();
     try {
+        auto overloaded = sessionMemoryExceeded();
         InfoHash infoHash(params["hash"]);
         if (!infoHash)
             infoHash = InfoHash::get(params["hash"]);
@@ -855,6 +1158,8 @@ DhtProxyServer::subscribe(restinio::request_handle_t request,
 
         // Insert new or return existing push listeners of a token
         std::lock_guard<std::mutex> lock(lockListener_);
+        if (overloaded and not hasPushListener(pushToken, infoHash, clientId))
+            return serverOverloaded(*request);
         auto& pushListener = pushListeners_[pushToken];
         auto& pushListeners = pushListener.listeners[infoHash];
 
@@ -909,8 +1214,7 @@ DhtProxyServer::subscribe(restinio::request_handle_t request,
             if (!root["refresh"].asBool()) {
                 // No Refresh
                 dht_->get(infoHash, [this, response](const Sp<Value>& value) {
-                    auto output = Json::writeString(jsonBuilder_, value->toJson()) + "\n";
-                    response->append_chunk(output);
+                    response->append_chunk(getSerializedValue(value));
                     response->flush();
                     return true;
                 },
@@ -1084,73 +1388,61 @@ DhtProxyServer::handlePushListen(const InfoHash& infoHash, const std::string& pu
 void
 DhtProxyServer::sendPushNotification(const std::string& token, Json::Value&& json, PushType type, bool highPriority, const std::string& topic)
 {
-    if (pushServer_.empty() && type != PushType::UnifiedPush)
+    if (type != PushType::UnifiedPush) {
+        if (pushServer_.empty())
+            return;
+        // NOTE: see https://github.com/appleboy/gorush
+        auto isResubscribe = json.isMember("timeout");
+        Json::Value notification(Json::objectValue);
+        notification["platform"] = type == PushType::Android ? 2 : 1;
+        notification["data"] = std::move(json);
+        auto priority = highPriority ? "high" : "normal";
+        if (type == PushType::Android) {
+            Json::Value androidConfig(Json::objectValue);
+            androidConfig["priority"] = priority;
+            androidConfig["ttl"] = "86400s"; // time to live = 24 hours
+            notification["android"] = std::move(androidConfig);
+        } else {
+            notification["priority"] = priority;
+            const auto expiration = std::chrono::system_clock::now() + std::chrono::hours(24);
+            uint32_t exp = std::chrono::duration_cast<std::chrono::seconds>(expiration.time_since_epoch()).count();
+            notification["expiration"] = exp;
+            if (!topic.empty())
+                notification["topic"] = topic;
+            if (highPriority || isResubscribe) {
+                Json::Value alert(Json::objectValue);
+                alert["title"]="hello";
+                notification["push_type"] = "alert";
+                notification["alert"] = alert;
+                notification["mutable_content"] = true;
+                notification["priority"] = "high";
+            } else {
+                notification["push_type"] = "background";
+                notification["content_available"] = true;
+            }
+        }
+        enqueuePushNotification(PendingPush{token, std::move(notification), type, highPriority});
         return;
+    }
 
     unsigned reqid = 0;
     try {
-        std::shared_ptr<http::Request> request;
         http::Url tokenUrl(token);
-        if (type == PushType::UnifiedPush)
-            request = std::make_shared<http::Request>(io_context(), tokenUrl.protocol + "://" + tokenUrl.host + (tokenUrl.service.empty() ? "" : (":" + tokenUrl.service)), logger_);
-        else
-            request = std::make_shared<http::Request>(io_context(), pushHostPort_.first, pushHostPort_.second, pushHostPort_.first.find("https://") == 0, logger_);;
+        auto request = std::make_shared<http::Request>(io_context(), tokenUrl.protocol + "://" + tokenUrl.host + (tokenUrl.service.empty() ? "" : (":" + tokenUrl.service)), logger_);
         reqid = request->id();
-        request->set_target(type == PushType::UnifiedPush ? (tokenUrl.target) : "/api/push");
+        request->set_connection_pool(pushConnectionPool_);
+        request->set_target(tokenUrl.target);
         request->set_method(restinio::http_method_post());
-        request->set_header_field(restinio::http_field_t::host, type == PushType::UnifiedPush ? tokenUrl.host.c_str() : pushServer_.c_str());
+        request->set_header_field(restinio::http_field_t::host, tokenUrl.host.c_str());
         request->set_header_field(restinio::http_field_t::user_agent, "RESTinio client");
         request->set_header_field(restinio::http_field_t::accept, "*/*");
         request->set_header_field(restinio::http_field_t::content_type, "application/json");
 
-        if (type == PushType::UnifiedPush) {
-            Json::Value notification(Json::objectValue);
-            notification["message"] = Json::writeString(jsonBuilder_, std::move(json));
-            notification["topic"] = token;
-            notification["priority"] = highPriority ? 5 : 1;
-            request->set_body(Json::writeString(jsonBuilder_, std::move(json)));
-        } else {
-            // NOTE: see https://github.com/appleboy/gorush
-            auto isResubscribe = json.isMember("timeout");
-            Json::Value notification(Json::objectValue);
-            Json::Value tokens(Json::arrayValue);
-            tokens[0] = token;
-            notification["tokens"] = std::move(tokens);
-            notification["platform"] = type == PushType::Android ? 2 : 1;
-            notification["data"] = std::move(json);
-            auto priority = highPriority ? "high" : "normal";
-            if (type == PushType::Android) {
-                Json::Value androidConfig(Json::objectValue);
-                androidConfig["priority"] = priority;
-                androidConfig["ttl"] = "86400s"; // time to live = 24 hours
-                notification["android"] = std::move(androidConfig);
-            } else {
-                notification["priority"] = priority;
-                const auto expiration = std::chrono::system_clock::now() + std::chrono::hours(24);
-                uint32_t exp = std::chrono::duration_cast<std::chrono::seconds>(expiration.time_since_epoch()).count();
-                notification["expiration"] = exp;
-                if (!topic.empty())
-                    notification["topic"] = topic;
-                if (highPriority || isResubscribe) {
-                    Json::Value alert(Json::objectValue);
-                    alert["title"]="hello";
-                    notification["push_type"] = "alert";
-                    notification["alert"] = alert;
-                    notification["mutable_content"] = true;
-                    notification["priority"] = "high";
-                } else {
-                    notification["push_type"] = "background";
-                    notification["content_available"] = true;
-                }
-            }
-
-            Json::Value notifications(Json::arrayValue);
-            notifications[0] = notification;
-
-            Json::Value content;
-            content["notifications"] = std::move(notifications);
-            request->set_body(Json::writeString(jsonBuilder_, content));
-        }
+        Json::Value notification(Json::objectValue);
+        notification["message"] = Json::writeString(jsonBuilder_, std::move(json));
+        notification["topic"] = token;
+        notification["priority"] = highPriority ? 5 : 1;
+        request->set_body(Json::writeString(jsonBuilder_, std::move(json)));
 
         request->add_on_state_change_callback([this, reqid]
                                               (http::Request::State state, const http::Response& response){
@@ -1168,19 +1460,169 @@ DhtProxyServer::sendPushNotification(const std::string& token, Json::Value&& jso
         request->send();
         // For monitoring purposes
         std::lock_guard lk(pushStatsMutex_);
-        switch (type) {
-        case PushType::Android:
-            androidPush_.increment(highPriority);
-            break;
-        case PushType::iOS:
-            iosPush_.increment(highPriority);
-            break;
-        case PushType::UnifiedPush:
-            unifiedPush_.increment(highPriority);
-            break;
-        default:
-            break;
+        unifiedPush_.increment(highPriority);
+    }
+    catch (const std::exception &e){
+        if (logger_)
+            logger_->e("[proxy:server] [notification] error send push: %s", e.what());
+        if (reqid) {
+            std::lock_guard<std::mutex> l(requestLock_);
+            requests_.erase(reqid);
+        }
+    }
+}
+
+DhtProxyServer::PushStats*
+DhtProxyServer::getPushStats(PushType type)
+{
+    switch (type) {
+    case PushType::Android:
+        return &androidPush_;
+    case PushType::iOS:
+        return &iosPush_;
+    case PushType::UnifiedPush:
+        return &unifiedPush_;
+    default:
+        return nullptr;
+    }
+}
+
+void
+DhtProxyServer::enqueuePushNotification(PendingPush&& push)
+{
+    auto type = push.type;
+    bool flushNow = false;
+    {
+        std::lock_guard<std::mutex> l(pushQueueLock_);
+        if (pushQueue_.size() >= pushQueueSize_) {
+            // the gateway can't keep up
+            {
+                std::lock_guard lk(pushStatsMutex_);
+                if (auto stats = getPushStats(type))
+                    stats->droppedCount++;
+            }
+            if (logger_)
+                logger_->w("[proxy:server] [notification] queue full (%zu), dropping notification", pushQueue_.size());
+            return;
+        }
+        pushQueue_.emplace_back(std::move(push));
+        {
+            std::lock_guard lk(pushStatsMutex_);
+            if (auto stats = getPushStats(type))
+                stats->queueDepth++;
+        }
+        if (pushQueue_.size() == pushBatchSize_) {
+            flushNow = true;
+        } else if (not pushFlushScheduled_) {
+            pushFlushScheduled_ = true;
+            pushFlushTimer_->expires_after(PUSH_BATCH_DELAY);
+            pushFlushTimer_->async_wait([this](const asio::error_code& ec){
+                if (ec != asio::error::operation_aborted)
+                    flushPushNotifications();
+            });
+        }
+    }
+    if (flushNow)
+        asio::post(*ioContext_, [this]{ flushPushNotifications(); });
+}
+
+void
+DhtProxyServer::flushPushNotifications()
+{
+    std::vector<std::vector<PendingPush>> batches;
+    {
+        std::lock_guard<std::mutex> l(pushQueueLock_);
+        pushFlushScheduled_ = false;
+        while (not pushQueue_.empty() and pushInflight_ < pushMaxInflight_) {
+            auto end = pushQueue_.begin() + std::min(pushQueue_.size(), pushBatchSize_);
+            batches.emplace_back(std::make_move_iterator(pushQueue_.begin()), std::make_move_iterator(end));
+            pushQueue_.erase(pushQueue_.begin(), end);
+            pushInflight_++;
+        }
+    }
+    for (auto& batch : batches)
+        sendPushBatch(std::move(batch));
+}
+
+void
+DhtProxyServer::sendPushBatch(std::vector<PendingPush>&& batch)
+{
+    std::set<PushType> types;
+    {
+        // For monitoring purposes
+        std::lock_guard lk(pushStatsMutex_);
+        for (const auto& push : batch) {
+            if (auto stats = getPushStats(push.type)) {
+                stats->queueDepth--;
+                stats->increment(push.highPriority);
+            }
+            types.emplace(push.type);
+        }
+    }
+
+    Json::Value notifications(Json::arrayValue);
+    std::map<std::string, Json::ArrayIndex> notificationIndex;
+    for (auto& push : batch) {
+        // The send time ("t" and "expiration") doesn't matter when merging.
+        // "to" and "s" identify the recipient, so only notifications for the
+        // same client session actually share a gorush entry.
+        Json::Value mergeKey = push.notification;
+        mergeKey.removeMember("expiration");
+        mergeKey["data"].removeMember("t");
+        auto it = notificationIndex.emplace(Json::writeString(jsonBuilder_, mergeKey), notifications.size());
+        if (it.second) {
+            Json::Value tokens(Json::arrayValue);
+            tokens.append(std::move(push.token));
+            push.notification["tokens"] = std::move(tokens);
+            notifications.append(std::move(push.notification));
+        } else {
+            notifications[it.first->second]["tokens"].append(std::move(push.token));
+        }
+    }
+    Json::Value content;
+    content["notifications"] = std::move(notifications);
+
+    unsigned reqid = 0;
+    try {
+        auto request = std::make_shared<http::Request>(io_context(), pushHostPort_.first, pushHostPort_.second, pushHostPort_.first.find("https://") == 0, logger_);
+        reqid = request->id();
+        request->set_connection_pool(pushConnectionPool_);
+        request->set_target("/api/push");
+        request->set_method(restinio::http_method_post());
+        request->set_header_field(restinio::http_field_t::host, pushServer_.c_str());
+        request->set_header_field(restinio::http_field_t::user_agent, "RESTinio client");
+        request->set_header_field(restinio::http_field_t::accept, "*/*");
+        request->set_header_field(restinio::http_field_t::content_type, "application/json");
+        request->set_body(Json::writeString(jsonBuilder_, content));
+
+        request->add_on_state_change_callback([this, reqid, types = std::move(types), count = batch.size(), start = clock::now()]
+                                              (http::Request::State state, const http::Response& response){
+            if (state == http::Request::State::DONE){
+                auto latency = clock::now() - start;
+                if (logger_ and response.status_code != 200)
+                    logger_->e("[proxy:server] [notification] push failed for %zu notifications: %i", count, response.status_code);
+                {
+                    std::lock_guard<std::mutex> l(requestLock_);
+                    requests_.erase(reqid);
+                }
+                {
+                    std::lock_guard lk(pushStatsMutex_);
+                    for (auto type : types)
+                        if (auto stats = getPushStats(type))
+                            stats->addBatch(latency);
+                }
+                {
+                    std::lock_guard<std::mutex> l(pushQueueLock_);
+                    pushInflight_--;
+                }
+                flushPushNotifications();
+            }
+        });
+        {
+            std::lock_guard<std::mutex> l(requestLock_);
+            requests_[reqid] = request;
         }
+        request->send();
     }
     catch (const std::exception &e){
         if (logger_)
@@ -1189,6 +1631,12 @@ DhtProxyServer::sendPushNotification(const std::string& token, Json::Value&& jso
             std::lock_guard<std::mutex> l(requestLock_);
             requests_.erase(reqid);
         }
+        {
+            std::lock_guard<std::mutex> l(pushQueueLock_);
+            pushInflight_--;
+        }
+        // we are called from flushPushNotifications
+        asio::post(*ioContext_, [this]{ flushPushNotifications(); });
     }
 }
 
@@ -1229,6 +1677,7 @@ DhtProxyServer::put(restinio::request_handle_t request,
                     restinio::router::route_params_t params)
 {
     requestNum_++;
+    metrics_->putRequests.inc();
     InfoHash infoHash(params["hash"]);
     if (!infoHash)
         infoHash = InfoHash::get(params["hash"]);
@@ -1239,129 +1688,163 @@ DhtProxyServer::put(restinio::request_handle_t request,
         return response.done();
     }
 
+    auto format = getValueFormat(*request);
     try {
-        std::string err;
-        Json::Value root;
+        Sp<Value> value;
+        bool permanent = false;
+        // permanent put parameters
+        Json::Value pVal;
         auto* char_data = reinterpret_cast<const char*>(request->body().data());
-        auto reader = std::unique_ptr<Json::CharReader>(jsonReaderBuilder_.newCharReader());
-
-        if (reader->parse(char_data, char_data + request->body().size(), &root, &err)){
-            auto value = std::make_shared<Value>(root);
-            bool permanent = root.isMember("permanent");
-            if (logger_)
-                logger_->d("[proxy:server] [put %s] %s %s", infoHash.toString().c_str(),
-                          value->toString().c_str(), (permanent ? "permanent" : ""));
-            if (permanent) {
-                std::string pushToken, clientId, sessionId, platform, topic;
-                auto& pVal = root["permanent"];
-                if (pVal.isObject()){
-                    pushToken = pVal["key"].asString();
-                    clientId = pVal["client_id"].asString();
-                    platform = pVal["platform"].asString();
-                    sessionId = pVal["session_id"].asString();
-                    topic = pVal["topic"].asString();
+        auto contentType = request->header().get_field_or(restinio::http_field::content_type, "");
+        if (contentType.find(proxy::CONTENT_TYPE_MSGPACK) != std::string::npos) {
+            try {
+                auto oh = msgpack::unpack(char_data, request->body().size());
+                const auto& root = oh.get();
+                auto rvalue = findMapValue(root, "value"sv);
+                if (not rvalue)
+                    throw msgpack::type_error();
+                value = std::make_shared<Value>(*rvalue);
+                if (auto rpermanent = findMapValue(root, "permanent"sv)) {
+                    permanent = true;
+                    if (rpermanent->type == msgpack::type::MAP) {
+                        for (const auto& kv : rpermanent->via.map)
+                            pVal[kv.key.as<std::string>()] = kv.val.as<std::string>();
+                    }
                 }
-                std::lock_guard<std::mutex> lock(lockSearchPuts_);
-                auto timeout = std::chrono::steady_clock::now() + proxy::OP_TIMEOUT;
-                auto& sPuts = puts_[infoHash];
-                if (value->id == Value::INVALID_ID) {
-                    for (auto& pp : sPuts.puts) {
-                        if (pp.second.pushToken == pushToken
-                            and pp.second.clientId == clientId
-                            and pp.second.value->contentEquals(*value))
-                        {
-                            pp.second.expireTimer->expires_at(timeout);
-                            pp.second.expireTimer->async_wait(std::bind(&DhtProxyServer::handleCancelPermamentPut, this,
-                                                        std::placeholders::_1, infoHash, pp.second.value->id));
-                            if (not sessionId.empty()) {
-                                if (not pp.second.sessionCtx)
-                                    pp.second.sessionCtx = std::make_shared<PushSessionContext>(sessionId);
-                                else {
-                                    std::lock_guard<std::mutex> l(pp.second.sessionCtx->lock);
-                                    pp.second.sessionCtx->sessionId = sessionId;
-                                }
+            } catch (const std::exception& e) {
+                auto response = initHttpResponse(request->create_response(restinio::status_bad_request()));
+                response.set_body(RESP_MSG_MSGPACK_INCORRECT);
+                return response.done();
+            }
+        } else {
+            std::string err;
+            Json::Value root;
+            auto reader = std::unique_ptr<Json::CharReader>(jsonReaderBuilder_.newCharReader());
+            if (!reader->parse(char_data, char_data + request->body().size(), &root, &err)) {
+                auto response = initHttpResponse(request->create_response(restinio::status_bad_request()));
+                response.set_body(RESP_MSG_JSON_INCORRECT);
+                return response.done();
+            }
+            value = std::make_shared<Value>(root);
+            permanent = root.isMember("permanent");
+            pVal = root["permanent"];
+        }
+        if (logger_)
+            logger_->d("[proxy:server] [put %s] %s %s", infoHash.toString().c_str(),
+                      value->toString().c_str(), (permanent ? "permanent" : ""));
+        if (permanent) {
+            auto overloaded = sessionMemoryExceeded();
+            std::string pushToken, clientId, sessionId, platform, topic;
+            if (pVal.isObject()){
+                pushToken = pVal["key"].asString();
+                clientId = pVal["client_id"].asString();
+                platform = pVal["platform"].asString();
+                sessionId = pVal["session_id"].asString();
+                topic = pVal["topic"].asString();
+            }
+            std::lock_guard<std::mutex> lock(lockSearchPuts_);
+            auto timeout = std::chrono::steady_clock::now() + proxy::OP_TIMEOUT;
+            auto& sPuts = puts_[infoHash];
+            if (value->id == Value::INVALID_ID) {
+                for (auto& pp : sPuts.puts) {
+                    if (pp.second.pushToken == pushToken
+                        and pp.second.clientId == clientId
+                        and pp.second.value->contentEquals(*value))
+                    {
+                        pp.second.expireTimer->expires_at(timeout);
+                        pp.second.expireTimer->async_wait(std::bind(&DhtProxyServer::handleCancelPermamentPut, this,
+                                                    std::placeholders::_1, infoHash, pp.second.value->id));
+                        if (not sessionId.empty()) {
+                            if (not pp.second.sessionCtx)
+                                pp.second.sessionCtx = std::make_shared<PushSessionContext>(sessionId);
+                            else {
+                                std::lock_guard<std::mutex> l(pp.second.sessionCtx->lock);
+                                pp.second.sessionCtx->sessionId = sessionId;
                             }
-                            auto response = initHttpResponse(request->create_response());
-                            response.append_body(Json::writeString(jsonBuilder_, pp.second.value->toJson()) + "\n");
-                            return response.done();
                         }
+                        auto response = initHttpResponse(request->create_response(), format);
+                        response.append_body(*getSerializedValue(pp.second.value, false, format));
+                        return response.done();
                     }
-                    value->id = std::uniform_int_distribution<Value::Id>{1}(rd);
                 }
+                value->id = std::uniform_int_distribution<Value::Id>{1}(rd);
+            }
 
-                auto vid = value->id;
-                auto& pput = sPuts.puts[vid];
-                pput.value = value;
-                pput.expiration = timeout;
-                if (not pput.expireTimer) {
-                    // cancel permanent put
-                    pput.expireTimer = std::make_unique<asio::steady_timer>(io_context(), timeout);
+            auto vid = value->id;
+            if (overloaded and sPuts.puts.find(vid) == sPuts.puts.end()) {
+                // only refreshes of existing permanent puts are accepted
+                if (sPuts.puts.empty())
+                    puts_.erase(infoHash);
+                return serverOverloaded(*request);
+            }
+            auto& pput = sPuts.puts[vid];
+            pput.value = value;
+            pput.expiration = timeout;
+            if (not pput.expireTimer) {
+                // cancel permanent put
+                pput.expireTimer = std::make_unique<asio::steady_timer>(io_context(), timeout);
 #ifdef OPENDHT_PUSH_NOTIFICATIONS
-                    if (not pushToken.empty()) {
-                        pput.pushToken = pushToken;
-                        pput.clientId = clientId;
-                        pput.type = getTypeFromString(platform);
-                        if (topic.empty())
-                            topic = getDefaultTopic(pput.type);
-                        pput.topic = topic;
-                        pput.sessionCtx = std::make_shared<PushSessionContext>(sessionId);
-                    }
+                if (not pushToken.empty()) {
+                    pput.pushToken = pushToken;
+                    pput.clientId = clientId;
+                    pput.type = getTypeFromString(platform);
+                    if (topic.empty())
+                        topic = getDefaultTopic(pput.type);
+                    pput.topic = topic;
+                    pput.sessionCtx = std::make_shared<PushSessionContext>(sessionId);
+                }
 #endif
-                } else {
-                    if (not sessionId.empty()) {
-                        if (not pput.sessionCtx)
-                            pput.sessionCtx = std::make_shared<PushSessionContext>(sessionId);
-                        else {
-                            std::lock_guard<std::mutex> l(pput.sessionCtx->lock);
-                            pput.sessionCtx->sessionId = sessionId;
-                        }
+            } else {
+                if (not sessionId.empty()) {
+                    if (not pput.sessionCtx)
+                        pput.sessionCtx = std::make_shared<PushSessionContext>(sessionId);
+                    else {
+                        std::lock_guard<std::mutex> l(pput.sessionCtx->lock);
+                        pput.sessionCtx->sessionId = sessionId;
                     }
-                    pput.expireTimer->expires_at(timeout);
                 }
-                pput.expireTimer->async_wait(std::bind(&DhtProxyServer::handleCancelPermamentPut, this,
-                                                std::placeholders::_1, infoHash, vid));
+                pput.expireTimer->expires_at(timeout);
+            }
+            pput.expireTimer->async_wait(std::bind(&DhtProxyServer::handleCancelPermamentPut, this,
+                                            std::placeholders::_1, infoHash, vid));
 
 #ifdef OPENDHT_PUSH_NOTIFICATIONS
-                // notify put permanent expiration
-                if (pput.sessionCtx) {
-                    auto jsonProvider = [infoHash, clientId, vid, sessionCtx = pput.sessionCtx](){
-                        Json::Value json;
-                        json["timeout"] = infoHash.toString();
-                        json["to"] = clientId;
-                        json["vid"] = std::to_string(vid);
-                        std::lock_guard<std::mutex> l(sessionCtx->lock);
-                        json["s"] = sessionCtx->sessionId;
-                        return json;
-                    };
-                    if (!pput.expireNotifyTimer)
-                        pput.expireNotifyTimer = std::make_unique<asio::steady_timer>(io_context(),
-                                                    timeout - proxy::OP_MARGIN);
-                    else
-                        pput.expireNotifyTimer->expires_at(timeout - proxy::OP_MARGIN);
-                    pput.expireNotifyTimer->async_wait(std::bind(
-                        &DhtProxyServer::handleNotifyPushListenExpire, this,
-                        std::placeholders::_1, pushToken, std::move(jsonProvider), pput.type, pput.topic));
-                }
-#endif
+            // notify put permanent expiration
+            if (pput.sessionCtx) {
+                auto jsonProvider = [infoHash, clientId, vid, sessionCtx = pput.sessionCtx](){
+                    Json::Value json;
+                    json["timeout"] = infoHash.toString();
+                    json["to"] = clientId;
+                    json["vid"] = std::to_string(vid);
+                    std::lock_guard<std::mutex> l(sessionCtx->lock);
+                    json["s"] = sessionCtx->sessionId;
+                    return json;
+                };
+                if (!pput.expireNotifyTimer)
+                    pput.expireNotifyTimer = std::make_unique<asio::steady_timer>(io_context(),
+                                                timeout - proxy::OP_MARGIN);
+                else
+                    pput.expireNotifyTimer->expires_at(timeout - proxy::OP_MARGIN);
+                pput.expireNotifyTimer->async_wait(std::bind(
+                    &DhtProxyServer::handleNotifyPushListenExpire, this,
+                    std::placeholders::_1, pushToken, std::move(jsonProvider), pput.type, pput.topic));
             }
-
-            dht_->put(infoHash, value, [this, request, value](bool ok){
-                if (ok){
-                    auto response = initHttpResponse(request->create_response());
-                    response.append_body(Json::writeString(jsonBuilder_, value->toJson()) + "\n");
-                    response.done();
-                } else {
-                    auto response = initHttpResponse(request->create_response(restinio::status_bad_gateway()));
-                    response.set_body(RESP_MSG_PUT_FAILED);
-                    response.done();
-                }
-            }, time_point::max(), permanent);
-            return restinio::request_handling_status_t::accepted;
-        } else {
-            auto response = initHttpResponse(request->create_response(restinio::status_bad_request()));
-            response.set_body(RESP_MSG_JSON_INCORRECT);
-            return response.done();
+#endif
         }
+
+        dht_->put(infoHash, value, [this, request, value, format, start = clock::now()](bool ok){
+            metrics_->putDuration.observe(clock::now() - start);
+            if (ok){
+                auto response = initHttpResponse(request->create_response(), format);
+                response.append_body(*getSerializedValue(value, false, format));
+                response.done();
+            } else {
+                auto response = initHttpResponse(request->create_response(restinio::status_bad_gateway()));
+                response.set_body(RESP_MSG_PUT_FAILED);
+                response.done();
+            }
+        }, time_point::max(), permanent);
+        return restinio::request_handling_status_t::accepted;
     } catch (const std::exception& e){
         if (logger_)
             logger_->d("[proxy:server] error in put: %s", e.what());
@@ -1509,7 +1992,7 @@ DhtProxyServer::getFiltered(restinio::request_handle_t request,
         response->flush();
         dht_->get(infoHash,
             [this, response](const Sp<Value>& value) {
-                response->append_chunk(Json::writeString(jsonBuilder_, value->toJson()) + "\n");
+                response->append_chunk(getSerializedValue(value));
                 response->flush();
                 return true;
             },
@@ -25,6 +25,7 @@
 #include "dhtrunner.h"
 #include "securedht.h"
 #include "network_utils.h"
+#include "trace_span.h"
 #ifdef OPENDHT_PEER_DISCOVERY
 #include "peer_discovery.h"
 #endif
@@ -33,6 +34,8 @@
 #endif
 
 #include <fstream>
+#include <algorithm>
+#include <numeric>
 
 namespace dht {
 
@@ -47,6 +50,20 @@ struct NodeInsertionPack {
     MSGPACK_DEFINE(nodeId, port, net)
 };
 
+struct DhtRunner::RxMetrics {
+    metrics::Gauge& queueSize;
+    metrics::Counter& droppedFull;
+    metrics::Counter& droppedDelay;
+    metrics::Histogram& queueDelay;
+
+    RxMetrics(metrics::Registry& r) :
+        queueSize(r.gauge("dht_rx_queue_packets", "Received packets waiting to be processed")),
+        droppedFull(r.counter("dht_rx_dropped_total", "Received packets dropped by the runner", {{"reason", "queue_full"}})),
+        droppedDelay(r.counter("dht_rx_dropped_total", "Received packets dropped by the runner", {{"reason", "delay"}})),
+        queueDelay(r.histogram("dht_rx_queue_delay_seconds", "Time spent by received packets in the queue"))
+    {}
+};
+
 DhtRunner::DhtRunner() : dht_()
 {
 #ifdef _WIN32
@@ -142,7 +159,13 @@ DhtRunner::run(const Config& config, Context&& context)
         identityAnnouncedCb_ = context.identityAnnouncedCb;
 #endif
 
+        if (context.metrics or not metrics_) {
+            metrics_ = context.metrics ? std::move(context.metrics) : std::make_shared<metrics::Registry>();
+            rxMetrics_ = std::make_unique<RxMetrics>(*metrics_);
+        }
+
         if (config.proxy_server.empty()) {
+            rcv_max_memory = config.max_rx_queue_memory;
             if (not context.sock) {
                 context.sock.reset(new net::UdpSocket(local4, local6, context.logger));
             }
@@ -150,16 +173,24 @@ DhtRunner::run(const Config& config, Context&& context)
                 net::PacketList ret;
                 {
                     std::lock_guard<std::mutex> lck(sock_mtx);
+                    for (const auto& pkt : pkts)
+                        rcv_memory += pkt.memoryUsage();
                     rcv.splice(rcv.end(), std::move(pkts));
                     size_t dropped = 0;
-                    while (rcv.size() > net::RX_QUEUE_MAX_SIZE) {
+                    while (rcv.size() > net::RX_QUEUE_MAX_SIZE or (rcv_memory > rcv_max_memory and not rcv.empty())) {
+                        rcv_memory -= std::min(rcv_memory, rcv.front().memoryUsage());
                         rcv.pop_front();
                         dropped++;
                     }
-                    if (dropped and logger_) {
-                        logger_->w("[runner %p] dropped %zu packets: queue is full!", fmt::ptr(this), dropped);
+                    if (dropped) {
+                        rxMetrics_->droppedFull.inc(dropped);
+                        if (logger_)
+                            logger_->w("[runner %p] dropped %zu packets: queue is full!", fmt::ptr(this), dropped);
                     }
+                    rxMetrics_->queueSize.set(rcv.size());
                     ret = std::move(rcv_free);
+                    rcv_free.clear();
+                    rcv_free_memory = 0;
                 }
                 cv.notify_all();
                 return ret;
@@ -191,6 +222,7 @@ DhtRunner::run(const Config& config, Context&& context)
     if (context.publicAddressChangedCb) {
         dht_->setOnPublicAddressChanged(std::move(context.publicAddressChangedCb));
     }
+    dht_->setMetrics(metrics_);
 
     if (not config.threaded)
         return;
@@ -332,6 +364,29 @@ DhtRunner::bindOpDoneCallback(DoneCallbackSimple&& cb) {
     };
 }
 
+std::function<void(const InfoHash&, bool)>
+DhtRunner::bindManyDoneCallback(size_t count, DoneManyCallback&& cb) {
+    struct State {
+        std::mutex lock;
+        size_t remaining;
+        std::vector<InfoHash> failed;
+        DoneManyCallback cb;
+    };
+    auto state = std::make_shared<State>();
+    state->remaining = count;
+    state->cb = std::move(cb);
+    return [this, state](const InfoHash& key, bool ok) {
+        std::unique_lock<std::mutex> lk(state->lock);
+        if (not ok)
+            state->failed.emplace_back(key);
+        if (--state->remaining)
+            return;
+        lk.unlock();
+        if (state->cb) state->cb(state->failed.empty(), state->failed);
+        opEnded();
+    };
+}
+
 bool
 DhtRunner::checkShutdown() {
     decltype(shutdownCallbacks_) cbs;
@@ -521,12 +576,17 @@ DhtRunner::getNodeInfo() const {
         info.node_id = dht_->getNodeId();
         info.ipv4 = dht_->getNodesStats(AF_INET);
         info.ipv6 = dht_->getNodesStats(AF_INET6);
+        info.memory = dht_->getMemoryStats();
         if (auto sock = dht_->getSocket()) {
             info.bound4 = sock->getBoundRef(AF_INET).getPort();
             info.bound6 = sock->getBoundRef(AF_INET6).getPort();
         }
     }
     info.ongoing_ops = ongoing_ops;
+    {
+        std::lock_guard<std::mutex> lck(sock_mtx);
+        info.memory.rx_queue = rcv_memory + rcv_free_memory;
+    }
     return info;
 }
 
@@ -543,11 +603,16 @@ DhtRunner::getNodeInfo(std::function<void(std::shared_ptr<NodeInfo>)> cb)
         info.ipv4 = dht.getNodesStats(AF_INET);
         info.ipv6 = dht.getNodesStats(AF_INET6);
         std::tie(info.storage_size, info.storage_values) = dht.getStoreSize();
+        info.memory = dht.getMemoryStats();
         if (auto sock = dht.getSocket()) {
             info.bound4 = sock->getBoundRef(AF_INET).getPort();
             info.bound6 = sock->getBoundRef(AF_INET6).getPort();
         }
         info.ongoing_ops = ongoing_ops;
+        {
+            std::lock_guard<std::mutex> lck(sock_mtx);
+            info.memory.rx_queue = rcv_memory + rcv_free_memory;
+        }
         cb(std::move(sinfo));
         opEnded();
     });
@@ -633,6 +698,23 @@ DhtRunner::setLocalCertificateStore(CertificateStoreQuery&& query_method) {
         dht_->setLocalCertificateStore(std::forward<CertificateStoreQuery>(query_method));
 }
 
+void
+DhtRunner::setIdentity(const crypto::Identity& identity) {
+    std::lock_guard<std::mutex> lck(dht_mtx);
+    if (not dht_)
+        throw std::runtime_error("dht is not running");
+    dht_->setIdentity(identity);
+#ifdef OPENDHT_PROXY_CLIENT
+    config_.dht_config.id = identity;
+#endif
+}
+
+LookupCacheStats
+DhtRunner::getCertificateCacheStats() const {
+    std::lock_guard<std::mutex> lck(dht_mtx);
+    return dht_ ? dht_->getCertificateCacheStats() : LookupCacheStats{};
+}
+
 time_point
 DhtRunner::loop_()
 {
@@ -658,6 +740,9 @@ DhtRunner::loop_()
         std::lock_guard<std::mutex> lck(sock_mtx);
         // move to stack
         received = std::move(rcv);
+        rcv.clear();
+        rcv_memory = 0;
+        rxMetrics_->queueSize.set(0);
     }
 
     // Discard old packets
@@ -677,6 +762,7 @@ DhtRunner::loop_()
     if (not received.empty()) {
         for (auto& pkt : received) {
             auto now = clock::now();
+            rxMetrics_->queueDelay.observe(now - pkt.received);
             if (now - pkt.received > net::RX_QUEUE_MAX_DELAY)
                 dropped++;
             else
@@ -690,13 +776,21 @@ DhtRunner::loop_()
     }
 
     if (not received_treated.empty()) {
+        size_t treated_memory {0};
+        for (const auto& pkt : received_treated)
+            treated_memory += pkt.memoryUsage();
         std::lock_guard<std::mutex> lck(sock_mtx);
-        if (rcv_free.size() < net::RX_QUEUE_MAX_SIZE)
+        if (rcv_free.size() < net::RX_QUEUE_MAX_SIZE and rcv_free_memory + treated_memory <= rcv_max_memory) {
             rcv_free.splice(rcv_free.end(), std::move(received_treated));
+            rcv_free_memory += treated_memory;
+        }
     }
 
-    if (dropped && logger_)
-        logger_->e("[runner %p] Dropped %zu packets with high delay.", fmt::ptr(this), dropped);
+    if (dropped) {
+        rxMetrics_->droppedDelay.inc(dropped);
+        if (logger_)
+            logger_->e("[runner %p] Dropped %zu packets with high delay.", fmt::ptr(this), dropped);
+    }
 
     NodeStatus nstatus4 = dht_->updateStatus(AF_INET);
     NodeStatus nstatus6 = dht_->updateStatus(AF_INET6);
@@ -721,12 +815,44 @@ DhtRunner::get(InfoHash hash, GetCallback vcb, DoneCallback dcb, Value::Filter f
         return;
     }
     ongoing_ops++;
-    pending_ops.emplace([=](SecureDht& dht) mutable {
+    pending_ops.emplace([=, op = trace::Enqueued()](SecureDht& dht) mutable {
+        trace::Dequeued dequeued(op);
         dht.get(hash, std::move(vcb), bindOpDoneCallback(std::move(dcb)), std::move(f), std::move(w));
     });
     cv.notify_all();
 }
 
+void
+DhtRunner::getMany(std::vector<InfoHash> keys, KeyedGetCallback vcb, DoneManyCallback dcb, Value::Filter f, Where w)
+{
+    std::unique_lock<std::mutex> lck(storage_mtx);
+    if (running != State::Running) {
+        lck.unlock();
+        if (dcb) dcb(false, keys);
+        return;
+    }
+    if (keys.empty()) {
+        lck.unlock();
+        if (dcb) dcb(true, {});
+        return;
+    }
+    ongoing_ops++;
+    pending_ops.emplace([=, keys = std::move(keys), dcb = std::move(dcb)](SecureDht& dht) mutable {
+        // Neighbour keys are searched in sequence so that the first one
+        // of each region leads node discovery for the others.
+        std::sort(keys.begin(), keys.end());
+        auto onDone = bindManyDoneCallback(keys.size(), std::move(dcb));
+        for (const auto& key : keys) {
+            dht.get(key, [vcb, key](const std::vector<Sp<Value>>& values) {
+                return vcb(key, values);
+            }, DoneCallback([onDone, key](bool ok, const std::vector<Sp<Node>>&) {
+                onDone(key, ok);
+            }), Value::Filter(f), Where(w));
+        }
+    });
+    cv.notify_all();
+}
+
 void
 DhtRunner::get(const std::string& key, GetCallback vcb, DoneCallbackSimple dcb, Value::Filter f, Where w)
 {
@@ -770,6 +896,35 @@ DhtRunner::listen(const std::string& key, GetCallback vcb, Value::Filter f, Wher
     return listen(InfoHash::get(key), std::move(vcb), std::move(f), std::move(w));
 }
 
+std::future<std::vector<size_t>>
+DhtRunner::listenMany(std::vector<InfoHash> keys, KeyedValueCallback vcb, Value::Filter f, Where w)
+{
+    auto ret_tokens = std::make_shared<std::promise<std::vector<size_t>>>();
+    std::unique_lock<std::mutex> lck(storage_mtx);
+    if (running != State::Running) {
+        lck.unlock();
+        ret_tokens->set_value(std::vector<size_t>(keys.size(), 0));
+        return ret_tokens->get_future();
+    }
+    pending_ops.emplace([=, keys = std::move(keys)](SecureDht& dht) mutable {
+        std::vector<size_t> order(keys.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return keys[a] < keys[b];
+        });
+        std::vector<size_t> tokens(keys.size());
+        for (auto i : order) {
+            const auto& key = keys[i];
+            tokens[i] = dht.listen(key, [vcb, key](const std::vector<Sp<Value>>& values, bool expired) {
+                return vcb(key, values, expired);
+            }, f, w);
+        }
+        ret_tokens->set_value(std::move(tokens));
+    });
+    cv.notify_all();
+    return ret_tokens->get_future();
+}
+
 void
 DhtRunner::cancelListen(InfoHash h, size_t token)
 {
@@ -810,8 +965,10 @@ DhtRunner::put(InfoHash hash, Value&& value, DoneCallback cb, time_point created
     ongoing_ops++;
     pending_ops.emplace([=,
         cb = std::move(cb),
-        sv = std::make_shared<Value>(std::move(value))
+        sv = std::make_shared<Value>(std::move(value)),
+        op = trace::Enqueued()
     ] (SecureDht& dht) mutable {
+        trace::Dequeued dequeued(op);
         dht.put(hash, sv, bindOpDoneCallback(std::move(cb)), created, permanent);
     });
     cv.notify_all();
@@ -827,7 +984,8 @@ DhtRunner::put(InfoHash hash, std::shared_ptr<Value> value, DoneCallback cb, tim
         return;
     }
     ongoing_ops++;
-    pending_ops.emplace([=, value = std::move(value), cb = std::move(cb)](SecureDht& dht) mutable {
+    pending_ops.emplace([=, value = std::move(value), cb = std::move(cb), op = trace::Enqueued()](SecureDht& dht) mutable {
+        trace::Dequeued dequeued(op);
         dht.put(hash, value, bindOpDoneCallback(std::move(cb)), created, permanent);
     });
     cv.notify_all();
@@ -839,6 +997,58 @@ DhtRunner::put(const std::string& key, Value&& value, DoneCallbackSimple cb, tim
     put(InfoHash::get(key), std::forward<Value>(value), std::move(cb), created, permanent);
 }
 
+void
+DhtRunner::cancelListen(std::vector<InfoHash> keys, std::shared_future<std::vector<size_t>> ftokens)
+{
+    std::lock_guard<std::mutex> lck(storage_mtx);
+    if (running != State::Running)
+        return;
+    ongoing_ops++;
+    pending_ops.emplace([this, keys = std::move(keys), ftokens = std::move(ftokens)](SecureDht& dht) {
+        const auto& tokens = ftokens.get();
+        for (size_t i = 0; i < keys.size() and i < tokens.size(); i++)
+            dht.cancelListen(keys[i], tokens[i]);
+        opEnded();
+    });
+    cv.notify_all();
+}
+
+void
+DhtRunner::putMany(std::vector<std::pair<InfoHash, std::shared_ptr<Value>>> values, DoneManyCallback cb, time_point created, bool permanent)
+{
+    std::unique_lock<std::mutex> lck(storage_mtx);
+    if (running != State::Running) {
+        lck.unlock();
+        if (cb) {
+            std::vector<InfoHash> failed;
+            failed.reserve(values.size());
+            for (const auto& v : values)
+                failed.emplace_back(v.first);
+            cb(false, failed);
+        }
+        return;
+    }
+    if (values.empty()) {
+        lck.unlock();
+        if (cb) cb(true, {});
+        return;
+    }
+    ongoing_ops++;
+    pending_ops.emplace([=, values = std::move(values), cb = std::move(cb)](SecureDht& dht) mutable {
+        std::stable_sort(values.begin(), values.end(), [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+        auto onDone = bindManyDoneCallback(values.size(), std::move(cb));
+        for (auto& v : values) {
+            const auto& key = v.first;
+            dht.put(key, std::move(v.second), DoneCallback([onDone, key](bool ok, const std::vector<Sp<Node>>&) {
+                onDone(key, ok);
+            }), created, permanent);
+        }
+    });
+    cv.notify_all();
+}
+
 void
 DhtRunner::cancelPut(const InfoHash& h, Value::Id id)
 {
@@ -33,6 +33,7 @@
 #include <openssl/x509.h>
 #include <openssl/x509_vfy.h>
 
+#include <algorithm>
 #include <cctype>
 #include <iomanip>
 #include <sstream>
@@ -440,6 +441,7 @@ void
 Connection::set_ssl_verification(const std::string& hostname, const asio::ssl::verify_mode verify_mode)
 {
     std::lock_guard<std::mutex> lock(mutex_);
+    hostname_ = hostname;
     if (ssl_socket_) {
         // Set SNI Hostname (many hosts need this to handshake successfully)
         SSL_set_tlsext_host_name(ssl_socket_->asio_ssl_stream().native_handle(), hostname.c_str());
@@ -494,6 +496,44 @@ Connection::set_ssl_verification(const std::string& hostname, const asio::ssl::v
     }
 }
 
+static int
+sessionExIndex()
+{
+    static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+void
+Connection::set_session_cache(std::shared_ptr<TlsSessionCache> cache)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (not ssl_socket_)
+        return;
+    sessionCache_ = std::move(cache);
+    auto ssl = ssl_socket_->asio_ssl_stream().native_handle();
+    if (sessionCache_) {
+        // TLS 1.3 sessions are only available after the handshake, when the server sends its tickets:
+        // get them from the callback rather than after the handshake.
+        auto ctx = ssl_ctx_->native_handle();
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx, &Connection::onNewSession);
+        SSL_set_ex_data(ssl, sessionExIndex(), this);
+    } else {
+        SSL_set_ex_data(ssl, sessionExIndex(), nullptr);
+    }
+}
+
+int
+Connection::onNewSession(SSL* ssl, SSL_SESSION* session)
+{
+    auto conn = static_cast<Connection*>(SSL_get_ex_data(ssl, sessionExIndex()));
+    if (not conn or not conn->sessionCache_ or conn->sessionKey_.empty())
+        return 0;
+    // returning 1 transfers the session reference to us
+    conn->sessionCache_->set(conn->sessionKey_, std::shared_ptr<SSL_SESSION>(session, &SSL_SESSION_free));
+    return 1;
+}
+
 asio::streambuf&
 Connection::input()
 {
@@ -535,6 +575,7 @@ Connection::async_connect(std::vector<asio::ip::tcp::endpoint>&& endpoints, Conn
 #pragma GCC diagnostic ignored "-Wunused-variable"
     ConnectHandlerCb wcb = [this, &base, cb=std::move(cb)](const asio::error_code& ec, const asio::ip::tcp::endpoint& endpoint) {
         if (!ec) {
+            endpoint_ = endpoint;
             local_address_ = base.local_endpoint().address();
             // Once connected, set a keep alive on the TCP socket with 30 seconds delay
             // This will generate broken pipes as soon as possible.
@@ -557,6 +598,11 @@ Connection::async_handshake(HandlerCb cb)
 {
     std::lock_guard<std::mutex> lock(mutex_);
     if (ssl_socket_) {
+        if (sessionCache_) {
+            sessionKey_ = hostname_ + ":" + std::to_string(endpoint_.port());
+            if (auto session = sessionCache_->get(sessionKey_))
+                SSL_set_session(ssl_socket_->asio_ssl_stream().native_handle(), session.get());
+        }
         std::weak_ptr<Connection> wthis = shared_from_this();
         ssl_socket_->async_handshake(asio::ssl::stream<asio::ip::tcp::socket>::client,
                                     [wthis, cb](const asio::error_code& ec)
@@ -565,7 +611,14 @@ Connection::async_handshake(HandlerCb cb)
                 return;
             if (auto sthis = wthis.lock()) {
                 auto& this_ = *sthis;
-                auto verify_ec = SSL_get_verify_result(this_.ssl_socket_->asio_ssl_stream().native_handle());
+                auto ssl = this_.ssl_socket_->asio_ssl_stream().native_handle();
+                if (this_.sessionCache_) {
+                    if (not ec)
+                        this_.sessionCache_->onHandshake(SSL_session_reused(ssl));
+                    else
+                        this_.sessionCache_->erase(this_.sessionKey_);
+                }
+                auto verify_ec = SSL_get_verify_result(ssl);
                 if (this_.logger_) {
                     if (verify_ec == X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT /*18*/
                         || verify_ec == X509_V_ERR_SELF_SIGNED_CERT_IN_CHAIN /*19*/)
@@ -719,6 +772,12 @@ Connection::local_address() const
     return local_address_;
 }
 
+const asio::ip::tcp::endpoint&
+Connection::endpoint() const
+{
+    return endpoint_;
+}
+
 void
 Connection::timeout(const std::chrono::seconds& timeout, HandlerCb cb)
 {
@@ -858,6 +917,241 @@ Resolver::resolve(const std::string& host, const std::string& serviceName)
     });
 }
 
+// TlsSessionCache
+
+std::shared_ptr<SSL_SESSION>
+TlsSessionCache::get(const std::string& host) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(host);
+    if (it == sessions_.end())
+        return {};
+    return it->second;
+}
+
+void
+TlsSessionCache::set(const std::string& host, std::shared_ptr<SSL_SESSION> session)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (maxSessions_ == 0)
+        return;
+    auto it = sessions_.find(host);
+    if (it != sessions_.end()) {
+        it->second = std::move(session);
+        return;
+    }
+    if (sessions_.size() >= maxSessions_) {
+        sessions_.erase(order_.front());
+        order_.pop_front();
+    }
+    sessions_.emplace(host, std::move(session));
+    order_.emplace_back(host);
+}
+
+void
+TlsSessionCache::erase(const std::string& host)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sessions_.erase(host))
+        order_.erase(std::find(order_.begin(), order_.end(), host));
+}
+
+void
+TlsSessionCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    sessions_.clear();
+    order_.clear();
+}
+
+void
+TlsSessionCache::onHandshake(bool resumed)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (resumed)
+        stats_.resumed++;
+    else
+        stats_.full++;
+}
+
+TlsSessionCache::Stats
+TlsSessionCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto stats = stats_;
+    stats.sessions = sessions_.size();
+    return stats;
+}
+
+// ConnectionPool
+
+ConnectionPool::ConnectionPool(asio::io_context& ctx, Config config)
+    : config_(std::move(config)), evictionTimer_(ctx)
+{}
+
+ConnectionPool::~ConnectionPool()
+{
+    clear();
+}
+
+void
+ConnectionPool::setConfig(const Config& config)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = config;
+    while (idleCount_ > config_.max_idle)
+        evictOldest();
+    for (auto& i : idle_) {
+        while (i.second.size() > config_.max_idle_per_host) {
+            i.second.front().conn->close();
+            i.second.pop_front();
+            idleCount_--;
+            stats_.evicted++;
+        }
+    }
+}
+
+std::shared_ptr<Connection>
+ConnectionPool::get(const std::string& origin)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = idle_.find(origin);
+    if (it != idle_.end()) {
+        auto& conns = it->second;
+        // most recently used first: least likely to have been closed by the peer
+        while (not conns.empty()) {
+            auto conn = std::move(conns.back().conn);
+            conns.pop_back();
+            idleCount_--;
+            if (conn->is_open()) {
+                if (conns.empty())
+                    idle_.erase(it);
+                stats_.hits++;
+                return conn;
+            }
+        }
+        idle_.erase(it);
+    }
+    stats_.misses++;
+    return {};
+}
+
+void
+ConnectionPool::release(const std::string& origin, std::shared_ptr<Connection> conn)
+{
+    if (not conn or not conn->is_open())
+        return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (config_.max_idle_per_host == 0 or config_.max_idle == 0) {
+        conn->close();
+        return;
+    }
+    auto& conns = idle_[origin];
+    if (conns.size() >= config_.max_idle_per_host) {
+        conns.front().conn->close();
+        conns.pop_front();
+        idleCount_--;
+        stats_.evicted++;
+    }
+    if (idleCount_ >= config_.max_idle)
+        evictOldest();
+    idle_[origin].emplace_back(IdleConnection{std::move(conn), std::chrono::steady_clock::now()});
+    idleCount_++;
+    scheduleEviction();
+}
+
+void
+ConnectionPool::stale()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.stale++;
+}
+
+void
+ConnectionPool::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& i : idle_)
+        for (auto& c : i.second)
+            c.conn->close();
+    idle_.clear();
+    idleCount_ = 0;
+    evictionTimer_.cancel();
+    evictionScheduled_ = false;
+}
+
+ConnectionPool::Stats
+ConnectionPool::getStats() const
+{
+    auto tlsStats = sessionCache_->getStats();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto stats = stats_;
+    stats.idle = idleCount_;
+    stats.tls_resumed = tlsStats.resumed;
+    stats.tls_full = tlsStats.full;
+    return stats;
+}
+
+void
+ConnectionPool::evictOldest()
+{
+    auto oldest = idle_.end();
+    for (auto it = idle_.begin(); it != idle_.end(); ++it)
+        if (not it->second.empty() and (oldest == idle_.end() or it->second.front().since < oldest->second.front().since))
+            oldest = it;
+    if (oldest == idle_.end())
+        return;
+    oldest->second.front().conn->close();
+    oldest->second.pop_front();
+    if (oldest->second.empty())
+        idle_.erase(oldest);
+    idleCount_--;
+    stats_.evicted++;
+}
+
+void
+ConnectionPool::scheduleEviction()
+{
+    if (evictionScheduled_ or idle_.empty())
+        return;
+    auto next = std::chrono::steady_clock::time_point::max();
+    for (const auto& i : idle_)
+        if (not i.second.empty())
+            next = std::min(next, i.second.front().since);
+    if (next == std::chrono::steady_clock::time_point::max())
+        return;
+    evictionScheduled_ = true;
+    evictionTimer_.expires_at(next + config_.idle_timeout);
+    evictionTimer_.async_wait([w=weak_from_this()](const asio::error_code& ec) {
+        if (auto sthis = w.lock())
+            sthis->onEvictionTimer(ec);
+    });
+}
+
+void
+ConnectionPool::onEvictionTimer(const asio::error_code& ec)
+{
+    if (ec == asio::error::operation_aborted)
+        return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    evictionScheduled_ = false;
+    auto limit = std::chrono::steady_clock::now() - config_.idle_timeout;
+    for (auto it = idle_.begin(); it != idle_.end();) {
+        auto& conns = it->second;
+        while (not conns.empty() and conns.front().since <= limit) {
+            conns.front().conn->close();
+            conns.pop_front();
+            idleCount_--;
+            stats_.evicted++;
+        }
+        if (conns.empty())
+            it = idle_.erase(it);
+        else
+            ++it;
+    }
+    scheduleEviction();
+}
+
 // Request
 
 std::atomic_uint Request::ids_ {1};
@@ -974,7 +1268,8 @@ Request::cancel()
     if (auto r = resolver_)
         r->cancel();
     if (auto c = conn_)
-        c->close();
+        if (not released_)
+            c->close();
 }
 
 void
@@ -987,6 +1282,26 @@ Request::get_connection() const {
     return conn_;
 }
 
+void
+Request::set_connection_pool(std::shared_ptr<ConnectionPool> pool) {
+    pool_ = std::move(pool);
+    if (pool_) {
+        connection_type_ = restinio::http_connection_header_t::keep_alive;
+        sessionCache_ = pool_->getSessionCache();
+    }
+}
+
+void
+Request::set_session_cache(std::shared_ptr<TlsSessionCache> cache) {
+    sessionCache_ = std::move(cache);
+}
+
+std::string
+Request::get_origin() const {
+    const auto& url = get_url();
+    return url.protocol + "://" + url.host + ":" + url.service + "/" + std::to_string(family_);
+}
+
 void
 Request::set_certificate_authority(std::shared_ptr<dht::crypto::Certificate> certificate) {
     server_ca_ = certificate;
@@ -1218,6 +1533,8 @@ Request::connect(std::vector<asio::ip::tcp::endpoint>&& endpoints, HandlerCb cb)
         else
             conn_ = std::make_shared<Connection>(ctx_, true/*ssl*/, logger_);
         conn_->set_ssl_verification(get_url().host, asio::ssl::verify_peer | asio::ssl::verify_fail_if_no_peer_cert);
+        if (sessionCache_)
+            conn_->set_session_cache(sessionCache_);
     }
     else
         conn_ = std::make_shared<Connection>(ctx_, false/*ssl*/, logger_);
@@ -1242,13 +1559,7 @@ Request::connect(std::vector<asio::ip::tcp::endpoint>&& endpoints, HandlerCb cb)
             if (this_.logger_)
                 this_.logger_->error("[http:request:{:d}] connect failed with all endpoints: {:s}", this_.id_, ec.message());
         } else {
-            const auto& url = this_.get_url();
-            auto port = endpoint.port();
-            if ((!isHttps && port == (in_port_t)80)
-             || (isHttps && port == (in_port_t)443))
-                this_.set_header_field(restinio::http_field_t::host, url.host);
-            else
-                this_.set_header_field(restinio::http_field_t::host, url.host + ":" + std::to_string(port));
+            this_.set_host(isHttps, endpoint.port());
 
             if (isHttps) {
                 if (this_.conn_ and this_.conn_->is_open() and this_.conn_->is_ssl()) {
@@ -1273,11 +1584,27 @@ Request::connect(std::vector<asio::ip::tcp::endpoint>&& endpoints, HandlerCb cb)
     });
 }
 
+void
+Request::set_host(bool https, in_port_t port)
+{
+    const auto& url = get_url();
+    if ((!https && port == (in_port_t)80)
+     || (https && port == (in_port_t)443))
+        set_header_field(restinio::http_field_t::host, url.host);
+    else
+        set_header_field(restinio::http_field_t::host, url.host + ":" + std::to_string(port));
+}
+
 void
 Request::send()
 {
     notify_state_change(State::CREATED);
+    start();
+}
 
+void
+Request::start()
+{
     std::weak_ptr<Request> wthis = shared_from_this();
     resolver_->add_callback([wthis](const asio::error_code& ec,
                                    std::vector<asio::ip::tcp::endpoint> endpoints) {
@@ -1290,6 +1617,20 @@ Request::send()
                 this_.terminate(asio::error::connection_aborted);
             }
             else if (!this_.conn_ or !this_.conn_->is_open()) {
+                if (this_.pool_) {
+                    if (auto conn = this_.pool_->get(this_.get_origin())) {
+                        if (this_.logger_)
+                            this_.logger_->debug("[http:request:{:d}] reusing connection {:d}", this_.id_, conn->id());
+                        this_.conn_ = std::move(conn);
+                        this_.reused_ = true;
+                        this_.set_host(this_.conn_->is_ssl(), this_.conn_->endpoint().port());
+                        // keep the callback in case the connection is stale and the request is retried
+                        if (this_.timeoutCb_)
+                            this_.conn_->timeout(this_.timeout_, this_.timeoutCb_);
+                        this_.post();
+                        return;
+                    }
+                }
                 this_.connect(std::move(endpoints), [wthis](const asio::error_code &ec) {
                     if (auto sthis = wthis.lock()) {
                         if (ec)
@@ -1326,15 +1667,47 @@ Request::post()
     notify_state_change(State::SENDING);
 
     std::weak_ptr<Request> wthis = shared_from_this();
-    conn_->async_write([wthis](const asio::error_code& ec, size_t) {
+    conn_->async_write([wthis](const asio::error_code& ec, size_t n_bytes) {
         if (auto sthis = wthis.lock())
-            sthis->handle_request(ec);
+            sthis->handle_request(ec, n_bytes);
     });
 }
 
+bool
+Request::is_idempotent() const
+{
+    auto method = header_.method();
+    return method == restinio::http_method_get()
+        or method == restinio::http_method_head()
+        or method == restinio::http_method_options()
+        or method == restinio::http_method_delete();
+}
+
 void
 Request::terminate(const asio::error_code& ec)
 {
+    if (reused_ and not complete_ and response_.status_code == 0 and not finishing_
+        and ec and ec != asio::error::operation_aborted and ec != asio::error::connection_aborted
+        and (not sent_ or is_idempotent()))
+    {
+        // The idle connection was closed by the peer before we got any response:
+        // retry once with a new connection, unless the peer may have processed
+        // a non-idempotent request.
+        if (logger_)
+            logger_->debug("[http:request:{:d}] reused connection failed: {:s}, retrying", id_, ec.message());
+        reused_ = false;
+        sent_ = false;
+        if (auto c = std::move(conn_))
+            c->close();
+        if (pool_)
+            pool_->stale();
+        std::weak_ptr<Request> wthis = shared_from_this();
+        asio::post(ctx_, [wthis]{
+            if (auto sthis = wthis.lock())
+                sthis->start();
+        });
+        return;
+    }
     if (finishing_.exchange(true))
         return;
 
@@ -1349,16 +1722,22 @@ Request::terminate(const asio::error_code& ec)
             logger_->debug("[http:request:{:d}] done with status code {:d}", id_, response_.status_code);
     }
 
-    if (!parser_ or !llhttp_should_keep_alive(parser_.get()))
+    if (!parser_ or !llhttp_should_keep_alive(parser_.get())) {
         if (auto c = conn_)
             c->close();
+    } else if (pool_ and complete_ and conn_ and timeout_ == std::chrono::seconds(0)) {
+        released_ = true;
+        pool_->release(get_origin(), conn_);
+    }
     notify_state_change(State::DONE);
 }
 
 void
-Request::handle_request(const asio::error_code& ec)
+Request::handle_request(const asio::error_code& ec, size_t n_bytes)
 {
     std::lock_guard<std::mutex> lock(mutex_);
+    if (n_bytes)
+        sent_ = true;
     if (ec and ec != asio::error::eof){
         terminate(ec);
         return;
@@ -1387,6 +1766,11 @@ Request::handle_response(const asio::error_code& ec, size_t /* n_bytes */)
         terminate(ec);
         return;
     }
+    if (ec == asio::error::eof and response_.status_code == 0) {
+        // closed by the peer before sending any response
+        terminate(asio::error::connection_reset);
+        return;
+    }
     auto request = (ec == asio::error::eof) ? std::string{} : conn_->read_bytes();
     enum llhttp_errno ret = llhttp_execute(parser_.get(), request.c_str(), request.size());
     if (ret != HPE_OK && ret != HPE_PAUSED) {
@@ -1417,6 +1801,7 @@ Request::onBody(const char* at, size_t length)
 
 void
 Request::onComplete() {
+    complete_ = true;
     terminate(asio::error::eof);
 }
 
@@ -1460,9 +1845,9 @@ Request::onHeadersComplete() {
             std::ostream request_stream(&conn_->input());
             request_stream << body_ << "\r\n";
             std::weak_ptr<Request> wthis = shared_from_this();
-            conn_->async_write([wthis](const asio::error_code& ec, size_t) {
+            conn_->async_write([wthis](const asio::error_code& ec, size_t n_bytes) {
                 if (auto sthis = wthis.lock())
-                    sthis->handle_request(ec);
+                    sthis->handle_request(ec, n_bytes);
             });
         }
     }
@@ -0,0 +1,152 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "identity_factory.h"
+
+namespace dht {
+namespace crypto {
+
+IdentityFactory::IdentityFactory(size_t pool_size, KeyGenerator generator)
+    : poolSize_(pool_size),
+      generator_(generator ? std::move(generator) : []{ return PrivateKey::generate(); })
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    fill(lock);
+}
+
+IdentityFactory::~IdentityFactory()
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    running_ = false;
+    cv_.wait(lock, [this]{ return generating_ == 0; });
+}
+
+void
+IdentityFactory::fill(std::unique_lock<std::mutex>&)
+{
+    // Keys being generated go to waiting callbacks first, then to the pool
+    while (running_ and keys_.size() + generating_ < poolSize_ + waiting_.size()) {
+        generating_++;
+        ThreadPool::computation().run([this] {
+            std::shared_ptr<PrivateKey> key;
+            std::exception_ptr err;
+            try {
+                key = std::make_shared<PrivateKey>(generator_());
+            } catch (...) {
+                err = std::current_exception();
+            }
+            generated(std::move(key), err);
+        });
+    }
+}
+
+void
+IdentityFactory::generated(std::shared_ptr<PrivateKey> key, std::exception_ptr err)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    KeyCallback cb;
+    if (not waiting_.empty()) {
+        cb = std::move(waiting_.front());
+        waiting_.pop_front();
+    } else if (key) {
+        keys_.emplace_back(std::move(key));
+    }
+    if (cb) {
+        lock.unlock();
+        cb(key, err);
+        lock.lock();
+    }
+    generating_--;
+    // Don't retry a failing generator: only waiting callbacks are served
+    if (not err)
+        fill(lock);
+    cv_.notify_all();
+}
+
+void
+IdentityFactory::getKey(KeyCallback cb)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    if (not keys_.empty()) {
+        auto key = std::move(keys_.front());
+        keys_.pop_front();
+        fill(lock);
+        lock.unlock();
+        cb(key, {});
+        return;
+    }
+    waiting_.emplace_back(std::move(cb));
+    fill(lock);
+}
+
+std::future<std::shared_ptr<PrivateKey>>
+IdentityFactory::getKey()
+{
+    auto ret = std::make_shared<std::promise<std::shared_ptr<PrivateKey>>>();
+    auto future = ret->get_future();
+    getKey([ret](const std::shared_ptr<PrivateKey>& key, std::exception_ptr err) {
+        if (err)
+            ret->set_exception(err);
+        else
+            ret->set_value(key);
+    });
+    return future;
+}
+
+void
+IdentityFactory::getIdentity(IdentityCallback cb, const std::string& name, const Identity& ca)
+{
+    getKey([cb = std::move(cb), name, ca](const std::shared_ptr<PrivateKey>& key, std::exception_ptr err) {
+        if (err) {
+            cb({}, err);
+            return;
+        }
+        Identity id;
+        try {
+            auto cert = std::make_shared<Certificate>(Certificate::generate(*key, name, ca, !ca.first || !ca.second));
+            id = {key, std::move(cert)};
+        } catch (...) {
+            cb({}, std::current_exception());
+            return;
+        }
+        cb(id, {});
+    });
+}
+
+std::future<Identity>
+IdentityFactory::getIdentity(const std::string& name, const Identity& ca)
+{
+    auto ret = std::make_shared<std::promise<Identity>>();
+    auto future = ret->get_future();
+    getIdentity([ret](const Identity& id, std::exception_ptr err) {
+        if (err)
+            ret->set_exception(err);
+        else
+            ret->set_value(id);
+    }, name, ca);
+    return future;
+}
+
+size_t
+IdentityFactory::available() const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return keys_.size();
+}
+
+}
+}
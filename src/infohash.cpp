@@ -10,3 +10,11 @@ dht::HexMap::HexMap() {
         e[1] = hex_digits[i & 0x0F];
     }
 }
+
+uint64_t dht::hashSeed() {
+    static const uint64_t seed = [] {
+        std::random_device rdev;
+        return (uint64_t(rdev()) << 32) | rdev();
+    }();
+    return seed;
+}
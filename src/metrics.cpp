@@ -0,0 +1,205 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <sstream>
+#include <limits>
+#include <stdexcept>
+
+namespace dht {
+namespace metrics {
+
+const std::vector<double>&
+Histogram::latencyBounds()
+{
+    static const std::vector<double> bounds {
+        .0001, .00025, .0005, .001, .0025, .005, .01, .025, .05, .1, .25, .5, 1., 2.5, 5., 10.
+    };
+    return bounds;
+}
+
+Histogram::Histogram(std::vector<double> bounds)
+    : bounds_((std::sort(bounds.begin(), bounds.end()), std::move(bounds))),
+      buckets_(new std::atomic<uint64_t>[bounds_.size() + 1])
+{
+    for (size_t i = 0; i <= bounds_.size(); i++)
+        buckets_[i].store(0, std::memory_order_relaxed);
+}
+
+void
+Histogram::observe(double v)
+{
+    auto i = std::lower_bound(bounds_.begin(), bounds_.end(), v) - bounds_.begin();
+    buckets_[i].fetch_add(1, std::memory_order_relaxed);
+    auto sum = sum_.load(std::memory_order_relaxed);
+    while (not sum_.compare_exchange_weak(sum, sum + v, std::memory_order_relaxed)) {}
+    count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<uint64_t>
+Histogram::buckets() const
+{
+    std::vector<uint64_t> ret(bounds_.size() + 1);
+    for (size_t i = 0; i < ret.size(); i++)
+        ret[i] = buckets_[i].load(std::memory_order_relaxed);
+    return ret;
+}
+
+static std::string
+formatLabels(const Labels& labels)
+{
+    if (labels.empty())
+        return {};
+    std::string ret = "{";
+    for (const auto& l : labels) {
+        if (ret.size() > 1)
+            ret += ',';
+        ret += l.first;
+        ret += "=\"";
+        for (auto c : l.second) {
+            switch (c) {
+            case '\\': ret += "\\\\"; break;
+            case '"':  ret += "\\\""; break;
+            case '\n': ret += "\\n"; break;
+            default:   ret += c;
+            }
+        }
+        ret += '"';
+    }
+    ret += '}';
+    return ret;
+}
+
+/** Adds a label to a formatted label set */
+static std::string
+addLabel(const std::string& labels, const std::string& label)
+{
+    if (labels.empty())
+        return "{" + label + "}";
+    return labels.substr(0, labels.size() - 1) + "," + label + "}";
+}
+
+static void
+formatValue(std::ostream& o, double v)
+{
+    if (v == std::numeric_limits<double>::infinity())
+        o << "+Inf";
+    else
+        o << v;
+}
+
+Registry::Metric&
+Registry::get(const std::string& name, const std::string& help, Type type, const Labels& labels)
+{
+    auto l = formatLabels(labels);
+    auto it = byName_.find(name);
+    Family* family;
+    if (it == byName_.end()) {
+        families_.emplace_back();
+        family = &families_.back();
+        family->name = name;
+        family->help = help;
+        family->type = type;
+        byName_.emplace(name, family);
+    } else {
+        family = it->second;
+        if (family->type != type)
+            throw std::invalid_argument("metric " + name + " already registered with another type");
+        for (auto& m : family->metrics)
+            if (m.labels == l)
+                return m;
+    }
+    family->metrics.emplace_back();
+    auto& metric = family->metrics.back();
+    metric.labels = std::move(l);
+    return metric;
+}
+
+Counter&
+Registry::counter(const std::string& name, const std::string& help, const Labels& labels)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    auto& m = get(name, help, Type::Counter, labels);
+    if (not m.counter)
+        m.counter = std::make_unique<Counter>();
+    return *m.counter;
+}
+
+Gauge&
+Registry::gauge(const std::string& name, const std::string& help, const Labels& labels)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    auto& m = get(name, help, Type::Gauge, labels);
+    if (not m.gauge)
+        m.gauge = std::make_unique<Gauge>();
+    return *m.gauge;
+}
+
+Histogram&
+Registry::histogram(const std::string& name, const std::string& help, const Labels& labels,
+                    const std::vector<double>& bounds)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    auto& m = get(name, help, Type::Histogram, labels);
+    if (not m.histogram)
+        m.histogram = std::make_unique<Histogram>(bounds);
+    return *m.histogram;
+}
+
+std::string
+Registry::toPrometheus() const
+{
+    std::ostringstream o;
+    std::lock_guard<std::mutex> lock(lock_);
+    for (const auto& family : families_) {
+        o << "# HELP " << family.name << ' ' << family.help << '\n';
+        o << "# TYPE " << family.name << ' '
+          << (family.type == Type::Counter ? "counter" : (family.type == Type::Gauge ? "gauge" : "histogram")) << '\n';
+        for (const auto& m : family.metrics) {
+            switch (family.type) {
+            case Type::Counter:
+                o << family.name << m.labels << ' ' << m.counter->value() << '\n';
+                break;
+            case Type::Gauge:
+                o << family.name << m.labels << ' ' << m.gauge->value() << '\n';
+                break;
+            case Type::Histogram: {
+                const auto& h = *m.histogram;
+                auto buckets = h.buckets();
+                uint64_t cumulative = 0;
+                for (size_t i = 0; i < buckets.size(); i++) {
+                    cumulative += buckets[i];
+                    std::ostringstream le;
+                    le << "le=\"";
+                    formatValue(le, i < h.bounds().size() ? h.bounds()[i] : std::numeric_limits<double>::infinity());
+                    le << '"';
+                    o << family.name << "_bucket" << addLabel(m.labels, le.str()) << ' ' << cumulative << '\n';
+                }
+                o << family.name << "_sum" << m.labels << ' ' << h.sum() << '\n';
+                o << family.name << "_count" << m.labels << ' ' << cumulative << '\n';
+                break;
+            }
+            }
+        }
+    }
+    return o.str();
+}
+
+}
+}
@@ -32,7 +32,8 @@ enum class MessageType {
     Listen,
     ValueData,
     ValueUpdate,
-    UpdateValue
+    UpdateValue,
+    ValueAck
 };
 
 } /* namespace net */
@@ -24,7 +24,9 @@
 #include "parsed_message.h"
 
 #include <msgpack.hpp>
+#include <array>
 #include <chrono>
+#include <deque>
 #include <string_view>
 
 namespace dht {
@@ -38,10 +40,13 @@ const std::string DhtProtocolException::PUT_NO_INFOHASH {"Put with no info_hash"
 const std::string DhtProtocolException::PUT_WRONG_TOKEN {"Put with wrong token"};
 const std::string DhtProtocolException::PUT_INVALID_ID {"Put with invalid id"};
 const std::string DhtProtocolException::STORAGE_NOT_FOUND {"Access operation for unknown storage"};
+const std::string DhtProtocolException::LISTEN_OVERLOADED {"Listen refused: too many listeners"};
 
 constexpr std::chrono::seconds NetworkEngine::UDP_REPLY_TIME;
 constexpr std::chrono::seconds NetworkEngine::RX_MAX_PACKET_TIME;
 constexpr std::chrono::seconds NetworkEngine::RX_TIMEOUT;
+constexpr std::chrono::milliseconds NetworkEngine::RX_ACK_DELAY;
+constexpr std::chrono::milliseconds NetworkEngine::TX_PACING;
 
 /* OpenDHT User Agent (UA) */
 constexpr std::string_view OPENDHT_UA {"o2"};
@@ -56,6 +61,23 @@ struct NetworkEngine::PartialMessage {
     time_point start;
     time_point last_part;
     std::unique_ptr<ParsedMessage> msg;
+    /* the sender accepts part acknowledgements */
+    bool want_ack {false};
+    unsigned ack_count {0};
+    Sp<Scheduler::Job> ack_job;
+    /* memory accounted in partial_memory */
+    size_t memory {0};
+};
+
+struct NetworkEngine::PartialTransmit {
+    SockAddr to;
+    std::vector<Blob> parts;
+    /* (part index, offset) of fragments waiting to be sent */
+    std::deque<std::pair<unsigned, size_t>> queue;
+    time_point last_activity;
+    /* the receiver reported missing fragments */
+    bool acked {false};
+    Sp<Scheduler::Job> pacing;
 };
 
 std::vector<Blob>
@@ -118,6 +140,47 @@ NetworkEngine::~NetworkEngine() {
     clear();
 }
 
+struct NetworkEngine::Metrics {
+    static constexpr size_t TYPES {(size_t)MessageType::ValueAck + 1};
+    std::array<metrics::Counter*, TYPES> received;
+    std::array<metrics::Histogram*, TYPES> processing;
+    metrics::Counter& dropMartian;
+    metrics::Counter& dropBlacklisted;
+    metrics::Counter& dropParse;
+    metrics::Counter& dropNetwork;
+    metrics::Counter& dropRateLimited;
+    metrics::Counter& processError;
+
+    Metrics(metrics::Registry& r) :
+        dropMartian(dropped(r, "martian")),
+        dropBlacklisted(dropped(r, "blacklisted")),
+        dropParse(dropped(r, "parse_error")),
+        dropNetwork(dropped(r, "other_network")),
+        dropRateLimited(dropped(r, "rate_limited")),
+        processError(r.counter("dht_messages_process_errors_total", "Messages that could not be processed"))
+    {
+        static constexpr std::array<const char*, TYPES> TYPE_NAMES {{
+            "error", "reply", "ping", "find_node", "get_values", "announce_value",
+            "refresh", "listen", "value_data", "value_update", "update_value", "value_ack"
+        }};
+        for (size_t i = 0; i < TYPES; i++) {
+            metrics::Labels labels {{"type", TYPE_NAMES[i]}};
+            received[i] = &r.counter("dht_messages_received_total", "Parsed messages received", labels);
+            processing[i] = &r.histogram("dht_message_processing_seconds", "Message processing time", labels);
+        }
+    }
+
+    static metrics::Counter& dropped(metrics::Registry& r, const char* reason) {
+        return r.counter("dht_messages_dropped_total", "Received packets dropped before processing", {{"reason", reason}});
+    }
+};
+
+void
+NetworkEngine::setMetrics(metrics::Registry& registry)
+{
+    metrics_ = std::make_unique<Metrics>(registry);
+}
+
 void
 NetworkEngine::tellListener(const Sp<Node>& node, Tid socket_id, const InfoHash& hash, want_t want,
         const Blob& ntoken, std::vector<Sp<Node>>&& nodes,
@@ -269,6 +332,7 @@ NetworkEngine::clear()
         request.second->node->setExpired();
     }
     requests.clear();
+    partial_transmits.clear();
 }
 
 void
@@ -277,6 +341,21 @@ NetworkEngine::connectivityChanged(sa_family_t af)
     cache.clearBadNodes(af);
 }
 
+static const char*
+requestSpanName(MessageType type)
+{
+    switch (type) {
+    case MessageType::Ping:          return "ping";
+    case MessageType::FindNode:      return "find_node";
+    case MessageType::GetValues:     return "get_values";
+    case MessageType::AnnounceValue: return "announce_value";
+    case MessageType::Refresh:       return "refresh";
+    case MessageType::Listen:        return "listen";
+    case MessageType::UpdateValue:   return "update_value";
+    default:                         return "request";
+    }
+}
+
 void
 NetworkEngine::requestStep(Sp<Request> sreq)
 {
@@ -296,6 +375,8 @@ NetworkEngine::requestStep(Sp<Request> sreq)
     } else if (req.attempt_count == 1) {
         req.on_expired(req, false);
     }
+    if (req.attempt_count)
+        req.span.event("retry");
 
     auto err = send(node.getAddr(), (char*)req.msg.data(), req.msg.size(), node.getReplyTime() < now - UDP_REPLY_TIME);
     if (err == ENETUNREACH  ||
@@ -310,11 +391,16 @@ NetworkEngine::requestStep(Sp<Request> sreq)
     } else {
         req.last_try = now;
         if (err != EAGAIN) {
-            ++req.attempt_count;
-            req.attempt_duration +=
-                req.attempt_duration + uniform_duration_distribution<>(0ms, ((duration)Node::MAX_RESPONSE_TIME)/4)(rd);
-            if (not req.parts.empty()){
-                sendValueParts(req.tid, req.parts, node.getAddr());
+            // the first attempt waits for the retransmission timeout,
+            // each retry doubles the previous wait
+            if (req.attempt_count++)
+                req.attempt_duration += req.attempt_duration;
+            req.attempt_duration += uniform_duration_distribution<>(0ms, node.getRto()/4)(rd);
+            if (not req.parts.empty()) {
+                // once the receiver reported missing fragments, only those are resent
+                auto tx = partial_transmits.find({req.tid, node.getAddr()});
+                if (tx == partial_transmits.end() or not tx->second.acked)
+                    sendValueParts(req.tid, req.parts, node.getAddr());
             }
         }
         std::weak_ptr<Request> wreq = sreq;
@@ -336,6 +422,8 @@ NetworkEngine::sendRequest(const Sp<Request>& request)
     if (not node.id)
         requests.emplace(request->tid, request);
     request->start = scheduler.time();
+    request->span.begin(requestSpanName(request->type));
+    request->attempt_duration = node.getRto();
     node.requested(request);
     requestStep(request);
 }
@@ -414,12 +502,16 @@ NetworkEngine::processMessage(const uint8_t *buf, size_t buflen, SockAddr f)
     if (isMartian(from)) {
         if (logger_)
             logger_->w("Received packet from martian node %s", from.toString().c_str());
+        if (metrics_)
+            metrics_->dropMartian.inc();
         return;
     }
 
     if (isNodeBlacklisted(from)) {
         if (logger_)
             logger_->w("Received packet from blacklisted node %s", from.toString().c_str());
+        if (metrics_)
+            metrics_->dropBlacklisted.inc();
         return;
     }
 
@@ -432,15 +524,22 @@ NetworkEngine::processMessage(const uint8_t *buf, size_t buflen, SockAddr f)
             logger_->w("Can't parse message of size %lu: %s", buflen, e.what());
         // if (logger_)
         //     logger_->DBG.logPrintable(buf, buflen);
+        if (metrics_)
+            metrics_->dropParse.inc();
         return;
     }
 
     if (msg->network != config.network) {
         if (logger_)
             logger_->d("Received message from other config.network %u", msg->network);
+        if (metrics_)
+            metrics_->dropNetwork.inc();
         return;
     }
 
+    if (metrics_ and (size_t)msg->type < Metrics::TYPES)
+        metrics_->received[(size_t)msg->type]->inc();
+
     const auto& now = scheduler.time();
 
     // partial value data
@@ -459,24 +558,71 @@ NetworkEngine::processMessage(const uint8_t *buf, size_t buflen, SockAddr f)
             rateLimit(from);
             return;
         }
+        auto& pmsg = pmsg_it->second;
+        pmsg.want_ack |= msg->want_ack;
         // append data block
-        if (pmsg_it->second.msg->append(*msg)) {
-            pmsg_it->second.last_part = now;
+        if (pmsg.msg->append(*msg)) {
+            pmsg.last_part = now;
             // check data completion
-            if (pmsg_it->second.msg->complete()) {
+            if (pmsg.msg->complete()) {
+                if (pmsg.want_ack)
+                    sendPartsAck(msg->tid, from, {});
                 try {
                     // process the full message
-                    process(std::move(pmsg_it->second.msg), from);
+                    metrics::ScopedTimer timer(metrics_ ? metrics_->processing[(size_t)pmsg.msg->type] : nullptr);
+                    process(std::move(pmsg.msg), from);
+                    partial_memory -= pmsg.memory;
                     partial_messages.erase(pmsg_it);
                 } catch (...) {
+                    if (metrics_)
+                        metrics_->processError.inc();
                     return;
                 }
-            } else
+            } else {
                 scheduler.add(now + RX_TIMEOUT, std::bind(&NetworkEngine::maintainRxBuffer, this, msg->tid));
+                if (pmsg.want_ack) {
+                    // request missing fragments once the sender pauses
+                    pmsg.ack_count = 0;
+                    if (pmsg.ack_job)
+                        scheduler.edit(pmsg.ack_job, now + RX_ACK_DELAY);
+                    else
+                        pmsg.ack_job = scheduler.add(now + RX_ACK_DELAY, std::bind(&NetworkEngine::requestMissingParts, this, msg->tid));
+                }
+            }
         }
         return;
     }
 
+    // acknowledgement of value data
+    if (msg->type == MessageType::ValueAck) {
+        auto tx_it = partial_transmits.find({msg->tid, from});
+        if (tx_it == partial_transmits.end()) {
+            rateLimit(from);
+            return;
+        }
+        auto& tx = tx_it->second;
+        if (msg->missing_parts.empty()) {
+            partial_transmits.erase(tx_it);
+            return;
+        }
+        tx.acked = true;
+        tx.last_activity = now;
+        tx.queue.clear();
+        for (const auto& part : msg->missing_parts) {
+            if (part.first >= tx.parts.size())
+                continue;
+            auto size = tx.parts[part.first].size();
+            for (const auto& range : part.second) {
+                auto end = std::min(size, (size_t)range.first + range.second);
+                for (size_t start = (range.first / MTU) * MTU; start < end; start += MTU)
+                    tx.queue.emplace_back(part.first, start);
+            }
+        }
+        if (not tx.pacing)
+            sendPendingParts(tx_it->first);
+        return;
+    }
+
     if (msg->id == myid or not msg->id) {
         if (logger_)
             logger_->d("Received message from self");
@@ -488,29 +634,47 @@ NetworkEngine::processMessage(const uint8_t *buf, size_t buflen, SockAddr f)
         if (!rateLimit(from)) {
             if (logger_)
                 logger_->w("Dropping request due to rate limiting");
+            if (metrics_)
+                metrics_->dropRateLimited.inc();
             return;
         }
     }
 
     if (msg->value_parts.empty()) {
         try {
+            metrics::ScopedTimer timer(metrics_ ? metrics_->processing[(size_t)msg->type] : nullptr);
             process(std::move(msg), from);
         } catch(...) {
+            if (metrics_)
+                metrics_->processError.inc();
             return;
         }
     } else {
         // starting partial message session
         auto k = msg->tid;
+        if (partial_messages.find(k) != partial_messages.end()) {
+            if (logger_)
+                logger_->e("Partial message with given TID %u already exists", k);
+            return;
+        }
+        // account for the declared size of the values to be received
+        size_t memory = sizeof(PartialMessage) + sizeof(ParsedMessage);
+        for (const auto& part : msg->value_parts)
+            memory += MemoryStats::NODE_OVERHEAD + sizeof(part) + part.second.first;
+        if (partial_memory + memory > config.max_partial_memory) {
+            if (logger_)
+                logger_->w("Dropping partial message from %s: memory limit reached", from.toString().c_str());
+            return;
+        }
         auto& pmsg = partial_messages[k];
-        if (not pmsg.msg) {
-            pmsg.from = from;
-            pmsg.msg = std::move(msg);
-            pmsg.start = now;
-            pmsg.last_part = now;
-            scheduler.add(now + RX_MAX_PACKET_TIME, std::bind(&NetworkEngine::maintainRxBuffer, this, k));
-            scheduler.add(now + RX_TIMEOUT, std::bind(&NetworkEngine::maintainRxBuffer, this, k));
-        } else if (logger_)
-            logger_->e("Partial message with given TID %u already exists", k);
+        pmsg.from = from;
+        pmsg.msg = std::move(msg);
+        pmsg.start = now;
+        pmsg.last_part = now;
+        pmsg.memory = memory;
+        partial_memory += memory;
+        scheduler.add(now + RX_MAX_PACKET_TIME, std::bind(&NetworkEngine::maintainRxBuffer, this, k));
+        scheduler.add(now + RX_TIMEOUT, std::bind(&NetworkEngine::maintainRxBuffer, this, k));
     }
 }
 
@@ -974,35 +1138,117 @@ NetworkEngine::packValueHeader(msgpack::sbuffer& buffer, std::vector<Sp<Value>>:
 }
 
 void
-NetworkEngine::sendValueParts(Tid tid, const std::vector<Blob>& svals, const SockAddr& addr)
+NetworkEngine::sendValueParts(Tid tid, std::vector<Blob> svals, const SockAddr& addr)
+{
+    TxKey key {tid, addr};
+    auto tx_it = partial_transmits.find(key);
+    if (tx_it == partial_transmits.end()) {
+        if (partial_transmits.size() >= TX_MAX_PENDING) {
+            // no room to keep the fragments: send them all at once
+            for (unsigned i=0; i<svals.size(); i++)
+                for (size_t start = 0; start < svals[i].size(); start += MTU)
+                    sendValuePart(tid, i, svals[i], start, addr, false);
+            return;
+        }
+        tx_it = partial_transmits.emplace(key, PartialTransmit{}).first;
+        scheduler.add(scheduler.time() + RX_TIMEOUT, std::bind(&NetworkEngine::maintainTxBuffer, this, key));
+    }
+    auto& tx = tx_it->second;
+    tx.to = addr;
+    tx.parts = std::move(svals);
+    tx.acked = false;
+    tx.last_activity = scheduler.time();
+    tx.queue.clear();
+    for (unsigned i=0; i<tx.parts.size(); i++)
+        for (size_t start = 0; start < tx.parts[i].size(); start += MTU)
+            tx.queue.emplace_back(i, start);
+    if (not tx.pacing)
+        sendPendingParts(key);
+}
+
+void
+NetworkEngine::sendPendingParts(const TxKey& key)
 {
+    auto tx_it = partial_transmits.find(key);
+    if (tx_it == partial_transmits.end())
+        return;
+    auto& tx = tx_it->second;
+    tx.pacing.reset();
+    for (unsigned n = 0; n < TX_BURST and not tx.queue.empty(); n++) {
+        auto part = tx.queue.front();
+        tx.queue.pop_front();
+        if (part.first < tx.parts.size() and part.second < tx.parts[part.first].size())
+            sendValuePart(key.first, part.first, tx.parts[part.first], part.second, tx.to, true);
+    }
+    if (not tx.queue.empty())
+        tx.pacing = scheduler.add(scheduler.time() + TX_PACING, std::bind(&NetworkEngine::sendPendingParts, this, key));
+}
+
+void
+NetworkEngine::sendValuePart(Tid tid, unsigned index, const Blob& v, size_t start, const SockAddr& addr, bool want_ack)
+{
+    auto end = std::min(start + MTU, v.size());
     msgpack::sbuffer buffer;
-    unsigned i=0;
-    for (const auto& v: svals) {
-        size_t start {0}, end;
-        do {
-            end = std::min(start + MTU, v.size());
-            buffer.clear();
-            msgpack::packer<msgpack::sbuffer> pk(&buffer);
-            pk.pack_map(3+(config.network?1:0)+(config.is_client?1:0));
-            if (config.network) {
-                pk.pack(KEY_NETID); pk.pack(config.network);
-            }
-            if (config.is_client) {
-                pk.pack(KEY_ISCLIENT); pk.pack(config.is_client);
-            }
-            pk.pack(KEY_Y); pk.pack(KEY_V);
-            pk.pack(KEY_TID); pk.pack(tid);
-            pk.pack(KEY_V); pk.pack_map(1);
-                pk.pack(i); pk.pack_map(2);
-                    pk.pack("o"sv); pk.pack(start);
-                    pk.pack("d"sv); pk.pack_bin(end-start);
-                                               pk.pack_bin_body((const char*)v.data()+start, end-start);
-            send(addr, buffer.data(), buffer.size());
-            start = end;
-        } while (start != v.size());
-        i++;
+    msgpack::packer<msgpack::sbuffer> pk(&buffer);
+    pk.pack_map(3+(want_ack?1:0)+(config.network?1:0)+(config.is_client?1:0));
+    if (config.network) {
+        pk.pack(KEY_NETID); pk.pack(config.network);
+    }
+    if (config.is_client) {
+        pk.pack(KEY_ISCLIENT); pk.pack(config.is_client);
+    }
+    if (want_ack) {
+        pk.pack(KEY_WANT_ACK); pk.pack(true);
+    }
+    pk.pack(KEY_Y); pk.pack(KEY_V);
+    pk.pack(KEY_TID); pk.pack(tid);
+    pk.pack(KEY_V); pk.pack_map(1);
+        pk.pack(index); pk.pack_map(2);
+            pk.pack("o"sv); pk.pack(start);
+            pk.pack("d"sv); pk.pack_bin(end-start);
+                            pk.pack_bin_body((const char*)v.data()+start, end-start);
+    send(addr, buffer.data(), buffer.size());
+}
+
+void
+NetworkEngine::sendPartsAck(Tid tid, const SockAddr& addr, const std::map<unsigned, std::vector<std::pair<unsigned, unsigned>>>& missing)
+{
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> pk(&buffer);
+    pk.pack_map(3+(config.network?1:0)+(config.is_client?1:0));
+    if (config.network) {
+        pk.pack(KEY_NETID); pk.pack(config.network);
+    }
+    if (config.is_client) {
+        pk.pack(KEY_ISCLIENT); pk.pack(config.is_client);
     }
+    pk.pack(KEY_Y); pk.pack(KEY_ACK);
+    pk.pack(KEY_TID); pk.pack(tid);
+    pk.pack(KEY_ACK); pk.pack_map(missing.size());
+    for (const auto& part : missing) {
+        pk.pack(part.first);
+        pk.pack_array(part.second.size() * 2);
+        for (const auto& range : part.second) {
+            pk.pack(range.first);
+            pk.pack(range.second);
+        }
+    }
+    send(addr, buffer.data(), buffer.size());
+}
+
+void
+NetworkEngine::requestMissingParts(Tid tid)
+{
+    auto pmsg_it = partial_messages.find(tid);
+    if (pmsg_it == partial_messages.end() or not pmsg_it->second.msg)
+        return;
+    auto& pmsg = pmsg_it->second;
+    sendPartsAck(tid, pmsg.from, pmsg.msg->getMissingParts(RX_ACK_MAX_RANGES));
+    // back off in case retransmissions are lost too
+    const auto& now = scheduler.time();
+    auto next = now + RX_ACK_DELAY * (1u << std::min(++pmsg.ack_count, 4u));
+    if (next < pmsg.last_part + RX_TIMEOUT)
+        pmsg.ack_job = scheduler.add(next, std::bind(&NetworkEngine::requestMissingParts, this, tid));
 }
 
 void
@@ -1062,7 +1308,7 @@ NetworkEngine::sendNodesValues(const SockAddr& addr, Tid tid, const Blob& nodes,
 
     // send parts
     if (not svals.empty())
-        sendValueParts(tid, svals, addr);
+        sendValueParts(tid, std::move(svals), addr);
 }
 
 Blob
@@ -1451,11 +1697,26 @@ NetworkEngine::maintainRxBuffer(Tid tid)
          || msg->second.last_part + RX_TIMEOUT < now) {
             if (logger_)
                 logger_->w("Dropping expired partial message from %s", msg->second.from.toString().c_str());
+            partial_memory -= msg->second.memory;
             partial_messages.erase(msg);
         }
     }
 }
 
+void
+NetworkEngine::maintainTxBuffer(const TxKey& key)
+{
+    auto tx = partial_transmits.find(key);
+    if (tx != partial_transmits.end()) {
+        const auto& now = scheduler.time();
+        auto expiration = tx->second.last_activity + RX_TIMEOUT;
+        if (expiration <= now)
+            partial_transmits.erase(tx);
+        else
+            scheduler.add(expiration, std::bind(&NetworkEngine::maintainTxBuffer, this, key));
+    }
+}
+
 
 } /* namespace net  */
 } /* namespace dht */
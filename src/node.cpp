@@ -22,6 +22,7 @@
 #include "request.h"
 #include "rng.h"
 
+#include <algorithm>
 #include <sstream>
 
 namespace dht {
@@ -29,6 +30,8 @@ namespace dht {
 constexpr std::chrono::minutes Node::NODE_EXPIRE_TIME;
 constexpr std::chrono::minutes Node::NODE_GOOD_TIME;
 constexpr std::chrono::seconds Node::MAX_RESPONSE_TIME;
+constexpr std::chrono::milliseconds Node::MIN_RTO;
+constexpr std::chrono::seconds Node::MAX_RTO;
 
 Node::Node(const InfoHash& id, const SockAddr& addr, std::mt19937_64& rd, bool client)
 : id(id), addr(addr), is_client(client), sockets_()
@@ -100,10 +103,35 @@ Node::received(time_point now, const Sp<net::Request>& req)
     expired_ = false;
     if (req) {
         reply_time = now;
+        // Karn's algorithm: a reply to a retransmitted request can't be matched to an attempt
+        if (req->pending() and req->getAttemptCount() == 1 and now >= req->getLastTry())
+            updateRtt(std::max<duration>(now - req->getLastTry(), std::chrono::microseconds(1)));
         requests_.erase(req->getTid());
     }
 }
 
+/* Jacobson/Karels estimator, as described in RFC 6298 */
+void
+Node::updateRtt(duration rtt)
+{
+    if (srtt_ == duration::zero()) {
+        srtt_ = rtt;
+        rttvar_ = rtt / 2;
+    } else {
+        auto delta = srtt_ > rtt ? srtt_ - rtt : rtt - srtt_;
+        rttvar_ = (3 * rttvar_ + delta) / 4;
+        srtt_ = (7 * srtt_ + rtt) / 8;
+    }
+}
+
+duration
+Node::getRto() const
+{
+    if (srtt_ == duration::zero())
+        return MAX_RESPONSE_TIME;
+    return std::clamp<duration>(srtt_ + 4 * rttvar_, MIN_RTO, MAX_RTO);
+}
+
 Sp<net::Request>
 Node::getRequest(Tid tid)
 {
@@ -189,6 +217,8 @@ NodeExport::msgpack_unpack(msgpack::object o)
         throw msgpack::type_error();
     id.msgpack_unpack(o.via.map.ptr[0].val);
     addr = {(const sockaddr*)maddr.via.bin.ptr, (socklen_t)maddr.via.bin.size};
+    if (o.via.map.size > 2 and o.via.map.ptr[2].key.as<std::string_view>() == "rtt"sv)
+        rtt = std::chrono::microseconds(o.via.map.ptr[2].val.as<int64_t>());
 }
 
 std::ostream& operator<< (std::ostream& s, const NodeExport& h)
@@ -76,6 +76,14 @@ public:
     std::vector<Sp<Value>> getValues() const;
     size_t size() const { return values.size(); }
 
+    /** Estimated memory used by the cached values */
+    size_t memoryUsage() const {
+        size_t ret = 0;
+        for (const auto& v : values)
+            ret += MemoryStats::NODE_OVERHEAD + sizeof(v) + sizeof(Value) + v.second.data->size();
+        return ret;
+    }
+
 private:
     OpValueCache(const OpValueCache&) = delete;
     OpValueCache& operator=(const OpValueCache&) = delete;
@@ -149,6 +157,11 @@ public:
         return cache.size();
     }
 
+    size_t memoryUsage() const {
+        return sizeof(OpCache) + cache.memoryUsage()
+             + listeners.size() * (MemoryStats::NODE_OVERHEAD + sizeof(decltype(listeners)::value_type));
+    }
+
     size_t searchToken {0};
 private:
     constexpr static const std::chrono::seconds EXPIRATION {60};
@@ -187,6 +200,13 @@ public:
         return {ops.size(), tot};
     }
 
+    size_t memoryUsage() const {
+        size_t ret = 0;
+        for (const auto& c : ops)
+            ret += MemoryStats::NODE_OVERHEAD + sizeof(c) + sizeof(Query) + c.second->memoryUsage();
+        return ret;
+    }
+
 private:
     SearchCache(const SearchCache&) = delete;
     SearchCache& operator=(const SearchCache&) = delete;
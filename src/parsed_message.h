@@ -40,6 +40,8 @@ static constexpr auto KEY_NETID = "n"sv;
 static constexpr auto KEY_ISCLIENT = "s"sv;
 static constexpr auto KEY_Q = "q"sv;
 static constexpr auto KEY_A = "a"sv;
+static constexpr auto KEY_ACK = "k"sv;
+static constexpr auto KEY_WANT_ACK = "wk"sv;
 
 static constexpr auto KEY_REQ_SID = "sid"sv;
 static constexpr auto KEY_REQ_ID = "id"sv;
@@ -110,6 +112,12 @@ struct ParsedMessage {
     /** When part of the message header: {index -> (total size, {})}
      *  When part of partial value data: {index -> (offset, part_data)} */
     std::map<unsigned, std::pair<unsigned, Blob>> value_parts;
+    /* received byte ranges of partial values {index -> {offset -> end}} */
+    std::map<unsigned, std::map<unsigned, unsigned>> received_ranges;
+    /* missing byte ranges reported by a part acknowledgement {index -> [(offset, size)]} */
+    std::map<unsigned, std::vector<std::pair<unsigned, unsigned>>> missing_parts;
+    /* the sender of value data accepts part acknowledgements */
+    bool want_ack {false};
     /* query describing a filter to apply on values. */
     Query query;
     /* states if ipv4 or ipv6 request */
@@ -124,38 +132,80 @@ struct ParsedMessage {
 
     bool append(const ParsedMessage& block);
     bool complete();
+    std::map<unsigned, std::vector<std::pair<unsigned, unsigned>>> getMissingParts(size_t max_ranges) const;
+
+private:
+    bool partComplete(unsigned index, unsigned total) const;
 };
 
+/**
+ * Adds [b, e) to a set of disjoint ranges, merging overlapping ones.
+ * Returns false if the range was already fully covered.
+ */
+static bool
+insertRange(std::map<unsigned, unsigned>& ranges, unsigned b, unsigned e)
+{
+    auto it = ranges.upper_bound(b);
+    if (it != ranges.begin()) {
+        auto prev = std::prev(it);
+        if (prev->second >= e)
+            return false;
+        if (prev->second >= b) {
+            b = prev->first;
+            it = ranges.erase(prev);
+        }
+    }
+    while (it != ranges.end() and it->first <= e) {
+        e = std::max(e, it->second);
+        it = ranges.erase(it);
+    }
+    ranges.emplace(b, e);
+    return true;
+}
+
 bool
 ParsedMessage::append(const ParsedMessage& block)
 {
     bool ret(false);
     for (const auto& ve : block.value_parts) {
         auto part_val = value_parts.find(ve.first);
-        if (part_val == value_parts.end()
-            || part_val->second.second.size() >= part_val->second.first)
+        if (part_val == value_parts.end())
             continue;
-        // TODO: handle out-of-order packets
-        if (ve.second.first != part_val->second.second.size()) {
-            //std::cout << "skipping out-of-order packet" << std::endl;
+        auto total = part_val->second.first;
+        auto offset = ve.second.first;
+        const auto& data = ve.second.second;
+        if (data.empty() or offset >= total or data.size() > total - offset)
             continue;
-        }
+        // parts may arrive out-of-order or be retransmitted
+        if (not insertRange(received_ranges[ve.first], offset, offset + data.size()))
+            continue;
+        auto& buf = part_val->second.second;
+        if (buf.size() != total)
+            buf.resize(total);
+        std::copy(data.begin(), data.end(), buf.begin() + offset);
         ret = true;
-        part_val->second.second.insert(part_val->second.second.end(),
-                                       ve.second.second.begin(),
-                                       ve.second.second.end());
     }
     return ret;
 }
 
+bool
+ParsedMessage::partComplete(unsigned index, unsigned total) const
+{
+    if (total == 0)
+        return true;
+    auto r = received_ranges.find(index);
+    return r != received_ranges.end()
+        and r->second.size() == 1
+        and r->second.begin()->first == 0
+        and r->second.begin()->second >= total;
+}
+
 bool
 ParsedMessage::complete()
 {
     for (auto& e : value_parts) {
-        if (e.second.first > e.second.second.size()) {
-            //std::cout << "uncomplete part " << e.first << ": " << e.second.second.size() << "/" << e.second.first << std::endl;
+        if (not partComplete(e.first, e.second.first))
             return false;
-        }
     }
     for (auto& e : value_parts) {
         msgpack::unpacked msg;
@@ -165,6 +215,37 @@ ParsedMessage::complete()
     return true;
 }
 
+std::map<unsigned, std::vector<std::pair<unsigned, unsigned>>>
+ParsedMessage::getMissingParts(size_t max_ranges) const
+{
+    std::map<unsigned, std::vector<std::pair<unsigned, unsigned>>> missing;
+    size_t count {0};
+    for (const auto& e : value_parts) {
+        auto total = e.second.first;
+        if (partComplete(e.first, total))
+            continue;
+        auto& gaps = missing[e.first];
+        unsigned pos {0};
+        auto r = received_ranges.find(e.first);
+        if (r != received_ranges.end()) {
+            for (const auto& range : r->second) {
+                if (range.first > pos) {
+                    if (count++ == max_ranges)
+                        return missing;
+                    gaps.emplace_back(pos, range.first - pos);
+                }
+                pos = range.second;
+            }
+        }
+        if (pos < total) {
+            if (count++ == max_ranges)
+                return missing;
+            gaps.emplace_back(pos, total - pos);
+        }
+    }
+    return missing;
+}
+
 void
 ParsedMessage::msgpack_unpack(const msgpack::object& msg)
 {
@@ -177,6 +258,7 @@ ParsedMessage::msgpack_unpack(const msgpack::object& msg)
         msgpack::object* e;
         msgpack::object* v;
         msgpack::object* a;
+        msgpack::object* k;
         std::string_view q;
     } parsed {};
 
@@ -207,6 +289,10 @@ ParsedMessage::msgpack_unpack(const msgpack::object& msg)
             parsed.q = o.val.as<std::string_view>();
         else if (key == KEY_A)
             parsed.a = &o.val;
+        else if (key == KEY_ACK)
+            parsed.k = &o.val;
+        else if (key == KEY_WANT_ACK)
+            want_ack = o.val.as<bool>();
     }
 
     if (parsed.e)
@@ -217,6 +303,8 @@ ParsedMessage::msgpack_unpack(const msgpack::object& msg)
         type = MessageType::ValueData;
     else if (parsed.u)
         type = MessageType::ValueUpdate;
+    else if (parsed.k)
+        type = MessageType::ValueAck;
     else if (parsed.y and parsed.y->as<std::string_view>() != "q"sv)
         throw msgpack::type_error();
     else if (parsed.q == QUERY_PING)
@@ -250,6 +338,20 @@ ParsedMessage::msgpack_unpack(const msgpack::object& msg)
         return;
     }
 
+    if (type == MessageType::ValueAck) {
+        if (parsed.k->type != msgpack::type::MAP)
+            throw msgpack::type_error();
+        for (size_t i = 0; i < parsed.k->via.map.size; ++i) {
+            auto& ack = parsed.k->via.map.ptr[i];
+            if (ack.val.type != msgpack::type::ARRAY)
+                continue;
+            auto& ranges = missing_parts[ack.key.as<unsigned>()];
+            for (size_t j = 0; j + 1 < ack.val.via.array.size; j += 2)
+                ranges.emplace_back(ack.val.via.array.ptr[j].as<unsigned>(), ack.val.via.array.ptr[j+1].as<unsigned>());
+        }
+        return;
+    }
+
     if (!parsed.a && !parsed.r && !parsed.e && !parsed.u)
         throw msgpack::type_error();
     auto& req = parsed.a ? *parsed.a : (parsed.r ? *parsed.r : (parsed.u ? *parsed.u : *parsed.e));
@@ -21,6 +21,7 @@
 
 #include "net.h"
 #include "value.h"
+#include "trace_span.h"
 
 namespace dht {
 struct Node;
@@ -85,6 +86,9 @@ struct Request {
 
     Tid getTid() const { return tid; }
     MessageType getType() const { return type; }
+    unsigned getAttemptCount() const { return attempt_count; }
+    time_point getLastTry() const { return last_try; }
+    time_point getStart() const { return start; }
 
     void setExpired() {
         if (pending()) {
@@ -125,6 +129,7 @@ private:
     }
 
     void clear() {
+        span.end();
         on_done = {};
         on_error = {};
         on_expired = {};
@@ -137,7 +142,7 @@ private:
     State state_ {State::PENDING};
 
     unsigned attempt_count {0};                /* number of attempt to process the request. */
-    duration attempt_duration {((duration)Node::MAX_RESPONSE_TIME)/2};
+    duration attempt_duration {Node::MAX_RESPONSE_TIME};
     time_point start {time_point::min()};      /* time when the request is created. */
     time_point last_try {time_point::min()};   /* time of the last attempt to process the request. */
 
@@ -147,6 +152,8 @@ private:
 
     Blob msg {};                      /* the serialized message. */
     std::vector<Blob> parts;
+
+    trace::Span span;                 /* from the first attempt to the reply or expiration. */
 };
 
 } /* namespace net  */
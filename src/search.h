@@ -23,6 +23,7 @@
 #include "listener.h"
 #include "value_cache.h"
 #include "op_cache.h"
+#include "trace_span.h"
 
 namespace dht {
 
@@ -36,6 +37,7 @@ struct Dht::Get {
     QueryCallback query_cb;
     GetCallback get_cb;
     DoneCallback done_cb;
+    trace::Span span;
 };
 
 /**
@@ -46,6 +48,7 @@ struct Dht::Announce {
     Sp<Value> value;
     time_point created;
     std::vector<DoneCallback> callbacks;
+    trace::Span span;
 };
 
 struct Dht::SearchNode {
@@ -120,6 +123,21 @@ struct Dht::SearchNode {
         }
     }
 
+    /**
+     * Estimated memory used by the node state, in bytes.
+     */
+    size_t memoryUsage() const {
+        size_t ret = sizeof(SearchNode) + token.size();
+        ret += getStatus.size() * (MemoryStats::NODE_OVERHEAD + sizeof(SyncStatus::value_type) + sizeof(net::Request));
+        ret += acked.size() * (MemoryStats::NODE_OVERHEAD + sizeof(AnnounceStatusMap::value_type) + sizeof(net::Request));
+        for (const auto& l : listenStatus)
+            ret += MemoryStats::NODE_OVERHEAD + sizeof(NodeListenerStatus::value_type)
+                 + l.second.cache.size() * (MemoryStats::NODE_OVERHEAD + sizeof(Value));
+        for (const auto& p : pagination_queries)
+            ret += MemoryStats::NODE_OVERHEAD + sizeof(p) + p.second.size() * (sizeof(Sp<Query>) + sizeof(Query));
+        return ret;
+    }
+
     /**
      * Can we use this node to listen/announce now ?
      */
@@ -128,6 +146,30 @@ struct Dht::SearchNode {
                not token.empty() and last_get_reply >= now - Node::NODE_EXPIRE_TIME;
     }
 
+    /**
+     * Round-trip time we expect from this node: the smoothed RTT plus some
+     * variance margin, or half the maximum response time if it was never
+     * measured.
+     */
+    duration getExpectedRtt() const {
+        auto rtt = node->getRtt();
+        if (rtt == duration::zero())
+            return Node::MAX_RESPONSE_TIME/2;
+        return std::max<duration>(rtt + 2*node->getRttVar(), Node::MIN_RTO);
+    }
+
+    /**
+     * Time at which the oldest pending get request to this node becomes
+     * slower than expected, or time_point::max() if none is pending.
+     */
+    time_point getHedgeTime() const {
+        auto t = time_point::max();
+        for (const auto& s : getStatus)
+            if (s.second and s.second->pending())
+                t = std::min(t, s.second->getStart());
+        return t == time_point::max() ? t : t + getExpectedRtt();
+    }
+
     time_point getSyncTime(const time_point& now) const {
         if (node->isExpired() or token.empty())
             return now;
@@ -410,6 +452,10 @@ struct Dht::Search {
     time_point refill_time {time_point::min()};
     time_point step_time {time_point::min()};           /* the time of the last search step */
     Sp<Scheduler::Job> nextSearchStep {};
+    Sp<Scheduler::Job> hedgeStep {};     /* next time a solicited node becomes slow (latency-aware searches) */
+
+    /* Earlier search in the same routing table bucket, doing the node discovery for this one. */
+    std::weak_ptr<Search> leader {};
 
     bool expired {false};              /* no node, or all nodes expired */
     bool done {false};                 /* search is over, cached for later */
@@ -434,6 +480,11 @@ struct Dht::Search {
     SearchCache cache;
     Sp<Scheduler::Job> opExpirationJob;
 
+    /* memory accounted for this search in Dht::searches_memory */
+    size_t memory {0};
+
+    trace::Span span;
+
     ~Search() {
         if (opExpirationJob)
             opExpirationJob->cancel();
@@ -460,6 +511,21 @@ struct Dht::Search {
         return s;
     }
 
+    /**
+     * Estimated memory used by the search, its nodes, pending
+     * operations and cache, in bytes.
+     */
+    size_t memoryUsage() const {
+        size_t ret = sizeof(Search) + cache.memoryUsage();
+        for (const auto& n : nodes)
+            ret += sizeof(n) + n->memoryUsage();
+        for (const auto& a : announce)
+            ret += sizeof(Announce) + sizeof(Value) + a.value->size() + a.callbacks.size() * sizeof(DoneCallback);
+        ret += callbacks.size() * (MemoryStats::NODE_OVERHEAD + sizeof(decltype(callbacks)::value_type));
+        ret += listeners.size() * (MemoryStats::NODE_OVERHEAD + sizeof(decltype(listeners)::value_type));
+        return ret;
+    }
+
     /**
      * @returns true if the node was not present and added to the search
      */
@@ -481,6 +547,34 @@ struct Dht::Search {
         return count;
     }
 
+    /* number of concurrent sync requests slower than expected */
+    unsigned slowSolicitedNodeCount(time_point now) const {
+        unsigned count = 0;
+        for (const auto& n : nodes)
+            if (not n->isBad() and n->getHedgeTime() <= now)
+                count++;
+        return count;
+    }
+
+    /* next time a concurrent sync request will become slower than expected */
+    time_point getNextHedgeTime(time_point now) const {
+        auto next = time_point::max();
+        for (const auto& n : nodes) {
+            if (n->isBad())
+                continue;
+            auto t = n->getHedgeTime();
+            if (t > now)
+                next = std::min(next, t);
+        }
+        return next;
+    }
+
+    /**
+     * Among the TARGET_NODES closest live nodes, returns the one we can send
+     * a 'get' to with the lowest expected round-trip time.
+     */
+    SearchNode* getFastestNode(time_point now, time_point update, const Sp<Query>& q) const;
+
     /**
      * Can we use this search to announce ?
      */
@@ -510,7 +604,7 @@ struct Dht::Search {
      *
      * @param get  The 'get' operation which is now over.
      */
-    void setDone(const Get& get) {
+    void setDone(Get& get) {
         for (auto& n : nodes) {
             auto pqs = n->pagination_queries.find(get.query);
             if (pqs != n->pagination_queries.cend()) {
@@ -519,6 +613,8 @@ struct Dht::Search {
             }
             n->getStatus.erase(get.query);
         }
+        get.span.mark(trace::Point::Done);
+        get.span.end();
         if (get.done_cb)
             get.done_cb(true, getNodes());
     }
@@ -535,6 +631,15 @@ struct Dht::Search {
             n->acked.clear();
         }
         done = true;
+        span.mark(trace::Point::Done);
+        span.end();
+    }
+
+    /** Records a step of the search and of its pending gets */
+    void traceMark(trace::Point p) {
+        span.mark(p);
+        for (auto& g : callbacks)
+            g.second.span.mark(p);
     }
 
     bool isAnnounced(Value::Id id) const;
@@ -544,7 +649,7 @@ struct Dht::Search {
         if (gcb or qcb) {
             if (not cache.get(f, q, gcb, dcb)) {
                 const auto& now = scheduler.time();
-                callbacks.emplace(now, Get { now, f, q, qcb, gcb, dcb });
+                callbacks.emplace(now, Get { now, f, q, qcb, gcb, dcb, trace::Span::adopt("get") });
                 scheduler.edit(nextSearchStep, now);
             }
         }
@@ -628,7 +733,7 @@ struct Dht::Search {
             return a.value->id == value->id;
         });
         if (a_sr == announce.end()) {
-            auto& a = announce.emplace_back(Announce {permanent, value, created, {}} );
+            auto& a = announce.emplace_back(Announce {permanent, value, created, {}, trace::Span::adopt("put")} );
             if (callback)
                 a.callbacks.emplace_back(std::move(callback));
             for (auto& n : nodes) {
@@ -752,6 +857,8 @@ struct Dht::Search {
                 if (vid != Value::INVALID_ID and (!a.value || a.value->id != vid))
                     return true;
                 if (isAnnounced(a.value->id)) {
+                    a.span.mark(trace::Point::Done);
+                    a.span.end();
                     if (!a.callbacks.empty()) {
                         const auto& nodes = getNodes();
                         for (auto& cb : a.callbacks)
@@ -785,6 +892,8 @@ struct Dht::Search {
         listeners.clear();
         nodes.clear();
         nextSearchStep.reset();
+        hedgeStep.reset();
+        leader.reset();
     }
 };
 
@@ -909,6 +1018,28 @@ Dht::Search::isSynced(time_point now) const
     return i > 0;
 }
 
+Dht::SearchNode*
+Dht::Search::getFastestNode(time_point now, time_point update, const Sp<Query>& q) const
+{
+    SearchNode* fastest = nullptr;
+    duration fastestRtt = duration::max();
+    unsigned i = 0;
+    for (const auto& n : nodes) {
+        if (n->isBad())
+            continue;
+        if (n->canGet(now, update, q)) {
+            auto rtt = n->getExpectedRtt();
+            if (rtt < fastestRtt) {
+                fastest = n.get();
+                fastestRtt = rtt;
+            }
+        }
+        if (++i == TARGET_NODES)
+            break;
+    }
+    return fastest;
+}
+
 unsigned
 Dht::Search::syncLevel(time_point now) const
 {
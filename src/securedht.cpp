@@ -25,6 +25,7 @@
 #include "rng.h"
 
 #include "default_types.h"
+#include "trace_span.h"
 
 extern "C" {
 #include <gnutls/gnutls.h>
@@ -37,7 +38,10 @@ extern "C" {
 namespace dht {
 
 SecureDht::SecureDht(std::unique_ptr<DhtInterface> dht, SecureDht::Config conf, IdentityAnnouncedCb iacb, const std::shared_ptr<Logger>& l)
-: DhtInterface(l), dht_(std::move(dht)), key_(conf.id.first), certificate_(conf.id.second), enableCache_(conf.cert_cache_all)
+: DhtInterface(l), dht_(std::move(dht)), key_(conf.id.first), certificate_(conf.id.second), identityAnnouncedCb_(std::move(iacb)),
+    nodesCertificates_(conf.cert_cache_size, conf.cert_cache_ttl, conf.cert_cache_negative_ttl),
+    nodesPubKeys_(conf.cert_cache_size, conf.cert_cache_ttl, conf.cert_cache_negative_ttl),
+    enableCache_(conf.cert_cache_all)
 {
     if (!dht_) return;
     for (const auto& type : DEFAULT_TYPES)
@@ -52,20 +56,47 @@ SecureDht::SecureDht(std::unique_ptr<DhtInterface> dht, SecureDht::Config conf,
         auto certId = certificate_->getId();
         if (key_ and certId != key_->getPublicKey().getId())
             throw DhtException("SecureDht: provided certificate doesn't match private key.");
-        dht_->addOnConnectedCallback([this, certId, cb=std::move(iacb)]{
-            dht_->put(certId, Value {
-                CERTIFICATE_TYPE,
-                *certificate_,
-                1
-            }, [this, certId, cb=std::move(cb)](bool ok) {
-                if (cb) cb(ok);
-                if (logger_)
-                    logger_->d(certId, "SecureDht: certificate announcement %s", ok ? "succeeded" : "failed");
-            }, {}, true);
-        });
+        announceCertificate();
     }
 }
 
+void
+SecureDht::announceCertificate()
+{
+    auto announce = [this, cert = std::atomic_load(&certificate_)] {
+        auto certId = cert->getId();
+        dht_->put(certId, Value {
+            CERTIFICATE_TYPE,
+            *cert,
+            1
+        }, [this, certId](bool ok) {
+            if (identityAnnouncedCb_) identityAnnouncedCb_(ok);
+            if (logger_)
+                logger_->d(certId, "SecureDht: certificate announcement %s", ok ? "succeeded" : "failed");
+        }, {}, true);
+    };
+    if (dht_->getStatus() == NodeStatus::Connected)
+        announce();
+    else
+        dht_->addOnConnectedCallback(std::move(announce));
+}
+
+void
+SecureDht::setIdentity(const crypto::Identity& id)
+{
+    if (id.first and id.second and id.second->getId() != id.first->getPublicKey().getId())
+        throw DhtException("SecureDht: provided certificate doesn't match private key.");
+    auto certificate = std::atomic_load(&certificate_);
+    if (certificate and (not id.second or certificate->getId() != id.second->getId()))
+        dht_->cancelPut(certificate->getId(), 1);
+    std::atomic_store(&key_, id.first);
+    std::atomic_store(&certificate_, id.second);
+    if (logger_)
+        logger_->d("SecureDht: using identity %s", getId().to_c_str());
+    if (id.second)
+        announceCertificate();
+}
+
 SecureDht::~SecureDht(){
     dht_.reset();
 }
@@ -111,28 +142,25 @@ Sp<crypto::Certificate>
 SecureDht::getCertificate(const InfoHash& node) const
 {
     if (node == getId())
-        return certificate_;
-    auto it = nodesCertificates_.find(node);
-    if (it == nodesCertificates_.end())
-        return nullptr;
-    else
+        return std::atomic_load(&certificate_);
+    auto it = pinnedCertificates_.find(node);
+    if (it != pinnedCertificates_.end())
         return it->second;
+    return nodesCertificates_.get(node);
 }
 
 Sp<crypto::PublicKey>
 SecureDht::getPublicKey(const InfoHash& node) const
 {
-    if (node == getId())
-        return certificate_->getSharedPublicKey();
-    auto it = nodesPubKeys_.find(node);
-    if (it == nodesPubKeys_.end())
-        return nullptr;
-    else
-        return it->second;
+    if (node == getId()) {
+        auto certificate = std::atomic_load(&certificate_);
+        return certificate ? certificate->getSharedPublicKey() : Sp<crypto::PublicKey>{};
+    }
+    return nodesPubKeys_.get(node);
 }
 
 Sp<crypto::Certificate>
-SecureDht::registerCertificate(const InfoHash& node, const Blob& data)
+SecureDht::parseCertificate(const InfoHash& node, const Blob& data) const
 {
     Sp<crypto::Certificate> crt;
     try {
@@ -142,14 +170,7 @@ SecureDht::registerCertificate(const InfoHash& node, const Blob& data)
     }
     InfoHash h = crt->getPublicKey().getId();
     if (node == h) {
-        if (logger_)
-            logger_->d("Registering certificate for %s", h.toString().c_str());
-        auto it = nodesCertificates_.find(h);
-        if (it == nodesCertificates_.end())
-            std::tie(it, std::ignore) = nodesCertificates_.emplace(h, std::move(crt));
-        else
-            it->second = std::move(crt);
-        return it->second;
+        return crt;
     } else {
         if (logger_)
             logger_->w("Certificate %s for node %s does not match node id !", h.toString().c_str(), node.toString().c_str());
@@ -157,22 +178,42 @@ SecureDht::registerCertificate(const InfoHash& node, const Blob& data)
     }
 }
 
+Sp<crypto::Certificate>
+SecureDht::registerCertificate(const InfoHash& node, const Blob& data)
+{
+    auto crt = parseCertificate(node, data);
+    if (crt) {
+        if (logger_)
+            logger_->d("Registering certificate for %s", node.toString().c_str());
+        pinnedCertificates_[node] = crt;
+    }
+    return crt;
+}
+
 void
 SecureDht::registerCertificate(const Sp<crypto::Certificate>& cert)
 {
     if (cert)
-        nodesCertificates_[cert->getId()] = cert;
+        pinnedCertificates_[cert->getId()] = cert;
 }
 
 void
 SecureDht::findCertificate(const InfoHash& node, const std::function<void(const Sp<crypto::Certificate>)>& cb)
 {
-    Sp<crypto::Certificate> b = getCertificate(node);
-    if (b && *b) {
-        if (logger_)
-            logger_->d("Using certificate from cache for %s", node.to_c_str());
+    auto certificate = node == getId() ? std::atomic_load(&certificate_) : Sp<crypto::Certificate>{};
+    if (not certificate) {
+        auto it = pinnedCertificates_.find(node);
+        if (it != pinnedCertificates_.end())
+            certificate = it->second;
+    }
+    if (certificate) {
         if (cb)
-            cb(b);
+            cb(certificate);
+        return;
+    }
+    if (not nodesCertificates_.lookup(node, cb ? decltype(nodesCertificates_)::Callback(cb) : nullptr)) {
+        if (logger_)
+            logger_->d(node, "Using cached or pending certificate lookup for %s", node.to_c_str());
         return;
     }
     if (localQueryMethod_) {
@@ -180,53 +221,51 @@ SecureDht::findCertificate(const InfoHash& node, const std::function<void(const
         if (not res.empty()) {
             if (logger_)
                 logger_->d("Registering certificate from local store for %s", node.to_c_str());
-            nodesCertificates_.emplace(node, res.front());
-            if (cb)
-                cb(res.front());
+            nodesCertificates_.resolve(node, res.front());
             return;
         }
     }
 
     auto found = std::make_shared<bool>(false);
-    dht_->get(node, [cb,node,found,this](const std::vector<Sp<Value>>& vals) {
+    dht_->get(node, [node,found,this](const std::vector<Sp<Value>>& vals) {
         for (const auto& v : vals) {
-            if (auto cert = registerCertificate(node, v->data)) {
+            if (auto cert = parseCertificate(node, v->data)) {
                 *found = true;
                 if (logger_)
                     logger_->d(node, "Found certificate for %s", node.to_c_str());
-                if (cb)
-                    cb(cert);
+                nodesCertificates_.resolve(node, cert);
                 return false;
             }
         }
         return !*found;
-    }, [cb,found](bool) {
-        if (!*found and cb)
-            cb(nullptr);
+    }, [node,found,this](bool) {
+        if (!*found)
+            nodesCertificates_.resolve(node, nullptr);
     }, Value::TypeFilter(CERTIFICATE_TYPE));
 }
 
 void
 SecureDht::findPublicKey(const InfoHash& node, const std::function<void(const Sp<crypto::PublicKey>)>& cb)
 {
-    auto pk = getPublicKey(node);
-    if (pk && *pk) {
-        if (logger_)
-            logger_->d(node, "Found public key from cache for %s", node.to_c_str());
+    auto certificate = node == getId() ? std::atomic_load(&certificate_) : Sp<crypto::Certificate>{};
+    if (certificate) {
         if (cb)
-            cb(pk);
+            cb(certificate->getSharedPublicKey());
         return;
     }
-    findCertificate(node, [=](const Sp<crypto::Certificate>& crt) {
+    if (not nodesPubKeys_.lookup(node, cb ? decltype(nodesPubKeys_)::Callback(cb) : nullptr)) {
+        if (logger_)
+            logger_->d(node, "Using cached or pending public key lookup for %s", node.to_c_str());
+        return;
+    }
+    findCertificate(node, [node,this](const Sp<crypto::Certificate>& crt) {
+        Sp<crypto::PublicKey> pk;
         if (crt && *crt) {
-            auto pk = crt->getSharedPublicKey();
-            if (*pk) {
-                nodesPubKeys_[pk->getId()] = pk;
-                if (cb) cb(pk);
-                return;
-            }
+            pk = crt->getSharedPublicKey();
+            if (not *pk)
+                pk.reset();
         }
-        if (cb) cb(nullptr);
+        nodesPubKeys_.resolve(node, std::move(pk));
     });
 }
 
@@ -235,7 +274,8 @@ SecureDht::checkValue(const Sp<Value>& v)
 {
     // Decrypt encrypted values
     if (v->isEncrypted()) {
-        if (not key_) {
+        auto key = std::atomic_load(&key_);
+        if (not key) {
 #ifdef OPENDHT_PROXY_SERVER
             if (forward_all_) // We are currently a proxy, send messages to clients.
                 return v;
@@ -244,10 +284,10 @@ SecureDht::checkValue(const Sp<Value>& v)
         }
         try {
             auto isDecrypted = v->isDecrypted();
-            if (auto decrypted_val = v->decrypt(*key_)) {
+            if (auto decrypted_val = v->decrypt(*key)) {
                 auto cacheValue = not isDecrypted and decrypted_val->owner;
                 if (cacheValue)
-                    nodesPubKeys_[decrypted_val->owner->getId()] = decrypted_val->owner;
+                    nodesPubKeys_.insert(decrypted_val->owner->getId(), decrypted_val->owner);
                 return decrypted_val;
             }
         } catch (const std::exception& e) {
@@ -260,7 +300,7 @@ SecureDht::checkValue(const Sp<Value>& v)
         auto cacheValue = not v->isSignatureChecked() and enableCache_ and v->owner;
         if (v->checkSignature()) {
             if (cacheValue)
-                nodesPubKeys_[v->owner->getId()] = v->owner;
+                nodesPubKeys_.insert(v->owner->getId(), v->owner);
             return v;
         } else if (logger_)
             logger_->w("Signature verification failed for %s", v->toString().c_str());
@@ -276,6 +316,7 @@ ValueCallback
 SecureDht::getCallbackFilter(const ValueCallback& cb, Value::Filter&& filter)
 {
     return [=](const std::vector<Sp<Value>>& values, bool expired) {
+        trace::ScopedSpan span("verify");
         std::vector<Sp<Value>> tmpvals {};
         if (not filter)
             tmpvals.reserve(values.size());
@@ -295,6 +336,7 @@ GetCallback
 SecureDht::getCallbackFilter(const GetCallback& cb, Value::Filter&& filter)
 {
     return [=](const std::vector<Sp<Value>>& values) {
+        trace::ScopedSpan span("verify");
         std::vector<Sp<Value>> tmpvals {};
         if (not filter)
             tmpvals.reserve(values.size());
@@ -331,7 +373,7 @@ SecureDht::listen(const InfoHash& id, GetCallback cb, Value::Filter f, Where w)
 void
 SecureDht::putSigned(const InfoHash& hash, Sp<Value> val, DoneCallback callback, bool permanent)
 {
-    if (not key_ or not hash or not val)  {
+    if (not std::atomic_load(&key_) or not hash or not val)  {
         if (callback)
             callback(false, {});
         return;
@@ -377,7 +419,7 @@ SecureDht::putSigned(const InfoHash& hash, Sp<Value> val, DoneCallback callback,
 void
 SecureDht::putEncrypted(const InfoHash& hash, const InfoHash& to, Sp<Value> val, DoneCallback callback, bool permanent)
 {
-    if (not key_)  {
+    if (not std::atomic_load(&key_))  {
         if (callback)
             callback(false, {});
         return;
@@ -404,7 +446,7 @@ SecureDht::putEncrypted(const InfoHash& hash, const InfoHash& to, Sp<Value> val,
 void
 SecureDht::putEncrypted(const InfoHash& hash, const crypto::PublicKey& pk, Sp<Value> val, DoneCallback callback, bool permanent)
 {
-    if (not key_)  {
+    if (not std::atomic_load(&key_))  {
         if (callback)
             callback(false, {});
         return;
@@ -424,13 +466,13 @@ SecureDht::putEncrypted(const InfoHash& hash, const crypto::PublicKey& pk, Sp<Va
 void
 SecureDht::sign(Value& v) const
 {
-    v.sign(*key_);
+    v.sign(*std::atomic_load(&key_));
 }
 
 Value
 SecureDht::encrypt(Value& v, const crypto::PublicKey& to) const
 {
-    return v.encrypt(*key_, to);
+    return v.encrypt(*std::atomic_load(&key_), to);
 }
 
 Value
@@ -439,7 +481,7 @@ SecureDht::decrypt(const Value& v)
     if (not v.isEncrypted())
         throw DhtException("Data is not encrypted.");
 
-    auto decrypted = key_->decrypt(v.cypher);
+    auto decrypted = std::atomic_load(&key_)->decrypt(v.cypher);
 
     Value ret {v.id};
     auto msg = msgpack::unpack((const char*)decrypted.data(), decrypted.size());
@@ -22,6 +22,7 @@
 #include "value.h"
 #include "listener.h"
 
+#include <list>
 #include <map>
 #include <utility>
 
@@ -72,7 +73,6 @@ struct ValueStorage {
     Sp<Value> data {};
     time_point created {};
     time_point expiration {};
-    Sp<Scheduler::Job> expiration_job {};
     StorageBucket* store_bucket {nullptr};
 
     ValueStorage() {}
@@ -82,7 +82,11 @@ struct ValueStorage {
 
 
 struct Storage {
+    using ValueList = std::list<ValueStorage>;
+
     time_point maintenance_time {};
+    /* expires the values at nextExpiration() */
+    Sp<Scheduler::Job> expiration_job {};
     std::map<Sp<Node>, std::map<size_t, Listener>> listeners;
     std::map<size_t, LocalListener> local_listeners {};
     size_t listener_token {1};
@@ -90,6 +94,9 @@ struct Storage {
     /* The maximum number of values we store for a given hash. */
     static constexpr unsigned MAX_VALUES {64 * 1024};
 
+    /* Estimated memory used by a remote listener, in bytes. */
+    static constexpr size_t LISTENER_MEMORY {sizeof(Listener) + sizeof(size_t) + 2 * MemoryStats::NODE_OVERHEAD};
+
     /**
      * Changes caused by an operation on the storage.
      */
@@ -123,7 +130,22 @@ struct Storage {
         return total_size;
     }
 
-    const std::vector<ValueStorage>& getValues() const { return values; }
+    size_t listenerCount() const {
+        size_t count = 0;
+        for (const auto& node_listeners : listeners)
+            count += node_listeners.second.size();
+        return count;
+    }
+
+    const ValueList& getValues() const { return values; }
+
+    /**
+     * @return time of the next value expiration, time_point::max() if no
+     * value expires.
+     */
+    time_point nextExpiration() const {
+        return expirations.empty() ? time_point::max() : expirations.begin()->first.first;
+    }
 
     Sp<Value> getById(Value::Id vid) const {
         for (auto& v : values)
@@ -161,15 +183,20 @@ struct Storage {
      */
     std::pair<ValueStorage*, time_point>
     refresh(const InfoHash& id, const time_point& now, const Value::Id& vid, const TypeStore& types) {
-        for (auto& vs : values)
+        for (auto it = values.begin(); it != values.end(); ++it) {
+            auto& vs = *it;
             if (vs.data->id == vid) {
                 vs.created = now;
                 auto oldExp = vs.expiration;
-                vs.expiration = std::max(oldExp, now + types.getType(vs.data->type).expiration);
-                if (vs.store_bucket)
-                    vs.store_bucket->refresh(id, *vs.data, oldExp, vs.expiration);
+                auto newExp = std::max(oldExp, now + types.getType(vs.data->type).expiration);
+                if (newExp != oldExp) {
+                    setExpiration(it, newExp);
+                    if (vs.store_bucket)
+                        vs.store_bucket->refresh(id, *vs.data, oldExp, vs.expiration);
+                }
                 return {&vs, vs.expiration};
             }
+        }
         return {nullptr, time_point::max()};
     }
 
@@ -187,7 +214,18 @@ private:
     Storage(const Storage&) = delete;
     Storage& operator=(const Storage&) = delete;
 
-    std::vector<ValueStorage> values {};
+    /* Sets the expiration of a stored value, keeping expirations ordered */
+    void setExpiration(ValueList::iterator it, time_point expiration) {
+        if (it->expiration != time_point::max())
+            expirations.erase({it->expiration, it->data->id});
+        it->expiration = expiration;
+        if (expiration != time_point::max())
+            expirations.emplace(std::make_pair(expiration, it->data->id), it);
+    }
+
+    ValueList values {};
+    /* Values that expire, ordered by expiration time */
+    std::map<std::pair<time_point, Value::Id>, ValueList::iterator> expirations {};
     size_t total_size {};
 };
 
@@ -225,7 +263,7 @@ Storage::store(const InfoHash& id, const Sp<Value>& value, time_point created, t
             // clear quota for previous value
             if (it->store_bucket)
                 it->store_bucket->erase(id, *it->data, it->expiration);
-            it->expiration = expiration;
+            setExpiration(it, expiration);
             // update quota for new value
             it->store_bucket = sb;
             if (sb)
@@ -238,7 +276,8 @@ Storage::store(const InfoHash& id, const Sp<Value>& value, time_point created, t
         //DHT_LOG.DEBUG("Storing %s -> %s", id.toString().c_str(), value->toString().c_str());
         if (values.size() < MAX_VALUES) {
             total_size += size_new;
-            values.emplace_back(value, created, expiration);
+            values.emplace_back(value, created, time_point::max());
+            setExpiration(std::prev(values.end()), expiration);
             values.back().store_bucket = sb;
             if (sb)
                 sb->insert(id, *value, expiration);
@@ -259,8 +298,8 @@ Storage::remove(const InfoHash& id, Value::Id vid)
     ssize_t size = it->data->size();
     if (it->store_bucket)
         it->store_bucket->erase(id, *it->data, it->expiration);
-    if (it->expiration_job)
-        it->expiration_job->cancel();
+    if (it->expiration != time_point::max())
+        expirations.erase({it->expiration, vid});
     total_size -= size;
     auto value = it->data;
     values.erase(it);
@@ -273,6 +312,7 @@ Storage::clear()
     ssize_t num_values = values.size();
     ssize_t tot_size = total_size;
     values.clear();
+    expirations.clear();
     total_size = 0;
     return {-tot_size, -num_values, 0, 0};
 }
@@ -297,23 +337,20 @@ Storage::expire(const InfoHash& id, time_point now)
             ++nl_it;
     }
 
-    // expire values
-    auto r = std::partition(values.begin(), values.end(), [&](const ValueStorage& v) {
-        return v.expiration > now;
-    });
+    // expire values: only the expired prefix of expirations is visited
     std::vector<Sp<Value>> ret;
-    ret.reserve(std::distance(r, values.end()));
     ssize_t size_diff {0};
-    std::for_each(r, values.end(), [&](const ValueStorage& v) {
+    auto e = expirations.begin();
+    for (; e != expirations.end() and e->first.first <= now; ++e) {
+        auto& v = *e->second;
         size_diff -= v.data->size();
         if (v.store_bucket)
             v.store_bucket->erase(id, *v.data, v.expiration);
-        if (v.expiration_job)
-            v.expiration_job->cancel();
         ret.emplace_back(std::move(v.data));
-    });
+        values.erase(e->second);
+    }
+    expirations.erase(expirations.begin(), e);
     total_size += size_diff;
-    values.erase(r, values.end());
     return {size_diff, std::move(ret)};
 }
 
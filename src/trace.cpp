@@ -0,0 +1,219 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "trace_span.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace dht {
+namespace trace {
+
+#ifdef OPENDHT_TRACING
+
+namespace {
+
+struct Event {
+    const char* name;
+    uint64_t id;
+    time_point ts;
+    duration dur;
+    Phase phase;
+};
+
+/* Events kept per thread */
+constexpr size_t RING_SIZE {8192};
+
+struct Ring {
+    std::mutex lock;
+    std::vector<Event> events = std::vector<Event>(RING_SIZE);
+    size_t count {0};
+    unsigned tid {0};
+};
+
+/* Rings of all threads, kept after threads exit to dump their events */
+struct Rings {
+    std::mutex lock;
+    std::vector<std::shared_ptr<Ring>> rings;
+    unsigned nextTid {1};
+};
+
+Rings&
+rings()
+{
+    static Rings r;
+    return r;
+}
+
+Ring&
+localRing()
+{
+    thread_local std::shared_ptr<Ring> ring = [] {
+        auto r = std::make_shared<Ring>();
+        auto& all = rings();
+        std::lock_guard<std::mutex> lock(all.lock);
+        r->tid = all.nextTid++;
+        all.rings.emplace_back(r);
+        return r;
+    }();
+    return *ring;
+}
+
+thread_local const Enqueued* currentOp {nullptr};
+
+double
+toMicroseconds(duration d)
+{
+    return std::chrono::duration<double, std::micro>(d).count();
+}
+
+}
+
+void
+record(const char* name, Phase phase, uint64_t id, time_point ts, duration dur)
+{
+    auto& ring = localRing();
+    std::lock_guard<std::mutex> lock(ring.lock);
+    ring.events[ring.count++ % RING_SIZE] = {name, id, ts, dur, phase};
+}
+
+uint64_t
+newId()
+{
+    static std::atomic<uint64_t> id {1};
+    return id.fetch_add(1, std::memory_order_relaxed);
+}
+
+const char*
+pointName(Point p)
+{
+    switch (p) {
+    case Point::Started:      return "started";
+    case Point::FirstRequest: return "first request";
+    case Point::FirstValue:   return "first value";
+    case Point::Synced:       return "synced";
+    case Point::Done:         return "done";
+    default:                  return "?";
+    }
+}
+
+Dequeued::Dequeued(const Enqueued& op)
+{
+    currentOp = &op;
+}
+
+Dequeued::~Dequeued()
+{
+    currentOp = nullptr;
+}
+
+const Enqueued*
+Dequeued::current()
+{
+    return currentOp;
+}
+
+std::string
+Span::breakdown() const
+{
+    std::string ret;
+    for (size_t i = 0; i < times_.size(); i++) {
+        if (times_[i] == time_point::min())
+            continue;
+        if (not ret.empty())
+            ret += ", ";
+        auto p = (Point)i;
+        ret += p == Point::Started ? "queued" : pointName(p);
+        ret += ' ';
+        ret += print_duration(times_[i] - start_);
+    }
+    return ret;
+}
+
+#endif
+
+bool
+enabled()
+{
+#ifdef OPENDHT_TRACING
+    return true;
+#else
+    return false;
+#endif
+}
+
+void
+dumpChromeTrace(std::ostream& out)
+{
+    out << "{\"traceEvents\":[";
+#ifdef OPENDHT_TRACING
+    std::vector<std::shared_ptr<Ring>> all;
+    {
+        std::lock_guard<std::mutex> lock(rings().lock);
+        all = rings().rings;
+    }
+    bool first = true;
+    auto flags = out.flags();
+    out << std::fixed;
+    out.precision(3);
+    for (const auto& ring : all) {
+        std::lock_guard<std::mutex> lock(ring->lock);
+        auto begin = ring->count > RING_SIZE ? ring->count - RING_SIZE : 0;
+        for (auto i = begin; i < ring->count; i++) {
+            const auto& e = ring->events[i % RING_SIZE];
+            out << (first ? "\n" : ",\n");
+            first = false;
+            out << "{\"name\":\"" << e.name << "\",\"cat\":\"dht\",\"ph\":\"" << (char)e.phase
+                << "\",\"ts\":" << toMicroseconds(e.ts.time_since_epoch())
+                << ",\"pid\":1,\"tid\":" << ring->tid;
+            if (e.phase == Phase::Complete)
+                out << ",\"dur\":" << toMicroseconds(e.dur);
+            else
+                out << ",\"id\":" << e.id;
+            out << '}';
+        }
+    }
+    out.flags(flags);
+#endif
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+std::string
+dumpChromeTrace()
+{
+    std::ostringstream out;
+    dumpChromeTrace(out);
+    return out.str();
+}
+
+void
+clear()
+{
+#ifdef OPENDHT_TRACING
+    std::lock_guard<std::mutex> lock(rings().lock);
+    for (const auto& ring : rings().rings) {
+        std::lock_guard<std::mutex> l(ring->lock);
+        ring->count = 0;
+    }
+#endif
+}
+
+}
+}
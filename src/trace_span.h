@@ -0,0 +1,198 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "trace.h"
+#include "utils.h"
+
+#include <array>
+#include <string>
+
+namespace dht {
+namespace trace {
+
+/** Steps of an operation, recorded once per span */
+enum class Point : uint8_t {
+    Started = 0,    /* dequeued by the DHT thread */
+    FirstRequest,
+    FirstValue,
+    Synced,
+    Done,
+    Count
+};
+
+#ifdef OPENDHT_TRACING
+
+/* Chrome trace event phases */
+enum class Phase : char {
+    Begin = 'b',
+    End = 'e',
+    Instant = 'n',
+    Complete = 'X'
+};
+
+void record(const char* name, Phase phase, uint64_t id, time_point ts, duration dur = {});
+uint64_t newId();
+const char* pointName(Point p);
+
+/**
+ * Operation queued for the DHT thread, captured by the queued job.
+ */
+struct Enqueued {
+    time_point time;
+    explicit Enqueued() : time(clock::now()) {}
+};
+
+/**
+ * Makes the queue time of the running job available to the spans
+ * started by the calling thread (see Span::adopt), for its lifetime.
+ */
+class Dequeued {
+public:
+    explicit Dequeued(const Enqueued& op);
+    ~Dequeued();
+    Dequeued(const Dequeued&) = delete;
+    Dequeued& operator=(const Dequeued&) = delete;
+    static const Enqueued* current();
+};
+
+/**
+ * Asynchronous operation, from its start to its end or destruction,
+ * with the time of each of its steps.
+ */
+class Span {
+public:
+    Span() { times_.fill(time_point::min()); }
+    explicit Span(const char* name) : Span() { begin(name); }
+    ~Span() { end(); }
+
+    Span(Span&& o) noexcept : name_(o.name_), id_(o.id_), start_(o.start_), times_(o.times_) {
+        o.id_ = 0;
+    }
+    Span& operator=(Span&& o) noexcept {
+        if (this != &o) {
+            end();
+            name_ = o.name_;
+            id_ = o.id_;
+            start_ = o.start_;
+            times_ = o.times_;
+            o.id_ = 0;
+        }
+        return *this;
+    }
+
+    /**
+     * Starts a span for an operation started by the job running on the
+     * calling thread: the span starts when the job was queued.
+     */
+    static Span adopt(const char* name) {
+        Span s;
+        auto now = clock::now();
+        auto op = Dequeued::current();
+        s.begin(name, op ? op->time : now);
+        s.times_[(size_t)Point::Started] = now;
+        return s;
+    }
+
+    void begin(const char* name, time_point start = clock::now()) {
+        end();
+        times_.fill(time_point::min());
+        name_ = name;
+        id_ = newId();
+        start_ = start;
+        record(name_, Phase::Begin, id_, start_);
+    }
+
+    /** Records the first time the operation reaches p */
+    void mark(Point p) {
+        auto& t = times_[(size_t)p];
+        if (id_ and t == time_point::min()) {
+            t = clock::now();
+            record(pointName(p), Phase::Instant, id_, t);
+        }
+    }
+
+    void event(const char* name) {
+        if (id_)
+            record(name, Phase::Instant, id_, clock::now());
+    }
+
+    void end() {
+        if (id_) {
+            record(name_, Phase::End, id_, clock::now());
+            id_ = 0;
+        }
+    }
+
+    /** Time of each recorded step, relative to the start of the span */
+    std::string breakdown() const;
+
+private:
+    const char* name_ {nullptr};
+    uint64_t id_ {0};
+    time_point start_ {time_point::min()};
+    std::array<time_point, (size_t)Point::Count> times_;
+};
+
+/**
+ * Synchronous section, recorded when the scope is left.
+ */
+class ScopedSpan {
+public:
+    explicit ScopedSpan(const char* name) : name_(name), start_(clock::now()) {}
+    ~ScopedSpan() {
+        auto now = clock::now();
+        record(name_, Phase::Complete, 0, start_, now - start_);
+    }
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+private:
+    const char* name_;
+    time_point start_;
+};
+
+#else
+
+struct Enqueued {};
+
+class Dequeued {
+public:
+    explicit Dequeued(const Enqueued&) {}
+};
+
+class Span {
+public:
+    Span() {}
+    explicit Span(const char*) {}
+    static Span adopt(const char*) { return {}; }
+    void begin(const char*) {}
+    void mark(Point) {}
+    void event(const char*) {}
+    void end() {}
+    std::string breakdown() const { return {}; }
+};
+
+class ScopedSpan {
+public:
+    explicit ScopedSpan(const char*) {}
+};
+
+#endif
+
+}
+}
@@ -22,6 +22,7 @@
 
 #include "utils.h"
 #include "sockaddr.h"
+#include "infohash.h"
 #include "default_types.h"
 
 /* An IPv4 equivalent to IN6_IS_ADDR_UNSPECIFIED */
@@ -297,3 +298,27 @@ findMapValue(const msgpack::object& map, const char* key, size_t key_length) {
 }
 
 }
+
+size_t
+std::hash<dht::SockAddr>::operator()(const dht::SockAddr& addr) const noexcept
+{
+    uint64_t ret = dht::hashMix(dht::hashSeed() ^ ((uint64_t)addr.getFamily() << 16 | addr.getPort()));
+    switch (addr.getFamily()) {
+    case AF_INET: {
+        uint32_t a;
+        std::memcpy(&a, &addr.getIPv4().sin_addr, sizeof(a));
+        ret = dht::hashMix(ret ^ a);
+        break;
+    }
+    case AF_INET6: {
+        uint64_t a[2];
+        std::memcpy(a, &addr.getIPv6().sin6_addr, sizeof(a));
+        ret = dht::hashMix(ret ^ a[0]);
+        ret = dht::hashMix(ret ^ a[1]);
+        break;
+    }
+    default:
+        break;
+    }
+    return static_cast<size_t>(ret);
+}
@@ -21,6 +21,11 @@
 #include "cryptotester.h"
 
 #include <opendht/crypto.h>
+#include <opendht/value.h>
+#include <opendht/identity_factory.h>
+
+#include <atomic>
+#include <set>
 
 namespace test {
 CPPUNIT_TEST_SUITE_REGISTRATION(CryptoTester);
@@ -76,6 +81,58 @@ CryptoTester::testSignatureEncryption() {
     }
 }
 
+void
+CryptoTester::testEd25519Signature() {
+    auto identity = dht::crypto::generateEd25519Identity("ed25519");
+    const auto& public_key = identity.first->getPublicKey();
+    CPPUNIT_ASSERT(identity.second->getId() == public_key.getId());
+
+    std::vector<uint8_t> data {5, 10};
+    auto signature = identity.first->sign(data);
+    CPPUNIT_ASSERT_EQUAL((size_t)64, signature.size());
+    CPPUNIT_ASSERT(public_key.checkSignature(data, signature));
+    signature[7]++;
+    CPPUNIT_ASSERT(!public_key.checkSignature(data, signature));
+
+    // signed values survive serialization and are much smaller than with RSA
+    auto rsa_key = dht::crypto::PrivateKey::generate();
+    dht::Value value {data}, rsa_value {data};
+    value.sign(*identity.first);
+    rsa_value.sign(rsa_key);
+    auto packed = dht::packMsg(value);
+    auto unpacked = std::make_shared<dht::Value>(msgpack::unpack((const char*)packed.data(), packed.size()).get());
+    CPPUNIT_ASSERT(unpacked->checkSignature());
+    CPPUNIT_ASSERT(*unpacked->owner == public_key);
+    CPPUNIT_ASSERT(packed.size() * 4 < dht::packMsg(rsa_value).size());
+}
+
+void
+CryptoTester::testEd25519Encryption() {
+    auto key = dht::crypto::PrivateKey::generateEd25519();
+    const auto& public_key = key.getPublicKey();
+
+    std::vector<uint8_t> data1 {5, 10};
+    std::vector<uint8_t> data2(64 * 1024, 10);
+    for (const auto& data : {data1, data2}) {
+        auto encrypted = public_key.encrypt(data);
+        CPPUNIT_ASSERT_EQUAL(data.size() + 60, encrypted.size());
+        CPPUNIT_ASSERT(data == key.decrypt(encrypted));
+        encrypted[40]++;
+        CPPUNIT_ASSERT_THROW(key.decrypt(encrypted), std::runtime_error);
+    }
+
+    auto other_key = dht::crypto::PrivateKey::generateEd25519();
+    CPPUNIT_ASSERT_THROW(other_key.decrypt(public_key.encrypt(data1)), std::runtime_error);
+
+    // encrypted values
+    dht::Value value {data1};
+    auto encrypted = std::make_shared<dht::Value>(value.encrypt(other_key, public_key));
+    auto decrypted = encrypted->decrypt(key);
+    CPPUNIT_ASSERT(decrypted);
+    CPPUNIT_ASSERT(decrypted->data == data1);
+    CPPUNIT_ASSERT(*decrypted->owner == other_key.getPublicKey());
+}
+
 void
 CryptoTester::testCertificateRevocation()
 {
@@ -260,6 +317,96 @@ void CryptoTester::testAesEncryptionWithMultipleKeySizes() {
     }
 }
 
+void
+CryptoTester::testHashContext() {
+    std::vector<uint8_t> data(1000);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (uint8_t)(i * 7);
+
+    for (size_t hash_length : {20, 32, 64, 16}) {
+        auto expected = dht::crypto::hash(data, hash_length);
+        CPPUNIT_ASSERT_EQUAL(hash_length, expected.size());
+
+        dht::crypto::HashContext ctx(hash_length);
+        CPPUNIT_ASSERT_EQUAL(hash_length, ctx.length());
+        std::vector<uint8_t> out(ctx.length());
+        ctx.update(data.data(), 1);
+        ctx.update(data.data() + 1, 499);
+        ctx.update(data.data() + 500, 500);
+        ctx.final(out.data());
+        CPPUNIT_ASSERT(out == expected);
+
+        // The context is reset by final()
+        ctx.update(data);
+        ctx.final(out.data());
+        CPPUNIT_ASSERT(out == expected);
+    }
+
+    // InfoHash::get uses the same hash function
+    auto h = dht::InfoHash::get(data);
+    CPPUNIT_ASSERT(std::equal(h.begin(), h.end(), dht::crypto::hash(data, h.size()).begin()));
+}
+
+void
+CryptoTester::testTokenGenerator() {
+    std::vector<uint8_t> key(32, 42);
+    dht::crypto::TokenGenerator gen(key.data(), key.size());
+    const uint8_t data[] = {127, 0, 0, 1, 0x1f, 0x90};
+
+    auto token = gen.get(data, sizeof(data));
+    CPPUNIT_ASSERT(token == gen.get(data, sizeof(data)));
+    CPPUNIT_ASSERT(gen.check(token.data(), token.size(), data, sizeof(data)));
+    // Truncated tokens are prefixes of the full token
+    CPPUNIT_ASSERT(gen.check(token.data(), 16, data, sizeof(data)));
+    CPPUNIT_ASSERT(not gen.check(token.data(), 0, data, sizeof(data)));
+
+    // Other data or other key
+    const uint8_t other[] = {127, 0, 0, 1, 0x1f, 0x91};
+    CPPUNIT_ASSERT(not gen.check(token.data(), token.size(), other, sizeof(other)));
+    dht::crypto::TokenGenerator random_gen;
+    CPPUNIT_ASSERT(not random_gen.check(token.data(), token.size(), data, sizeof(data)));
+
+    // Tampered token
+    token[7] ^= 1;
+    CPPUNIT_ASSERT(not gen.check(token.data(), token.size(), data, sizeof(data)));
+}
+
+void
+CryptoTester::testIdentityFactory() {
+    std::atomic_uint generated {0};
+    {
+        dht::crypto::IdentityFactory factory(2, [&]{
+            generated++;
+            return dht::crypto::PrivateKey::generateEC();
+        });
+        std::vector<std::future<dht::crypto::Identity>> futures;
+        for (unsigned i = 0; i < 4; i++)
+            futures.emplace_back(factory.getIdentity("factory"));
+        std::set<dht::InfoHash> ids;
+        for (auto& f : futures) {
+            auto id = f.get();
+            CPPUNIT_ASSERT(id.first and id.second);
+            CPPUNIT_ASSERT(id.second->getId() == id.first->getPublicKey().getId());
+            CPPUNIT_ASSERT(id.second->isCA());
+            ids.emplace(id.second->getId());
+        }
+        CPPUNIT_ASSERT_EQUAL((size_t)4, ids.size());
+
+        auto ca = factory.getIdentity("ca").get();
+        auto id = factory.getIdentity("signed", ca).get();
+        CPPUNIT_ASSERT(not id.second->isCA());
+        CPPUNIT_ASSERT(id.second->issuer and id.second->issuer->getId() == ca.second->getId());
+    }
+    // keys being generated are waited for, and the pool is bounded
+    CPPUNIT_ASSERT(generated >= 6u and generated <= 8u);
+
+    // generation errors are forwarded
+    dht::crypto::IdentityFactory failing(1, []() -> dht::crypto::PrivateKey {
+        throw dht::crypto::CryptoException("no key");
+    });
+    CPPUNIT_ASSERT_THROW(failing.getKey().get(), dht::crypto::CryptoException);
+}
+
 void
 CryptoTester::tearDown() {
 
@@ -29,12 +29,17 @@ namespace test {
 class CryptoTester : public CppUnit::TestFixture {
     CPPUNIT_TEST_SUITE(CryptoTester);
     CPPUNIT_TEST(testSignatureEncryption);
+    CPPUNIT_TEST(testEd25519Signature);
+    CPPUNIT_TEST(testEd25519Encryption);
     CPPUNIT_TEST(testCertificateRevocation);
     CPPUNIT_TEST(testCertificateRequest);
     CPPUNIT_TEST(testCertificateSerialNumber);
     CPPUNIT_TEST(testOcsp);
     CPPUNIT_TEST(testAesEncryption);
     CPPUNIT_TEST(testAesEncryptionWithMultipleKeySizes);
+    CPPUNIT_TEST(testHashContext);
+    CPPUNIT_TEST(testTokenGenerator);
+    CPPUNIT_TEST(testIdentityFactory);
     CPPUNIT_TEST_SUITE_END();
 
  public:
@@ -50,6 +55,14 @@ class CryptoTester : public CppUnit::TestFixture {
      * Test data signature, encryption and decryption
      */
     void testSignatureEncryption();
+    /**
+     * Test Ed25519 identities and signed values
+     */
+    void testEd25519Signature();
+    /**
+     * Test X25519 encryption with Ed25519 keys
+     */
+    void testEd25519Encryption();
     /**
      * Test certificate generation, validation and revocation
      */
@@ -71,6 +84,18 @@ class CryptoTester : public CppUnit::TestFixture {
      */
     void testAesEncryption();
     void testAesEncryptionWithMultipleKeySizes();
+    /**
+     * Test incremental hashing against crypto::hash
+     */
+    void testHashContext();
+    /**
+     * Test keyed token generation and checking
+     */
+    void testTokenGenerator();
+    /**
+     * Test asynchronous key and identity generation
+     */
+    void testIdentityFactory();
 };
 
 }  // namespace test
@@ -26,6 +26,9 @@
 
 #include <chrono>
 #include <condition_variable>
+#include <future>
+#include <set>
+#include <thread>
 
 using namespace std::chrono_literals;
 
@@ -334,4 +337,134 @@ DhtProxyTester::testShutdownStop()
     CPPUNIT_ASSERT_EQUAL(2*C, callback_count.load());
 }
 
+void
+DhtProxyTester::testSessionMemoryLimit() {
+    uint16_t port = 1024 + (std::rand() % (65535 - 1024));
+    dht::ProxyServerConfig serverConfig;
+    serverConfig.port = port;
+    serverConfig.maxSessionMemory = 1;
+    serverProxy = std::make_unique<dht::DhtProxyServer>(nodeProxy, serverConfig);
+
+    auto key = dht::InfoHash::get("aperture");
+    auto putPermanent = [&](dht::Value::Id id) {
+        std::promise<unsigned> status;
+        dht::Value value {"Still alive"};
+        value.id = id;
+        auto body = value.toJson();
+        body["permanent"] = true;
+        auto request = std::make_shared<dht::http::Request>(serverProxy->io_context(),
+            "http://127.0.0.1:" + std::to_string(port) + "/key/" + key.toString(),
+            [&](const dht::http::Response& response) {
+                status.set_value(response.status_code);
+            });
+        request->set_method(restinio::http_method_post());
+        request->set_body(Json::writeString(Json::StreamWriterBuilder{}, body));
+        request->send();
+        return status.get_future().get();
+    };
+
+    CPPUNIT_ASSERT_EQUAL(200u, putPermanent(1));
+    // wait for the session memory estimate to be refreshed
+    std::this_thread::sleep_for(1500ms);
+    // new sessions are refused, existing ones can still be refreshed
+    CPPUNIT_ASSERT_EQUAL(503u, putPermanent(2));
+    CPPUNIT_ASSERT_EQUAL(200u, putPermanent(1));
+}
+
+#ifdef OPENDHT_PUSH_NOTIFICATIONS
+void
+DhtProxyTester::testPushNotificationBatching() {
+    // Arrange
+    constexpr unsigned N = 500;
+    constexpr unsigned BATCH = 100;
+    std::condition_variable cv;
+    std::mutex cv_m;
+    std::unique_lock<std::mutex> lk(cv_m);
+    std::set<std::string> receivedTokens;
+    unsigned receivedCount = 0;
+    unsigned gatewayRequests = 0;
+
+    // stub gorush gateway
+    uint16_t gatewayPort = 1024 + (std::rand() % (65535 - 1024));
+    auto gateway = restinio::run_async(
+        restinio::own_io_context(),
+        restinio::server_settings_t<>{}
+            .address("127.0.0.1")
+            .port(gatewayPort)
+            .request_handler([&](restinio::request_handle_t req) {
+                Json::Value root;
+                std::string err;
+                Json::CharReaderBuilder rbuilder;
+                auto reader = std::unique_ptr<Json::CharReader>(rbuilder.newCharReader());
+                const auto& body = req->body();
+                if (reader->parse(body.data(), body.data() + body.size(), &root, &err)) {
+                    std::lock_guard<std::mutex> lk(cv_m);
+                    gatewayRequests++;
+                    for (const auto& notification : root["notifications"])
+                        for (const auto& token : notification["tokens"]) {
+                            receivedTokens.emplace(token.asString());
+                            receivedCount++;
+                        }
+                    cv.notify_all();
+                }
+                return req->create_response()
+                    .append_header(restinio::http_field::content_type, "application/json")
+                    .set_body("{\"counts\":0,\"success\":\"ok\"}")
+                    .done();
+            }),
+        1u);
+
+    uint16_t port = 1024 + (std::rand() % (65535 - 1024));
+    dht::ProxyServerConfig serverConfig;
+    serverConfig.port = port;
+    serverConfig.pushServer = "127.0.0.1:" + std::to_string(gatewayPort);
+    serverConfig.pushBatchSize = BATCH;
+    serverProxy = std::make_unique<dht::DhtProxyServer>(nodeProxy, serverConfig);
+
+    auto key = dht::InfoHash::get("wheatley");
+    unsigned subscribed = 0;
+    std::vector<std::shared_ptr<dht::http::Request>> requests;
+    for (unsigned i = 0; i < N; i++) {
+        auto request = std::make_shared<dht::http::Request>(serverProxy->io_context(),
+            "http://127.0.0.1:" + std::to_string(port) + "/key/" + key.toString(),
+            [&](const dht::http::Response& response) {
+                std::lock_guard<std::mutex> lk(cv_m);
+                if (response.status_code == 200)
+                    subscribed++;
+                cv.notify_all();
+            });
+        Json::Value body;
+        body["key"] = "token" + std::to_string(i);
+        body["platform"] = "android";
+        body["client_id"] = "client" + std::to_string(i);
+        request->set_method(restinio::http_method_subscribe());
+        request->set_body(Json::writeString(Json::StreamWriterBuilder{}, body));
+        requests.emplace_back(std::move(request));
+    }
+    for (auto& request : requests)
+        request->send();
+    CPPUNIT_ASSERT(cv.wait_for(lk, 30s, [&]{ return subscribed == N; }));
+
+    // Act
+    lk.unlock();
+    nodePeer.put(key, dht::Value("The cake is a lie"));
+    lk.lock();
+
+    // Assert
+    CPPUNIT_ASSERT(cv.wait_for(lk, 30s, [&]{ return receivedTokens.size() == N; }));
+    // every subscriber is notified exactly once, in full batches
+    CPPUNIT_ASSERT_EQUAL(N, receivedCount);
+    for (unsigned i = 0; i < N; i++)
+        CPPUNIT_ASSERT(receivedTokens.count("token" + std::to_string(i)));
+    CPPUNIT_ASSERT_EQUAL((N + BATCH - 1) / BATCH, gatewayRequests);
+
+    auto stats = serverProxy->updateStats({});
+    CPPUNIT_ASSERT_EQUAL((uint64_t)N, stats->androidPush.highPriorityCount + stats->androidPush.normalPriorityCount);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)0, stats->androidPush.queueDepth);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)0, stats->androidPush.droppedCount);
+    lk.unlock();
+    serverProxy.reset();
+}
+#endif
+
 }  // namespace test
@@ -37,6 +37,10 @@ class DhtProxyTester : public CppUnit::TestFixture {
     CPPUNIT_TEST(testPutGet40KChars);
     CPPUNIT_TEST(testFuzzy);
     CPPUNIT_TEST(testShutdownStop);
+    CPPUNIT_TEST(testSessionMemoryLimit);
+#ifdef OPENDHT_PUSH_NOTIFICATIONS
+    CPPUNIT_TEST(testPushNotificationBatching);
+#endif
     CPPUNIT_TEST_SUITE_END();
 
  public:
@@ -71,6 +75,20 @@ class DhtProxyTester : public CppUnit::TestFixture {
 
    void testShutdownStop();
 
+   /**
+    * Past the session memory limit, the proxy refuses new permanent
+    * puts but accepts refreshes of existing ones
+    */
+   void testSessionMemoryLimit();
+
+#ifdef OPENDHT_PUSH_NOTIFICATIONS
+   /**
+    * Notifications to many push listeners are batched
+    * in few requests to a stub push gateway
+    */
+   void testPushNotificationBatching();
+#endif
+
  private:
     dht::DhtRunner::Config clientConfig {};
     dht::DhtRunner nodePeer;
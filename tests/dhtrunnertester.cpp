@@ -20,9 +20,16 @@
 #include "dhtrunnertester.h"
 
 #include <opendht/thread_pool.h>
+#include <opendht/network_utils.h>
 
+#include <algorithm>
+#include <map>
 #include <chrono>
 #include <mutex>
+#include <future>
+#include <random>
+#include <thread>
+#include <iostream>
 #include <condition_variable>
 using namespace std::chrono_literals;
 using namespace std::literals;
@@ -90,6 +97,65 @@ DhtRunnerTester::testGetPut() {
     CPPUNIT_ASSERT(vals.front()->data == val_data);
 }
 
+void
+DhtRunnerTester::testGetPutMany() {
+    constexpr unsigned N = 64;
+    std::vector<dht::InfoHash> keys;
+    std::vector<std::pair<dht::InfoHash, std::shared_ptr<dht::Value>>> values;
+    for (unsigned i=0; i<N; i++) {
+        keys.emplace_back(dht::InfoHash::get("many" + std::to_string(i)));
+        values.emplace_back(keys.back(), std::make_shared<dht::Value>("hey" + std::to_string(i)));
+    }
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::map<dht::InfoHash, unsigned> listened;
+    auto tokens = node1.listenMany(keys, [&](const dht::InfoHash& key, const std::vector<std::shared_ptr<dht::Value>>& vals, bool expired) {
+        if (not expired) {
+            std::lock_guard<std::mutex> lk(m);
+            listened[key] += vals.size();
+            cv.notify_all();
+        }
+        return true;
+    }).share();
+
+    std::promise<bool> putDone;
+    unsigned putCalls {0};
+    size_t putFailed {0};
+    node2.putMany(values, [&](bool ok, const std::vector<dht::InfoHash>& failed) {
+        putCalls++;
+        putFailed = failed.size();
+        putDone.set_value(ok);
+    });
+    CPPUNIT_ASSERT(putDone.get_future().get());
+    CPPUNIT_ASSERT_EQUAL(1u, putCalls);
+    CPPUNIT_ASSERT_EQUAL((size_t)0, putFailed);
+
+    std::map<dht::InfoHash, std::vector<dht::Blob>> found;
+    std::promise<bool> getDone;
+    node1.getMany(keys, [&](const dht::InfoHash& key, const std::vector<std::shared_ptr<dht::Value>>& vals) {
+        std::lock_guard<std::mutex> lk(m);
+        for (const auto& v : vals)
+            found[key].emplace_back(v->data);
+        return true;
+    }, [&](bool ok, const std::vector<dht::InfoHash>&) {
+        getDone.set_value(ok);
+    });
+    CPPUNIT_ASSERT(getDone.get_future().get());
+    CPPUNIT_ASSERT_EQUAL((size_t)N, found.size());
+    for (const auto& v : values) {
+        const auto& blobs = found[v.first];
+        CPPUNIT_ASSERT(std::find(blobs.begin(), blobs.end(), v.second->data) != blobs.end());
+    }
+
+    {
+        std::unique_lock<std::mutex> lk(m);
+        CPPUNIT_ASSERT(cv.wait_for(lk, 10s, [&]{ return listened.size() == N; }));
+    }
+    CPPUNIT_ASSERT_EQUAL((size_t)N, tokens.get().size());
+    node1.cancelListen(keys, tokens);
+}
+
 void
 DhtRunnerTester::testPutDuplicate() {
     auto key = dht::InfoHash::get("123");
@@ -423,6 +489,332 @@ DhtRunnerTester::testListenLotOfBytes() {
 }
 
 
+void
+DhtRunnerTester::testCertificateCache() {
+    auto id = dht::crypto::generateEcIdentity("cache");
+    node1.registerCertificate(id.second);
+    auto unknown = dht::InfoHash::get("unknown certificate");
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    unsigned done {0}, found {0};
+    auto cb = [&](const std::shared_ptr<dht::crypto::Certificate>& crt) {
+        std::lock_guard<std::mutex> lk(mtx);
+        done++;
+        if (crt)
+            found++;
+        cv.notify_all();
+    };
+
+    // concurrent lookups of the same id share one query
+    node1.findCertificate(unknown, cb);
+    node1.findCertificate(unknown, cb);
+    node1.findCertificate(id.second->getId(), cb);
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        CPPUNIT_ASSERT(cv.wait_for(lk, 30s, [&]{ return done == 3; }));
+    }
+    // the failure is cached
+    node1.findCertificate(unknown, cb);
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        CPPUNIT_ASSERT(cv.wait_for(lk, 10s, [&]{ return done == 4; }));
+    }
+    CPPUNIT_ASSERT_EQUAL(1u, found);
+
+    // the registered certificate is pinned outside of the cache
+    auto stats = node1.getCertificateCacheStats();
+    CPPUNIT_ASSERT_EQUAL((uint64_t)0, stats.hits);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)1, stats.negative_hits);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)1, stats.coalesced);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)1, stats.misses);
+    CPPUNIT_ASSERT_EQUAL((size_t)1, stats.size);
+    CPPUNIT_ASSERT(stats.hitRate() == 2. / 3.);
+}
+
+void
+DhtRunnerTester::testNodeRtt() {
+    // Generate a few request/reply exchanges between the two nodes
+    for (unsigned i=0; i<4; i++)
+        node1.get(dht::InfoHash::get("rtt" + std::to_string(i))).get();
+
+    auto nodes = node1.exportNodes();
+    CPPUNIT_ASSERT(not nodes.empty());
+    auto it = std::find_if(nodes.begin(), nodes.end(), [&](const dht::NodeExport& n) {
+        return n.id == node2.getNodeId();
+    });
+    CPPUNIT_ASSERT(it != nodes.end());
+    CPPUNIT_ASSERT(it->rtt.count() > 0);
+    CPPUNIT_ASSERT(it->rtt < std::chrono::seconds(2));
+
+    auto stats = node1.getNodesStats(AF_INET);
+    CPPUNIT_ASSERT_EQUAL(dht::NodeStats::RTT_HISTOGRAM_BOUNDS.size() + 1, stats.rtt_histogram.size());
+    unsigned sampled {0};
+    for (auto c : stats.rtt_histogram)
+        sampled += c;
+    CPPUNIT_ASSERT(sampled > 0);
+}
+
+namespace {
+
+/**
+ * In-memory datagram network dropping a fraction of packets.
+ */
+class LossyNetwork {
+public:
+    class Socket : public dht::net::DatagramSocket {
+    public:
+        Socket(LossyNetwork& net, in_port_t port) : net_(net) {
+            bound_.setFamily(AF_INET);
+            bound_.setAddress("127.0.0.1");
+            bound_.setPort(port);
+            std::lock_guard<std::mutex> lk(net_.lock_);
+            net_.sockets_[port] = this;
+        }
+        ~Socket() { stop(); }
+
+        int sendTo(const dht::SockAddr& dest, const uint8_t* data, size_t size, bool) override {
+            std::lock_guard<std::mutex> lk(net_.lock_);
+            net_.sent_++;
+            net_.sentBytes_ += size;
+            if (std::bernoulli_distribution(net_.loss_)(net_.rd_))
+                return 0;
+            auto s = net_.sockets_.find(dest.getPort());
+            if (s != net_.sockets_.end()) {
+                dht::net::PacketList pkts;
+                pkts.emplace_back(dht::net::ReceivedPacket {dht::Blob(data, data + size), bound_, dht::clock::now()});
+                s->second->onReceived(std::move(pkts));
+            }
+            return 0;
+        }
+        bool hasIPv4() const override { return true; }
+        bool hasIPv6() const override { return false; }
+        const dht::SockAddr& getBoundRef(sa_family_t family = AF_UNSPEC) const override {
+            static const dht::SockAddr none {};
+            return family == AF_INET6 ? none : bound_;
+        }
+        void stop() override {
+            std::lock_guard<std::mutex> lk(net_.lock_);
+            net_.sockets_.erase(bound_.getPort());
+        }
+    private:
+        LossyNetwork& net_;
+        dht::SockAddr bound_;
+    };
+
+    std::unique_ptr<dht::net::DatagramSocket> makeSocket(in_port_t port) {
+        return std::make_unique<Socket>(*this, port);
+    }
+    void setLoss(double loss) {
+        std::lock_guard<std::mutex> lk(lock_);
+        loss_ = loss;
+        sent_ = 0;
+        sentBytes_ = 0;
+    }
+    size_t getSentCount() {
+        std::lock_guard<std::mutex> lk(lock_);
+        return sent_;
+    }
+    size_t getSentBytes() {
+        std::lock_guard<std::mutex> lk(lock_);
+        return sentBytes_;
+    }
+private:
+    std::mutex lock_;
+    std::map<in_port_t, Socket*> sockets_;
+    std::mt19937 rd_ {42};
+    double loss_ {0};
+    size_t sent_ {0};
+    size_t sentBytes_ {0};
+};
+
+}
+
+void
+DhtRunnerTester::testLossyValueParts() {
+    LossyNetwork net;
+    dht::DhtRunner::Config config;
+    config.dht_config.node_config.max_peer_req_per_sec = -1;
+    config.dht_config.node_config.max_req_per_sec = -1;
+    dht::DhtRunner nodeA, nodeB;
+    {
+        dht::DhtRunner::Context context;
+        context.sock = net.makeSocket(5001);
+        nodeA.run(config, std::move(context));
+    }
+    {
+        dht::DhtRunner::Context context;
+        context.sock = net.makeSocket(5002);
+        nodeB.run(config, std::move(context));
+    }
+    nodeB.bootstrap(nodeA.getBound());
+    std::promise<bool> connected;
+    nodeB.put(dht::InfoHash::get("lossy"), dht::Value(dht::Blob {1, 2, 3}), [&](bool ok) {
+        connected.set_value(ok);
+    });
+    CPPUNIT_ASSERT(connected.get_future().get());
+
+    // Each value is sent as about 40 fragments
+    constexpr unsigned N = 16;
+    constexpr size_t VALUE_SIZE = 50 * 1024;
+    for (double loss : {0.01, 0.05, 0.1}) {
+        net.setLoss(loss);
+        std::mutex mutex;
+        std::condition_variable cv;
+        unsigned putCount {0}, putOkCount {0};
+        for (unsigned i=0; i<N; i++) {
+            auto key = dht::InfoHash::get("lossy" + std::to_string(loss) + std::to_string(i));
+            nodeB.put(key, dht::Value(dht::Blob(VALUE_SIZE, (uint8_t)i)), [&](bool ok) {
+                std::lock_guard<std::mutex> lk(mutex);
+                putCount++;
+                if (ok) putOkCount++;
+                cv.notify_all();
+            });
+        }
+        std::unique_lock<std::mutex> lk(mutex);
+        CPPUNIT_ASSERT(cv.wait_for(lk, 30s, [&]{ return putCount == N; }));
+        CPPUNIT_ASSERT_EQUAL(N, putOkCount);
+        // Only lost fragments are resent. Resending whole values would
+        // take 1.5x the payload at 1% loss and much more above.
+        auto payload = N * VALUE_SIZE;
+        CPPUNIT_ASSERT(net.getSentBytes() < payload * (1.15 + 3 * loss) + 64 * 1024);
+    }
+    net.setLoss(0);
+    nodeA.join();
+    nodeB.join();
+}
+
+void
+DhtRunnerTester::testMetrics() {
+    dht::metrics::Registry registry;
+    auto& counter = registry.counter("test_total", "Test counter", {{"kind", "a"}});
+    CPPUNIT_ASSERT(&counter == &registry.counter("test_total", "Test counter", {{"kind", "a"}}));
+    CPPUNIT_ASSERT(&counter != &registry.counter("test_total", "Test counter", {{"kind", "b"}}));
+    CPPUNIT_ASSERT_THROW(registry.gauge("test_total", "Test gauge"), std::invalid_argument);
+    counter.inc(3);
+    auto& histogram = registry.histogram("test_seconds", "Test histogram", {}, {.1, 1.});
+    histogram.observe(.05);
+    histogram.observe(.5);
+    histogram.observe(5.);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)3, histogram.count());
+    CPPUNIT_ASSERT((histogram.buckets() == std::vector<uint64_t>{1, 1, 1}));
+    auto text = registry.toPrometheus();
+    CPPUNIT_ASSERT(text.find("test_total{kind=\"a\"} 3\n") != std::string::npos);
+    CPPUNIT_ASSERT(text.find("test_seconds_bucket{le=\"1\"} 2\n") != std::string::npos);
+    CPPUNIT_ASSERT(text.find("test_seconds_bucket{le=\"+Inf\"} 3\n") != std::string::npos);
+
+    auto key = dht::InfoHash::get("metrics");
+    std::promise<bool> p;
+    node2.put(key, dht::Value("hey"), [&](bool ok){
+        p.set_value(ok);
+    });
+    CPPUNIT_ASSERT(p.get_future().get());
+    CPPUNIT_ASSERT(not node1.get(key).get().empty());
+    auto metrics = node1.getMetrics();
+    CPPUNIT_ASSERT(metrics);
+    auto& received = metrics->counter("dht_messages_received_total", "Parsed messages received", {{"type", "reply"}});
+    CPPUNIT_ASSERT(received.value() > 0);
+    CPPUNIT_ASSERT(metrics->histogram("dht_get_duration_seconds", "Time to complete get operations").count() > 0);
+}
+
+void
+DhtRunnerTester::testMemoryStats() {
+    auto key = dht::InfoHash::get("memory");
+    std::promise<bool> p;
+    node2.put(key, dht::Value("hey"), [&](bool ok){
+        p.set_value(ok);
+    });
+    CPPUNIT_ASSERT(p.get_future().get());
+
+    auto info1 = node1.getNodeInfo();
+    CPPUNIT_ASSERT(info1.memory.storage > 0);
+    auto info2 = node2.getNodeInfo();
+    CPPUNIT_ASSERT(info2.memory.searches > 0);
+    CPPUNIT_ASSERT(info2.memory.total() >= info2.memory.searches + info2.memory.rx_queue);
+
+    dht::NodeInfo parsed(info2.toJson());
+    CPPUNIT_ASSERT_EQUAL(info2.memory.searches, parsed.memory.searches);
+    CPPUNIT_ASSERT_EQUAL(info2.memory.total(), parsed.memory.total());
+}
+
+void
+DhtRunnerTester::testMemoryLimits() {
+    auto waitFor = [](const std::function<bool()>& pred) {
+        for (auto end = std::chrono::steady_clock::now() + 30s; std::chrono::steady_clock::now() < end;) {
+            if (pred())
+                return true;
+            std::this_thread::sleep_for(50ms);
+        }
+        return false;
+    };
+    auto getOk = [](dht::DhtRunner& node, const dht::InfoHash& key) {
+        std::promise<bool> p;
+        node.get(key, [](const std::shared_ptr<dht::Value>&){ return true; }, [&](bool ok){
+            p.set_value(ok);
+        });
+        return p.get_future().get();
+    };
+    auto putDone = [](dht::DhtRunner& node, const dht::InfoHash& key, dht::Value&& value) {
+        std::promise<bool> p;
+        node.put(key, std::move(value), [&](bool ok){
+            p.set_value(ok);
+        });
+        return p.get_future().get();
+    };
+
+    dht::DhtRunner::Config config;
+    config.dht_config.node_config.max_peer_req_per_sec = -1;
+    config.dht_config.node_config.max_req_per_sec = -1;
+    config.dht_config.node_config.max_search_memory = 1;
+    config.dht_config.node_config.max_listener_memory = 1;
+    config.dht_config.node_config.max_partial_memory = 1;
+    dht::DhtRunner limited;
+    limited.run(0, config);
+    limited.bootstrap(node1.getBound());
+    node2.bootstrap(limited.getBound());
+
+    // idle searches are evicted above the limit
+    auto idle = dht::InfoHash::get("idle search");
+    CPPUNIT_ASSERT(getOk(limited, idle));
+    CPPUNIT_ASSERT(getOk(limited, dht::InfoHash::get("new search")));
+    CPPUNIT_ASSERT(limited.getSearchLog(idle).empty());
+
+    // searches with a listener are not, so new searches are refused
+    auto listened = dht::InfoHash::get("listened search");
+    CPPUNIT_ASSERT(limited.listen(listened, [](const std::shared_ptr<dht::Value>&){ return true; }).get());
+    CPPUNIT_ASSERT(waitFor([&]{ return limited.getNodeInfo().memory.searches > 0; }));
+    CPPUNIT_ASSERT(not getOk(limited, dht::InfoHash::get("refused search")));
+    CPPUNIT_ASSERT_EQUAL((size_t)0, limited.listen(dht::InfoHash::get("refused listen"),
+        [](const std::shared_ptr<dht::Value>&){ return true; }).get());
+
+    // listen requests from other nodes are refused with an error
+    auto& errors = node2.getMetrics()->counter("dht_messages_received_total", "Parsed messages received", {{"type", "error"}});
+    auto errorCount = errors.value();
+    auto token = node2.listen(dht::InfoHash::get("remote listen"), [](const std::shared_ptr<dht::Value>&){ return true; }).get();
+    CPPUNIT_ASSERT(token);
+    CPPUNIT_ASSERT(waitFor([&]{ return errors.value() > errorCount; }));
+    CPPUNIT_ASSERT_EQUAL((size_t)0, limited.getNodeInfo().memory.listeners);
+
+    // values sent in several parts are dropped, smaller ones are stored
+    CPPUNIT_ASSERT(putDone(node2, dht::InfoHash::get("small value"), dht::Value("hey")));
+    CPPUNIT_ASSERT(waitFor([&]{ return limited.getNodeInfo().storage_values == 1; }));
+    putDone(node2, dht::InfoHash::get("large value"), dht::Value(std::string(32 * 1024, 'a')));
+    CPPUNIT_ASSERT(not node1.get(dht::InfoHash::get("large value")).get().empty());
+    auto info = limited.getNodeInfo();
+    CPPUNIT_ASSERT_EQUAL((size_t)1, info.storage_values);
+    CPPUNIT_ASSERT_EQUAL((size_t)0, info.memory.partial_messages);
+
+    // received packets are dropped when the queue is full
+    dht::DhtRunner::Config tinyConfig;
+    tinyConfig.max_rx_queue_memory = 1;
+    dht::DhtRunner tiny;
+    tiny.run(0, tinyConfig);
+    tiny.bootstrap(node1.getBound());
+    auto& dropped = tiny.getMetrics()->counter("dht_rx_dropped_total", "Received packets dropped by the runner", {{"reason", "queue_full"}});
+    CPPUNIT_ASSERT(waitFor([&]{ return dropped.value() > 0; }));
+    CPPUNIT_ASSERT_EQUAL(0u, tiny.getNodeInfo().ipv4.good_nodes);
+}
+
 void
 DhtRunnerTester::testMultithread() {
     std::mutex mutex;
@@ -31,11 +31,18 @@ class DhtRunnerTester : public CppUnit::TestFixture {
     CPPUNIT_TEST_SUITE(DhtRunnerTester);
     CPPUNIT_TEST(testConstructors);
     CPPUNIT_TEST(testGetPut);
+    CPPUNIT_TEST(testGetPutMany);
     CPPUNIT_TEST(testPutDuplicate);
     CPPUNIT_TEST(testPutOverride);
     CPPUNIT_TEST(testListen);
     CPPUNIT_TEST(testListenLotOfBytes);
     CPPUNIT_TEST(testIdOps);
+    CPPUNIT_TEST(testNodeRtt);
+    CPPUNIT_TEST(testLossyValueParts);
+    CPPUNIT_TEST(testCertificateCache);
+    CPPUNIT_TEST(testMetrics);
+    CPPUNIT_TEST(testMemoryStats);
+    CPPUNIT_TEST(testMemoryLimits);
     CPPUNIT_TEST_SUITE_END();
 
     dht::DhtRunner node1 {};
@@ -57,6 +64,10 @@ class DhtRunnerTester : public CppUnit::TestFixture {
      * Test get and put methods
      */
     void testGetPut();
+    /**
+     * Test multi-key get, put and listen
+     */
+    void testGetPutMany();
     /**
      * Test get and multiple put
      */
@@ -77,6 +88,30 @@ class DhtRunnerTester : public CppUnit::TestFixture {
      * Test listen method with lot of datas
      */
     void testListenLotOfBytes();
+    /**
+     * Test round-trip time estimation of routing table nodes
+     */
+    void testNodeRtt();
+    /**
+     * Test transfer of fragmented values over a lossy network
+     */
+    void testLossyValueParts();
+    /**
+     * Test certificate lookup caching and coalescing
+     */
+    void testCertificateCache();
+    /**
+     * Test metrics registry and node instrumentation
+     */
+    void testMetrics();
+    /**
+     * Test memory accounting of the node subsystems
+     */
+    void testMemoryStats();
+    /**
+     * Test memory limits of searches, listeners and received messages
+     */
+    void testMemoryLimits();
     /**
      * Test multithread
      */
@@ -289,4 +289,46 @@ HttpTester::test_send_json() {
 #endif
 }
 
+void
+HttpTester::test_connection_pool() {
+    // Arrange
+    std::condition_variable cv;
+    std::mutex cv_m;
+    std::unique_lock<std::mutex> lk(cv_m);
+    bool done = false;
+    unsigned int status = 0;
+    auto pool = std::make_shared<dht::http::ConnectionPool>(serverProxy->io_context());
+
+    auto sendRequest = [&]{
+        auto request = std::make_shared<dht::http::Request>(serverProxy->io_context(),
+            "http://127.0.0.1:8080/",
+            [&](const dht::http::Response& response) {
+                std::lock_guard<std::mutex> lk(cv_m);
+                status = response.status_code;
+                done = true;
+                cv.notify_all();
+            });
+        request->set_connection_pool(pool);
+        request->send();
+        return request;
+    };
+
+    // Act
+    auto first = sendRequest();
+    CPPUNIT_ASSERT(cv.wait_for(lk, std::chrono::seconds(10), [&]{ return done; }));
+    CPPUNIT_ASSERT_EQUAL(200u, status);
+    done = false;
+    status = 0;
+    auto second = sendRequest();
+    CPPUNIT_ASSERT(cv.wait_for(lk, std::chrono::seconds(10), [&]{ return done; }));
+
+    // Assert
+    CPPUNIT_ASSERT_EQUAL(200u, status);
+    CPPUNIT_ASSERT_EQUAL(first->get_connection()->id(), second->get_connection()->id());
+    auto stats = pool->getStats();
+    CPPUNIT_ASSERT_EQUAL((uint64_t)1, stats.hits);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)1, stats.misses);
+    CPPUNIT_ASSERT_EQUAL((size_t)1, stats.idle);
+}
+
 }  // namespace test
@@ -22,9 +22,11 @@
 // std
 #include <iostream>
 #include <string>
+#include <unordered_set>
 
 // opendht
 #include "opendht/infohash.h"
+#include "opendht/sockaddr.h"
 
 namespace test {
 CPPUNIT_TEST_SUITE_REGISTRATION(InfoHashTester);
@@ -144,6 +146,37 @@ InfoHashTester::testHex() {
     CPPUNIT_ASSERT_EQUAL(TEST_HASH_STR, dht::toHex(TEST_HASH.data(), TEST_HASH.size()));
 }
 
+void
+InfoHashTester::testStdHash() {
+    std::unordered_set<dht::InfoHash> hashes;
+    for (unsigned i = 0; i < 1000; i++)
+        hashes.emplace(dht::InfoHash::get(std::to_string(i)));
+    CPPUNIT_ASSERT_EQUAL((size_t)1000, hashes.size());
+    CPPUNIT_ASSERT(hashes.count(dht::InfoHash::get("42")));
+    CPPUNIT_ASSERT(not hashes.count(dht::InfoHash::get("1000")));
+
+    // Hashes differing only in their last bytes
+    std::hash<dht::InfoHash> hasher;
+    auto a = dht::InfoHash("0000000000000000000000000000000000000001");
+    auto b = dht::InfoHash("0000000000000000000000000000000000000002");
+    CPPUNIT_ASSERT(hasher(a) != hasher(b));
+
+    auto addr = [](sa_family_t family, const char* address, in_port_t port) {
+        dht::SockAddr ret;
+        ret.setFamily(family);
+        ret.setAddress(address);
+        ret.setPort(port);
+        return ret;
+    };
+    std::unordered_set<dht::SockAddr> addrs;
+    addrs.emplace(addr(AF_INET, "192.168.0.1", 4222));
+    addrs.emplace(addr(AF_INET, "192.168.0.1", 4223));
+    addrs.emplace(addr(AF_INET6, "2001:db8::1", 4222));
+    addrs.emplace(addr(AF_INET, "192.168.0.1", 4222));
+    CPPUNIT_ASSERT_EQUAL((size_t)3, addrs.size());
+    CPPUNIT_ASSERT(addrs.count(addr(AF_INET6, "2001:db8::1", 4222)));
+}
+
 void
 InfoHashTester::tearDown() {
 
@@ -33,6 +33,7 @@ class InfoHashTester : public CppUnit::TestFixture {
     CPPUNIT_TEST(testCommonBits);
     CPPUNIT_TEST(testXorCmp);
     CPPUNIT_TEST(testHex);
+    CPPUNIT_TEST(testStdHash);
     CPPUNIT_TEST_SUITE_END();
 
  public:
@@ -69,6 +70,11 @@ class InfoHashTester : public CppUnit::TestFixture {
      * Test hex conversion
      */
     void testHex();
+
+    /**
+     * Test std::hash specializations for InfoHash and SockAddr
+     */
+    void testStdHash();
 };
 
 }  // namespace test
@@ -0,0 +1,104 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "storagetester.h"
+
+// opendht
+#include <opendht/node.h>
+#include <opendht/scheduler.h>
+#include "storage.h"
+
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+namespace test {
+CPPUNIT_TEST_SUITE_REGISTRATION(StorageTester);
+
+void
+StorageTester::testExpiration() {
+    auto key = dht::InfoHash::get("storage");
+    auto now = dht::clock::now();
+    dht::TypeStore types;
+    dht::StorageBucket bucket;
+    dht::Storage storage(now);
+
+    auto makeValue = [](dht::Value::Id id, size_t size) {
+        auto v = std::make_shared<dht::Value>(dht::Blob(size, (uint8_t)id));
+        v->id = id;
+        return v;
+    };
+    auto a = makeValue(1, 100);
+    auto b = makeValue(2, 200);
+    auto c = makeValue(3, 300);
+    auto d = makeValue(4, 400);
+
+    // stored out of expiration order
+    storage.store(key, a, now, now + 3min, &bucket);
+    storage.store(key, b, now, now + 1min, &bucket);
+    storage.store(key, c, now, now + 2min, &bucket);
+    storage.store(key, d, now, dht::time_point::max(), &bucket);
+    size_t size = a->size() + b->size() + c->size() + d->size();
+    CPPUNIT_ASSERT_EQUAL((size_t)4, storage.valueCount());
+    CPPUNIT_ASSERT_EQUAL(size, storage.totalSize());
+    CPPUNIT_ASSERT_EQUAL(size, bucket.size());
+    CPPUNIT_ASSERT(storage.nextExpiration() == now + 1min);
+
+    // refreshing b moves it after a
+    auto refreshed = storage.refresh(key, now, b->id, types);
+    auto bExpiration = now + types.getType(b->type).expiration;
+    CPPUNIT_ASSERT(bExpiration > now + 3min);
+    CPPUNIT_ASSERT(refreshed.first);
+    CPPUNIT_ASSERT(refreshed.second == bExpiration);
+    CPPUNIT_ASSERT(storage.nextExpiration() == now + 2min);
+    CPPUNIT_ASSERT_EQUAL(size, storage.totalSize());
+
+    // removing c leaves a first
+    CPPUNIT_ASSERT(storage.remove(key, c->id) == c);
+    size -= c->size();
+    CPPUNIT_ASSERT_EQUAL((size_t)3, storage.valueCount());
+    CPPUNIT_ASSERT_EQUAL(size, storage.totalSize());
+    CPPUNIT_ASSERT_EQUAL(size, bucket.size());
+    CPPUNIT_ASSERT(storage.nextExpiration() == now + 3min);
+
+    // values expiring at or before now are expired
+    auto expired = storage.expire(key, now + 3min);
+    CPPUNIT_ASSERT_EQUAL(-(ssize_t)a->size(), expired.first);
+    CPPUNIT_ASSERT_EQUAL((size_t)1, expired.second.size());
+    CPPUNIT_ASSERT(expired.second.front() == a);
+    size -= a->size();
+    CPPUNIT_ASSERT_EQUAL((size_t)2, storage.valueCount());
+    CPPUNIT_ASSERT_EQUAL(size, storage.totalSize());
+    CPPUNIT_ASSERT_EQUAL(size, bucket.size());
+    CPPUNIT_ASSERT(storage.nextExpiration() == bExpiration);
+
+    expired = storage.expire(key, now + 3min);
+    CPPUNIT_ASSERT_EQUAL((ssize_t)0, expired.first);
+    CPPUNIT_ASSERT(expired.second.empty());
+
+    // d never expires
+    expired = storage.expire(key, now + 24h);
+    CPPUNIT_ASSERT_EQUAL((size_t)1, expired.second.size());
+    CPPUNIT_ASSERT(expired.second.front() == b);
+    CPPUNIT_ASSERT_EQUAL((size_t)1, storage.valueCount());
+    CPPUNIT_ASSERT_EQUAL(d->size(), storage.totalSize());
+    CPPUNIT_ASSERT_EQUAL(d->size(), bucket.size());
+    CPPUNIT_ASSERT(storage.nextExpiration() == dht::time_point::max());
+    CPPUNIT_ASSERT(storage.getById(d->id) == d);
+}
+
+}  // namespace test
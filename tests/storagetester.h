@@ -0,0 +1,39 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// cppunit
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace test {
+
+class StorageTester : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(StorageTester);
+    CPPUNIT_TEST(testExpiration);
+    CPPUNIT_TEST_SUITE_END();
+
+ public:
+    /**
+     * Test the expiration index: refresh, remove and expire
+     * values with mixed expirations
+     */
+    void testExpiration();
+};
+
+}  // namespace test
@@ -0,0 +1,516 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Load generator: drives a mix of put, get, listen and putSigned
+ * operations across a set of keys at a target rate, from several threads
+ * over one or more DhtRunners, and reports throughput, error rate and
+ * latency percentiles.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "tools_common.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <random>
+#include <thread>
+
+using namespace dht;
+
+namespace load {
+
+using clock = std::chrono::steady_clock;
+
+enum class Op : size_t { Put, Get, Listen, PutSigned, Count };
+constexpr size_t OP_COUNT = static_cast<size_t>(Op::Count);
+static const std::array<const char*, OP_COUNT> OP_NAMES {{"put", "get", "listen", "putSigned"}};
+
+enum class Status { Ok, Failed, Timeout };
+
+struct Options {
+    bool help {false};
+    unsigned runners {1};
+    unsigned threads {4};
+    unsigned keys {1000};
+    /** Operations started per second, over all threads */
+    double rate {100};
+    std::chrono::seconds duration {30};
+    /** Time after which a pending operation is counted as timed out */
+    std::chrono::seconds timeout {30};
+    size_t value_size {64};
+    /** Relative weight of each operation */
+    std::array<double, OP_COUNT> mix {{1, 1, 0, 0}};
+    unsigned max_inflight {10000};
+    bool prefill {true};
+    bool no_rate_limit {false};
+    NetId network {0};
+    std::string bootstrap {};
+    std::string proxyclient {};
+};
+
+struct OpStats {
+    mutable std::mutex lock;
+    uint64_t started {0};
+    uint64_t ok {0};
+    uint64_t failed {0};
+    uint64_t timeout {0};
+    /** Not started because too many operations were in flight */
+    uint64_t skipped {0};
+    std::vector<clock::duration> latency;
+};
+
+/* Listen started by a worker, cancelled on first value or timeout */
+struct Listener {
+    DhtRunner* runner;
+    InfoHash key;
+    std::shared_future<size_t> token;
+    clock::time_point start;
+    std::shared_ptr<std::atomic_bool> resolved;
+};
+
+class LoadGenerator {
+public:
+    explicit LoadGenerator(const Options& opts);
+    ~LoadGenerator();
+
+    /** Puts a value on every key, so that gets and listens find one */
+    void prefill();
+    /** Runs the workers for the configured duration */
+    void run();
+    void report(std::ostream& out) const;
+
+private:
+    void worker(unsigned index);
+    void startOp(Op op, DhtRunner& runner, const InfoHash& key, std::deque<Listener>& listeners);
+    void done(Op op, clock::time_point start, Status status);
+    void expireListeners(std::deque<Listener>& listeners);
+    Value makeValue(std::mt19937_64& rd) const;
+    void printProgress(std::ostream& out, clock::duration elapsed) const;
+
+    const Options opts_;
+    std::vector<InfoHash> keys_;
+    std::array<OpStats, OP_COUNT> stats_;
+    std::atomic_uint inflight_ {0};
+    std::atomic<uint64_t> completed_ {0};
+    std::atomic<uint64_t> errors_ {0};
+    std::atomic_bool running_ {false};
+    clock::duration elapsed_ {};
+    std::vector<std::unique_ptr<DhtRunner>> runners_;
+};
+
+LoadGenerator::LoadGenerator(const Options& opts) : opts_(opts)
+{
+    keys_.reserve(opts_.keys);
+    for (unsigned i = 0; i < opts_.keys; i++)
+        keys_.emplace_back(InfoHash::get("dhtload:" + std::to_string(i)));
+
+    DhtRunner::Config config {};
+    config.dht_config.node_config.network = opts_.network;
+    config.threaded = true;
+    config.proxy_server = opts_.proxyclient;
+    if (opts_.no_rate_limit) {
+        config.dht_config.node_config.max_req_per_sec = -1;
+        config.dht_config.node_config.max_peer_req_per_sec = -1;
+        config.dht_config.node_config.max_searches = -1;
+        config.dht_config.node_config.max_store_size = -1;
+    }
+
+    runners_.reserve(opts_.runners);
+    for (unsigned i = 0; i < opts_.runners; i++) {
+        auto runnerConfig = config;
+        if (opts_.mix[static_cast<size_t>(Op::PutSigned)] > 0)
+            runnerConfig.dht_config.id = crypto::generateEcIdentity("dhtload");
+        auto runner = std::make_unique<DhtRunner>();
+        runner->run(0, runnerConfig);
+        if (not opts_.bootstrap.empty())
+            runner->bootstrap(opts_.bootstrap);
+        else if (not runners_.empty())
+            runner->bootstrap(runners_.front()->getBound());
+        runners_.emplace_back(std::move(runner));
+    }
+
+    // Wait for the runners to join the network
+    auto deadline = clock::now() + std::chrono::seconds(10);
+    for (const auto& runner : runners_)
+        while (runner->getStatus() != NodeStatus::Connected and clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+LoadGenerator::~LoadGenerator()
+{
+    for (auto& runner : runners_)
+        runner->shutdown();
+    for (auto& runner : runners_)
+        runner->join();
+}
+
+Value
+LoadGenerator::makeValue(std::mt19937_64& rd) const
+{
+    Blob data(opts_.value_size);
+    std::uniform_int_distribution<int> byte {0, 255};
+    std::generate(data.begin(), data.end(), [&]{ return (uint8_t)byte(rd); });
+    return Value {std::move(data)};
+}
+
+void
+LoadGenerator::prefill()
+{
+    std::mt19937_64 rd {crypto::random_device{}()};
+    std::vector<std::future<bool>> pending;
+    pending.reserve(keys_.size());
+    for (size_t i = 0; i < keys_.size(); i++) {
+        auto p = std::make_shared<std::promise<bool>>();
+        pending.emplace_back(p->get_future());
+        runners_[i % runners_.size()]->put(keys_[i], makeValue(rd), [p](bool ok) { p->set_value(ok); });
+    }
+    unsigned failed = 0;
+    for (auto& f : pending)
+        failed += not f.get();
+    std::cout << "Prefilled " << keys_.size() << " keys";
+    if (failed)
+        std::cout << " (" << failed << " puts failed)";
+    std::cout << std::endl;
+}
+
+void
+LoadGenerator::done(Op op, clock::time_point start, Status status)
+{
+    auto latency = clock::now() - start;
+    auto& stats = stats_[static_cast<size_t>(op)];
+    {
+        std::lock_guard<std::mutex> lock(stats.lock);
+        switch (status) {
+        case Status::Ok:
+            stats.ok++;
+            stats.latency.emplace_back(latency);
+            break;
+        case Status::Failed:  stats.failed++; break;
+        case Status::Timeout: stats.timeout++; break;
+        }
+    }
+    if (status != Status::Ok)
+        errors_++;
+    completed_++;
+    inflight_--;
+}
+
+void
+LoadGenerator::startOp(Op op, DhtRunner& runner, const InfoHash& key, std::deque<Listener>& listeners)
+{
+    auto& stats = stats_[static_cast<size_t>(op)];
+    if (inflight_ >= opts_.max_inflight) {
+        std::lock_guard<std::mutex> lock(stats.lock);
+        stats.skipped++;
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(stats.lock);
+        stats.started++;
+    }
+    inflight_++;
+
+    thread_local std::mt19937_64 rd {crypto::random_device{}()};
+    auto start = clock::now();
+    switch (op) {
+    case Op::Put:
+        runner.put(key, makeValue(rd), [this, start](bool ok) {
+            done(Op::Put, start, ok ? Status::Ok : Status::Failed);
+        });
+        break;
+    case Op::PutSigned:
+        runner.putSigned(key, makeValue(rd), [this, start](bool ok) {
+            done(Op::PutSigned, start, ok ? Status::Ok : Status::Failed);
+        });
+        break;
+    case Op::Get:
+        runner.get(key, [](const std::vector<Sp<Value>>&) {
+            return true;
+        }, [this, start](bool ok) {
+            done(Op::Get, start, ok ? Status::Ok : Status::Failed);
+        });
+        break;
+    case Op::Listen: {
+        auto resolved = std::make_shared<std::atomic_bool>(false);
+        auto token = runner.listen(key, [this, start, resolved](const std::vector<Sp<Value>>&, bool expired) {
+            if (expired)
+                return true;
+            if (not resolved->exchange(true))
+                done(Op::Listen, start, Status::Ok);
+            return false;
+        });
+        listeners.emplace_back(Listener {&runner, key, token.share(), start, std::move(resolved)});
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void
+LoadGenerator::expireListeners(std::deque<Listener>& listeners)
+{
+    // Listeners of a worker are started in order and share the same timeout
+    auto now = clock::now();
+    while (not listeners.empty()) {
+        auto& l = listeners.front();
+        if (not *l.resolved) {
+            if (now - l.start < opts_.timeout)
+                break;
+            if (not l.resolved->exchange(true)) {
+                l.runner->cancelListen(l.key, l.token);
+                done(Op::Listen, l.start, Status::Timeout);
+            }
+        }
+        listeners.pop_front();
+    }
+}
+
+void
+LoadGenerator::worker(unsigned index)
+{
+    std::mt19937_64 rd {crypto::random_device{}() + index};
+    std::discrete_distribution<size_t> opDist(opts_.mix.begin(), opts_.mix.end());
+    std::uniform_int_distribution<size_t> keyDist {0, keys_.size() - 1};
+    std::uniform_int_distribution<size_t> runnerDist {0, runners_.size() - 1};
+    std::deque<Listener> listeners;
+
+    // Open loop: operations are started on schedule, whether or not
+    // previous ones completed, so that latency doesn't throttle the load.
+    auto interval = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(opts_.threads / opts_.rate));
+    auto next = clock::now() + interval * index / opts_.threads;
+    while (running_) {
+        std::this_thread::sleep_until(next);
+        next += interval;
+        startOp(static_cast<Op>(opDist(rd)), *runners_[runnerDist(rd)], keys_[keyDist(rd)], listeners);
+        expireListeners(listeners);
+    }
+    while (not listeners.empty()) {
+        expireListeners(listeners);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+void
+LoadGenerator::printProgress(std::ostream& out, clock::duration elapsed) const
+{
+    uint64_t started = 0;
+    for (const auto& stats : stats_) {
+        std::lock_guard<std::mutex> lock(stats.lock);
+        started += stats.started;
+    }
+    out << "[" << print_duration(elapsed) << "] " << started << " started, "
+        << completed_ << " completed, " << errors_ << " errors, "
+        << inflight_ << " in flight" << std::endl;
+}
+
+void
+LoadGenerator::run()
+{
+    running_ = true;
+    auto start = clock::now();
+    std::vector<std::thread> workers;
+    workers.reserve(opts_.threads);
+    for (unsigned i = 0; i < opts_.threads; i++)
+        workers.emplace_back([this, i] { worker(i); });
+
+    auto end = start + opts_.duration;
+    for (auto now = clock::now(); now < end; now = clock::now()) {
+        std::this_thread::sleep_until(std::min(end, now + std::chrono::seconds(5)));
+        printProgress(std::cout, clock::now() - start);
+    }
+    running_ = false;
+    elapsed_ = clock::now() - start;
+    for (auto& w : workers)
+        w.join();
+
+    // Let pending puts and gets complete
+    auto deadline = clock::now() + opts_.timeout;
+    while (inflight_ and clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    printProgress(std::cout, clock::now() - start);
+}
+
+template <typename T>
+static T
+percentile(std::vector<T>& v, double p)
+{
+    if (v.empty())
+        return {};
+    auto n = std::min(v.size() - 1, (size_t)(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + n, v.end());
+    return v[n];
+}
+
+void
+LoadGenerator::report(std::ostream& out) const
+{
+    auto seconds = std::chrono::duration<double>(elapsed_).count();
+    uint64_t totalStarted = 0, totalOk = 0, totalErrors = 0;
+    out << std::endl << opts_.threads << " threads over " << runners_.size() << " runners, "
+        << opts_.keys << " keys, target " << opts_.rate << " ops/s for " << print_duration(elapsed_) << std::endl;
+    for (size_t i = 0; i < OP_COUNT; i++) {
+        const auto& stats = stats_[i];
+        std::lock_guard<std::mutex> lock(stats.lock);
+        if (not stats.started and not stats.skipped)
+            continue;
+        // Operations still pending at the end are counted as timed out
+        auto timeout = stats.timeout + (stats.started - stats.ok - stats.failed - stats.timeout);
+        auto errors = stats.failed + timeout;
+        totalStarted += stats.started;
+        totalOk += stats.ok;
+        totalErrors += errors;
+        out << OP_NAMES[i] << ": " << stats.started << " started, " << stats.ok / seconds << " ok/s, "
+            << "errors " << (stats.started ? 100. * errors / stats.started : 0.) << "% ("
+            << stats.failed << " failed, " << timeout << " timed out)";
+        if (stats.skipped)
+            out << ", " << stats.skipped << " skipped";
+        out << std::endl;
+        auto latency = stats.latency;
+        if (not latency.empty())
+            out << "  latency: p50 " << print_duration(percentile(latency, .5))
+                << ", p90 " << print_duration(percentile(latency, .9))
+                << ", p99 " << print_duration(percentile(latency, .99))
+                << ", max " << print_duration(*std::max_element(latency.begin(), latency.end())) << std::endl;
+    }
+    out << "Total: " << totalStarted / seconds << " started/s, " << totalOk / seconds << " ok/s, errors "
+        << (totalStarted ? 100. * totalErrors / totalStarted : 0.) << "%" << std::endl;
+}
+
+}
+
+static const constexpr struct option load_options[] = {
+    {"help",          no_argument,       nullptr, 'h'},
+    {"bootstrap",     required_argument, nullptr, 'b'},
+    {"net",           required_argument, nullptr, 'n'},
+    {"proxyclient",   required_argument, nullptr, 'C'},
+    {"runners",       required_argument, nullptr, 'R'},
+    {"threads",       required_argument, nullptr, 't'},
+    {"keys",          required_argument, nullptr, 'k'},
+    {"rate",          required_argument, nullptr, 'r'},
+    {"duration",      required_argument, nullptr, 'd'},
+    {"timeout",       required_argument, nullptr, 'T'},
+    {"size",          required_argument, nullptr, 's'},
+    {"mix",           required_argument, nullptr, 'm'},
+    {"max-inflight",  required_argument, nullptr, 'i'},
+    {"no-prefill",    no_argument,       nullptr, 'P'},
+    {"no-rate-limit", no_argument,       nullptr, 'U'},
+    {nullptr,         0,                 nullptr,  0}
+};
+
+static bool
+parseMix(const std::string& str, std::array<double, load::OP_COUNT>& mix)
+{
+    std::array<double, load::OP_COUNT> ret {};
+    for (const auto& w : parseStringMap(str)) {
+        auto it = std::find(load::OP_NAMES.begin(), load::OP_NAMES.end(), w.first);
+        if (it == load::OP_NAMES.end()) {
+            std::cerr << "Unknown operation in mix: " << w.first << std::endl;
+            return false;
+        }
+        ret[it - load::OP_NAMES.begin()] = std::max(0., strtod(w.second.c_str(), nullptr));
+    }
+    if (std::all_of(ret.begin(), ret.end(), [](double w) { return w == 0; })) {
+        std::cerr << "Empty operation mix" << std::endl;
+        return false;
+    }
+    mix = ret;
+    return true;
+}
+
+static load::Options
+parseLoadArgs(int argc, char** argv)
+{
+    using namespace std::chrono;
+    load::Options opts;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "hb:n:C:R:t:k:r:d:T:s:m:i:PU", load_options, nullptr)) != -1) {
+        switch (opt) {
+        case 'b': opts.bootstrap = optarg; break;
+        case 'n': opts.network = strtoul(optarg, nullptr, 0); break;
+        case 'C': opts.proxyclient = optarg; break;
+        case 'R': opts.runners = std::max(1ul, strtoul(optarg, nullptr, 0)); break;
+        case 't': opts.threads = std::max(1ul, strtoul(optarg, nullptr, 0)); break;
+        case 'k': opts.keys = std::max(1ul, strtoul(optarg, nullptr, 0)); break;
+        case 'r': opts.rate = std::max(.001, strtod(optarg, nullptr)); break;
+        case 'd': opts.duration = seconds(strtoul(optarg, nullptr, 0)); break;
+        case 'T': opts.timeout = seconds(strtoul(optarg, nullptr, 0)); break;
+        case 's': opts.value_size = strtoul(optarg, nullptr, 0); break;
+        case 'm': opts.help |= not parseMix(optarg, opts.mix); break;
+        case 'i': opts.max_inflight = std::max(1ul, strtoul(optarg, nullptr, 0)); break;
+        case 'P': opts.prefill = false; break;
+        case 'U': opts.no_rate_limit = true; break;
+        default:  opts.help = true; break;
+        }
+    }
+    return opts;
+}
+
+static void
+print_usage()
+{
+    std::cout << "Usage: dhtload [options]" << std::endl << std::endl;
+    std::cout << "dhtload, an OpenDHT load generator." << std::endl;
+    std::cout << "Starts a mix of operations on random keys at a target rate, from several threads" << std::endl;
+    std::cout << "over one or more nodes, and reports throughput, error rate and latency percentiles." << std::endl;
+    std::cout << "Without bootstrap, the nodes only bootstrap from each other." << std::endl << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  -h, --help                  Show this help message and exit." << std::endl;
+    std::cout << "  -b, --bootstrap <host:port> Node to bootstrap from." << std::endl;
+    std::cout << "  -n, --net <id>              Network ID (default 0)." << std::endl;
+    std::cout << "  -C, --proxyclient <url>     Run the operations through a DHT proxy server." << std::endl;
+    std::cout << "  -R, --runners <count>       Number of local nodes (default 1)." << std::endl;
+    std::cout << "  -t, --threads <count>       Number of threads starting operations (default 4)." << std::endl;
+    std::cout << "  -k, --keys <count>          Number of keys (default 1000)." << std::endl;
+    std::cout << "  -r, --rate <ops/s>          Operations started per second (default 100)." << std::endl;
+    std::cout << "  -d, --duration <s>          Duration of the test (default 30)." << std::endl;
+    std::cout << "  -T, --timeout <s>           Time after which an operation is counted as timed out (default 30)." << std::endl;
+    std::cout << "  -s, --size <bytes>          Size of the values put (default 64)." << std::endl;
+    std::cout << "  -m, --mix <op:weight,...>   Weights of put, get, listen and putSigned (default put:1,get:1)." << std::endl;
+    std::cout << "                              A listen completes when it receives its first value." << std::endl;
+    std::cout << "  -i, --max-inflight <count>  Operations in flight above which new ones are skipped (default 10000)." << std::endl;
+    std::cout << "  -P, --no-prefill            Don't put a value on each key before the test." << std::endl;
+    std::cout << "  -U, --no-rate-limit         Disable the request rate limits of the local nodes." << std::endl;
+    std::cout << std::endl << "Report bugs to: https://opendht.net" << std::endl;
+}
+
+int
+main(int argc, char** argv)
+{
+    auto opts = parseLoadArgs(argc, argv);
+    if (opts.help) {
+        print_usage();
+        return 0;
+    }
+    {
+        load::LoadGenerator generator(opts);
+        if (opts.prefill)
+            generator.prefill();
+        generator.run();
+        generator.report(std::cout);
+    }
+    return 0;
+}
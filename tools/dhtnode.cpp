@@ -23,6 +23,8 @@
 #endif
 
 #include "tools_common.h"
+#include <opendht/identity_factory.h>
+#include <opendht/trace.h>
 extern "C" {
 #include <gnutls/gnutls.h>
 }
@@ -43,7 +45,7 @@ void print_version() {
 }
 
 void print_usage() {
-    std::cout << "Usage: dhtnode [-v [-l logfile]] [-i] [-d] [-n network_id] [-p local_port] [-b bootstrap_host[:port]] [--proxyserver local_port] [--proxyserverssl local_port] [--bundleid bundleid] [--pushserver endpoint]" << std::endl << std::endl;
+    std::cout << "Usage: dhtnode [-v [-l logfile]] [-i] [-d] [-n network_id] [-p local_port] [-b bootstrap_host[:port]] [--proxyserver local_port] [--proxyserverssl local_port] [--proxy-metrics] [--bundleid bundleid] [--pushserver endpoint]" << std::endl << std::endl;
     print_info();
 }
 
@@ -60,9 +62,11 @@ void print_help() {
 
     std::cout << std::endl << "Node information:" << std::endl
               << "  ll         Print basic information and stats about the current node." << std::endl
+              << "  lm         Print the node metrics." << std::endl
               << "  ls [key]   Print basic information about current search(es)." << std::endl
               << "  ld [key]   Print basic information about currenty stored values on this node (or key)." << std::endl
-              << "  lr         Print the full current routing table of this node." << std::endl;
+              << "  lr         Print the full current routing table of this node." << std::endl
+              << "  lt [file]  Write the recorded traces in the Chrome trace format (to stdout or file)." << std::endl;
 
 #ifdef OPENDHT_PROXY_SERVER
     std::cout << std::endl << "Operations with the proxy:" << std::endl
@@ -147,6 +151,7 @@ void cmd_loop(std::shared_ptr<DhtRunner>& node, dht_params& params
                 print_node_info(*nodeInfo);
                 std::cout << nodeInfo->ongoing_ops << " ongoing operations" << std::endl;
                 std::cout << "Storage has " << nodeInfo->storage_values <<  " values, using " << (nodeInfo->storage_size/1024) << " KB" << std::endl;
+                std::cout << nodeInfo->memory.toString() << std::endl;
                 std::cout << "IPv4 stats:" << std::endl;
                 std::cout << nodeInfo->ipv4.toString() << std::endl;
                 std::cout << "IPv6 stats:" << std::endl;
@@ -162,6 +167,28 @@ void cmd_loop(std::shared_ptr<DhtRunner>& node, dht_params& params
 #endif
             });
             continue;
+        } else if (op == "lm") {
+            if (auto metrics = node->getMetrics())
+                std::cout << metrics->toPrometheus();
+            continue;
+        } else if (op == "lt") {
+            if (not dht::trace::enabled()) {
+                std::cout << "Tracing is not enabled in this build." << std::endl;
+                continue;
+            }
+            std::string file;
+            iss >> file;
+            if (file.empty()) {
+                dht::trace::dumpChromeTrace(std::cout);
+            } else {
+                std::ofstream out(file);
+                if (out) {
+                    dht::trace::dumpChromeTrace(out);
+                    std::cout << "Traces written to " << file << std::endl;
+                } else
+                    std::cout << "Can't open " << file << std::endl;
+            }
+            continue;
         } else if (op == "lr") {
             std::cout << "IPv4 routing table:" << std::endl;
             std::cout << node->getRoutingTablesLog(AF_INET) << std::endl;
@@ -420,7 +447,7 @@ void cmd_loop(std::shared_ptr<DhtRunner>& node, dht_params& params
             node->cancelPut(id, std::stoul(rem, nullptr, 16));
         }
         else if (op == "s") {
-            if (not params.id.first) {
+            if (not node->getPublicKey()) {
                 print_id_req();
                 continue;
             }
@@ -435,7 +462,7 @@ void cmd_loop(std::shared_ptr<DhtRunner>& node, dht_params& params
             });
         }
         else if (op == "e") {
-            if (not params.id.first) {
+            if (not node->getPublicKey()) {
                 print_id_req();
                 continue;
             }
@@ -533,11 +560,36 @@ main(int argc, char **argv)
     }
     setupSignals();
 
+    // Generate the identity in the background: the node runs unsigned until it's ready
+    bool generateIdentity = params.generate_identity and not params.id.first;
+    params.generate_identity = false;
+    std::unique_ptr<crypto::IdentityFactory> identityFactory;
+
     auto node = std::make_shared<DhtRunner>();
     try {
         auto dhtConf = getDhtConfig(params);
         node->run(params.port, dhtConf.first, std::move(dhtConf.second));
 
+        if (generateIdentity) {
+            auto start = std::chrono::steady_clock::now();
+            auto node_ca = crypto::generateEcIdentity("DHT Node CA");
+            identityFactory = std::make_unique<crypto::IdentityFactory>(0);
+            identityFactory->getIdentity([node, node_ca, start, save = params.save_identity, pwd = params.privkey_pwd](const crypto::Identity& id, std::exception_ptr err) {
+                try {
+                    if (err)
+                        std::rethrow_exception(err);
+                    node->setIdentity(id);
+                    if (not save.empty()) {
+                        crypto::saveIdentity(node_ca, save + "_ca", pwd);
+                        crypto::saveIdentity(id, save, pwd);
+                    }
+                    std::cout << "Identity ready: " << id.second->getId() << " (took " << print_duration(std::chrono::steady_clock::now() - start) << ")" << std::endl;
+                } catch (const std::exception& e) {
+                    std::cerr << "Can't set identity: " << e.what() << std::endl;
+                }
+            }, "DHT Node", node_ca);
+        }
+
         if (not params.bootstrap.empty()) {
             std::cout << "Bootstrap: " << params.bootstrap << std::endl;
             node->bootstrap(params.bootstrap);
@@ -552,6 +604,7 @@ main(int argc, char **argv)
             serverConfig.pushServer = params.pushserver;
             serverConfig.bundleId = params.bundle_id;
             serverConfig.address = params.proxy_address;
+            serverConfig.metricsEndpoint = params.proxy_metrics;
             if (params.proxyserverssl and params.proxy_id.first and params.proxy_id.second){
                 serverConfig.identity = params.proxy_id;
                 serverConfig.port = params.proxyserverssl;
@@ -598,6 +651,7 @@ main(int argc, char **argv)
     // wait for shutdown
     std::unique_lock<std::mutex> lk(m);
     cv.wait(lk, [&](){ return done; });
+    identityFactory.reset();
 
     node->join();
 #ifdef _MSC_VER
@@ -0,0 +1,730 @@
+/*
+ *  Copyright (C) 2014-2025 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Deterministic network simulator: runs many Dht instances in a single
+ * thread, in virtual time, over an in-memory network with configurable
+ * latency, loss and churn.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "tools_common.h"
+#include <opendht/scheduler.h>
+
+#include <msgpack.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <numeric>
+#include <random>
+#include <string_view>
+
+using namespace dht;
+
+/*
+ * Memory accounting: allocations are attributed to the simulated node
+ * running when they are made, and given back to it when freed.
+ */
+namespace {
+
+struct AllocHeader {
+    int owner;
+    size_t size;
+};
+constexpr size_t ALLOC_HEADER_SIZE = alignof(std::max_align_t) > sizeof(AllocHeader)
+    ? alignof(std::max_align_t) : sizeof(AllocHeader);
+
+int currentNode {-1};
+int64_t* nodeMemory {nullptr};
+
+void*
+allocate(size_t size) noexcept
+{
+    auto p = static_cast<char*>(std::malloc(size + ALLOC_HEADER_SIZE));
+    if (not p)
+        return nullptr;
+    auto header = reinterpret_cast<AllocHeader*>(p);
+    header->owner = currentNode;
+    header->size = size;
+    if (currentNode >= 0)
+        nodeMemory[currentNode] += size;
+    return p + ALLOC_HEADER_SIZE;
+}
+
+void
+deallocate(void* ptr) noexcept
+{
+    if (not ptr)
+        return;
+    auto p = static_cast<char*>(ptr) - ALLOC_HEADER_SIZE;
+    auto header = reinterpret_cast<AllocHeader*>(p);
+    if (header->owner >= 0)
+        nodeMemory[header->owner] -= header->size;
+    std::free(p);
+}
+
+/* Attributes the allocations made in its scope to a node (or to none with -1) */
+class NodeScope {
+public:
+    explicit NodeScope(int node) : previous_(currentNode) { currentNode = node; }
+    ~NodeScope() { currentNode = previous_; }
+    NodeScope(const NodeScope&) = delete;
+    NodeScope& operator=(const NodeScope&) = delete;
+private:
+    int previous_;
+};
+
+}
+
+void* operator new(size_t size) {
+    if (auto p = allocate(size))
+        return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+    if (auto p = allocate(size))
+        return p;
+    throw std::bad_alloc();
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void operator delete(void* p) noexcept { deallocate(p); }
+void operator delete[](void* p) noexcept { deallocate(p); }
+void operator delete(void* p, size_t) noexcept { deallocate(p); }
+void operator delete[](void* p, size_t) noexcept { deallocate(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { deallocate(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { deallocate(p); }
+
+namespace sim {
+
+struct Options {
+    unsigned nodes {1000};
+    unsigned keys {100};
+    unsigned gets {1000};
+    double rate {20};                       /* operations per second */
+    duration latency {std::chrono::milliseconds(40)};
+    duration jitter {std::chrono::milliseconds(40)};
+    double loss {0};
+    double churn {0};                       /* part of the nodes leaving per minute */
+    duration downtime {std::chrono::minutes(1)};
+    duration warmup {std::chrono::minutes(2)};
+    duration timeout {std::chrono::minutes(2)};
+    uint64_t seed {0};
+    bool latency_aware {false};
+    bool help {false};
+};
+
+/* Measured put or get */
+struct Lookup {
+    bool put {false};
+    unsigned origin {0};
+    time_point start {};
+    time_point firstValue {time_point::max()};
+    time_point done {time_point::max()};
+    bool success {false};
+    /** Search requests sent by the origin */
+    unsigned requests {0};
+    /** Number of request rounds: requests sent after a reply of round n are of round n+1 */
+    unsigned rounds {0};
+    std::map<unsigned, unsigned> pending {};
+};
+
+struct SimNode {
+    unsigned index {0};
+    std::unique_ptr<Dht> dht {};
+    Sp<Scheduler::Job> wakeup {};
+    time_point wakeupTime {time_point::max()};
+    duration access {};
+    int lookup {-1};
+};
+
+class Simulation;
+
+/**
+ * In-memory socket of a simulated node, forwarding sent packets to the
+ * simulated network.
+ */
+class SimSocket : public net::DatagramSocket {
+public:
+    SimSocket(Simulation& sim, unsigned index);
+
+    int sendTo(const SockAddr& dest, const uint8_t* data, size_t size, bool replied) override;
+
+    const SockAddr& getBoundRef(sa_family_t family = AF_UNSPEC) const override {
+        return family == AF_INET6 ? none_ : addr_;
+    }
+    bool hasIPv4() const override { return true; }
+    bool hasIPv6() const override { return false; }
+    void stop() override {}
+
+private:
+    Simulation& sim_;
+    unsigned index_;
+    SockAddr addr_;
+    SockAddr none_ {};
+};
+
+class Simulation {
+public:
+    explicit Simulation(const Options& opts);
+    ~Simulation();
+
+    void run();
+    void report(std::ostream& out) const;
+
+    int send(unsigned from, const SockAddr& dest, const uint8_t* data, size_t size);
+
+    static SockAddr address(unsigned index) {
+        sockaddr_in sin {};
+        sin.sin_family = AF_INET;
+        sin.sin_port = htons(net::DHT_DEFAULT_PORT);
+        sin.sin_addr.s_addr = htonl((10u << 24) | (index + 1));
+        return SockAddr((const sockaddr*)&sin, sizeof(sin));
+    }
+    static int indexOf(const SockAddr& addr) {
+        if (addr.getFamily() != AF_INET)
+            return -1;
+        auto a = ntohl(addr.getIPv4().sin_addr.s_addr);
+        if ((a >> 24) != 10)
+            return -1;
+        return (int)(a & 0xFFFFFF) - 1;
+    }
+
+private:
+    enum class MessageKind { Other, Request, Reply };
+    static MessageKind messageKind(const uint8_t* data, size_t size);
+
+    void start(SimNode& node);
+    void stop(SimNode& node);
+    void wake(SimNode& node, const uint8_t* data = nullptr, size_t size = 0, const SockAddr& from = {});
+    void deliver(unsigned from, unsigned to, const Blob& data);
+    void scheduleChurn();
+    void startLookup(bool put, unsigned key);
+    void endLookup(unsigned id, bool success);
+    SimNode* randomNode(bool idle = false);
+    void printProgress();
+
+    Options opts_;
+    Scheduler scheduler_;
+    std::mt19937_64 rd_;
+    std::vector<SimNode> nodes_;
+    std::vector<unsigned> online_;
+    std::vector<InfoHash> keys_;
+    std::vector<Lookup> lookups_;
+    unsigned remaining_ {0};
+
+    uint64_t packetsSent_ {0};
+    uint64_t packetsLost_ {0};
+    uint64_t packetsUndelivered_ {0};
+    uint64_t bytesSent_ {0};
+    uint64_t departures_ {0};
+    std::vector<unsigned> requestsReceived_ = std::vector<unsigned>(5);
+    time_point begin_ {};
+    time_point end_ {};
+};
+
+SimSocket::SimSocket(Simulation& sim, unsigned index)
+    : sim_(sim), index_(index), addr_(Simulation::address(index))
+{}
+
+int
+SimSocket::sendTo(const SockAddr& dest, const uint8_t* data, size_t size, bool)
+{
+    return sim_.send(index_, dest, data, size);
+}
+
+/* Virtual time starts at an arbitrary, fixed date */
+static const time_point SIM_EPOCH {std::chrono::hours(24)};
+
+Simulation::Simulation(const Options& opts)
+    : opts_(opts), rd_(opts.seed)
+{
+    scheduler_.syncTime(SIM_EPOCH);
+    begin_ = SIM_EPOCH;
+    // kept until exit, as memory allocated by the nodes can be freed later
+    nodeMemory = new int64_t[opts_.nodes]();
+    nodes_.resize(opts_.nodes);
+    online_.reserve(opts_.nodes);
+    std::uniform_int_distribution<duration::rep> access_dist(0, opts_.jitter.count());
+    for (unsigned i = 0; i < opts_.nodes; i++) {
+        nodes_[i].index = i;
+        nodes_[i].access = duration(access_dist(rd_));
+    }
+    for (unsigned i = 0; i < opts_.keys; i++)
+        keys_.emplace_back(InfoHash::get("dhtsim-" + std::to_string(i)));
+    lookups_.reserve(opts_.keys + opts_.gets);
+}
+
+Simulation::~Simulation()
+{
+    for (auto& node : nodes_)
+        stop(node);
+}
+
+Simulation::MessageKind
+Simulation::messageKind(const uint8_t* data, size_t size)
+{
+    using namespace std::literals;
+    try {
+        auto msg = msgpack::unpack((const char*)data, size);
+        const auto& o = msg.get();
+        if (o.type != msgpack::type::MAP)
+            return MessageKind::Other;
+        std::string_view y, q;
+        for (uint32_t i = 0; i < o.via.map.size; i++) {
+            const auto& kv = o.via.map.ptr[i];
+            if (kv.key.type != msgpack::type::STR or kv.val.type != msgpack::type::STR)
+                continue;
+            std::string_view k(kv.key.via.str.ptr, kv.key.via.str.size);
+            std::string_view v(kv.val.via.str.ptr, kv.val.via.str.size);
+            if (k == "y"sv)
+                y = v;
+            else if (k == "q"sv)
+                q = v;
+        }
+        if (y == "q"sv)
+            return q == "ping"sv ? MessageKind::Other : MessageKind::Request;
+        if (y == "r"sv or y == "e"sv)
+            return MessageKind::Reply;
+    } catch (const std::exception&) {}
+    return MessageKind::Other;
+}
+
+int
+Simulation::send(unsigned from, const SockAddr& dest, const uint8_t* data, size_t size)
+{
+    NodeScope scope(-1);
+    auto to = indexOf(dest);
+    if (to < 0 or (unsigned)to >= nodes_.size())
+        return EHOSTUNREACH;
+    packetsSent_++;
+    bytesSent_ += size;
+
+    auto& sender = nodes_[from];
+    if (sender.lookup >= 0) {
+        auto& lookup = lookups_[sender.lookup];
+        if (messageKind(data, size) == MessageKind::Request) {
+            lookup.requests++;
+            lookup.pending[to] = lookup.rounds + 1;
+        }
+    }
+
+    if (opts_.loss > 0 and std::bernoulli_distribution(opts_.loss)(rd_)) {
+        packetsLost_++;
+        return 0;
+    }
+    auto delay = opts_.latency + sender.access + nodes_[to].access;
+    scheduler_.add(scheduler_.time() + delay, [this, from, to, packet = Blob(data, data + size)] {
+        deliver(from, to, packet);
+    });
+    return 0;
+}
+
+void
+Simulation::deliver(unsigned from, unsigned to, const Blob& data)
+{
+    auto& node = nodes_[to];
+    if (not node.dht) {
+        packetsUndelivered_++;
+        return;
+    }
+    if (node.lookup >= 0) {
+        auto& lookup = lookups_[node.lookup];
+        auto p = lookup.pending.find(from);
+        if (p != lookup.pending.end() and messageKind(data.data(), data.size()) == MessageKind::Reply) {
+            lookup.rounds = std::max(lookup.rounds, p->second);
+            lookup.pending.erase(p);
+        }
+    }
+    wake(node, data.data(), data.size(), address(from));
+}
+
+void
+Simulation::wake(SimNode& node, const uint8_t* data, size_t size, const SockAddr& from)
+{
+    time_point next;
+    {
+        NodeScope scope(node.index);
+        next = node.dht->periodic(data, size, from, scheduler_.time());
+    }
+    if (next == node.wakeupTime)
+        return;
+    node.wakeupTime = next;
+    scheduler_.cancel(node.wakeup);
+    if (next != time_point::max()) {
+        auto index = node.index;
+        node.wakeup = scheduler_.add(std::max(next, scheduler_.time()), [this, index] {
+            auto& n = nodes_[index];
+            n.wakeup.reset();
+            n.wakeupTime = time_point::max();
+            if (n.dht)
+                wake(n);
+        });
+    }
+}
+
+void
+Simulation::start(SimNode& node)
+{
+    {
+        NodeScope scope(node.index);
+        Config config;
+        config.max_req_per_sec = -1;
+        config.max_peer_req_per_sec = -1;
+        config.latency_aware_search = opts_.latency_aware;
+        config.clock = [this]{ return scheduler_.time(); };
+        node.dht = std::make_unique<Dht>(std::make_unique<SimSocket>(*this, node.index), config, Sp<Logger>{},
+                                         std::make_unique<std::mt19937_64>(rd_()));
+        // bootstrap from a few random nodes already online
+        for (unsigned i = 0; i < 3 and i < online_.size(); i++) {
+            auto other = online_[std::uniform_int_distribution<size_t>(0, online_.size() - 1)(rd_)];
+            node.dht->pingNode(address(other));
+        }
+    }
+    online_.emplace_back(node.index);
+    wake(node);
+}
+
+void
+Simulation::stop(SimNode& node)
+{
+    if (not node.dht)
+        return;
+    if (node.lookup >= 0)
+        endLookup(node.lookup, false);
+    {
+        NodeScope scope(node.index);
+        node.dht.reset();
+    }
+    scheduler_.cancel(node.wakeup);
+    node.wakeupTime = time_point::max();
+    online_.erase(std::find(online_.begin(), online_.end(), node.index));
+}
+
+SimNode*
+Simulation::randomNode(bool idle)
+{
+    if (online_.empty())
+        return nullptr;
+    std::uniform_int_distribution<size_t> dist(0, online_.size() - 1);
+    for (unsigned tries = 0; tries < 16; tries++) {
+        auto& node = nodes_[online_[dist(rd_)]];
+        if (not idle or node.lookup < 0)
+            return &node;
+    }
+    return nullptr;
+}
+
+void
+Simulation::scheduleChurn()
+{
+    if (opts_.churn <= 0)
+        return;
+    // departures follow a Poisson process
+    std::exponential_distribution<double> dist(opts_.churn * opts_.nodes / 60.);
+    auto delay = std::chrono::duration_cast<duration>(std::chrono::duration<double>(dist(rd_)));
+    scheduler_.add(scheduler_.time() + delay, [this] {
+        if (auto node = randomNode(true)) {
+            auto index = node->index;
+            stop(*node);
+            departures_++;
+            scheduler_.add(scheduler_.time() + opts_.downtime, [this, index] {
+                start(nodes_[index]);
+            });
+        }
+        scheduleChurn();
+    });
+}
+
+void
+Simulation::startLookup(bool put, unsigned key)
+{
+    auto node = randomNode(true);
+    if (not node) {
+        remaining_--;
+        return;
+    }
+    auto id = (unsigned)lookups_.size();
+    lookups_.emplace_back();
+    auto& lookup = lookups_.back();
+    lookup.put = put;
+    lookup.origin = node->index;
+    lookup.start = scheduler_.time();
+    node->lookup = id;
+    {
+        NodeScope scope(node->index);
+        if (put) {
+            Blob data(64);
+            std::generate(data.begin(), data.end(), [&]{ return (uint8_t)rd_(); });
+            node->dht->put(keys_[key], std::make_shared<Value>(std::move(data)), [this, id](bool ok, const std::vector<Sp<Node>>&) {
+                endLookup(id, ok);
+            });
+        } else {
+            node->dht->get(keys_[key], [this, id](const std::vector<Sp<Value>>&) {
+                auto& l = lookups_[id];
+                if (l.firstValue == time_point::max())
+                    l.firstValue = scheduler_.time();
+                return true;
+            }, [this, id](bool ok, const std::vector<Sp<Node>>&) {
+                endLookup(id, ok);
+            });
+        }
+    }
+    wake(*node);
+}
+
+void
+Simulation::endLookup(unsigned id, bool success)
+{
+    auto& lookup = lookups_[id];
+    if (lookup.done != time_point::max())
+        return;
+    lookup.done = scheduler_.time();
+    lookup.success = success and (lookup.put or lookup.firstValue != time_point::max());
+    lookup.pending.clear();
+    auto& node = nodes_[lookup.origin];
+    if (node.lookup == (int)id)
+        node.lookup = -1;
+    remaining_--;
+}
+
+void
+Simulation::printProgress()
+{
+    std::cerr << "[" << print_duration(scheduler_.time() - begin_) << "] "
+              << online_.size() << " nodes online, "
+              << lookups_.size() << " operations started, "
+              << remaining_ << " remaining" << std::endl;
+}
+
+void
+Simulation::run()
+{
+    using namespace std::chrono;
+    // nodes join during the first half of the warmup
+    std::uniform_int_distribution<duration::rep> join_dist(0, opts_.warmup.count() / 2);
+    for (auto& node : nodes_) {
+        auto t = node.index ? duration(join_dist(rd_)) : duration::zero();
+        scheduler_.add(begin_ + t, [this, &node] { start(node); });
+    }
+    scheduler_.add(begin_ + opts_.warmup, [this] { scheduleChurn(); });
+
+    // puts, then gets of the put keys
+    remaining_ = opts_.keys + opts_.gets;
+    auto interval = duration_cast<duration>(duration<double>(1. / opts_.rate));
+    auto t = begin_ + opts_.warmup;
+    for (unsigned i = 0; i < opts_.keys; i++, t += interval)
+        scheduler_.add(t, [this, i] { startLookup(true, i); });
+    t += seconds(30);
+    std::uniform_int_distribution<unsigned> key_dist(0, opts_.keys ? opts_.keys - 1 : 0);
+    for (unsigned i = 0; i < opts_.gets and opts_.keys; i++, t += interval)
+        scheduler_.add(t, [this, key = key_dist(rd_)] { startLookup(false, key); });
+    if (not opts_.keys)
+        remaining_ = 0;
+    auto deadline = t + opts_.timeout;
+
+    auto nextProgress = begin_;
+    while (true) {
+        auto next = scheduler_.getNextJobTime();
+        if (next > deadline or (remaining_ == 0 and next > t))
+            break;
+        scheduler_.syncTime(next);
+        scheduler_.run();
+        if (next >= nextProgress) {
+            printProgress();
+            nextProgress = next + seconds(30);
+        }
+    }
+    end_ = scheduler_.time();
+
+    for (auto index : online_) {
+        auto stats = nodes_[index].dht->getNodeMessageStats(true);
+        for (size_t i = 0; i < std::min(stats.size(), requestsReceived_.size()); i++)
+            requestsReceived_[i] += stats[i];
+    }
+}
+
+template <typename T>
+static T
+percentile(std::vector<T>& v, double p)
+{
+    if (v.empty())
+        return {};
+    auto n = std::min(v.size() - 1, (size_t)(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + n, v.end());
+    return v[n];
+}
+
+static void
+printDistribution(std::ostream& out, const std::string& name, std::vector<duration> v)
+{
+    if (v.empty())
+        return;
+    out << "  " << name << ": p50 " << print_duration(percentile(v, .5))
+        << ", p90 " << print_duration(percentile(v, .9))
+        << ", p99 " << print_duration(percentile(v, .99))
+        << ", max " << print_duration(*std::max_element(v.begin(), v.end())) << std::endl;
+}
+
+void
+Simulation::report(std::ostream& out) const
+{
+    out << "Simulated " << opts_.nodes << " nodes for " << print_duration(end_ - begin_)
+        << " (seed " << opts_.seed << ")" << std::endl;
+
+    for (bool put : {true, false}) {
+        std::vector<duration> latency, firstValue;
+        std::vector<unsigned> rounds;
+        unsigned count = 0, success = 0, requests = 0;
+        for (const auto& l : lookups_) {
+            if (l.put != put)
+                continue;
+            count++;
+            if (l.done == time_point::max())
+                continue;
+            requests += l.requests;
+            rounds.emplace_back(l.rounds);
+            if (l.success) {
+                success++;
+                latency.emplace_back(l.done - l.start);
+                if (l.firstValue != time_point::max())
+                    firstValue.emplace_back(l.firstValue - l.start);
+            }
+        }
+        if (not count)
+            continue;
+        out << (put ? "Puts" : "Gets") << ": " << success << "/" << count << " succeeded";
+        if (not rounds.empty()) {
+            auto total = std::accumulate(rounds.begin(), rounds.end(), 0u);
+            out << ", " << (double)requests / rounds.size() << " requests per lookup"
+                << ", hops: mean " << (double)total / rounds.size()
+                << ", p90 " << percentile(rounds, .9)
+                << ", max " << *std::max_element(rounds.begin(), rounds.end());
+        }
+        out << std::endl;
+        printDistribution(out, "latency", std::move(latency));
+        printDistribution(out, "first value", std::move(firstValue));
+    }
+
+    out << "Messages: " << packetsSent_ << " packets sent (" << bytesSent_ / 1024 << " KB), "
+        << packetsLost_ << " lost, " << packetsUndelivered_ << " to offline nodes" << std::endl;
+    out << "  requests received: ping " << requestsReceived_[0] << ", find " << requestsReceived_[1]
+        << ", get " << requestsReceived_[2] << ", listen " << requestsReceived_[3]
+        << ", put " << requestsReceived_[4] << std::endl;
+    if (opts_.churn > 0)
+        out << "Churn: " << departures_ << " departures" << std::endl;
+
+    std::vector<int64_t> memory;
+    for (auto index : online_)
+        memory.emplace_back(nodeMemory[index]);
+    if (not memory.empty()) {
+        auto total = std::accumulate(memory.begin(), memory.end(), (int64_t)0);
+        out << "Memory per node: mean " << total / (int64_t)memory.size() / 1024 << " KB"
+            << ", p50 " << percentile(memory, .5) / 1024 << " KB"
+            << ", p90 " << percentile(memory, .9) / 1024 << " KB"
+            << ", max " << *std::max_element(memory.begin(), memory.end()) / 1024 << " KB" << std::endl;
+    }
+}
+
+}
+
+static const constexpr struct option sim_options[] = {
+    {"help",          no_argument,       nullptr, 'h'},
+    {"nodes",         required_argument, nullptr, 'n'},
+    {"keys",          required_argument, nullptr, 'k'},
+    {"gets",          required_argument, nullptr, 'g'},
+    {"rate",          required_argument, nullptr, 'r'},
+    {"latency",       required_argument, nullptr, 'l'},
+    {"jitter",        required_argument, nullptr, 'j'},
+    {"loss",          required_argument, nullptr, 'L'},
+    {"churn",         required_argument, nullptr, 'c'},
+    {"downtime",      required_argument, nullptr, 'd'},
+    {"warmup",        required_argument, nullptr, 'w'},
+    {"seed",          required_argument, nullptr, 's'},
+    {"latency-aware", no_argument,       nullptr, 'a'},
+    {nullptr,         0,                 nullptr,  0}
+};
+
+static sim::Options
+parseSimArgs(int argc, char** argv)
+{
+    using namespace std::chrono;
+    sim::Options opts;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "hn:k:g:r:l:j:L:c:d:w:s:a", sim_options, nullptr)) != -1) {
+        switch (opt) {
+        case 'n': opts.nodes = std::max(1ul, strtoul(optarg, nullptr, 0)); break;
+        case 'k': opts.keys = strtoul(optarg, nullptr, 0); break;
+        case 'g': opts.gets = strtoul(optarg, nullptr, 0); break;
+        case 'r': opts.rate = std::max(.001, strtod(optarg, nullptr)); break;
+        case 'l': opts.latency = milliseconds(strtoul(optarg, nullptr, 0)); break;
+        case 'j': opts.jitter = milliseconds(strtoul(optarg, nullptr, 0)); break;
+        case 'L': opts.loss = strtod(optarg, nullptr); break;
+        case 'c': opts.churn = strtod(optarg, nullptr); break;
+        case 'd': opts.downtime = seconds(strtoul(optarg, nullptr, 0)); break;
+        case 'w': opts.warmup = seconds(strtoul(optarg, nullptr, 0)); break;
+        case 's': opts.seed = strtoull(optarg, nullptr, 0); break;
+        case 'a': opts.latency_aware = true; break;
+        default:  opts.help = true; break;
+        }
+    }
+    return opts;
+}
+
+static void
+print_usage()
+{
+    std::cout << "Usage: dhtsim [options]" << std::endl << std::endl;
+    std::cout << "dhtsim, a deterministic OpenDHT network simulator." << std::endl;
+    std::cout << "Runs the nodes in a single thread and in virtual time, over an in-memory network." << std::endl;
+    std::cout << "Puts values on the keys, then gets them from random nodes, and reports" << std::endl;
+    std::cout << "lookup latencies and hops, message counts and memory usage per node." << std::endl << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  -h, --help               Show this help message and exit." << std::endl;
+    std::cout << "  -n, --nodes <count>      Number of nodes (default 1000)." << std::endl;
+    std::cout << "  -k, --keys <count>       Number of keys to put (default 100)." << std::endl;
+    std::cout << "  -g, --gets <count>       Number of gets (default 1000)." << std::endl;
+    std::cout << "  -r, --rate <ops/s>       Operations started per second (default 20)." << std::endl;
+    std::cout << "  -l, --latency <ms>       Base one-way latency (default 40)." << std::endl;
+    std::cout << "  -j, --jitter <ms>        Maximum access latency of each node, added at both ends (default 40)." << std::endl;
+    std::cout << "  -L, --loss <ratio>       Packet loss probability (default 0)." << std::endl;
+    std::cout << "  -c, --churn <ratio>      Part of the nodes leaving per minute (default 0)." << std::endl;
+    std::cout << "  -d, --downtime <s>       Time before a node that left comes back with a new ID (default 60)." << std::endl;
+    std::cout << "  -w, --warmup <s>         Time for the nodes to join before the first put (default 120)." << std::endl;
+    std::cout << "  -s, --seed <seed>        Seed of the simulation (default 0)." << std::endl;
+    std::cout << "  -a, --latency-aware      Enable latency-aware searches." << std::endl;
+    std::cout << std::endl << "Report bugs to: https://opendht.net" << std::endl;
+}
+
+int
+main(int argc, char** argv)
+{
+    auto opts = parseSimArgs(argc, argv);
+    if (opts.help) {
+        print_usage();
+        return 0;
+    }
+    sim::Simulation simulation(opts);
+    simulation.run();
+    simulation.report(std::cout);
+    return 0;
+}
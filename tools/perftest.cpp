@@ -22,6 +22,12 @@
 
 #include "tools_common.h"
 #include <opendht/node.h>
+#include <opendht/coroutine.h>
+#include <opendht/identity_factory.h>
+#ifdef OPENDHT_PROXY_SERVER
+#include <opendht/dht_proxy_server.h>
+#include <opendht/http.h>
+#endif
 
 extern "C" {
 #include <gnutls/gnutls.h>
@@ -29,13 +35,90 @@ extern "C" {
 #include <condition_variable>
 #include <mutex>
 #include <atomic>
+#include <algorithm>
+#include <map>
+#include <thread>
+#include <future>
 
 void print_usage() {
-    std::cout << "Usage: perftest" << std::endl << std::endl;
+    std::cout << "Usage: perftest [options]" << std::endl << std::endl;
     std::cout << "perftest, a simple OpenDHT basic performance tester." << std::endl;
+    std::cout << "Runs the ping-pong benchmark, and optionally:" << std::endl;
+    std::cout << "  -g, --get-latency   get latency with and without latency-aware search" << std::endl;
+    std::cout << "  -c, --coroutines    concurrent gets with futures and coroutines" << std::endl;
+    std::cout << "  -s, --crypto        signature and decryption throughput" << std::endl;
+    std::cout << "  -i, --identity      first put with blocking and asynchronous identity generation" << std::endl;
+    std::cout << "  -t, --tls           TLS handshakes with and without session resumption" << std::endl;
+    std::cout << "  -a, --all           all of the above" << std::endl;
     std::cout << "Report bugs to: https://opendht.net" << std::endl;
 }
+
+static const constexpr struct option perftest_options[] = {
+    {"help",                no_argument      , nullptr, 'h'},
+    {"get-latency",         no_argument      , nullptr, 'g'},
+    {"coroutines",          no_argument      , nullptr, 'c'},
+    {"crypto",              no_argument      , nullptr, 's'},
+    {"identity",            no_argument      , nullptr, 'i'},
+    {"tls",                 no_argument      , nullptr, 't'},
+    {"all",                 no_argument      , nullptr, 'a'},
+    {nullptr,               0                , nullptr,  0}
+};
+
+struct perftest_params {
+    bool help {false};
+    bool get_latency {false};
+    bool coroutines {false};
+    bool crypto {false};
+    bool identity {false};
+    bool tls {false};
+};
+
+perftest_params
+parsePerftestArgs(int argc, char **argv) {
+    perftest_params params;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "hgcsita", perftest_options, nullptr)) != -1) {
+        switch (opt) {
+        case 'h':
+            params.help = true;
+            break;
+        case 'g':
+            params.get_latency = true;
+            break;
+        case 'c':
+            params.coroutines = true;
+            break;
+        case 's':
+            params.crypto = true;
+            break;
+        case 'i':
+            params.identity = true;
+            break;
+        case 't':
+            params.tls = true;
+            break;
+        case 'a':
+            params.get_latency = params.coroutines = params.crypto = params.identity = params.tls = true;
+            break;
+        default:
+            break;
+        }
+    }
+    return params;
+}
+
 constexpr unsigned PINGPONG_MAX = 2048;
+constexpr unsigned LATENCY_NET_SIZE = 32;
+constexpr unsigned LATENCY_GET_COUNT = 128;
+constexpr unsigned SIGNATURE_COUNT = 256;
+#ifdef OPENDHT_COROUTINES
+constexpr unsigned CONCURRENT_GET_COUNT = 4096;
+constexpr unsigned CONCURRENT_GET_KEYS = 64;
+#endif
+#ifdef OPENDHT_PROXY_SERVER
+constexpr unsigned HANDSHAKE_COUNT = 256;
+constexpr in_port_t HANDSHAKE_PORT = 8443;
+#endif
 using namespace dht;
 
 namespace tests {
@@ -127,6 +210,376 @@ benchPingPong(unsigned netSize, unsigned n_parallel) {
     return end-start;
 }
 
+/**
+ * UDP socket delaying every sent packet, to simulate nodes with
+ * different network latencies on the loopback interface.
+ */
+class DelayedSocket : public net::DatagramSocket {
+public:
+    DelayedSocket(duration delay) : sock_(std::make_unique<net::UdpSocket>(0)), delay_(delay) {
+        sock_->setOnReceive([this](net::PacketList&& packets) {
+            onReceived(std::move(packets));
+            return net::PacketList {};
+        });
+        thread_ = std::thread([this]{ loop(); });
+    }
+    ~DelayedSocket() {
+        stop();
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    int sendTo(const SockAddr& dest, const uint8_t* data, size_t size, bool replied) override {
+        std::lock_guard<std::mutex> lk(queueLock_);
+        queue_.emplace(clock::now() + delay_, Packet {dest, Blob(data, data + size), replied});
+        cv_.notify_one();
+        return 0;
+    }
+    bool hasIPv4() const override { return sock_->hasIPv4(); }
+    bool hasIPv6() const override { return sock_->hasIPv6(); }
+    const SockAddr& getBoundRef(sa_family_t family = AF_UNSPEC) const override {
+        return sock_->getBoundRef(family);
+    }
+    void stop() override {
+        {
+            std::lock_guard<std::mutex> lk(queueLock_);
+            running_ = false;
+        }
+        cv_.notify_all();
+        sock_->stop();
+    }
+
+private:
+    struct Packet {
+        SockAddr dest;
+        Blob data;
+        bool replied;
+    };
+
+    void loop() {
+        std::unique_lock<std::mutex> lk(queueLock_);
+        while (running_) {
+            if (queue_.empty()) {
+                cv_.wait(lk);
+                continue;
+            }
+            auto next = queue_.begin();
+            if (next->first > clock::now()) {
+                cv_.wait_until(lk, next->first);
+                continue;
+            }
+            auto pkt = std::move(next->second);
+            queue_.erase(next);
+            lk.unlock();
+            sock_->sendTo(pkt.dest, pkt.data.data(), pkt.data.size(), pkt.replied);
+            lk.lock();
+        }
+    }
+
+    std::unique_ptr<net::UdpSocket> sock_;
+    const duration delay_;
+    std::mutex queueLock_;
+    std::condition_variable cv_;
+    std::multimap<clock::time_point, Packet> queue_;
+    bool running_ {true};
+    std::thread thread_;
+};
+
+struct GetLatency {
+    duration first_value;
+    duration done;
+};
+
+/**
+ * Sequential gets on a simulated network where a quarter of the nodes
+ * reply slowly. Returns the time to the first value and to completion of
+ * each get.
+ */
+std::vector<GetLatency>
+benchGetLatency(bool latencyAware) {
+    DhtRunner::Config config {};
+    config.dht_config.node_config.max_peer_req_per_sec = -1;
+    config.dht_config.node_config.max_req_per_sec = -1;
+
+    std::vector<std::unique_ptr<DhtRunner>> nodes;
+    nodes.reserve(LATENCY_NET_SIZE);
+    for (unsigned i=0; i<LATENCY_NET_SIZE; i++) {
+        DhtRunner::Context context {};
+        auto delay = i % 4 == 3 ? std::chrono::milliseconds(250) : std::chrono::milliseconds(5);
+        context.sock = std::make_unique<DelayedSocket>(delay);
+        auto node = std::make_unique<DhtRunner>();
+        node->run(config, std::move(context));
+        if (not nodes.empty())
+            node->bootstrap(nodes.front()->getBound());
+        nodes.emplace_back(std::move(node));
+    }
+
+    auto clientConfig = config;
+    clientConfig.dht_config.node_config.latency_aware_search = latencyAware;
+    DhtRunner client;
+    client.run(0, clientConfig);
+    client.bootstrap(nodes.front()->getBound());
+
+    std::vector<InfoHash> keys;
+    keys.reserve(LATENCY_GET_COUNT);
+    for (unsigned i=0; i<LATENCY_GET_COUNT; i++) {
+        keys.emplace_back(InfoHash::get("latency" + std::to_string(i)));
+        std::promise<bool> p;
+        nodes[i % LATENCY_NET_SIZE]->put(keys.back(), Value("hey"), [&](bool ok){ p.set_value(ok); });
+        p.get_future().wait();
+    }
+
+    // Let the client measure round-trip times
+    for (unsigned i=0; i<8; i++)
+        client.get(InfoHash::getRandom()).wait();
+
+    std::vector<GetLatency> results;
+    results.reserve(LATENCY_GET_COUNT);
+    for (const auto& key : keys) {
+        std::promise<void> done;
+        clock::time_point firstValue {};
+        auto start = clock::now();
+        client.get(key, [&](const std::vector<std::shared_ptr<Value>>&) {
+            if (firstValue == clock::time_point {})
+                firstValue = clock::now();
+            return true;
+        }, [&](bool) {
+            done.set_value();
+        });
+        done.get_future().wait();
+        auto end = clock::now();
+        if (firstValue == clock::time_point {})
+            firstValue = end;
+        results.emplace_back(GetLatency {firstValue - start, end - start});
+    }
+
+    client.shutdown();
+    for (auto& node : nodes)
+        node->shutdown();
+    client.join();
+    for (auto& node : nodes)
+        node->join();
+    return results;
+}
+
+duration
+percentile(std::vector<duration> values, double p) {
+    if (values.empty())
+        return duration::zero();
+    std::sort(values.begin(), values.end());
+    auto i = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    return values[i];
+}
+
+#ifdef OPENDHT_COROUTINES
+coro::Task
+coroGet(DhtRunner& node, InfoHash key, std::atomic_uint& pending, std::promise<void>& done) {
+    co_await coro::get(node, key);
+    if (--pending == 0)
+        done.set_value();
+}
+
+/**
+ * Many concurrent gets, awaited with the future-based API and with
+ * coroutines. Returns both durations.
+ */
+std::pair<duration, duration>
+benchConcurrentGets(unsigned n) {
+    DhtRunner::Config config {};
+    config.dht_config.node_config.max_peer_req_per_sec = -1;
+    config.dht_config.node_config.max_req_per_sec = -1;
+
+    DhtRunner node, client;
+    node.run(0, config);
+    client.run(0, config);
+    client.bootstrap(node.getBound());
+
+    std::vector<InfoHash> keys;
+    keys.reserve(CONCURRENT_GET_KEYS);
+    for (unsigned i=0; i<CONCURRENT_GET_KEYS; i++) {
+        keys.emplace_back(InfoHash::get("concurrent" + std::to_string(i)));
+        std::promise<bool> p;
+        node.put(keys.back(), Value("hey"), [&](bool ok){ p.set_value(ok); });
+        p.get_future().wait();
+    }
+
+    auto start = clock::now();
+    std::vector<std::future<std::vector<std::shared_ptr<Value>>>> futures;
+    futures.reserve(n);
+    for (unsigned i=0; i<n; i++)
+        futures.emplace_back(client.get(keys[i % keys.size()]));
+    for (auto& f : futures)
+        f.wait();
+    auto futuresTime = clock::now() - start;
+
+    start = clock::now();
+    std::atomic_uint pending {n};
+    std::promise<void> done;
+    for (unsigned i=0; i<n; i++)
+        coroGet(client, keys[i % keys.size()], pending, done);
+    done.get_future().wait();
+    auto coroTime = clock::now() - start;
+
+    client.shutdown();
+    node.shutdown();
+    client.join();
+    node.join();
+    return {futuresTime, coroTime};
+}
+#endif
+
+struct SignatureBench {
+    duration sign;
+    duration verify;
+    size_t packed_size;
+};
+
+/**
+ * Signs and verifies n values with the given key.
+ * Verification uses fresh copies of the values so that results aren't cached.
+ */
+SignatureBench
+benchSignatures(const crypto::PrivateKey& key, unsigned n) {
+    std::vector<Sp<Value>> values;
+    values.reserve(n);
+    for (unsigned i=0; i<n; i++)
+        values.emplace_back(std::make_shared<Value>(Blob(32, (uint8_t)i)));
+
+    SignatureBench result;
+    auto start = clock::now();
+    for (auto& v : values)
+        v->sign(key);
+    result.sign = clock::now() - start;
+
+    std::vector<Blob> packed;
+    packed.reserve(n);
+    for (const auto& v : values)
+        packed.emplace_back(packMsg(*v));
+    result.packed_size = packed.front().size();
+    std::vector<Sp<Value>> received;
+    received.reserve(n);
+    for (const auto& p : packed)
+        received.emplace_back(std::make_shared<Value>(msgpack::unpack((const char*)p.data(), p.size()).get()));
+
+    start = clock::now();
+    for (const auto& v : received)
+        if (not v->checkSignature())
+            throw std::runtime_error("Signature verification failed");
+    result.verify = clock::now() - start;
+    return result;
+}
+
+/**
+ * Decrypts n encrypted values, as done by SecureDht::checkValue for each
+ * received value. Returns the total time and the size of an encrypted value.
+ */
+std::pair<duration, size_t>
+benchDecrypt(const crypto::PrivateKey& key, unsigned n) {
+    auto sender = crypto::PrivateKey::generateEd25519();
+    std::vector<Sp<Value>> values;
+    values.reserve(n);
+    for (unsigned i=0; i<n; i++) {
+        Value v {Blob(32, (uint8_t)i)};
+        values.emplace_back(std::make_shared<Value>(v.encrypt(sender, key.getPublicKey())));
+    }
+    auto start = clock::now();
+    for (const auto& v : values)
+        if (not v->decrypt(key))
+            throw std::runtime_error("Decryption failed");
+    return {clock::now() - start, packMsg(*values.front()).size()};
+}
+
+struct StartupTime {
+    duration first_put;
+    duration identity;
+};
+
+/**
+ * Starts a node with a new RSA identity and puts a value.
+ * If async, the node runs unsigned while the identity is generated
+ * by IdentityFactory; otherwise, startup waits for generateIdentity.
+ */
+StartupTime
+benchFirstPut(const SockAddr& bootstrap, bool async) {
+    StartupTime result {};
+    DhtRunner node;
+    auto start = clock::now();
+    std::future<void> identityReady;
+    std::unique_ptr<crypto::IdentityFactory> factory;
+    if (async) {
+        factory = std::make_unique<crypto::IdentityFactory>(0);
+        auto ready = std::make_shared<std::promise<void>>();
+        identityReady = ready->get_future();
+        node.run(0);
+        factory->getIdentity([&node, ready](const crypto::Identity& id, std::exception_ptr) {
+            node.setIdentity(id);
+            ready->set_value();
+        });
+    } else {
+        node.run(0, crypto::generateIdentity());
+        result.identity = clock::now() - start;
+    }
+    node.bootstrap(bootstrap);
+    std::promise<bool> p;
+    node.put(InfoHash::get("startup"), Value("hey"), [&](bool ok){ p.set_value(ok); });
+    p.get_future().wait();
+    result.first_put = clock::now() - start;
+    if (async) {
+        identityReady.wait();
+        result.identity = clock::now() - start;
+    }
+    node.shutdown();
+    node.join();
+    return result;
+}
+
+#ifdef OPENDHT_PROXY_SERVER
+/**
+ * Sequential https requests to a local proxy server, each on a new connection,
+ * optionally resuming TLS sessions.
+ */
+duration
+benchTlsHandshakes(const crypto::Identity& identity, unsigned n, bool resume, http::TlsSessionCache::Stats& stats) {
+    auto node = std::make_shared<DhtRunner>();
+    node->run(0);
+    ProxyServerConfig serverConfig;
+    serverConfig.port = HANDSHAKE_PORT;
+    serverConfig.identity = identity;
+    DhtProxyServer server(node, serverConfig);
+
+    auto cache = std::make_shared<http::TlsSessionCache>();
+    const std::string url = "https://localhost:" + std::to_string(HANDSHAKE_PORT) + "/";
+    std::condition_variable cv;
+    std::mutex m;
+    unsigned done {0};
+    unsigned failed {0};
+
+    auto start = clock::now();
+    for (unsigned i=0; i<n; i++) {
+        auto request = std::make_shared<http::Request>(server.io_context(), url, [&](const http::Response& response){
+            std::lock_guard<std::mutex> lk(m);
+            if (response.status_code != 200)
+                failed++;
+            done++;
+            cv.notify_one();
+        });
+        request->set_certificate_authority(identity.second);
+        if (resume)
+            request->set_session_cache(cache);
+        request->send();
+        std::unique_lock<std::mutex> lk(m);
+        if (not cv.wait_for(lk, std::chrono::seconds(10), [&](){ return done == i+1; }))
+            throw std::runtime_error(std::string("Timeout: ") + std::to_string(i));
+    }
+    auto end = clock::now();
+
+    if (failed)
+        std::cout << failed << " requests failed" << std::endl;
+    stats = cache->getStats();
+    return end-start;
+}
+#endif
+
 }
 
 int
@@ -135,7 +588,7 @@ main(int argc, char **argv)
 #ifdef _MSC_VER
     gnutls_global_init();
 #endif
-    auto params = parseArgs(argc, argv);
+    auto params = parsePerftestArgs(argc, argv);
     if (params.help) {
         print_usage();
         return 0;
@@ -173,6 +626,88 @@ main(int argc, char **argv)
     std::cout << print_duration(totalTime/totalOps) << " per rt, "
             << totalOps/std::chrono::duration<double>(totalTime).count() << " ping per s" << std::endl << std::endl;
 
+    if (params.get_latency) {
+        for (bool latencyAware : {false, true}) {
+            auto results = tests::benchGetLatency(latencyAware);
+            std::vector<duration> firstValue, done;
+            for (const auto& r : results) {
+                firstValue.emplace_back(r.first_value);
+                done.emplace_back(r.done);
+            }
+            std::cout << results.size() << " gets " << (latencyAware ? "with" : "without") << " latency-aware search" << std::endl;
+            std::cout << "first value: p50 " << print_duration(tests::percentile(firstValue, .5))
+                      << ", p99 " << print_duration(tests::percentile(firstValue, .99)) << std::endl;
+            std::cout << "done: p50 " << print_duration(tests::percentile(done, .5))
+                      << ", p99 " << print_duration(tests::percentile(done, .99)) << std::endl << std::endl;
+        }
+    }
+
+#ifdef OPENDHT_COROUTINES
+    if (params.coroutines) {
+        auto [futuresTime, coroTime] = tests::benchConcurrentGets(CONCURRENT_GET_COUNT);
+        std::cout << CONCURRENT_GET_COUNT << " concurrent gets" << std::endl;
+        std::cout << "futures: " << print_duration(futuresTime) << ", "
+                  << CONCURRENT_GET_COUNT/std::chrono::duration<double>(futuresTime).count() << " gets per s" << std::endl;
+        std::cout << "coroutines: " << print_duration(coroTime) << ", "
+                  << CONCURRENT_GET_COUNT/std::chrono::duration<double>(coroTime).count() << " gets per s" << std::endl << std::endl;
+    }
+#endif
+
+    if (params.crypto) {
+        for (const auto& k : std::vector<std::pair<std::string, std::function<crypto::PrivateKey()>>> {
+                {"RSA-4096", []{ return crypto::PrivateKey::generate(); }},
+                {"ECDSA P-521", []{ return crypto::PrivateKey::generateEC(); }},
+                {"Ed25519", []{ return crypto::PrivateKey::generateEd25519(); }}}) {
+            auto key = k.second();
+            auto r = tests::benchSignatures(key, SIGNATURE_COUNT);
+            std::cout << k.first << " signed values: " << r.packed_size << " bytes packed" << std::endl;
+            std::cout << "sign: " << print_duration(r.sign/SIGNATURE_COUNT) << " per value, "
+                      << SIGNATURE_COUNT/std::chrono::duration<double>(r.sign).count() << " per s" << std::endl;
+            std::cout << "verify: " << print_duration(r.verify/SIGNATURE_COUNT) << " per value, "
+                      << SIGNATURE_COUNT/std::chrono::duration<double>(r.verify).count() << " per s" << std::endl << std::endl;
+        }
+
+        for (const auto& k : std::vector<std::pair<std::string, std::function<crypto::PrivateKey()>>> {
+                {"RSA-4096", []{ return crypto::PrivateKey::generate(); }},
+                {"X25519 (Ed25519 key)", []{ return crypto::PrivateKey::generateEd25519(); }}}) {
+            auto key = k.second();
+            auto [dt, size] = tests::benchDecrypt(key, SIGNATURE_COUNT);
+            std::cout << k.first << " encrypted values: " << size << " bytes packed" << std::endl;
+            std::cout << "decrypt: " << print_duration(dt/SIGNATURE_COUNT) << " per value, "
+                      << SIGNATURE_COUNT/std::chrono::duration<double>(dt).count() << " per s" << std::endl << std::endl;
+        }
+    }
+
+    if (params.identity) {
+        DhtRunner bootstrap;
+        bootstrap.run(0);
+        for (bool async : {false, true}) {
+            auto r = tests::benchFirstPut(bootstrap.getBound(), async);
+            std::cout << "Startup with " << (async ? "asynchronous" : "blocking") << " identity generation" << std::endl;
+            std::cout << "first put: " << print_duration(r.first_put)
+                      << ", identity ready: " << print_duration(r.identity) << std::endl << std::endl;
+        }
+        bootstrap.shutdown();
+        bootstrap.join();
+    }
+
+#ifdef OPENDHT_PROXY_SERVER
+    if (params.tls) {
+        auto identity = crypto::generateIdentity("localhost");
+        for (bool resume : {false, true}) {
+            http::TlsSessionCache::Stats stats;
+            auto dt = tests::benchTlsHandshakes(identity, HANDSHAKE_COUNT, resume, stats);
+            std::cout << "TLS handshakes " << (resume ? "with" : "without") << " session resumption" << std::endl;
+            std::cout << HANDSHAKE_COUNT << " requests done, took " << print_duration(dt) << std::endl;
+            std::cout << print_duration(dt/HANDSHAKE_COUNT) << " per request, "
+                    << HANDSHAKE_COUNT/std::chrono::duration<double>(dt).count() << " handshakes per s";
+            if (resume)
+                std::cout << " (" << stats.resumed << " resumed, " << stats.full << " full)";
+            std::cout << std::endl << std::endl;
+        }
+    }
+#endif
+
 #ifdef _MSC_VER
     gnutls_global_deinit();
 #endif
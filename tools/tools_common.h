@@ -145,6 +145,7 @@ struct dht_params {
     in_port_t port {0};
     in_port_t proxyserver {0};
     in_port_t proxyserverssl {0};
+    bool proxy_metrics {false};
     std::string proxyclient {};
     std::string proxy_address {};
     std::string pushserver {};
@@ -244,6 +245,7 @@ static const constexpr struct option long_options[] = {
     {"proxyserver",             required_argument, nullptr, 'S'},
     {"proxyserverssl",          required_argument, nullptr, 'e'},
     {"proxy-addr",              required_argument, nullptr, 'a'},
+    {"proxy-metrics",           no_argument      , nullptr, 'T'},
     {"proxy-certificate",       required_argument, nullptr, 'w'},
     {"proxy-privkey",           required_argument, nullptr, 'K'},
     {"proxy-privkey-password",  required_argument, nullptr, 'M'},
@@ -311,6 +313,9 @@ parseArgs(int argc, char **argv) {
         case 'U':
             params.no_rate_limit = true;
             break;
+        case 'T':
+            params.proxy_metrics = true;
+            break;
         case 'P':
             params.public_stable = true;
             break;